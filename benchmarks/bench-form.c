@@ -0,0 +1,86 @@
+// Form decoding benchmark: a ~10KB application/x-www-form-urlencoded body with hundreds of fields
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+
+#define HTTPP_IMPLEMENTATION
+#include "../httpp_form.h"
+
+#define FIELDS 400
+
+static char form[16 * 1024];
+static size_t form_len;
+
+static void build_form()
+{
+    for (int i = 0; i < FIELDS; i++) {
+        // Mix of plain, '+' and percent encoded fields, like real form posts
+        const char* fmt = i % 3 == 0 ? "%sfield_%d=plain_value_%d"
+                        : i % 3 == 1 ? "%sfield+%d=hello+world+%d"
+                        :              "%sfield%%5B%d%%5D=caf%%C3%%A9+%d";
+
+        form_len += sprintf(form + form_len, fmt, i ? "&" : "", i, i);
+    }
+}
+
+double benchmark(const char* name, int find)
+{
+    char buf[sizeof(form)];
+    size_t fields = 0;
+    int i;
+    double start, end;
+
+    start = (double)clock()/CLOCKS_PER_SEC;
+    for (i = 0; i < ITERATIONS; ++i) {
+        // Decoding is in place, every iteration starts from the encoded body
+        memcpy(buf, form, form_len);
+        httpp_span_t body = {buf, form_len, false};
+        httpp_form_field_t f;
+
+        if (find) {
+            assert(httpp_form_find(&body, name, &f) && httpp_form_decode(&f));
+            fields++;
+            continue;
+        }
+
+        httpp_form_iter_t it;
+        httpp_form_iter_init(&it, &body);
+
+        while (httpp_form_next(&it, &f)) {
+            assert(httpp_form_decode(&f));
+            fields++;
+        }
+    }
+    end = (double)clock()/CLOCKS_PER_SEC;
+
+    assert(fields == (size_t) ITERATIONS * (find ? 1 : FIELDS));
+    return end - start;
+}
+
+void run(const char* title, const char* name, int find)
+{
+    double total = 0.0;
+
+    for (int i = 0; i < RUNS; i++)
+        total += benchmark(name, find);
+
+    double avg = total / RUNS;
+
+    printf("%s:\n", title);
+    printf(" Average elapsed time %f\n", avg);
+    printf(" Forms per second ≈ %.2f\n", (double) ITERATIONS / avg);
+    printf(" Throughput ≈ %.2f MB/s\n\n", (double) ITERATIONS * form_len / avg / (1024 * 1024));
+}
+
+int main()
+{
+    build_form();
+    printf("Form: %zu bytes, %d fields\n\n", form_len, FIELDS);
+
+    run("Iterate and decode every field", NULL, 0);
+    run("Find the last field by name", "field_399", 1);
+
+    return 0;
+}
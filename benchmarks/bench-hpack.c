@@ -0,0 +1,117 @@
+// HPACK decoding (httpp_hpack.h) of a browser request, compared with parsing it as HTTP/1.1
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+
+#define HTTPP_IMPLEMENTATION
+#include "../httpp_hpack.h"
+
+// First request on a connection: every field Huffman coded and added to the dynamic table
+static const unsigned char first[] = {
+    0x82, 0x87, 0x44, 0x89, 0x62, 0xbb, 0x0f, 0x25, 0xa4, 0x4a, 0x18, 0x68, 0x5f, 0x41, 0x8c, 0x44,
+    0xe7, 0xad, 0x72, 0xf9, 0x1d, 0x35, 0xd0, 0x55, 0xc8, 0x7a, 0x7f, 0x7a, 0xb5, 0xd0, 0x7f, 0x66,
+    0xa2, 0x81, 0xb0, 0xda, 0xe0, 0x53, 0xfa, 0xfc, 0x08, 0x7e, 0xd4, 0xce, 0x6a, 0xad, 0xf2, 0xa7,
+    0x97, 0x9c, 0x89, 0xc6, 0xbe, 0xd4, 0xb3, 0xbd, 0xc0, 0x89, 0xe5, 0xc1, 0xfd, 0xa9, 0x88, 0xa4,
+    0xea, 0x76, 0x04, 0x00, 0x80, 0x01, 0x00, 0x54, 0xc2, 0x6b, 0x0b, 0x29, 0xfc, 0xb0, 0x11, 0x3c,
+    0xb8, 0x3f, 0x53, 0xb0, 0x49, 0x7c, 0xa5, 0x89, 0xd3, 0x4d, 0x1f, 0x43, 0xae, 0xba, 0x0c, 0x41,
+    0xa4, 0xc7, 0xa9, 0x8f, 0x33, 0xa6, 0x9a, 0x3f, 0xdf, 0x9a, 0x68, 0xfa, 0x1d, 0x75, 0xd0, 0x62,
+    0x0d, 0x26, 0x3d, 0x4c, 0x79, 0xa6, 0x8f, 0xbe, 0xd0, 0x01, 0x77, 0xfe, 0xbe, 0x58, 0xf9, 0xfb,
+    0xed, 0x00, 0x17, 0x7b, 0x51, 0x8b, 0x2d, 0x4b, 0x70, 0xdd, 0xf4, 0x5a, 0xbe, 0xfb, 0x40, 0x05,
+    0xdb, 0x50, 0x92, 0x9b, 0xd9, 0xab, 0xfa, 0x52, 0x42, 0xcb, 0x40, 0xd2, 0x5f, 0xa5, 0x23, 0xb3,
+    0xe9, 0x4f, 0x68, 0x4c, 0x9f, 0x60, 0xbd, 0x41, 0x50, 0x83, 0x1e, 0xa8, 0x1d, 0x95, 0xf2, 0x0a,
+    0x31, 0xb4, 0x57, 0x9e, 0x95, 0xe1, 0x3b, 0x23, 0x81, 0x70, 0x0d, 0x36, 0xd8, 0x1d, 0x70, 0x0d,
+    0xbc, 0xdb, 0x25, 0xfb, 0x51, 0x33, 0x96, 0x92, 0xc1, 0x20, 0xec, 0xeb, 0xf6, 0xa4, 0x53, 0x0e,
+    0x0c, 0x50, 0x85, 0x70, 0xae, 0x11, 0x32, 0xd3, 0x6e, 0x3a, 0xf3, 0xe0, 0x5c, 0x2e, 0x80, 0x00,
+    0x00, 0x00, 0x00, 0x7f, 0x40, 0x8a, 0x41, 0x48, 0xb4, 0xa5, 0x49, 0x27, 0x5a, 0x42, 0xa1, 0x3f,
+    0x86, 0x90, 0xe4, 0xb6, 0x92, 0xd4, 0x9f, 0x40, 0x8a, 0x41, 0x48, 0xb4, 0xa5, 0x49, 0x27, 0x5a,
+    0x93, 0xc8, 0x5f, 0x86, 0xa8, 0x7d, 0xcd, 0x30, 0xd2, 0x5f, 0x40, 0x8a, 0x41, 0x48, 0xb4, 0xa5,
+    0x49, 0x27, 0x59, 0x06, 0x49, 0x7f, 0x88, 0x40, 0xe9, 0x2a, 0xc7, 0xb0, 0xd3, 0x1a, 0xaf
+};
+
+// Next request: a new :path, every other field indexed
+static const unsigned char next[] = {
+    0x82, 0x87, 0x04, 0x89, 0x62, 0xbb, 0x0f, 0x25, 0xa4, 0x4a, 0x18, 0x69, 0x9f, 0xc6, 0xc5, 0xc4,
+    0xc3, 0xc2, 0xc1, 0xc0, 0xbf, 0xbe
+};
+
+static char http1[] =
+    "GET /products/42 HTTP/1.1\r\n"
+    "Host: shop.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Cookie: session=7f9c2ba4e88f827d616045507605853e; theme=dark; _ga=GA1.1.1234567890.1700000000\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "\r\n";
+
+static httpp_hpack_t hp;
+static char arena[4096];
+
+static void report(const char* name, double total)
+{
+    printf("%s:\n", name);
+    printf(" Average elapsed time %f\n", total / RUNS);
+    printf(" Requests per second ≈ %.2f\n\n", (double) ITERATIONS / (total / RUNS));
+}
+
+double parse_http1()
+{
+    double start, end;
+
+    start = (double)clock()/CLOCKS_PER_SEC;
+    for (int i = 0; i < ITERATIONS; ++i) {
+        HTTPP_NEW_REQ(req, 32);
+        assert(httpp_parse_request(http1, sizeof(http1) - 1, &req) > 0);
+    }
+    end = (double)clock()/CLOCKS_PER_SEC;
+    return end - start;
+}
+
+double decode(const unsigned char* block, size_t len, bool warm)
+{
+    double start, end;
+
+    start = (double)clock()/CLOCKS_PER_SEC;
+    for (int i = 0; i < ITERATIONS; ++i) {
+        HTTPP_NEW_REQ(req, 32);
+
+        if (!warm)
+            httpp_hpack_init(&hp);
+
+        assert(httpp_hpack_decode(&hp, (const char*) block, len, &req, arena, sizeof(arena)) >= 0);
+        assert(req.headers.length == 9);
+    }
+    end = (double)clock()/CLOCKS_PER_SEC;
+    return end - start;
+}
+
+int main()
+{
+    double total = 0.0;
+    HTTPP_NEW_REQ(req, 32);
+
+    for (int i = 0; i < RUNS; i++)
+        total += parse_http1();
+    report("httpp_parse_request, HTTP/1.1", total);
+
+    total = 0.0;
+    for (int i = 0; i < RUNS; i++)
+        total += decode(first, sizeof(first), false);
+    report("httpp_hpack_decode, first request (Huffman literals)", total);
+
+    // The table now has what the first request added, the next one only refers to it
+    httpp_hpack_init(&hp);
+    assert(httpp_hpack_decode(&hp, (const char*) first, sizeof(first), &req, arena, sizeof(arena)) >= 0);
+
+    total = 0.0;
+    for (int i = 0; i < RUNS; i++)
+        total += decode(next, sizeof(next), true);
+    report("httpp_hpack_decode, next request (indexed)", total);
+
+    return 0;
+}
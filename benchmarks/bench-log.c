@@ -0,0 +1,105 @@
+// One combined access log line per request: httpp_span_to_str for every field and
+// fprintf, or httpp_log_write into a buffer written out in large batches
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+
+#define HTTPP_POSIX
+#define HTTPP_IMPLEMENTATION
+#include "../httpp_log.h"
+
+static char raw[] =
+    "GET /api/v1/orders?limit=20&cursor=eyJpZCI6MTIzfQ HTTP/1.1\r\n"
+    "Host: api.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+    "Accept: application/json\r\n"
+    "Referer: https://www.example.com/orders/overview\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+static char mem[64 * 1024];
+
+// Same line as HTTPP_LOG_COMBINED, without escaping
+static void log_fprintf(FILE* f, httpp_req_t* req, httpp_span_t* addr, time_t t)
+{
+    char* remote = httpp_span_to_str(addr);
+    char* route = httpp_span_to_str(&req->route);
+    char* version = httpp_span_to_str(&req->version);
+    httpp_header_t* ref = httpp_find_header(*req, "referer");
+    httpp_header_t* ua = httpp_find_header(*req, "user-agent");
+    char* referer = ref ? httpp_span_to_str(&ref->value) : NULL;
+    char* agent = ua ? httpp_span_to_str(&ua->value) : NULL;
+    char  date[32];
+    struct tm tm;
+
+    gmtime_r(&t, &tm);
+    strftime(date, sizeof(date), "%d/%b/%Y:%H:%M:%S +0000", &tm);
+
+    fprintf(f, "%s - - [%s] \"%s %s %s\" %d %zu \"%s\" \"%s\"\n", remote, date,
+            httpp_method_to_string(req->method), route, version, 200, (size_t) 1234,
+            referer ? referer : "-", agent ? agent : "-");
+
+    free(remote);
+    free(route);
+    free(version);
+    free(referer);
+    free(agent);
+}
+
+double format(bool batched)
+{
+    double start, end;
+    httpp_span_t addr = {"203.0.113.195", 13, false};
+    httpp_log_format_t fmt;
+    httpp_log_t log;
+    int   fd = open("/dev/null", O_WRONLY);
+    FILE* f = fopen("/dev/null", "w");
+    time_t now = time(NULL);
+
+    assert(fd >= 0 && f != NULL);
+    assert(httpp_log_format_init(&fmt, HTTPP_LOG_COMBINED, HTTPP_LOG_ESCAPE_DEFAULT));
+    httpp_log_init(&log, mem, sizeof(mem), fd);
+
+    HTTPP_NEW_REQ(req, 32);
+    assert(httpp_parse_request(raw, sizeof(raw) - 1, &req) > 0);
+
+    start = (double)clock()/CLOCKS_PER_SEC;
+    for (int i = 0; i < ITERATIONS; ++i) {
+        if (batched) {
+            httpp_log_entry_t e = {&req, addr, 200, 1234, 0, now};
+            assert(httpp_log_write(&log, &fmt, &e));
+        }
+        else
+            log_fprintf(f, &req, &addr, now);
+    }
+    assert(httpp_log_flush(&log));
+    fflush(f);
+    end = (double)clock()/CLOCKS_PER_SEC;
+
+    fclose(f);
+    close(fd);
+    return end - start;
+}
+
+void run(bool batched)
+{
+    double total = 0.0;
+
+    for (int i = 0; i < RUNS; i++)
+        total += format(batched);
+
+    printf("%s:\n", batched ? "httpp_log_write" : "httpp_span_to_str, fprintf");
+    printf(" Average elapsed time %f\n", total / RUNS);
+    printf(" Lines per second ≈ %.2f\n\n", (double) ITERATIONS / (total / RUNS));
+}
+
+int main()
+{
+    run(false);
+    run(true);
+    return 0;
+}
@@ -0,0 +1,84 @@
+// First request of a connection behind a PROXY load balancer: stripping the preamble and
+// shifting the buffer before httpp_parse_request, or httpp_parse_proxy_request in place
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+
+#define HTTPP_IMPLEMENTATION
+#include "../httpp_proxy.h"
+
+#define REQUEST                                                                             \
+    "GET /api/v1/orders?limit=20 HTTP/1.1\r\n"                                              \
+    "Host: api.example.com\r\n"                                                             \
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n" \
+    "Accept: application/json\r\n"                                                          \
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"                                          \
+    "Connection: keep-alive\r\n"                                                            \
+    "\r\n"
+
+static const char v1[] = "PROXY TCP4 203.0.113.195 198.51.100.2 56324 443\r\n" REQUEST;
+
+// TCP over IPv4 with an ALPN TLV
+static const char v2[] = "\r\n\r\n\0\r\nQUIT\n\x21\x11\x00\x11"
+                         "\xcb\x00\x71\xc3\xc6\x33\x64\x02\xdc\x04\x01\xbb"
+                         "\x01\x00\x02h2" REQUEST;
+
+static char buf[sizeof(v2) > sizeof(v1) ? sizeof(v2) : sizeof(v1)];
+
+// Length of the preamble, the way it's found without parsing it
+static size_t preamble_len(const char* raw)
+{
+    if (raw[0] == 'P')
+        return strstr(raw, "\r\n") + 2 - raw;
+
+    return 16 + ((unsigned char) raw[14] << 8 | (unsigned char) raw[15]);
+}
+
+double parse(const char* raw, size_t n, bool fused)
+{
+    double start, end;
+
+    start = (double)clock()/CLOCKS_PER_SEC;
+    for (int i = 0; i < ITERATIONS; ++i) {
+        HTTPP_NEW_REQ(req, 32);
+
+        // Every connection starts with a fresh buffer
+        memcpy(buf, raw, n);
+
+        if (fused) {
+            httpp_proxy_t proxy;
+            assert(httpp_parse_proxy_request(buf, n, &proxy, &req) == (int) n);
+        }
+        else {
+            size_t skip = preamble_len(buf);
+
+            memmove(buf, buf + skip, n - skip);
+            assert(httpp_parse_request(buf, n - skip, &req) == (int) (n - skip));
+        }
+    }
+    end = (double)clock()/CLOCKS_PER_SEC;
+    return end - start;
+}
+
+void run(const char* name, const char* raw, size_t n, bool fused)
+{
+    double total = 0.0;
+
+    for (int i = 0; i < RUNS; i++)
+        total += parse(raw, n, fused);
+
+    printf("%s, %s:\n", name, fused ? "httpp_parse_proxy_request" : "strip, shift, httpp_parse_request");
+    printf(" Average elapsed time %f\n", total / RUNS);
+    printf(" Requests per second ≈ %.2f\n\n", (double) ITERATIONS / (total / RUNS));
+}
+
+int main()
+{
+    run("v1", v1, sizeof(v1) - 1, false);
+    run("v1", v1, sizeof(v1) - 1, true);
+    run("v2", v2, sizeof(v2) - 1, false);
+    run("v2", v2, sizeof(v2) - 1, true);
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Scan-only, lazy and allowlist modes against the full parse, same request as the parser benchmarks
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+
+#define HTTPP_IMPLEMENTATION
+#include "../httpp.h"
+
+#define REQ                                                                                                                        \
+    "GET /wp-content/uploads/2010/03/hello-kitty-darth-vader-pink.jpg HTTP/1.1\r\n"                                                \
+    "Host: www.kittyhell.com\r\n"                                                                                                  \
+    "User-Agent: Mozilla/5.0 (Macintosh; U; Intel Mac OS X 10.6; ja-JP-mac; rv:1.9.2.3) Gecko/20100401 Firefox/3.6.3 "             \
+    "Pathtraq/0.9\r\n"                                                                                                             \
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"                                                  \
+    "Accept-Language: ja,en-us;q=0.7,en;q=0.3\r\n"                                                                                 \
+    "Accept-Encoding: gzip,deflate\r\n"                                                                                            \
+    "Accept-Charset: Shift_JIS,utf-8;q=0.7,*;q=0.7\r\n"                                                                            \
+    "Keep-Alive: 115\r\n"                                                                                                          \
+    "Connection: keep-alive\r\n"                                                                                                   \
+    "Cookie: wp_ozh_wsa_visits=2; wp_ozh_wsa_visit_lasttime=xxxxxxxxxx; "                                                          \
+    "__utma=xxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.x; "                                                             \
+    "__utmz=xxxxxxxxx.xxxxxxxxxx.x.x.utmccn=(referral)|utmcsr=reader.livedoor.com|utmcct=/reader/|utmcmd=referral\r\n"             \
+    "\r\n"
+
+double parse()
+{
+    char* raw = REQ;
+    size_t raw_len = strlen(raw);
+    int i;
+    double start, end;
+
+    start = (double)clock()/CLOCKS_PER_SEC;
+    for (i = 0; i < ITERATIONS; ++i) {
+        httpp_req_t req;
+        httpp_header_t arr[HTTPP_DEFAULT_HEADERS_ARR_CAP];
+
+        httpp_req_init(&req, arr, HTTPP_DEFAULT_HEADERS_ARR_CAP);
+
+        assert(httpp_parse_request(raw, raw_len, &req) == (int) raw_len);
+    }
+    end = (double)clock()/CLOCKS_PER_SEC;
+    return end - start;
+}
+
+double scan()
+{
+    char* raw = REQ;
+    size_t raw_len = strlen(raw);
+    int i;
+    double start, end;
+
+    start = (double)clock()/CLOCKS_PER_SEC;
+    for (i = 0; i < ITERATIONS; ++i) {
+        httpp_scan_header_t wanted[] = {HTTPP_SCAN_HEADER("Host")};
+        httpp_scan_t scan;
+
+        assert(httpp_scan_request(raw, raw_len, &scan, wanted, 1) == (int) raw_len);
+    }
+    end = (double)clock()/CLOCKS_PER_SEC;
+    return end - start;
+}
+
+double lazy()
+{
+    char* raw = REQ;
+    size_t raw_len = strlen(raw);
+    int i;
+    double start, end;
+
+    start = (double)clock()/CLOCKS_PER_SEC;
+    for (i = 0; i < ITERATIONS; ++i) {
+        httpp_req_t req;
+        httpp_header_t arr[HTTPP_DEFAULT_HEADERS_ARR_CAP];
+
+        httpp_req_init(&req, arr, HTTPP_DEFAULT_HEADERS_ARR_CAP);
+
+        // Handler which only looks at the method and route
+        assert(httpp_parse_request_lazy(raw, raw_len, &req) == (int) raw_len);
+        assert(req.route.length > 0);
+    }
+    end = (double)clock()/CLOCKS_PER_SEC;
+    return end - start;
+}
+
+double allow()
+{
+    char* raw = REQ;
+    size_t raw_len = strlen(raw);
+    const char* names[] = {"Host", "Cookie", "Content-Type", "Authorization"};
+    httpp_allowlist_t al;
+    int i;
+    double start, end;
+
+    assert(httpp_allowlist_init(&al, names, 4));
+
+    start = (double)clock()/CLOCKS_PER_SEC;
+    for (i = 0; i < ITERATIONS; ++i) {
+        httpp_req_t req;
+        httpp_header_t arr[4];
+
+        httpp_req_init(&req, arr, 4);
+
+        assert(httpp_parse_request_allow(raw, raw_len, &req, &al) == (int) raw_len);
+    }
+    end = (double)clock()/CLOCKS_PER_SEC;
+    return end - start;
+}
+
+void run(const char* title, double (*fn)())
+{
+    double total = 0.0;
+
+    for (int i = 0; i < RUNS; i++)
+        total += fn();
+
+    printf("%s:\n", title);
+    printf(" Average elapsed time %f\n", total / RUNS);
+    printf(" Requests per second ≈ %.2f\n\n", (double) ITERATIONS / (total / RUNS));
+}
+
+int main()
+{
+    run("httpp_parse_request", parse);
+    run("httpp_scan_request (Host only)", scan);
+    run("httpp_parse_request_lazy (headers untouched)", lazy);
+    run("httpp_parse_request_allow (4 names, 4 slots)", allow);
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+// WebSocket frame parsing: masked client frames of different sizes, payload unmasked in place
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+
+#define HTTPP_IMPLEMENTATION
+#include "../httpp_ws.h"
+
+#define WIRE_SIZE (1024 * 1024)
+
+static char wire[WIRE_SIZE + 64];
+static char work[WIRE_SIZE + 64];
+static size_t wire_len;
+static size_t frames;
+
+static int on_end(void* ctx, const httpp_ws_frame_t* frame)
+{
+    (void) ctx;
+    (void) frame;
+    frames++;
+    return 0;
+}
+
+static const httpp_ws_callbacks_t callbacks = {NULL, NULL, on_end};
+
+// Fills the wire with masked binary frames of `size` bytes
+static void build(size_t size)
+{
+    unsigned char mask[4] = {0x12, 0x34, 0x56, 0x78};
+    wire_len = 0;
+
+    while (wire_len + size + HTTPP_WS_MAX_HEADER <= WIRE_SIZE) {
+        wire_len += httpp_ws_frame_header(wire + wire_len, HTTPP_WS_BINARY, true, size, mask);
+        memset(wire + wire_len, 'x', size);
+        httpp_ws_mask(wire + wire_len, size, mask, 0);
+        wire_len += size;
+    }
+}
+
+void run(size_t size)
+{
+    httpp_ws_parser_t p;
+    double start, end;
+    int i;
+
+    build(size);
+    frames = 0;
+
+    start = (double)clock()/CLOCKS_PER_SEC;
+    for (i = 0; i < ITERATIONS; ++i) {
+        // Unmasking is in place, every iteration starts from the masked wire
+        memcpy(work, wire, wire_len);
+        httpp_ws_parser_init(&p, true, 1 << 20, &callbacks, NULL);
+        assert(httpp_ws_feed(&p, work, wire_len) == 0);
+    }
+    end = (double)clock()/CLOCKS_PER_SEC;
+
+    printf("%zu byte frames:\n", size);
+    printf(" Frames per second ≈ %.2f\n", frames / (end - start));
+    printf(" MB per second ≈ %.2f\n\n", (double) wire_len * ITERATIONS / (end - start) / 1e6);
+}
+
+int main()
+{
+    size_t sizes[] = {16, 125, 1024, 64 * 1024};
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        run(sizes[i]);
+
+    return 0;
+}
@@ -0,0 +1,383 @@
+/*
+ * Loopback HTTP/1.1 load generator, meant to be used together with server/epoll.c
+ * (or any other server) to measure end to end throughput of httpp.
+ *
+ * Every thread drives its share of keep-alive connections from its own epoll loop.
+ * Each connection has exactly one request in flight; latency is measured from the
+ * moment the request is written until the whole response is read.
+ *
+ * Build:
+ *      gcc -O3 -pthread benchmarks/loadgen.c -o loadgen
+ *
+ * Usage:
+ *      ./loadgen [-p port] [-t threads] [-c connections] [-d seconds] [-r request_file]
+ *
+ * Linux only.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOADGEN_BUF_CAP 65536
+
+// Latencies are bucketed by microsecond, anything above goes to the last bucket
+#define LOADGEN_HIST_BUCKETS 100000
+
+#define LOADGEN_DEFAULT_REQ                                                                                             \
+    "GET /wp-content/uploads/2010/03/hello-kitty-darth-vader-pink.jpg HTTP/1.1\r\n"                                     \
+    "Host: www.kittyhell.com\r\n"                                                                                       \
+    "User-Agent: Mozilla/5.0 (Macintosh; U; Intel Mac OS X 10.6; ja-JP-mac; rv:1.9.2.3) Gecko/20100401 Firefox/3.6.3 "  \
+    "Pathtraq/0.9\r\n"                                                                                                  \
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"                                       \
+    "Accept-Language: ja,en-us;q=0.7,en;q=0.3\r\n"                                                                      \
+    "Accept-Encoding: gzip,deflate\r\n"                                                                                 \
+    "Accept-Charset: Shift_JIS,utf-8;q=0.7,*;q=0.7\r\n"                                                                 \
+    "Keep-Alive: 115\r\n"                                                                                               \
+    "Connection: keep-alive\r\n"                                                                                        \
+    "Cookie: wp_ozh_wsa_visits=2; wp_ozh_wsa_visit_lasttime=xxxxxxxxxx; "                                               \
+    "__utma=xxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.x; "                                                  \
+    "__utmz=xxxxxxxxx.xxxxxxxxxx.x.x.utmccn=(referral)|utmcsr=reader.livedoor.com|utmcct=/reader/|utmcmd=referral\r\n"  \
+    "\r\n"
+
+typedef struct {
+    int      fd;
+    size_t   len;
+    uint64_t sent_at;
+    char     buf[LOADGEN_BUF_CAP];
+} client_t;
+
+typedef struct {
+    int       conns;
+    uint64_t  done;
+    uint64_t  errors;
+    uint64_t  max_us;
+    uint32_t* hist;
+} worker_t;
+
+static const char* req_data = LOADGEN_DEFAULT_REQ;
+static size_t      req_len;
+static int         port = 8080;
+static volatile bool running = true;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int client_connect()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1)
+        return -1;
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static int client_send(client_t* c)
+{
+    size_t off = 0;
+
+    c->sent_at = now_ns();
+    while (off < req_len) {
+        ssize_t w = send(c->fd, req_data + off, req_len - off, MSG_NOSIGNAL);
+
+        if (w == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        off += w;
+    }
+
+    return 0;
+}
+
+/*
+ * Checks whether c->buf holds a complete response.
+ *   On malformed response returns -1.
+ *
+ * Returns length of the response, or 0 if more bytes are needed.
+ */
+static ssize_t response_complete(client_t* c)
+{
+    char* eoh = (char*) memmem(c->buf, c->len, "\r\n\r\n", 4);
+    if (!eoh)
+        return c->len == LOADGEN_BUF_CAP ? -1 : 0;
+
+    size_t head_len = eoh - c->buf + 4;
+    size_t body_len = 0;
+    char*  line = (char*) memchr(c->buf, '\n', head_len);
+
+    while (line && line + 1 < eoh) {
+        line++;
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            body_len = strtoul(line + 15, NULL, 10);
+            break;
+        }
+        line = (char*) memchr(line, '\n', eoh - line);
+    }
+
+    if (head_len + body_len > LOADGEN_BUF_CAP)
+        return -1;
+
+    if (head_len + body_len > c->len)
+        return 0;
+
+    return head_len + body_len;
+}
+
+static void record(worker_t* w, uint64_t ns)
+{
+    uint64_t us = ns / 1000;
+
+    if (us > w->max_us)
+        w->max_us = us;
+
+    if (us >= LOADGEN_HIST_BUCKETS)
+        us = LOADGEN_HIST_BUCKETS - 1;
+
+    w->hist[us]++;
+    w->done++;
+}
+
+static void* worker_run(void* arg)
+{
+    worker_t* w = (worker_t*) arg;
+    client_t* clients = (client_t*) calloc(w->conns, sizeof(client_t));
+    int epfd = epoll_create1(0);
+
+    if (!clients || epfd == -1) {
+        perror("worker");
+        exit(1);
+    }
+
+    for (int i = 0; i < w->conns; i++) {
+        client_t* c = &clients[i];
+
+        if ((c->fd = client_connect()) == -1) {
+            perror("connect");
+            exit(1);
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+
+        if (client_send(c) == -1) {
+            perror("send");
+            exit(1);
+        }
+    }
+
+    struct epoll_event events[256];
+
+    while (running) {
+        int n = epoll_wait(epfd, events, 256, 100);
+
+        for (int i = 0; i < n; i++) {
+            client_t* c = (client_t*) events[i].data.ptr;
+            ssize_t r = recv(c->fd, c->buf + c->len, LOADGEN_BUF_CAP - c->len, 0);
+
+            if (r <= 0) {
+                if (r == -1 && errno == EINTR)
+                    continue;
+                goto reconnect;
+            }
+
+            c->len += r;
+
+            ssize_t done = response_complete(c);
+            if (done == 0)
+                continue;
+            if (done == -1)
+                goto reconnect;
+
+            record(w, now_ns() - c->sent_at);
+
+            // One request in flight, so anything past the response is garbage
+            c->len = 0;
+            if (running && client_send(c) == -1)
+                goto reconnect;
+
+            continue;
+
+        reconnect:
+            w->errors++;
+            epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+            close(c->fd);
+            c->len = 0;
+
+            if ((c->fd = client_connect()) == -1)
+                continue;
+
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.ptr = c;
+            epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+            client_send(c);
+        }
+    }
+
+    for (int i = 0; i < w->conns; i++) {
+        if (clients[i].fd != -1)
+            close(clients[i].fd);
+    }
+
+    close(epfd);
+    free(clients);
+    return NULL;
+}
+
+static uint64_t percentile(uint64_t* hist, uint64_t total, double p)
+{
+    uint64_t want = (uint64_t) (total * p);
+    uint64_t seen = 0;
+
+    for (uint64_t i = 0; i < LOADGEN_HIST_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen > want)
+            return i;
+    }
+
+    return LOADGEN_HIST_BUCKETS - 1;
+}
+
+static char* read_file(const char* path, size_t* out_len)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char* data = (char*) malloc(n + 1);
+    if (!data || fread(data, 1, n, f) != (size_t) n) {
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+
+    data[n] = '\0';
+    *out_len = n;
+    fclose(f);
+    return data;
+}
+
+int main(int argc, char** argv)
+{
+    int threads = 2;
+    int conns = 64;
+    int duration = 10;
+    int opt;
+
+    req_len = strlen(req_data);
+
+    while ((opt = getopt(argc, argv, "p:t:c:d:r:")) != -1) {
+        switch (opt) {
+            case 'p': port = atoi(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            case 'c': conns = atoi(optarg); break;
+            case 'd': duration = atoi(optarg); break;
+            case 'r':
+                if ((req_data = read_file(optarg, &req_len)) == NULL) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-p port] [-t threads] [-c connections] [-d seconds] [-r request_file]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (threads < 1 || conns < threads) {
+        fprintf(stderr, "Need at least one connection per thread\n");
+        return 1;
+    }
+
+    pthread_t* tids = (pthread_t*) malloc(sizeof(pthread_t) * threads);
+    worker_t* workers = (worker_t*) calloc(threads, sizeof(worker_t));
+
+    for (int i = 0; i < threads; i++) {
+        workers[i].conns = conns / threads + (i < conns % threads);
+        workers[i].hist = (uint32_t*) calloc(LOADGEN_HIST_BUCKETS, sizeof(uint32_t));
+        pthread_create(&tids[i], NULL, worker_run, &workers[i]);
+    }
+
+    uint64_t start = now_ns();
+    sleep(duration);
+    running = false;
+
+    for (int i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+
+    double elapsed = (now_ns() - start) / 1e9;
+
+    uint64_t* hist = (uint64_t*) calloc(LOADGEN_HIST_BUCKETS, sizeof(uint64_t));
+    uint64_t total = 0, errors = 0, max_us = 0, sum_us = 0;
+
+    for (int i = 0; i < threads; i++) {
+        for (uint64_t b = 0; b < LOADGEN_HIST_BUCKETS; b++) {
+            hist[b] += workers[i].hist[b];
+            sum_us += b * workers[i].hist[b];
+        }
+
+        total += workers[i].done;
+        errors += workers[i].errors;
+
+        if (workers[i].max_us > max_us)
+            max_us = workers[i].max_us;
+    }
+
+    if (total == 0) {
+        fprintf(stderr, "No responses received\n");
+        return 1;
+    }
+
+    printf("Threads: %d, connections: %d, duration: %.2fs\n", threads, conns, elapsed);
+    printf("Requests:   %lu (%lu errors)\n", (unsigned long) total, (unsigned long) errors);
+    printf("Requests/s: %.2f\n", total / elapsed);
+    printf("Latency (us): avg %lu, p50 %lu, p90 %lu, p99 %lu, p99.9 %lu, max %lu\n",
+        (unsigned long) (sum_us / total),
+        (unsigned long) percentile(hist, total, 0.50),
+        (unsigned long) percentile(hist, total, 0.90),
+        (unsigned long) percentile(hist, total, 0.99),
+        (unsigned long) percentile(hist, total, 0.999),
+        (unsigned long) max_us);
+
+    return 0;
+}
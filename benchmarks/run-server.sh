@@ -0,0 +1,32 @@
+# End to end benchmark: reference servers + loopback load generator.
+# Both servers are benchmarked with the same load on the same machine.
+
+if [ -n "$1" ]; then
+    OPT=$1
+else
+    OPT="-O3"
+fi
+
+PORT=8080
+THREADS=$(nproc)
+CONNECTIONS=256
+DURATION=10
+
+gcc $OPT -pthread ../server/epoll.c -o epoll-server.out
+gcc $OPT -pthread ../server/uring.c -o uring-server.out
+gcc $OPT -pthread loadgen.c -o loadgen.out
+
+for SERVER in epoll uring; do
+    ./$SERVER-server.out $PORT $THREADS &
+    PID=$!
+    sleep 1
+
+    echo "Benchmarking $SERVER server..."
+    ./loadgen.out -p $PORT -t $THREADS -c $CONNECTIONS -d $DURATION
+
+    kill $PID
+    wait $PID 2>/dev/null
+    sleep 1
+done
+
+rm -f *.out
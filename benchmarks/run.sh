@@ -10,11 +10,21 @@ else
 fi
 
 ITERATIONS=10000000
+FORM_ITERATIONS=100000
+WS_ITERATIONS=2000
+HPACK_ITERATIONS=1000000
 RUNS=5
 
 gcc $OPT -DITERATIONS=$ITERATIONS -DRUNS=$RUNS picohttpparser/picohttpparser.c bench-pico.c -o picohttpparser.out
 gcc $OPT -DITERATIONS=$ITERATIONS -DRUNS=$RUNS bench-httppv1.c -o httppv1.out
 gcc $OPT -DITERATIONS=$ITERATIONS -DRUNS=$RUNS bench-httppv2.c -o httppv2.out
+gcc $OPT -DITERATIONS=$FORM_ITERATIONS -DRUNS=$RUNS bench-form.c -o form.out
+gcc $OPT -DITERATIONS=$ITERATIONS -DRUNS=$RUNS bench-scan.c -o scan.out
+gcc $OPT -DITERATIONS=$ITERATIONS -DRUNS=$RUNS bench-keepalive.c -o keepalive.out
+gcc $OPT -DITERATIONS=$WS_ITERATIONS -DRUNS=$RUNS bench-ws.c -o ws.out
+gcc $OPT -DITERATIONS=$HPACK_ITERATIONS -DRUNS=$RUNS bench-hpack.c -o hpack.out
+gcc $OPT -DITERATIONS=$ITERATIONS -DRUNS=$RUNS bench-proxy.c -o proxy.out
+gcc $OPT -DITERATIONS=$ITERATIONS -DRUNS=$RUNS bench-log.c -o log.out
 
 echo "Benchmarking httpp (1.0.0)..."
 ./httppv1.out
@@ -28,3 +38,38 @@ sleep 1
 
 echo "Benchmarking picohttpparser..."
 ./picohttpparser.out
+
+sleep 1
+
+echo "Benchmarking form decoding..."
+./form.out
+
+sleep 1
+
+echo "Benchmarking scan-only mode..."
+./scan.out
+
+sleep 1
+
+echo "Benchmarking keep-alive header cache..."
+./keepalive.out
+
+sleep 1
+
+echo "Benchmarking WebSocket frames..."
+./ws.out
+
+sleep 1
+
+echo "Benchmarking HPACK decoding..."
+./hpack.out
+
+sleep 1
+
+echo "Benchmarking PROXY protocol preamble..."
+./proxy.out
+
+sleep 1
+
+echo "Benchmarking access log lines..."
+./log.out
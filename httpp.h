@@ -37,13 +37,37 @@
  *  of the previous one. 
  * 
  * OPTIONS:
- *  By default httpp considers http version mismatch an error, to prevent this:
+ *  By default httpp accepts HTTP/1.0 and HTTP/1.1 only and considers any other 
+ *  version an error, to prevent this:
  *      #define HTTPP_DONT_CHECK_VERSION
+ *
+ *  While parsing, httpp decodes the version into version_major / version_minor
+ *  and looks at the Connection header tokens to set keep_alive (HTTP/1.1 default
+ *  unless "close", HTTP/1.0 only with "keep-alive", "close" wins over "keep-alive")
+ *  and upgrade ("upgrade" token).
+ *  "Expect: 100-continue" sets expect_continue (HTTP/1.1 only), answer it with
+ *  HTTPP_CONTINUE, or with a final response (e.g 413) before the body is sent.
  *  
  *  By default httpp will only remove first optional whitespace after header name.
  *  For general purpose it should be okay. If you want it to completely trim trailing
  *  and leading whitespaces from header values:
  *      #define HTTPP_TRIM_HEADER_VALUES
+ *
+ *  Some scans (substring search, etc.) use SSE2 when it's available. To always use
+ *  the plain C versions:
+ *      #define HTTPP_NO_SIMD
+ *
+ *  Sending functions (httpp_res_template_writev, httpp_file_sender_t) and the parts
+ *  of the extensions which use file descriptors need POSIX headers. They are only
+ *  included and compiled with:
+ *      #define HTTPP_POSIX
+ *  On Linux file bodies which are not regular files (pipes) are sent with splice,
+ *  which is only declared when _GNU_SOURCE is defined before the first #include.
+ *
+ * EXTENSIONS:
+ *  Optional features that work on top of parsed spans live in their own headers
+ *  (httpp_cookie.h, ...). They follow the same rules: include them after httpp.h
+ *  and define HTTPP_IMPLEMENTATION in exactly one translation unit.
  */
 
 #include <stddef.h>
@@ -51,11 +75,24 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
 # include <strings.h>  /* strncasecmp (-std=c11) */
 #endif
 
+#ifdef HTTPP_POSIX
+# include <sys/types.h>
+# include <sys/uio.h>  /* writev */
+# include <sys/socket.h>
+# include <errno.h>
+# include <fcntl.h>
+# include <unistd.h>
+# ifdef __linux__
+#  include <sys/sendfile.h>
+# endif
+#endif
+
 #define HTTPP_DEFAULT_HEADERS_ARR_CAP 20
 
 #define HTTPP_SUPPORTED_VERSION "HTTP/1.1"
@@ -111,11 +148,26 @@ typedef struct {
     httpp_span_t route;
     httpp_span_t version;
     int method;
+    int version_major; // -1 if the version couldn't be decoded (HTTPP_DONT_CHECK_VERSION)
+    int version_minor;
+    bool keep_alive;   // Connection can be reused after this request
+    bool upgrade;      // Connection header has "upgrade" token
+    bool conn_close;   // Connection header has "close" token, later "keep-alive" tokens can't undo it
+    bool expect_continue; // "Expect: 100-continue", the client waits for an interim response to send the body
+    httpp_span_t unsplit; // Header block left by httpp_parse_request_lazy, ptr is NULL once split
 } httpp_req_t;
 
+// Body which is sent straight from a file descriptor. fd is -1 when unused
+typedef struct {
+    int    fd;
+    size_t offset;
+    size_t length;
+} httpp_file_span_t;
+
 typedef struct {
     httpp_headers_arr_t headers;
     httpp_span_t body;
+    httpp_file_span_t file;
     int code;
 } httpp_res_t;
 
@@ -124,6 +176,35 @@ typedef struct {
     size_t raw_len;
 } httpp_raw_res_t;
 
+/*
+ * Response template: status line and headers serialized once, with fixed width
+ * slots for the fields that change per response. Setting a slot patches the bytes
+ * in place, so the template must not be shared between threads, clone it instead.
+ * Offsets of absent slots are 0.
+ */
+typedef struct {
+    char*  raw;
+    size_t raw_len;
+    size_t content_length_off;
+    size_t date_off;
+    size_t request_id_off;
+} httpp_res_template_t;
+
+// Slots for httpp_res_template_init, can be OR'd
+#define HTTPP_SLOT_CONTENT_LENGTH (1 << 0)
+#define HTTPP_SLOT_DATE           (1 << 1)
+#define HTTPP_SLOT_REQUEST_ID     (1 << 2)
+
+/*
+ * Width of the slots. Values are padded with spaces, which is optional whitespace
+ * for HTTP, so the padding is invisible to clients.
+ */
+#define HTTPP_SLOT_CONTENT_LENGTH_WIDTH 12
+#define HTTPP_SLOT_DATE_WIDTH 29 // IMF-fixdate, "Sun, 06 Nov 1994 08:49:37 GMT"
+#define HTTPP_SLOT_REQUEST_ID_WIDTH 36
+
+#define HTTPP_REQUEST_ID_HEADER "X-Request-Id"
+
 const char* httpp_method_to_string(int method);
 const char* httpp_status_to_string(int status_code);
 
@@ -136,6 +217,13 @@ bool httpp_span_eq(httpp_span_t* span, const char* to);
 // Checks is httpp_span_t equal to `to` without case considering
 bool httpp_span_case_eq(httpp_span_t* span, const char* to);
 
+/*
+ * Decodes percent encoded `span` in place (modifies the buffer span points to) 
+ * and updates span->length. If `plus_as_space` is set, '+' is decoded as ' '
+ *   On malformed escape returns false, span is left partially decoded.
+ */
+bool httpp_span_url_decode(httpp_span_t* span, bool plus_as_space);
+
 /*
  * Parses the raw http request passed as `buf`. 
  *   On failure returns -1.
@@ -145,6 +233,66 @@ bool httpp_span_case_eq(httpp_span_t* span, const char* to);
  */
 int httpp_parse_request(char* buf, size_t n, httpp_req_t* dest);
 
+/*
+ * Same as httpp_parse_request, but only the start line is parsed. The header block
+ * is found with a single search for its end and split into `dest->headers` the first
+ * time it's needed: httpp_req_find_header, httpp_req_split_headers. Until then the
+ * array is empty, httpp_find_header finds nothing. The block must be complete.
+ *   On failure returns -1.
+ *
+ * Connection and Expect aren't looked at either, keep_alive and upgrade follow the
+ * version and expect_continue is false until the headers are split. With
+ * HTTPP_CONSIDER_CONTENT_LENGTH the headers are needed for the body and get split
+ * right away.
+ *
+ * On sucess returns offset from the beginning of `buf` to the beginning of the dest->body.
+ */
+int httpp_parse_request_lazy(char* buf, size_t n, httpp_req_t* dest);
+
+/*
+ * Splits the header block left by httpp_parse_request_lazy and applies its Connection
+ * header to keep_alive and upgrade, Expect to expect_continue. Does nothing if there
+ * is no block, it's split only once.
+ *   On malformed header returns false, `req->headers` is left empty.
+ */
+bool httpp_req_split_headers(httpp_req_t* req);
+
+// Same as httpp_find_header, splits headers of a lazily parsed `req` first
+httpp_header_t* httpp_req_find_header(httpp_req_t* req, const char* name);
+
+/*
+ * Header names to keep, built once into a perfect hash: every name gets its own
+ * slot, so a lookup is one hash and at most one comparison.
+ */
+#define HTTPP_ALLOWLIST_MAX   32
+#define HTTPP_ALLOWLIST_SLOTS 128
+
+typedef struct {
+    const char*   names[HTTPP_ALLOWLIST_SLOTS]; // NULL for empty slots
+    unsigned char lens[HTTPP_ALLOWLIST_SLOTS];
+    unsigned      seed;
+} httpp_allowlist_t;
+
+/*
+ * Builds the allowlist of `n` names, they must outlive it. Names are case insensitive.
+ *   On failure (too many, empty, longer than 255 or duplicate names) returns false,
+ *   `al` is then empty.
+ */
+bool httpp_allowlist_init(httpp_allowlist_t* al, const char** names, size_t n);
+
+// True if header `name` of `len` bytes is in `al`
+bool httpp_allowlist_has(const httpp_allowlist_t* al, const char* name, size_t len);
+
+/*
+ * Same as httpp_parse_request, but only headers in `allow` are stored in
+ * `dest->headers`. The rest are still validated, Connection (and Content-Length
+ * with HTTPP_CONSIDER_CONTENT_LENGTH) are looked at even when not kept.
+ *   On failure returns -1.
+ *
+ * On sucess returns offset from the beginning of `buf` to the beginning of the dest->body.
+ */
+int httpp_parse_request_allow(char* buf, size_t n, httpp_req_t* dest, const httpp_allowlist_t* allow);
+
 /* 
  * Parses http request start line.
  * http version mismatch is considered a failure
@@ -169,7 +317,7 @@ httpp_header_t* httpp_parse_header(httpp_headers_arr_t* dest, char* line, size_t
 // Appends `header` to `hs`, On failure returns NULL, on sucess returns pointer to last header
 httpp_header_t* httpp_headers_arr_append(httpp_headers_arr_t* hs, httpp_header_t header);
 
-// Searches for a header with `name` in `hs`, On failure returns NULL, on sucess returns pointer to it
+// Searches for a header with `name` in `hs`. On failure returns NULL, on sucess returns pointer to it
 httpp_header_t* httpp_headers_arr_find(httpp_headers_arr_t* hs, const char* name);
 
 // Converts `res` to it's malloc'd raw string representation. Sets final raw length to `out_len`
@@ -181,12 +329,220 @@ httpp_header_t* httpp_res_add_header(httpp_res_t* res, const char* name, const c
 // Frees strdupped by httpp_res_add_header headers from `res` 
 void httpp_res_free_added(httpp_res_t* res);
 
+/*
+ * Serializes status line and headers of `res` into `dest`, followed by a header
+ * for each of the requested `slots`. Content-Length and Date headers of `res`
+ * are skipped when the matching slot is requested. The body of `res` is ignored.
+ * Until set, Content-Length is 0 and Date is the epoch.
+ *   On failure returns false.
+ */
+bool httpp_res_template_init(httpp_res_template_t* dest, httpp_res_t* res, int slots);
+
+// Copies `src` to `dest`, e.g to give each thread its own template. On failure returns false
+bool httpp_res_template_clone(httpp_res_template_t* dest, httpp_res_template_t* src);
+
+void httpp_res_template_free(httpp_res_template_t* tmpl);
+
+// Patches Content-Length slot. If the value doesn't fit the slot returns false
+bool httpp_res_template_set_content_length(httpp_res_template_t* tmpl, size_t length);
+
+// Patches Date slot, `date` must be HTTPP_SLOT_DATE_WIDTH bytes long
+void httpp_res_template_set_date(httpp_res_template_t* tmpl, const char* date);
+
+// Patches request id slot. If `id` is longer than the slot returns false
+bool httpp_res_template_set_request_id(httpp_res_template_t* tmpl, const char* id, size_t id_len);
+
+// Interim response for expect_continue requests, the client sends the body once it gets it
+#define HTTPP_CONTINUE     "HTTP/1.1 100 Continue\r\n\r\n"
+#define HTTPP_CONTINUE_LEN 25
+
+/*
+ * Serializes a 103 Early Hints interim response into `dest`, with a Link header for
+ * each of `links` (e.g "</app.css>; rel=preload; as=style"). Nothing in it depends on
+ * the request, so it can be built once per route and written as is.
+ *   If it doesn't fit into `cap` returns -1.
+ *
+ * On sucess returns its length.
+ */
+int httpp_early_hints(char* dest, size_t cap, const char* const* links, size_t links_len);
+
+#ifdef HTTPP_POSIX
+/*
+ * State of sending a response whose body is a file (see httpp_res_set_body_file).
+ * The header block is serialized once, then the body goes from the file to the socket
+ * with sendfile (or splice for pipes) without being copied to user space.
+ */
+typedef struct {
+    char*  head;
+    size_t head_len;
+    size_t head_off;
+    int    fd;
+    off_t  offset;
+    size_t remaining;
+} httpp_file_sender_t;
+
+/*
+ * Serializes header block of `res` into `dest`.
+ *   On failure returns false.
+ */
+bool httpp_file_sender_init(httpp_file_sender_t* dest, httpp_res_t* res);
+
+/*
+ * Pushes as much of the response to `sock` as it takes. Header block is sent 
+ * with MSG_MORE, so it leaves in the same segment as the beginning of the body.
+ *   On failure returns -1.
+ *
+ * Returns 1 when everything is sent, 0 when the socket is non blocking and
+ * is full, call it again once it becomes writable.
+ */
+int httpp_file_sender_send(httpp_file_sender_t* sender, int sock);
+
+void httpp_file_sender_free(httpp_file_sender_t* sender);
+
+// Points `iov` at the template and the body, returns number of used iovecs (1 or 2)
+int httpp_res_template_iov(httpp_res_template_t* tmpl, 
+                           const char* body, size_t body_len, struct iovec iov[2]);
+
+// Writes template and body to `fd` with a single writev. Returns what writev returned
+ssize_t httpp_res_template_writev(int fd, httpp_res_template_t* tmpl, const char* body, size_t body_len);
+#endif
+
+/*
+ * Parses Content-Length value (digits only, no sign, no overflow)
+ *   On failure returns false.
+ */
+bool httpp_parse_content_length(httpp_span_t* value, size_t* out);
+
+/*
+ * Streaming body.
+ *
+ * httpp_parse_request expects the whole request in the buffer. For large bodies
+ * parse only the header block and stream the body through a httpp_body_stream_t:
+ * either push bytes into it as they arrive (httpp_body_stream_feed), which hands
+ * them to `on_data` in pieces of at most `piece_size` bytes, or pull them 
+ * (httpp_body_stream_read) from a reader function. Either way memory usage does 
+ * not depend on the size of the body.
+ *
+ * Body bytes that already came along with the header block (req->body) are 
+ * delivered first. Only Content-Length framing is handled, requests with 
+ * Transfer-Encoding are rejected by httpp_body_stream_init.
+ *
+ * Streaming doesn't work with HTTPP_CONSIDER_CONTENT_LENGTH: httpp_parse_request
+ * then fails until the whole body is in the buffer, so there is no parsed request
+ * to start streaming from.
+ */
+
+// Returned by `on_data` to stop feeding, e.g when the consumer can't keep up
+#define HTTPP_BODY_PAUSE 1
+
+/*
+ * Called with the next piece of the body.
+ * Return 0 to continue, HTTPP_BODY_PAUSE to stop for now, negative to abort.
+ */
+typedef int (*httpp_body_cb)(void* ctx, const char* data, size_t len);
+
+// Reads up to `cap` bytes into `buf`, same contract as read(2)
+typedef ptrdiff_t (*httpp_read_fn)(void* io, char* buf, size_t cap);
+
+typedef struct {
+    size_t content_length;
+    size_t received;
+    size_t piece_size;
+    httpp_body_cb on_data;
+    void*  ctx;
+    const char* pending; // Body bytes that came with the header block, not delivered yet
+    size_t pending_len;
+} httpp_body_stream_t;
+
+/*
+ * Prepares `dest` to stream the body of parsed `req`. `on_data` may be NULL if the
+ * body is only pulled. `piece_size` of 0 means no limit. Headers of a lazily parsed
+ * `req` are split first.
+ *   On invalid Content-Length, Transfer-Encoding or malformed headers returns -1.
+ */
+int httpp_body_stream_init(httpp_body_stream_t* dest, httpp_req_t* req, 
+                           size_t piece_size, httpp_body_cb on_data, void* ctx);
+
+/*
+ * Delivers body bytes from `data` to on_data, bytes past the end of the body
+ * are not consumed (they are the next request).
+ *   When on_data aborts returns -1.
+ *
+ * On sucess returns number of consumed bytes of `data`. When on_data paused, the
+ * rest of `data` must be fed again later.
+ */
+ptrdiff_t httpp_body_stream_feed(httpp_body_stream_t* s, const char* data, size_t n);
+
+/*
+ * Reads next part of the body into `out`, calls `read` only when the bytes that
+ * came with the header block are used up and never reads past the end of the body.
+ *   On read failure returns -1.
+ *
+ * On sucess returns number of bytes stored in `out`, 0 at the end of the body
+ */
+ptrdiff_t httpp_body_stream_read(httpp_body_stream_t* s, char* out, size_t cap, 
+                                 httpp_read_fn read, void* io);
+
+#define httpp_body_stream_done(s) ((s)->received == (s)->content_length)
+
+/*
+ * Scan-only mode, e.g for load balancers which only route and forward bytes.
+ *
+ * httpp_scan_request finds the end of the header block, decodes the start line and
+ * looks at the framing headers (Content-Length, Transfer-Encoding, Connection), but
+ * only keeps values of the headers the caller asked for. Nothing else is stored.
+ * Line ends are found with one pass over the block, a line is only split into name
+ * and value when its first letter may start an interesting header.
+ *
+ *      httpp_scan_header_t wanted[] = {HTTPP_SCAN_HEADER("Host"), HTTPP_SCAN_HEADER("X-Tenant")};
+ *      httpp_scan_t scan;
+ *
+ *      int head_len = httpp_scan_request(buf, n, &scan, wanted, 2);
+ *      // Request is buf[0, head_len + scan.body_len) unless scan.chunked
+ */
+#define HTTPP_SCAN_MAX_WANTED 16
+
+typedef struct {
+    const char*  name;  // Set by the caller
+    httpp_span_t value; // ptr is NULL if the header is absent, first one wins
+} httpp_scan_header_t;
+
+#define HTTPP_SCAN_HEADER(name) {(name), {NULL, 0, false}}
+
+typedef struct {
+    int method;
+    httpp_span_t route;
+    int version_major;
+    int version_minor;
+    bool keep_alive;
+    bool chunked;       // Transfer-Encoding present, body_len is 0
+    size_t header_len;  // Offset of the body
+    size_t body_len;    // Content-Length
+} httpp_scan_t;
+
+/*
+ * Scans the request at the beginning of `buf`, filling values of `wanted`.
+ * At most HTTPP_SCAN_MAX_WANTED headers can be asked for.
+ *   On malformed request returns -1, also when Content-Length is repeated with
+ *   different values or comes together with Transfer-Encoding.
+ *   When the header block is not complete yet returns 0.
+ *
+ * On sucess returns length of the header block (start line included).
+ */
+int httpp_scan_request(char* buf, size_t n, httpp_scan_t* dest,
+                       httpp_scan_header_t* wanted, size_t wanted_len);
+
 #define httpp_find_header(req_or_res, name) \
     (httpp_headers_arr_find(&(req_or_res).headers, name))
 
 #define httpp_res_set_body(res, body_ptr, body_len) \
    (res.body = (httpp_span_t){body_ptr, body_len, false})
 
+// Makes `res` body `body_len` bytes of file `fd` from `body_off`. httpp_file_sender_init
+// serializes the header block only, the body is sent with httpp_file_sender_send (HTTPP_POSIX)
+#define httpp_res_set_body_file(res, body_fd, body_off, body_len) \
+   (res.file = (httpp_file_span_t){body_fd, body_off, body_len})
+
 #define HTTPP_NEW_REQ(name, arr_cap) \
     httpp_req_t name; \
     httpp_header_t name##_headers[arr_cap]; \
@@ -224,6 +580,11 @@ void httpp_res_free_added(httpp_res_t* res);
         (dest)[(len)] = '\0';         \
     } while (0)
 
+#if defined(__SSE2__) && defined(__GNUC__) && !defined(HTTPP_NO_SIMD)
+# include <emmintrin.h>
+# define HTTPP_SSE2
+#endif
+
 
 static inline void httpp_span_init(httpp_span_t* span) 
 {
@@ -238,14 +599,28 @@ static inline void httpp_req_init(
     httpp_span_init(&dest->route);
     httpp_span_init(&dest->body);
 
+    dest->version_major = -1;
+    dest->version_minor = -1;
+    dest->keep_alive = false;
+    dest->upgrade = false;
+    dest->conn_close = false;
+    dest->expect_continue = false;
+
     dest->headers.arr = headers_arr;
     dest->headers.capacity = headers_cap;
     dest->headers.length = 0;
+    httpp_span_init(&dest->unsplit);
 }
 
 static inline void httpp_res_init(
     httpp_res_t* dest, httpp_header_t* headers_arr, size_t headers_cap, int status)
 {
+    httpp_span_init(&dest->body);
+
+    dest->file.fd = -1;
+    dest->file.offset = 0;
+    dest->file.length = 0;
+
     dest->code = status;
     dest->headers.arr = headers_arr;
     dest->headers.capacity = headers_cap;
@@ -403,6 +778,103 @@ bool httpp_span_case_eq(httpp_span_t* span, const char* to)
     return (strncasecmp(span->ptr, to, expected) == 0);
 }
 
+/*
+ * memmem, which is not standard C. Returns pointer to the first occurrence of 
+ * `needle` in `hay` or NULL. With SSE2 every 16 positions are filtered at once by 
+ * comparing the first and the last byte of `needle`, only candidates are memcmp'd.
+ */
+static inline const char* __memfind(const char* hay, size_t n, const char* needle, size_t m)
+{
+    if (m == 0)
+        return hay;
+
+    if (m > n)
+        return NULL;
+
+    if (m == 1)
+        return (const char*) memchr(hay, needle[0], n);
+
+    size_t i = 0;
+
+#ifdef HTTPP_SSE2
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last  = _mm_set1_epi8(needle[m - 1]);
+
+    for (; i + 16 + m - 1 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (hay + i));
+        __m128i b = _mm_loadu_si128((const __m128i*) (hay + i + m - 1));
+        unsigned mask = _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+
+        while (mask) {
+            unsigned bit = __builtin_ctz(mask);
+            if (memcmp(hay + i + bit + 1, needle + 1, m - 2) == 0)
+                return hay + i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    while (i + m <= n) {
+        const char* c = (const char*) memchr(hay + i, needle[0], n - m + 1 - i);
+        if (!c)
+            return NULL;
+
+        if (memcmp(c + 1, needle + 1, m - 1) == 0)
+            return c;
+
+        i = c - hay + 1;
+    }
+
+    return NULL;
+}
+
+static inline int __hexval(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool httpp_span_url_decode(httpp_span_t* span, bool plus_as_space)
+{
+    if (!span || !span->ptr)
+        return false;
+
+    char* src = span->ptr;
+    char* end = span->ptr + span->length;
+
+    // Nothing to decode is the common case, don't touch the buffer then
+    while (src < end && *src != '%' && !(plus_as_space && *src == '+'))
+        src++;
+
+    char* dst = src;
+
+    while (src < end) {
+        if (*src == '%') {
+            if (end - src < 3)
+                return false;
+
+            int hi = __hexval(src[1]);
+            int lo = __hexval(src[2]);
+
+            if (hi < 0 || lo < 0)
+                return false;
+
+            *dst++ = (char) ((hi << 4) | lo);
+            src += 3;
+        } 
+        else {
+            *dst++ = (plus_as_space && *src == '+') ? ' ' : *src;
+            src++;
+        }
+    }
+
+    span->length = dst - span->ptr;
+    return true;
+}
+
 httpp_header_t* httpp_headers_arr_append(httpp_headers_arr_t* hs, httpp_header_t header)
 {
     if (!header.name.ptr || !header.value.ptr) 
@@ -488,8 +960,8 @@ static inline char* __chop(char until, httpp_span_t* to, char* from, size_t from
 
 int httpp_parse_start_line(char* buf, size_t n, httpp_req_t* dest)
 {
-    httpp_span_t route = {.is_owned = false};
-    httpp_span_t version = {.is_owned = false};
+    httpp_span_t route = {NULL, 0, false};
+    httpp_span_t version = {NULL, 0, false};
 
     char  method_buf[HTTPP_MAX_METHOD_LENGTH + 1];
     char* itr = buf;
@@ -522,14 +994,26 @@ int httpp_parse_start_line(char* buf, size_t n, httpp_req_t* dest)
     if (version.length != HTTPP_SUPPORTED_VERSION_LEN)
         return -1;
 
+    // "HTTP/x.y"
+    char* v = version.ptr;
+    bool decoded = memcmp(v, "HTTP/", 5) == 0 && v[6] == '.'
+                && v[5] >= '0' && v[5] <= '9' && v[7] >= '0' && v[7] <= '9';
+
 #ifndef HTTPP_DONT_CHECK_VERSION
-    if (strncmp(version.ptr, HTTPP_SUPPORTED_VERSION, version.length) != 0)
+    if (!decoded || v[5] != '1' || (v[7] != '0' && v[7] != '1'))
         return -1;
 #endif
 
     dest->method = httpp_string_to_method(method_buf);
     dest->version = version;
     dest->route = route;
+    dest->version_major = decoded ? v[5] - '0' : -1;
+    dest->version_minor = decoded ? v[7] - '0' : -1;
+    dest->keep_alive = dest->version_major > 1 || (dest->version_major == 1 && dest->version_minor >= 1);
+    dest->upgrade = false;
+    dest->conn_close = false;
+    dest->expect_continue = false;
+    httpp_span_init(&dest->unsplit);
 
     return (itr - buf);
 }
@@ -569,7 +1053,140 @@ httpp_header_t* httpp_parse_header(httpp_headers_arr_t* dest, char* line, size_t
     return httpp_headers_arr_append(dest, (httpp_header_t){name, value});
 }
 
-int httpp_parse_request(char* buf, size_t n, httpp_req_t* dest)
+// Applies tokens of the Connection header value to keep_alive and upgrade flags of `dest`
+static void __parse_connection(httpp_req_t* dest, httpp_span_t* value)
+{
+    char* itr = value->ptr;
+    char* end = value->ptr + value->length;
+
+    while (itr < end) {
+        char* comma = (char*) memchr(itr, ',', end - itr);
+        char* tok = itr;
+        size_t len = (comma ? comma : end) - itr;
+
+        itr = comma ? comma + 1 : end;
+
+        LTRIM(tok, len);
+        RTRIM(tok, len);
+
+        // "close" wins, whatever order the tokens (or Connection headers) come in
+        if (len == 5 && strncasecmp(tok, "close", 5) == 0) {
+            dest->keep_alive = false;
+            dest->conn_close = true;
+        }
+        else if (len == 10 && strncasecmp(tok, "keep-alive", 10) == 0)
+            dest->keep_alive = !dest->conn_close;
+        else if (len == 7 && strncasecmp(tok, "upgrade", 7) == 0)
+            dest->upgrade = true;
+    }
+}
+
+// Sets expect_continue of `dest` for "100-continue", HTTP/1.0 clients can't ask for it (RFC 9110, 10.1.1)
+static void __parse_expect(httpp_req_t* dest, httpp_span_t* value)
+{
+    char*  v = value->ptr;
+    size_t len = value->length;
+
+    LTRIM(v, len);
+    RTRIM(v, len);
+
+    if (len == 12 && strncasecmp(v, "100-continue", 12) == 0)
+        dest->expect_continue = dest->version_major > 1 || (dest->version_major == 1 && dest->version_minor >= 1);
+}
+
+// Applies a header the parser looks at itself (Connection, Expect). Lengths differ, so most lines stop at one compare
+static inline void __parse_known(httpp_req_t* dest, httpp_header_t* h)
+{
+    if (h->name.length == 10 && strncasecmp(h->name.ptr, "connection", 10) == 0)
+        __parse_connection(dest, &h->value);
+    else if (h->name.length == 6 && strncasecmp(h->name.ptr, "expect", 6) == 0)
+        __parse_expect(dest, &h->value);
+}
+
+static inline unsigned __allow_hash(const char* name, size_t len, unsigned seed)
+{
+    // FNV-1a over every byte, header names often differ in a single letter
+    // ("Sec-Fetch-Site", "Sec-Fetch-Mode"). Case is folded with | 0x20, the exact
+    // comparison comes after anyway
+    unsigned h = 0x811c9dc5 ^ (seed * 0x9e3779b9);
+
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char) (name[i] | 0x20)) * 0x01000193;
+
+    // Low bits of FNV are weak, mix the high ones in before taking the slot
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+
+    return h & (HTTPP_ALLOWLIST_SLOTS - 1);
+}
+
+bool httpp_allowlist_init(httpp_allowlist_t* al, const char** names, size_t n)
+{
+    // Empty until a seed works out, nothing matches a failed list
+    memset(al->names, 0, sizeof(al->names));
+    al->seed = 0;
+
+    if (n > HTTPP_ALLOWLIST_MAX)
+        return false;
+
+    for (size_t i = 0; i < n; i++) {
+        size_t len = strlen(names[i]);
+        if (len == 0 || len > 255)
+            return false;
+    }
+
+    // Try seeds until no two names share a slot. Duplicates always do, so give up eventually
+    for (unsigned seed = 0; seed < 4096; seed++) {
+        bool ok = true;
+
+        memset(al->names, 0, sizeof(al->names));
+
+        for (size_t i = 0; i < n && ok; i++) {
+            size_t   len = strlen(names[i]);
+            unsigned slot = __allow_hash(names[i], len, seed);
+
+            if (al->names[slot])
+                ok = false;
+
+            al->names[slot] = names[i];
+            al->lens[slot] = (unsigned char) len;
+        }
+
+        if (ok) {
+            al->seed = seed;
+            return true;
+        }
+    }
+
+    memset(al->names, 0, sizeof(al->names));
+    return false;
+}
+
+bool httpp_allowlist_has(const httpp_allowlist_t* al, const char* name, size_t len)
+{
+    if (len == 0)
+        return false;
+
+    unsigned slot = __allow_hash(name, len, al->seed);
+
+    return al->names[slot] && al->lens[slot] == len
+        && strncasecmp(al->names[slot], name, len) == 0;
+}
+
+// Headers the parser itself needs, even when they are not kept
+#define __ALLOW_KNOWN(name, len) \
+    (((len) == 10 && strncasecmp((name), "connection", 10) == 0) \
+     || ((len) == 6 && strncasecmp((name), "expect", 6) == 0))
+
+#ifdef HTTPP_CONSIDER_CONTENT_LENGTH
+# define __ALLOW_LOOKED_AT(name, len) \
+    (__ALLOW_KNOWN(name, len) || ((len) == 14 && strncasecmp((name), "content-length", 14) == 0))
+#else
+# define __ALLOW_LOOKED_AT(name, len) __ALLOW_KNOWN(name, len)
+#endif
+
+static int __parse_request(char* buf, size_t n, httpp_req_t* dest, const httpp_allowlist_t* allow)
 {
     if (buf == NULL || dest == NULL)
         return -1;
@@ -588,6 +1205,10 @@ int httpp_parse_request(char* buf, size_t n, httpp_req_t* dest)
     if ((off = httpp_parse_start_line(itr, n, dest)) == -1)
         return -1;
 
+    // Headers which are not allowed are parsed into here and dropped
+    httpp_header_t skipped;
+    httpp_headers_arr_t scratch = {&skipped, 1, 0};
+
     itr += off;
     while (itr < end) {
         httpp_header_t* parsed;
@@ -602,14 +1223,33 @@ int httpp_parse_request(char* buf, size_t n, httpp_req_t* dest)
             break;
         }
 
-        if ((parsed = httpp_parse_header(&dest->headers, itr, line_size)) == NULL)
+        if (allow) {
+            // Same checks as httpp_parse_header, the value is only split when it's used
+            char* colon = (char*) memchr(itr, ':', line_size);
+            if (__ISSPACE(*itr) || !colon)
+                return -1;
+
+            size_t name_len = colon - itr;
+            bool   keep = httpp_allowlist_has(allow, itr, name_len);
+
+            if (!keep && !__ALLOW_LOOKED_AT(itr, name_len)) {
+                itr = delim + HTTPP_DELIMITER_LEN;
+                continue;
+            }
+
+            scratch.length = 0;
+            if ((parsed = httpp_parse_header(keep ? &dest->headers : &scratch, itr, line_size)) == NULL)
+                return -1;
+        }
+        else if ((parsed = httpp_parse_header(&dest->headers, itr, line_size)) == NULL)
             return -1;
 
+        __parse_known(dest, parsed);
+
 #ifdef HTTPP_CONSIDER_CONTENT_LENGTH
         if (httpp_span_case_eq(&parsed->name, "content-length")) {
-            char* val = httpp_span_to_str(&parsed->value);
-            content_len = atol(val);
-            free(val);
+            if (!httpp_parse_content_length(&parsed->value, &content_len))
+                return -1;
         }
 #endif
         itr = delim + HTTPP_DELIMITER_LEN;
@@ -629,32 +1269,448 @@ int httpp_parse_request(char* buf, size_t n, httpp_req_t* dest)
     return itr - buf;
 }
 
-char* httpp_res_to_raw(httpp_res_t* res, size_t* out_len)
+#undef __ALLOW_LOOKED_AT
+#undef __ALLOW_KNOWN
+
+int httpp_parse_request(char* buf, size_t n, httpp_req_t* dest)
 {
-    if (res == NULL)
-        return NULL; 
+    return __parse_request(buf, n, dest, NULL);
+}
 
-    if (res->code == -1 || res->code > 600)
-        return NULL;
+int httpp_parse_request_allow(char* buf, size_t n, httpp_req_t* dest, const httpp_allowlist_t* allow)
+{
+    if (allow == NULL)
+        return -1;
 
-    const char* status_msg = httpp_status_to_string(res->code);
-    size_t out_size =  
-        strlen(HTTPP_SUPPORTED_VERSION) 
-        + 1 // Space
-        + HTTPP_MAX_STATUS_CODE_LEN
-        + 1 // Space
-        + strlen(status_msg)
-        + HTTPP_DELIMITER_LEN;
+    return __parse_request(buf, n, dest, allow);
+}
 
-    for (size_t i = 0; i < res->headers.length; i++) {
-        httpp_header_t header = res->headers.arr[i];
-        
-        if (!header.name.ptr || !header.value.ptr)
-            continue;
+bool httpp_parse_content_length(httpp_span_t* value, size_t* out)
+{
+    if (!value || !value->ptr || value->length == 0)
+        return false;
 
-        out_size += header.name.length + 2 // ": "
-                  + header.value.length 
-                  + HTTPP_DELIMITER_LEN;
+    size_t v = 0;
+
+    for (size_t i = 0; i < value->length; i++) {
+        char c = value->ptr[i];
+
+        if (c < '0' || c > '9')
+            return false;
+
+        if (v > ((size_t) -1 - 9) / 10)
+            return false;
+
+        v = v * 10 + (c - '0');
+    }
+
+    *out = v;
+    return true;
+}
+
+int httpp_body_stream_init(httpp_body_stream_t* dest, httpp_req_t* req, 
+                           size_t piece_size, httpp_body_cb on_data, void* ctx)
+{
+    dest->content_length = 0;
+    dest->received = 0;
+    dest->piece_size = piece_size ? piece_size : (size_t) -1;
+    dest->on_data = on_data;
+    dest->ctx = ctx;
+    dest->pending = req->body.ptr;
+    dest->pending_len = 0;
+
+    // A lazily parsed request must not lose its framing headers
+    if (!httpp_req_split_headers(req))
+        return -1;
+
+    if (httpp_find_header(*req, "transfer-encoding"))
+        return -1;
+
+    httpp_header_t* cl = httpp_find_header(*req, "content-length");
+    if (cl && !httpp_parse_content_length(&cl->value, &dest->content_length))
+        return -1;
+
+    dest->pending_len = req->body.length < dest->content_length 
+                      ? req->body.length : dest->content_length;
+    return 0;
+}
+
+// Hands up to `n` bytes of `data` to on_data in pieces. Returns delivered count, -1 on abort
+static ptrdiff_t __body_deliver(httpp_body_stream_t* s, const char* data, size_t n, bool* paused)
+{
+    size_t left = s->content_length - s->received;
+    size_t done = 0;
+
+    if (n > left)
+        n = left;
+
+    while (done < n) {
+        size_t piece = n - done < s->piece_size ? n - done : s->piece_size;
+        int ret = s->on_data ? s->on_data(s->ctx, data + done, piece) : 0;
+
+        if (ret < 0)
+            return -1;
+
+        done += piece;
+        s->received += piece;
+
+        if (ret == HTTPP_BODY_PAUSE) {
+            *paused = true;
+            break;
+        }
+    }
+
+    return done;
+}
+
+ptrdiff_t httpp_body_stream_feed(httpp_body_stream_t* s, const char* data, size_t n)
+{
+    bool paused = false;
+
+    if (s->pending_len) {
+        ptrdiff_t done = __body_deliver(s, s->pending, s->pending_len, &paused);
+        if (done == -1)
+            return -1;
+
+        s->pending += done;
+        s->pending_len -= done;
+
+        if (paused || s->pending_len)
+            return 0;
+    }
+
+    if (!data || n == 0)
+        return 0;
+
+    return __body_deliver(s, data, n, &paused);
+}
+
+ptrdiff_t httpp_body_stream_read(httpp_body_stream_t* s, char* out, size_t cap, 
+                                 httpp_read_fn read, void* io)
+{
+    size_t left = s->content_length - s->received;
+
+    if (left == 0 || cap == 0)
+        return 0;
+
+    if (cap > left)
+        cap = left;
+
+    if (s->pending_len) {
+        size_t n = s->pending_len < cap ? s->pending_len : cap;
+
+        memcpy(out, s->pending, n);
+        s->pending += n;
+        s->pending_len -= n;
+        s->received += n;
+        return n;
+    }
+
+    ptrdiff_t r = read(io, out, cap);
+    if (r < 0)
+        return -1;
+
+    if (r == 0)
+        return -1; // Peer is gone before the whole body arrived
+
+    s->received += r;
+    return r;
+}
+
+// Iterates over '\n' positions, with SSE2 16 bytes are compared at once
+typedef struct {
+    const char* blk;  // Current window, 16 bytes
+    const char* next; // Start of the next window
+    const char* end;
+    unsigned    mask; // Not yet returned '\n' positions of the window
+} __lf_iter_t;
+
+static inline void __lf_init(__lf_iter_t* it, const char* from, const char* end)
+{
+    it->blk = from;
+    it->next = from;
+    it->end = end;
+    it->mask = 0;
+}
+
+static inline const char* __lf_next(__lf_iter_t* it)
+{
+    while (!it->mask) {
+        if (it->next >= it->end)
+            return NULL;
+
+        it->blk = it->next;
+        it->next += 16;
+
+#ifdef HTTPP_SSE2
+        if (it->end - it->blk >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*) it->blk);
+            it->mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+            continue;
+        }
+#endif
+        size_t len = it->end - it->blk < 16 ? it->end - it->blk : 16;
+
+        for (size_t i = 0; i < len; i++)
+            it->mask |= (unsigned) (it->blk[i] == '\n') << i;
+    }
+
+    unsigned bit = __builtin_ctz(it->mask);
+    it->mask &= it->mask - 1;
+    return it->blk + bit;
+}
+
+#define __FIRST_SET(set, c) ((set)[(unsigned char) (c) >> 6] |= 1ull << ((unsigned char) (c) & 63))
+#define __FIRST_HAS(set, c) ((set)[(unsigned char) (c) >> 6] & (1ull << ((unsigned char) (c) & 63)))
+
+// Looks at a single header line of httpp_scan_request. On malformed line returns false
+static bool __scan_line(char* line, char* eol, httpp_scan_t* dest, httpp_req_t* req, bool* has_len,
+                        httpp_scan_header_t* wanted, size_t* name_lens, size_t wanted_len)
+{
+    char* colon = (char*) memchr(line, ':', eol - line);
+    if (!colon)
+        return false;
+
+    size_t name_len = colon - line;
+    char*  value = colon + 1;
+    size_t value_len = eol - value;
+
+    LTRIM(value, value_len);
+    RTRIM(value, value_len);
+
+    httpp_span_t v = {value, value_len, false};
+
+    if (name_len == 14 && strncasecmp(line, "content-length", 14) == 0) {
+        size_t len;
+
+        // A later value must not replace an earlier one, peers could pick different ones
+        if (!httpp_parse_content_length(&v, &len) || (*has_len && len != dest->body_len))
+            return false;
+
+        dest->body_len = len;
+        *has_len = true;
+    }
+    else if (name_len == 17 && strncasecmp(line, "transfer-encoding", 17) == 0)
+        dest->chunked = true;
+    else if (name_len == 10 && strncasecmp(line, "connection", 10) == 0)
+        __parse_connection(req, &v);
+
+    for (size_t i = 0; i < wanted_len; i++) {
+        if (name_lens[i] == name_len && !wanted[i].value.ptr
+            && strncasecmp(line, wanted[i].name, name_len) == 0) {
+            wanted[i].value = v;
+            break;
+        }
+    }
+
+    return true;
+}
+
+int httpp_scan_request(char* buf, size_t n, httpp_scan_t* dest,
+                       httpp_scan_header_t* wanted, size_t wanted_len)
+{
+    if (buf == NULL || dest == NULL || wanted_len > HTTPP_SCAN_MAX_WANTED)
+        return -1;
+
+    char* end = buf + n;
+    char* line;
+    const char* lf;
+    __lf_iter_t it;
+    httpp_req_t req;
+    bool has_len = false;
+    int off;
+
+    __lf_init(&it, buf, end);
+
+    if ((lf = __lf_next(&it)) == NULL)
+        return 0;
+
+    httpp_req_init(&req, NULL, 0);
+
+    if ((off = httpp_parse_start_line(buf, lf + 1 - buf, &req)) == -1)
+        return -1;
+
+    // First letters of the headers worth looking at, the rest are only split into lines
+    uint64_t first[4] = {0, 0, 0, 0};
+    size_t name_lens[HTTPP_SCAN_MAX_WANTED];
+
+    __FIRST_SET(first, 'c');
+    __FIRST_SET(first, 'C');
+    __FIRST_SET(first, 't');
+    __FIRST_SET(first, 'T');
+
+    for (size_t i = 0; i < wanted_len; i++) {
+        name_lens[i] = strlen(wanted[i].name);
+        httpp_span_init(&wanted[i].value);
+
+        // Both cases, for other characters the extra bit only costs a needless look
+        __FIRST_SET(first, wanted[i].name[0] | 0x20);
+        __FIRST_SET(first, wanted[i].name[0] & ~0x20);
+    }
+
+    dest->chunked = false;
+    dest->body_len = 0;
+
+    for (line = buf + off;;) {
+        if (end - line < 2)
+            return 0;
+
+        if (line[0] == '\r') {
+            if (line[1] != '\n')
+                return -1;
+            break; // Empty line, end of headers
+        }
+
+        // Folded headers are rejected, like in httpp_parse_header
+        if (__ISSPACE(line[0]))
+            return -1;
+
+        if ((lf = __lf_next(&it)) == NULL)
+            return 0;
+
+        if (lf[-1] != '\r')
+            return -1;
+
+        if (__FIRST_HAS(first, line[0])) {
+            if (!__scan_line(line, (char*) lf - 1, dest, &req, &has_len, wanted, name_lens, wanted_len))
+                return -1;
+        }
+        else if (!memchr(line, ':', lf - line))
+            return -1;
+
+        line = (char*) lf + 1;
+    }
+
+    size_t head_len = line + HTTPP_DELIMITER_LEN - buf;
+
+    // Framing is ambiguous with both (RFC 9112, 6.3)
+    if (dest->chunked && has_len)
+        return -1;
+
+    dest->method = req.method;
+    dest->route = req.route;
+    dest->version_major = req.version_major;
+    dest->version_minor = req.version_minor;
+    dest->keep_alive = req.keep_alive;
+    dest->header_len = head_len;
+
+    return (int) head_len;
+}
+
+#undef __FIRST_SET
+#undef __FIRST_HAS
+
+int httpp_parse_request_lazy(char* buf, size_t n, httpp_req_t* dest)
+{
+    if (buf == NULL || dest == NULL)
+        return -1;
+
+    if (n == 0)
+        return 0;
+
+    int off;
+
+    if ((off = httpp_parse_start_line(buf, n, dest)) == -1)
+        return -1;
+
+    // The start line ends with "\r\n", so a block without headers is found as well
+    const char* eoh = __memfind(buf + off - HTTPP_DELIMITER_LEN, n - off + HTTPP_DELIMITER_LEN,
+                                "\r\n\r\n", 4);
+    if (!eoh)
+        return -1;
+
+    char* body = (char*) eoh + 4;
+
+    dest->unsplit.ptr = buf + off;
+    dest->unsplit.length = body - HTTPP_DELIMITER_LEN - (buf + off);
+
+    dest->body.ptr = body;
+    dest->body.length = n - (body - buf);
+
+#ifdef HTTPP_CONSIDER_CONTENT_LENGTH
+    if (!httpp_req_split_headers(dest))
+        return -1;
+
+    httpp_header_t* cl = httpp_find_header(*dest, "content-length");
+    size_t content_len = 0;
+
+    if (cl && !httpp_parse_content_length(&cl->value, &content_len))
+        return -1;
+
+    if (content_len > dest->body.length)
+        return -1;
+
+    dest->body.length = content_len;
+#endif
+
+    return body - buf;
+}
+
+bool httpp_req_split_headers(httpp_req_t* req)
+{
+    if (!req->unsplit.ptr)
+        return true;
+
+    httpp_headers_arr_t* hs = &req->headers;
+    char* itr = req->unsplit.ptr;
+    char* end = itr + req->unsplit.length;
+    const char* lf;
+    __lf_iter_t it;
+
+    httpp_span_init(&req->unsplit); // Whatever happens, it's split only once
+    __lf_init(&it, itr, end);
+
+    // Every line of the block ends with "\r\n", the empty line is not part of it
+    while ((lf = __lf_next(&it)) != NULL) {
+        if (lf == itr || lf[-1] != '\r'
+            || !httpp_parse_header(hs, itr, lf - 1 - itr)) {
+            hs->length = 0;
+            return false;
+        }
+
+        itr = (char*) lf + 1;
+    }
+
+    for (size_t i = 0; i < hs->length; i++)
+        __parse_known(req, &hs->arr[i]);
+
+    return true;
+}
+
+httpp_header_t* httpp_req_find_header(httpp_req_t* req, const char* name)
+{
+    if (!httpp_req_split_headers(req))
+        return NULL;
+
+    return httpp_headers_arr_find(&req->headers, name);
+}
+
+char* httpp_res_to_raw(httpp_res_t* res, size_t* out_len)
+{
+    if (res == NULL)
+        return NULL; 
+
+    if (res->code == -1 || res->code > 600)
+        return NULL;
+
+    const char* status_msg = httpp_status_to_string(res->code);
+    size_t out_size =  
+        strlen(HTTPP_SUPPORTED_VERSION) 
+        + 1 // Space
+        + HTTPP_MAX_STATUS_CODE_LEN
+        + 1 // Space
+        + strlen(status_msg)
+        + HTTPP_DELIMITER_LEN;
+
+    for (size_t i = 0; i < res->headers.length; i++) {
+        httpp_header_t header = res->headers.arr[i];
+        
+        if (!header.name.ptr || !header.value.ptr)
+            continue;
+
+        out_size += header.name.length + 2 // ": "
+                  + header.value.length 
+                  + HTTPP_DELIMITER_LEN;
     }
 
     out_size += HTTPP_DELIMITER_LEN;
@@ -678,8 +1734,9 @@ char* httpp_res_to_raw(httpp_res_t* res, size_t* out_len)
         if (!header.name.ptr || !header.value.ptr)
             continue;
 
-        int n = snprintf(out + offset, out_size - offset, 
-                    "%s: %s\r\n", header.name.ptr, header.value.ptr);
+        int n = snprintf(out + offset, out_size - offset, "%.*s: %.*s\r\n", 
+                    (int) header.name.length, header.name.ptr, 
+                    (int) header.value.length, header.value.ptr);
 
         if (n < 0 || (size_t) n >= out_size - offset) {
             free(out);
@@ -702,6 +1759,340 @@ char* httpp_res_to_raw(httpp_res_t* res, size_t* out_len)
     return out;
 }
 
+static size_t __status_line_len(int code)
+{
+    return HTTPP_SUPPORTED_VERSION_LEN + 1 + HTTPP_MAX_STATUS_CODE_LEN + 1 
+         + strlen(httpp_status_to_string(code)) + HTTPP_DELIMITER_LEN;
+}
+
+// Writes "HTTP/1.1 200 OK\r\n" to `out`, returns pointer past it
+static char* __write_status_line(char* out, int code)
+{
+    const char* msg = httpp_status_to_string(code);
+    size_t msg_len = strlen(msg);
+
+    memcpy(out, HTTPP_SUPPORTED_VERSION " ", HTTPP_SUPPORTED_VERSION_LEN + 1);
+    out += HTTPP_SUPPORTED_VERSION_LEN + 1;
+
+    *out++ = '0' + (code / 100) % 10;
+    *out++ = '0' + (code / 10) % 10;
+    *out++ = '0' + code % 10;
+    *out++ = ' ';
+
+    memcpy(out, msg, msg_len);
+    out += msg_len;
+
+    memcpy(out, HTTPP_DELIMITER, HTTPP_DELIMITER_LEN);
+    return out + HTTPP_DELIMITER_LEN;
+}
+
+// Writes "name: " followed by `width` spaces and "\r\n", returns offset of the slot
+static size_t __write_slot(char* base, char** out, const char* name, size_t width)
+{
+    size_t name_len = strlen(name);
+
+    memcpy(*out, name, name_len);
+    *out += name_len;
+    *(*out)++ = ':';
+    *(*out)++ = ' ';
+
+    size_t off = *out - base;
+    memset(*out, ' ', width);
+    *out += width;
+
+    memcpy(*out, HTTPP_DELIMITER, HTTPP_DELIMITER_LEN);
+    *out += HTTPP_DELIMITER_LEN;
+    return off;
+}
+
+static bool __template_skips(httpp_header_t* h, int slots)
+{
+    if ((slots & HTTPP_SLOT_CONTENT_LENGTH) && httpp_span_case_eq(&h->name, "content-length"))
+        return true;
+
+    if ((slots & HTTPP_SLOT_DATE) && httpp_span_case_eq(&h->name, "date"))
+        return true;
+
+    if ((slots & HTTPP_SLOT_REQUEST_ID) && httpp_span_case_eq(&h->name, HTTPP_REQUEST_ID_HEADER))
+        return true;
+
+    return false;
+}
+
+bool httpp_res_template_init(httpp_res_template_t* dest, httpp_res_t* res, int slots)
+{
+    if (!dest || !res || res->code < 100 || res->code > 999)
+        return false;
+
+    size_t size = __status_line_len(res->code);
+
+    for (size_t i = 0; i < res->headers.length; i++) {
+        httpp_header_t* h = &res->headers.arr[i];
+
+        if (!h->name.ptr || !h->value.ptr || __template_skips(h, slots))
+            continue;
+
+        size += h->name.length + 2 + h->value.length + HTTPP_DELIMITER_LEN;
+    }
+
+    if (slots & HTTPP_SLOT_CONTENT_LENGTH)
+        size += sizeof("Content-Length: ") - 1 + HTTPP_SLOT_CONTENT_LENGTH_WIDTH + HTTPP_DELIMITER_LEN;
+
+    if (slots & HTTPP_SLOT_DATE)
+        size += sizeof("Date: ") - 1 + HTTPP_SLOT_DATE_WIDTH + HTTPP_DELIMITER_LEN;
+
+    if (slots & HTTPP_SLOT_REQUEST_ID)
+        size += sizeof(HTTPP_REQUEST_ID_HEADER ": ") - 1 + HTTPP_SLOT_REQUEST_ID_WIDTH + HTTPP_DELIMITER_LEN;
+
+    size += HTTPP_DELIMITER_LEN;
+
+    char* raw = (char*) malloc(size);
+    if (!raw)
+        return false;
+
+    char* out = __write_status_line(raw, res->code);
+
+    for (size_t i = 0; i < res->headers.length; i++) {
+        httpp_header_t* h = &res->headers.arr[i];
+
+        if (!h->name.ptr || !h->value.ptr || __template_skips(h, slots))
+            continue;
+
+        memcpy(out, h->name.ptr, h->name.length);
+        out += h->name.length;
+        *out++ = ':';
+        *out++ = ' ';
+        memcpy(out, h->value.ptr, h->value.length);
+        out += h->value.length;
+        memcpy(out, HTTPP_DELIMITER, HTTPP_DELIMITER_LEN);
+        out += HTTPP_DELIMITER_LEN;
+    }
+
+    dest->content_length_off = dest->date_off = dest->request_id_off = 0;
+
+    // Valid values until set, a blank Content-Length would be an invalid header
+    if (slots & HTTPP_SLOT_CONTENT_LENGTH) {
+        dest->content_length_off = __write_slot(raw, &out, "Content-Length", HTTPP_SLOT_CONTENT_LENGTH_WIDTH);
+        raw[dest->content_length_off + HTTPP_SLOT_CONTENT_LENGTH_WIDTH - 1] = '0';
+    }
+
+    if (slots & HTTPP_SLOT_DATE) {
+        dest->date_off = __write_slot(raw, &out, "Date", HTTPP_SLOT_DATE_WIDTH);
+        memcpy(raw + dest->date_off, "Thu, 01 Jan 1970 00:00:00 GMT", HTTPP_SLOT_DATE_WIDTH);
+    }
+
+    if (slots & HTTPP_SLOT_REQUEST_ID)
+        dest->request_id_off = __write_slot(raw, &out, HTTPP_REQUEST_ID_HEADER, HTTPP_SLOT_REQUEST_ID_WIDTH);
+
+    memcpy(out, HTTPP_DELIMITER, HTTPP_DELIMITER_LEN);
+
+    dest->raw = raw;
+    dest->raw_len = size;
+    return true;
+}
+
+bool httpp_res_template_clone(httpp_res_template_t* dest, httpp_res_template_t* src)
+{
+    char* raw = (char*) malloc(src->raw_len);
+    if (!raw)
+        return false;
+
+    memcpy(raw, src->raw, src->raw_len);
+    *dest = *src;
+    dest->raw = raw;
+    return true;
+}
+
+void httpp_res_template_free(httpp_res_template_t* tmpl)
+{
+    free(tmpl->raw);
+    tmpl->raw = NULL;
+    tmpl->raw_len = 0;
+}
+
+bool httpp_res_template_set_content_length(httpp_res_template_t* tmpl, size_t length)
+{
+    if (!tmpl->content_length_off)
+        return false;
+
+    char  digits[20];
+    char* itr = digits + sizeof(digits);
+
+    do {
+        *--itr = '0' + length % 10;
+        length /= 10;
+    } while (length);
+
+    size_t n = digits + sizeof(digits) - itr;
+    if (n > HTTPP_SLOT_CONTENT_LENGTH_WIDTH)
+        return false;
+
+    // Right aligned, leading spaces are optional whitespace after the colon
+    char* slot = tmpl->raw + tmpl->content_length_off;
+    memset(slot, ' ', HTTPP_SLOT_CONTENT_LENGTH_WIDTH - n);
+    memcpy(slot + HTTPP_SLOT_CONTENT_LENGTH_WIDTH - n, itr, n);
+    return true;
+}
+
+void httpp_res_template_set_date(httpp_res_template_t* tmpl, const char* date)
+{
+    if (tmpl->date_off)
+        memcpy(tmpl->raw + tmpl->date_off, date, HTTPP_SLOT_DATE_WIDTH);
+}
+
+bool httpp_res_template_set_request_id(httpp_res_template_t* tmpl, const char* id, size_t id_len)
+{
+    if (!tmpl->request_id_off || id_len > HTTPP_SLOT_REQUEST_ID_WIDTH)
+        return false;
+
+    char* slot = tmpl->raw + tmpl->request_id_off;
+    memcpy(slot, id, id_len);
+    memset(slot + id_len, ' ', HTTPP_SLOT_REQUEST_ID_WIDTH - id_len);
+    return true;
+}
+
+int httpp_early_hints(char* dest, size_t cap, const char* const* links, size_t links_len)
+{
+    static const char status[] = "HTTP/1.1 103 Early Hints\r\n";
+    size_t len = sizeof(status) - 1;
+
+    if (dest == NULL || cap < len + HTTPP_DELIMITER_LEN)
+        return -1;
+
+    memcpy(dest, status, len);
+
+    for (size_t i = 0; i < links_len; i++) {
+        size_t link_len = strlen(links[i]);
+
+        // "Link: " + link + "\r\n", the final "\r\n" has to fit too
+        if (cap - len < 6 + link_len + 2 * HTTPP_DELIMITER_LEN)
+            return -1;
+
+        memcpy(dest + len, "Link: ", 6);
+        memcpy(dest + len + 6, links[i], link_len);
+        memcpy(dest + len + 6 + link_len, HTTPP_DELIMITER, HTTPP_DELIMITER_LEN);
+        len += 6 + link_len + HTTPP_DELIMITER_LEN;
+    }
+
+    memcpy(dest + len, HTTPP_DELIMITER, HTTPP_DELIMITER_LEN);
+    return (int) (len + HTTPP_DELIMITER_LEN);
+}
+
+#ifdef HTTPP_POSIX
+
+#ifndef MSG_MORE
+# define MSG_MORE 0
+#endif
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+bool httpp_file_sender_init(httpp_file_sender_t* dest, httpp_res_t* res)
+{
+    dest->head = httpp_res_to_raw(res, &dest->head_len);
+    if (!dest->head)
+        return false;
+
+    dest->head_off = 0;
+    dest->fd = res->file.fd;
+    dest->offset = (off_t) res->file.offset;
+    dest->remaining = res->file.fd == -1 ? 0 : res->file.length;
+    return true;
+}
+
+void httpp_file_sender_free(httpp_file_sender_t* sender)
+{
+    free(sender->head);
+    sender->head = NULL;
+}
+
+// Moves up to `n` bytes of the body to `sock`, returns what the underlying call returned
+static ssize_t __send_file_chunk(httpp_file_sender_t* s, int sock, size_t n)
+{
+#ifdef __linux__
+    ssize_t w = sendfile(sock, s->fd, &s->offset, n);
+# ifdef SPLICE_F_MOVE
+    if (w == -1 && errno == EINVAL) {
+        // Not a regular file, e.g a pipe. Those have no offset.
+        w = splice(s->fd, NULL, sock, NULL, n, SPLICE_F_MOVE | SPLICE_F_MORE);
+    }
+# endif
+    return w;
+#else
+    char chunk[16384];
+
+    if (n > sizeof(chunk))
+        n = sizeof(chunk);
+
+    ssize_t r = pread(s->fd, chunk, n, s->offset);
+    if (r <= 0)
+        return r;
+
+    ssize_t w = send(sock, chunk, r, MSG_NOSIGNAL);
+    if (w > 0)
+        s->offset += w;
+    return w;
+#endif
+}
+
+int httpp_file_sender_send(httpp_file_sender_t* sender, int sock)
+{
+    while (sender->head_off < sender->head_len) {
+        int flags = MSG_NOSIGNAL | (sender->remaining ? MSG_MORE : 0);
+        ssize_t w = send(sock, sender->head + sender->head_off, 
+                         sender->head_len - sender->head_off, flags);
+
+        if (w == -1) {
+            if (errno == EINTR)
+                continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+
+        sender->head_off += w;
+    }
+
+    while (sender->remaining > 0) {
+        size_t n = sender->remaining > 0x7ffff000 ? 0x7ffff000 : sender->remaining;
+        ssize_t w = __send_file_chunk(sender, sock, n);
+
+        if (w == 0)
+            return -1; // File is shorter than promised
+
+        if (w == -1) {
+            if (errno == EINTR)
+                continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+
+        sender->remaining -= w;
+    }
+
+    return 1;
+}
+
+int httpp_res_template_iov(httpp_res_template_t* tmpl, 
+                           const char* body, size_t body_len, struct iovec iov[2])
+{
+    iov[0].iov_base = tmpl->raw;
+    iov[0].iov_len = tmpl->raw_len;
+
+    if (!body || body_len == 0)
+        return 1;
+
+    iov[1].iov_base = (void*) body;
+    iov[1].iov_len = body_len;
+    return 2;
+}
+
+ssize_t httpp_res_template_writev(int fd, httpp_res_template_t* tmpl, const char* body, size_t body_len)
+{
+    struct iovec iov[2];
+    int n = httpp_res_template_iov(tmpl, body, body_len, iov);
+    return writev(fd, iov, n);
+}
+#endif // HTTPP_POSIX
+
 #endif // HTTPP_IMPLEMENTATION
 #endif // _HTTPP_HEADER
 
@@ -0,0 +1,517 @@
+#ifndef _HTTPP_HPP_HEADER
+#define _HTTPP_HPP_HEADER
+
+/*
+ * C++17 interface for httpp. Everything is a thin layer over the C functions,
+ * the same HTTPP_IMPLEMENTATION rule applies: define it in exactly one translation unit.
+ *
+ *      httpp::request req;
+ *      if (req.parse(buf, n) < 0) ...
+ *
+ *      std::string_view host = req.header("Host"_h);  // using namespace httpp::literals
+ *
+ * Spans are exposed as std::string_view, which point into the parsed buffer just like
+ * the spans do, so nothing is copied or allocated.
+ *
+ * httpp::response owns headers added with add_header and frees them on destruction
+ * (instead of httpp_res_free_added). Both request and response are move-only.
+ *
+ * httpp::parser<Headers...> parses a request, but only keeps the headers listed as
+ * template arguments. Names are matched by FNV-1a hashes computed at compile time,
+ * there is no headers array and no capacity limit for the rest of the headers:
+ *
+ *      httpp::parser<httpp::hdr::host, httpp::hdr::content_length> p;
+ *      p.parse(buf, n);
+ *      p.get<httpp::hdr::host>();
+ *
+ * With C++20 any header can be used as httpp::hdr::named<"X-Api-Key">.
+ */
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "httpp.h"
+
+namespace httpp {
+
+inline std::string_view to_view(const httpp_span_t& span)
+{
+    return span.ptr ? std::string_view(span.ptr, span.length) : std::string_view();
+}
+
+constexpr char ascii_lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (char) (c - 'A' + 'a') : c;
+}
+
+constexpr bool case_eq(std::string_view a, std::string_view b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); i++) {
+        if (ascii_lower(a[i]) != ascii_lower(b[i]))
+            return false;
+    }
+
+    return true;
+}
+
+// FNV-1a of the lowercased name, header names are case insensitive
+constexpr uint32_t name_hash(std::string_view name)
+{
+    uint32_t h = 2166136261u;
+
+    for (char c : name) {
+        h ^= (unsigned char) ascii_lower(c);
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+// Header name with its hash, "Host"_h
+struct header_name {
+    std::string_view name;
+    uint32_t hash;
+
+    constexpr header_name(std::string_view n) : name(n), hash(name_hash(n)) {}
+};
+
+namespace literals {
+    constexpr header_name operator""_h(const char* s, size_t n)
+    {
+        return header_name(std::string_view(s, n));
+    }
+}
+
+struct header {
+    std::string_view name;
+    std::string_view value;
+};
+
+// Iterable view over a headers array, yields httpp::header
+class headers_view {
+public:
+    class iterator {
+    public:
+        explicit iterator(const httpp_header_t* h) : h_(h) {}
+
+        header operator*() const { return {to_view(h_->name), to_view(h_->value)}; }
+        iterator& operator++() { ++h_; return *this; }
+        bool operator!=(const iterator& o) const { return h_ != o.h_; }
+        bool operator==(const iterator& o) const { return h_ == o.h_; }
+
+    private:
+        const httpp_header_t* h_;
+    };
+
+    explicit headers_view(const httpp_headers_arr_t& hs) : hs_(hs) {}
+
+    iterator begin() const { return iterator(hs_.arr); }
+    iterator end() const { return iterator(hs_.arr + hs_.length); }
+    size_t size() const { return hs_.length; }
+
+    // Value of the first header named `name`, empty view if there is none
+    std::string_view find(header_name name) const
+    {
+        for (size_t i = 0; i < hs_.length; i++) {
+            const httpp_header_t& h = hs_.arr[i];
+
+            if (h.name.length == name.name.size() && case_eq(to_view(h.name), name.name))
+                return to_view(h.value);
+        }
+
+        return std::string_view();
+    }
+
+    bool contains(header_name name) const
+    {
+        return find(name).data() != nullptr;
+    }
+
+private:
+    const httpp_headers_arr_t& hs_;
+};
+
+/*
+ * Parsed request with room for `Cap` headers. Views returned by the accessors point
+ * into the buffer passed to parse, which must outlive them.
+ */
+template <size_t Cap = HTTPP_DEFAULT_HEADERS_ARR_CAP>
+class basic_request {
+public:
+    basic_request() { httpp_req_init(&req_, arr_.data(), Cap); }
+
+    basic_request(const basic_request&) = delete;
+    basic_request& operator=(const basic_request&) = delete;
+
+    basic_request(basic_request&& o) noexcept : arr_(o.arr_), req_(o.req_)
+    {
+        req_.headers.arr = arr_.data();
+    }
+
+    basic_request& operator=(basic_request&& o) noexcept
+    {
+        arr_ = o.arr_;
+        req_ = o.req_;
+        req_.headers.arr = arr_.data();
+        return *this;
+    }
+
+    /*
+     * Same as httpp_parse_request, previous headers are dropped.
+     *   On failure returns -1.
+     */
+    int parse(char* buf, size_t n)
+    {
+        httpp_req_init(&req_, arr_.data(), Cap);
+        return httpp_parse_request(buf, n, &req_);
+    }
+
+    int method() const { return req_.method; }
+    std::string_view method_name() const { return httpp_method_to_string(req_.method); }
+    std::string_view route() const { return to_view(req_.route); }
+    std::string_view version() const { return to_view(req_.version); }
+    std::string_view body() const { return to_view(req_.body); }
+    int version_major() const { return req_.version_major; }
+    int version_minor() const { return req_.version_minor; }
+    bool keep_alive() const { return req_.keep_alive; }
+    bool upgrade() const { return req_.upgrade; }
+    bool expect_continue() const { return req_.expect_continue; }
+
+    headers_view headers() const { return headers_view(req_.headers); }
+    std::string_view header(header_name name) const { return headers().find(name); }
+
+    httpp_req_t* c() { return &req_; }
+    const httpp_req_t* c() const { return &req_; }
+
+private:
+    std::array<httpp_header_t, Cap> arr_;
+    httpp_req_t req_;
+};
+
+using request = basic_request<>;
+
+// Serialized response, malloc'd by httpp_res_to_raw
+class raw_response {
+public:
+    raw_response(char* raw, size_t len) : raw_(raw), len_(len) {}
+
+    explicit operator bool() const { return raw_ != nullptr; }
+    std::string_view view() const { return raw_ ? std::string_view(raw_.get(), len_) : std::string_view(); }
+    const char* data() const { return raw_.get(); }
+    size_t size() const { return len_; }
+
+private:
+    struct free_deleter {
+        void operator()(char* p) const { std::free(p); }
+    };
+
+    std::unique_ptr<char, free_deleter> raw_;
+    size_t len_;
+};
+
+/*
+ * Response with room for `Cap` headers. Headers added with add_header are copied
+ * and freed by the destructor, borrow_header and body only keep views.
+ */
+template <size_t Cap = HTTPP_DEFAULT_HEADERS_ARR_CAP>
+class basic_response {
+public:
+    explicit basic_response(int status = 200) { httpp_res_init(&res_, arr_.data(), Cap, status); }
+
+    ~basic_response() { httpp_res_free_added(&res_); }
+
+    basic_response(const basic_response&) = delete;
+    basic_response& operator=(const basic_response&) = delete;
+
+    basic_response(basic_response&& o) noexcept : arr_(o.arr_), res_(o.res_)
+    {
+        res_.headers.arr = arr_.data();
+        o.res_.headers.length = 0; // Owned strings belong to us now
+    }
+
+    basic_response& operator=(basic_response&& o) noexcept
+    {
+        if (this != &o) {
+            httpp_res_free_added(&res_);
+            arr_ = o.arr_;
+            res_ = o.res_;
+            res_.headers.arr = arr_.data();
+            o.res_.headers.length = 0;
+        }
+        return *this;
+    }
+
+    void status(int code) { res_.code = code; }
+    int status() const { return res_.code; }
+
+    // Copies name and value, which must be '\0' terminated. On failure returns false
+    bool add_header(const char* name, const char* value)
+    {
+        return httpp_res_add_header(&res_, name, value) != nullptr;
+    }
+
+    // Keeps views of name and value, they must outlive the response. On failure returns false
+    bool borrow_header(std::string_view name, std::string_view value)
+    {
+        httpp_header_t h = {
+            {const_cast<char*>(name.data()), name.size(), false},
+            {const_cast<char*>(value.data()), value.size(), false}
+        };
+
+        return httpp_headers_arr_append(&res_.headers, h) != nullptr;
+    }
+
+    // Body is not copied
+    void body(std::string_view b)
+    {
+        res_.body.ptr = const_cast<char*>(b.data());
+        res_.body.length = b.size();
+        res_.body.is_owned = false;
+    }
+
+    std::string_view body() const { return to_view(res_.body); }
+    headers_view headers() const { return headers_view(res_.headers); }
+
+    // Same as httpp_res_to_raw
+    raw_response to_raw()
+    {
+        size_t len = 0;
+        char* raw = httpp_res_to_raw(&res_, &len);
+        return raw_response(raw, raw ? len : 0);
+    }
+
+    httpp_res_t* c() { return &res_; }
+    const httpp_res_t* c() const { return &res_; }
+
+private:
+    std::array<httpp_header_t, Cap> arr_;
+    httpp_res_t res_;
+};
+
+using response = basic_response<>;
+
+/*
+ * Header tags for httpp::parser. A tag is any type with a
+ * `static constexpr std::string_view name`.
+ */
+namespace hdr {
+#define HTTPP_HEADER_TAG(tag, str) \
+    struct tag { static constexpr std::string_view name = str; }
+
+    HTTPP_HEADER_TAG(host, "Host");
+    HTTPP_HEADER_TAG(content_length, "Content-Length");
+    HTTPP_HEADER_TAG(content_type, "Content-Type");
+    HTTPP_HEADER_TAG(transfer_encoding, "Transfer-Encoding");
+    HTTPP_HEADER_TAG(connection, "Connection");
+    HTTPP_HEADER_TAG(upgrade, "Upgrade");
+    HTTPP_HEADER_TAG(expect, "Expect");
+    HTTPP_HEADER_TAG(cookie, "Cookie");
+    HTTPP_HEADER_TAG(authorization, "Authorization");
+    HTTPP_HEADER_TAG(user_agent, "User-Agent");
+    HTTPP_HEADER_TAG(accept, "Accept");
+    HTTPP_HEADER_TAG(accept_encoding, "Accept-Encoding");
+    HTTPP_HEADER_TAG(if_none_match, "If-None-Match");
+    HTTPP_HEADER_TAG(if_modified_since, "If-Modified-Since");
+    HTTPP_HEADER_TAG(range, "Range");
+
+#undef HTTPP_HEADER_TAG
+
+#if __cplusplus >= 202002L
+    template <size_t N>
+    struct fixed_string {
+        char data[N] = {};
+
+        constexpr fixed_string(const char (&s)[N])
+        {
+            for (size_t i = 0; i < N; i++)
+                data[i] = s[i];
+        }
+
+        constexpr std::string_view view() const { return std::string_view(data, N - 1); }
+    };
+
+    // Any header, hdr::named<"X-Api-Key">
+    template <fixed_string S>
+    struct named {
+        static constexpr std::string_view name = S.view();
+    };
+#endif
+}
+
+namespace detail {
+    template <typename T, typename... Ts>
+    struct index_of;
+
+    template <typename T, typename... Ts>
+    struct index_of<T, T, Ts...> : std::integral_constant<size_t, 0> {};
+
+    template <typename T, typename U, typename... Ts>
+    struct index_of<T, U, Ts...> : std::integral_constant<size_t, 1 + index_of<T, Ts...>::value> {};
+
+    // Applies tokens of the Connection header value, same rules as the C parser
+    inline void apply_connection(httpp_req_t& req, std::string_view value)
+    {
+        while (!value.empty()) {
+            size_t comma = value.find(',');
+            std::string_view tok = value.substr(0, comma);
+            value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+
+            while (!tok.empty() && (tok.front() == ' ' || tok.front() == '\t'))
+                tok.remove_prefix(1);
+            while (!tok.empty() && (tok.back() == ' ' || tok.back() == '\t'))
+                tok.remove_suffix(1);
+
+            // Same as the C parser, "close" wins over any "keep-alive"
+            if (case_eq(tok, "close")) {
+                req.keep_alive = false;
+                req.conn_close = true;
+            }
+            else if (case_eq(tok, "keep-alive"))
+                req.keep_alive = !req.conn_close;
+            else if (case_eq(tok, "upgrade"))
+                req.upgrade = true;
+        }
+    }
+
+    // "100-continue" sets expect_continue, same rules as the C parser
+    inline void apply_expect(httpp_req_t& req, std::string_view value)
+    {
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+            value.remove_prefix(1);
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+            value.remove_suffix(1);
+
+        if (case_eq(value, "100-continue"))
+            req.expect_continue = req.version_major > 1 || (req.version_major == 1 && req.version_minor >= 1);
+    }
+}
+
+/*
+ * Request parser which records only `Headers...`. When a header is repeated, the
+ * first one is kept. Connection and Expect are always looked at for keep_alive / upgrade
+ * and expect_continue.
+ */
+template <typename... Headers>
+class parser {
+public:
+    static constexpr size_t size = sizeof...(Headers);
+
+    parser() { reset(); }
+
+    /*
+     * Parses start line and headers of `buf`, body is everything after the header block.
+     *   On failure returns -1.
+     *
+     * On sucess returns offset of the body
+     */
+    int parse(char* buf, size_t n)
+    {
+        reset();
+
+        if (buf == nullptr)
+            return -1;
+
+        if (n == 0)
+            return 0;
+
+        int off = httpp_parse_start_line(buf, n, &req_);
+        if (off == -1)
+            return -1;
+
+        std::string_view rest(buf + off, n - off);
+
+        while (!rest.empty()) {
+            size_t eol = rest.find(HTTPP_DELIMITER);
+            if (eol == std::string_view::npos)
+                break;
+
+            if (eol == 0) {
+                rest.remove_prefix(HTTPP_DELIMITER_LEN);
+                break;
+            }
+
+            // Reuses the C header line parser, so trimming rules stay the same
+            httpp_header_t line;
+            httpp_headers_arr_t scratch = {&line, 1, 0};
+
+            if (httpp_parse_header(&scratch, const_cast<char*>(rest.data()), eol) == nullptr)
+                return -1;
+
+            record(to_view(line.name), to_view(line.value));
+            rest.remove_prefix(eol + HTTPP_DELIMITER_LEN);
+        }
+
+        req_.body.ptr = const_cast<char*>(rest.data());
+        req_.body.length = rest.size();
+        return (int) (rest.data() - buf);
+    }
+
+    // Value of a recorded header, empty view if it wasn't present
+    template <typename H>
+    std::string_view get() const
+    {
+        return values_[detail::index_of<H, Headers...>::value];
+    }
+
+    template <typename H>
+    bool has() const
+    {
+        return get<H>().data() != nullptr;
+    }
+
+    int method() const { return req_.method; }
+    std::string_view route() const { return to_view(req_.route); }
+    std::string_view version() const { return to_view(req_.version); }
+    std::string_view body() const { return to_view(req_.body); }
+    int version_major() const { return req_.version_major; }
+    int version_minor() const { return req_.version_minor; }
+    bool keep_alive() const { return req_.keep_alive; }
+    bool upgrade() const { return req_.upgrade; }
+    bool expect_continue() const { return req_.expect_continue; }
+
+private:
+    void reset()
+    {
+        httpp_req_init(&req_, nullptr, 0);
+        values_.fill(std::string_view());
+    }
+
+    void record(std::string_view name, std::string_view value)
+    {
+        constexpr uint32_t connection = name_hash("Connection");
+        constexpr uint32_t expect = name_hash("Expect");
+        uint32_t h = name_hash(name);
+
+        if (h == connection && case_eq(name, "Connection"))
+            detail::apply_connection(req_, value);
+        else if (h == expect && case_eq(name, "Expect"))
+            detail::apply_expect(req_, value);
+
+        match(h, name, value, std::index_sequence_for<Headers...>{});
+    }
+
+    template <size_t... I>
+    void match(uint32_t h, std::string_view name, std::string_view value, std::index_sequence<I...>)
+    {
+        // Unrolled into one comparison per header, hashes are constants
+        (void) ((h == hashes_[I] && case_eq(name, Headers::name)
+                 && (values_[I].data() ? true : (values_[I] = value, true))) || ...);
+    }
+
+    static constexpr std::array<uint32_t, sizeof...(Headers)> hashes_ = {name_hash(Headers::name)...};
+
+    std::array<std::string_view, sizeof...(Headers)> values_;
+    httpp_req_t req_;
+};
+
+} // namespace httpp
+
+#endif // _HTTPP_HPP_HEADER
@@ -0,0 +1,368 @@
+#ifndef _HTTPP_ACCEPT_HEADER
+#define _HTTPP_ACCEPT_HEADER
+
+/*
+ * Content negotiation (RFC 9110, 12.5) for httpp: Accept, Accept-Encoding,
+ * Accept-Language and anything else shaped like "a;q=0.5, b, c;q=0".
+ *
+ * q-values are fixed point integers in thousandths (q=0.8 -> 800, missing q -> 1000).
+ * No floats, no allocation, the header value is never modified.
+ *
+ *      const char* encodings[] = {"br", "gzip", "identity"};
+ *      httpp_header_t* h = httpp_req_find_header(&req, "Accept-Encoding");
+ *      int best = httpp_negotiate_encoding(h ? &h->value : NULL, encodings, 3);
+ *
+ * negotiate functions return index of the best entry in the server's `supported`
+ * list, or -1 if none is acceptable (respond 406 then, or ignore the header).
+ * When the client sends no header at all (NULL), index 0 is returned.
+ * Ties are broken by the order of `supported`, so list preferred ones first.
+ *
+ * Header values browsers send all the time are matched as a whole against a small
+ * table of pre-parsed lists first, those skip tokenizing entirely.
+ */
+
+#include "httpp.h"
+
+#define HTTPP_Q_MAX 1000
+
+// Max length of the `supported` list passed to negotiate functions
+#define HTTPP_ACCEPT_MAX_SUPPORTED 32
+
+typedef struct {
+    httpp_span_t value;  // e.g "text/html", "gzip", "en-us"
+    httpp_span_t params; // Everything between value and q, without ';'. Might be empty
+    int q;               // 0..HTTPP_Q_MAX
+} httpp_accept_item_t;
+
+typedef struct {
+    char* itr;
+    char* end;
+} httpp_accept_iter_t;
+
+// Prepares `it` to iterate over comma separated items of `header_value`
+void httpp_accept_iter_init(httpp_accept_iter_t* it, httpp_span_t* header_value);
+
+/*
+ * Stores the next item into `out`. Malformed q-values are treated as q=0
+ *   When there are no more items returns false.
+ */
+bool httpp_accept_next(httpp_accept_iter_t* it, httpp_accept_item_t* out);
+
+/*
+ * Parses qvalue ("0", "0.5", "1.000", ...) into thousandths.
+ *   On failure returns -1.
+ */
+int httpp_parse_qvalue(const char* str, size_t len);
+
+// Accept: media ranges with "*/*" and "type/*" wildcards
+int httpp_negotiate_media(httpp_span_t* accept, const char* const* supported, size_t n);
+
+// Accept-Encoding: "*" wildcard, "identity" is acceptable unless excluded explicitly
+int httpp_negotiate_encoding(httpp_span_t* accept_encoding, const char* const* supported, size_t n);
+
+// Accept-Language: "*" wildcard, "en" matches "en-us" (RFC 4647 basic filtering)
+int httpp_negotiate_language(httpp_span_t* accept_language, const char* const* supported, size_t n);
+
+#ifdef HTTPP_IMPLEMENTATION
+
+#define __ACCEPT_ISWS(c) ((c) == ' ' || (c) == '\t')
+
+#define __ACCEPT_MEDIA    0
+#define __ACCEPT_ENCODING 1
+#define __ACCEPT_LANGUAGE 2
+
+#define __ACCEPT_LIT(s) s, sizeof(s) - 1
+
+typedef struct {
+    const char* value;
+    size_t value_len;
+    int q;
+} __accept_static_item_t;
+
+typedef struct {
+    const char* literal;
+    size_t literal_len;
+    const __accept_static_item_t* items;
+    size_t items_len;
+} __accept_fast_path_t;
+
+static const __accept_static_item_t __accept_any[] = {{__ACCEPT_LIT("*/*"), 1000}};
+
+static const __accept_static_item_t __accept_browser_html[] = {
+    {__ACCEPT_LIT("text/html"), 1000}, {__ACCEPT_LIT("application/xhtml+xml"), 1000},
+    {__ACCEPT_LIT("application/xml"), 900}, {__ACCEPT_LIT("*/*"), 800}
+};
+
+static const __accept_static_item_t __accept_browser_html_img[] = {
+    {__ACCEPT_LIT("text/html"), 1000}, {__ACCEPT_LIT("application/xhtml+xml"), 1000},
+    {__ACCEPT_LIT("application/xml"), 900}, {__ACCEPT_LIT("image/avif"), 1000},
+    {__ACCEPT_LIT("image/webp"), 1000}, {__ACCEPT_LIT("image/apng"), 1000},
+    {__ACCEPT_LIT("*/*"), 800}, {__ACCEPT_LIT("application/signed-exchange"), 700}
+};
+
+static const __accept_static_item_t __accept_json[] = {{__ACCEPT_LIT("application/json"), 1000}};
+
+static const __accept_fast_path_t __accept_media_fast[] = {
+    {__ACCEPT_LIT("*/*"), __accept_any, 1},
+    {__ACCEPT_LIT("text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8"), __accept_browser_html, 4},
+    {__ACCEPT_LIT("text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,"
+     "image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7"), __accept_browser_html_img, 8},
+    {__ACCEPT_LIT("application/json"), __accept_json, 1},
+};
+
+static const __accept_static_item_t __accept_gzip_deflate[] = {
+    {__ACCEPT_LIT("gzip"), 1000}, {__ACCEPT_LIT("deflate"), 1000}
+};
+
+static const __accept_static_item_t __accept_gzip_deflate_br[] = {
+    {__ACCEPT_LIT("gzip"), 1000}, {__ACCEPT_LIT("deflate"), 1000}, {__ACCEPT_LIT("br"), 1000}
+};
+
+static const __accept_static_item_t __accept_gzip_deflate_br_zstd[] = {
+    {__ACCEPT_LIT("gzip"), 1000}, {__ACCEPT_LIT("deflate"), 1000},
+    {__ACCEPT_LIT("br"), 1000}, {__ACCEPT_LIT("zstd"), 1000}
+};
+
+static const __accept_static_item_t __accept_gzip[] = {{__ACCEPT_LIT("gzip"), 1000}};
+static const __accept_static_item_t __accept_identity[] = {{__ACCEPT_LIT("identity"), 1000}};
+
+static const __accept_fast_path_t __accept_encoding_fast[] = {
+    {__ACCEPT_LIT("gzip, deflate, br, zstd"), __accept_gzip_deflate_br_zstd, 4},
+    {__ACCEPT_LIT("gzip, deflate, br"), __accept_gzip_deflate_br, 3},
+    {__ACCEPT_LIT("gzip, deflate"), __accept_gzip_deflate, 2},
+    {__ACCEPT_LIT("gzip,deflate"), __accept_gzip_deflate, 2},
+    {__ACCEPT_LIT("gzip"), __accept_gzip, 1},
+    {__ACCEPT_LIT("identity"), __accept_identity, 1},
+};
+
+static const __accept_static_item_t __accept_en_us[] = {
+    {__ACCEPT_LIT("en-US"), 1000}, {__ACCEPT_LIT("en"), 900}
+};
+
+static const __accept_fast_path_t __accept_language_fast[] = {
+    {__ACCEPT_LIT("en-US,en;q=0.9"), __accept_en_us, 2},
+    {__ACCEPT_LIT("en-US,en;q=0.5"), __accept_en_us, 2},
+};
+
+void httpp_accept_iter_init(httpp_accept_iter_t* it, httpp_span_t* header_value)
+{
+    it->itr = header_value->ptr;
+    it->end = header_value->ptr + header_value->length;
+}
+
+int httpp_parse_qvalue(const char* str, size_t len)
+{
+    if (len == 0 || (str[0] != '0' && str[0] != '1'))
+        return -1;
+
+    int q = (str[0] - '0') * 1000;
+
+    if (len == 1)
+        return q;
+
+    if (str[1] != '.' || len > 5)
+        return -1;
+
+    int scale = 100;
+    for (size_t i = 2; i < len; i++, scale /= 10) {
+        if (str[i] < '0' || str[i] > '9')
+            return -1;
+        q += (str[i] - '0') * scale;
+    }
+
+    return q > HTTPP_Q_MAX ? -1 : q;
+}
+
+static inline void __accept_trim(char** str, size_t* len)
+{
+    while (*len > 0 && __ACCEPT_ISWS(**str)) {
+        (*str)++;
+        (*len)--;
+    }
+
+    while (*len > 0 && __ACCEPT_ISWS((*str)[*len - 1]))
+        (*len)--;
+}
+
+bool httpp_accept_next(httpp_accept_iter_t* it, httpp_accept_item_t* out)
+{
+    while (it->itr < it->end) {
+        char* start = it->itr;
+        char* comma = (char*) memchr(start, ',', it->end - start);
+        char* stop = comma ? comma : it->end;
+
+        it->itr = comma ? comma + 1 : it->end;
+
+        char* semi = (char*) memchr(start, ';', stop - start);
+        size_t value_len = (semi ? semi : stop) - start;
+
+        __accept_trim(&start, &value_len);
+        if (value_len == 0)
+            continue; // Empty element, e.g "gzip,,br"
+
+        out->value = (httpp_span_t){start, value_len, false};
+        out->params = (httpp_span_t){stop, 0, false};
+        out->q = HTTPP_Q_MAX;
+
+        // Parameters, q must be the last one
+        char* param = semi;
+        while (param) {
+            char* pstart = param + 1;
+            char* next = (char*) memchr(pstart, ';', stop - pstart);
+            size_t plen = (next ? next : stop) - pstart;
+
+            __accept_trim(&pstart, &plen);
+
+            if (plen >= 2 && (pstart[0] == 'q' || pstart[0] == 'Q') && pstart[1] == '=') {
+                int q = httpp_parse_qvalue(pstart + 2, plen - 2);
+                out->q = q < 0 ? 0 : q;
+                break;
+            }
+
+            if (out->params.length == 0)
+                out->params.ptr = pstart;
+            out->params.length = pstart + plen - out->params.ptr;
+
+            param = next;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * How specific `range` is for `candidate`, 0 means no match.
+ * Bigger wins when several ranges match the same candidate.
+ */
+static int __accept_match(int kind, const char* range, size_t range_len, const char* candidate)
+{
+    size_t cand_len = strlen(candidate);
+
+    if (range_len == 1 && range[0] == '*')
+        return 1;
+
+    if (kind == __ACCEPT_MEDIA) {
+        if (range_len == 3 && memcmp(range, "*/*", 3) == 0)
+            return 1;
+
+        if (range_len >= 2 && range[range_len - 2] == '/' && range[range_len - 1] == '*') {
+            return cand_len > range_len - 1
+                && strncasecmp(range, candidate, range_len - 1) == 0 ? 2 : 0;
+        }
+
+        return range_len == cand_len && strncasecmp(range, candidate, cand_len) == 0 ? 3 : 0;
+    }
+
+    if (kind == __ACCEPT_LANGUAGE) {
+        // "en" matches "en" and "en-us", longer prefix is more specific
+        if (range_len > cand_len || strncasecmp(range, candidate, range_len) != 0)
+            return 0;
+
+        if (range_len < cand_len && candidate[range_len] != '-')
+            return 0;
+
+        return 1 + (int) range_len;
+    }
+
+    return range_len == cand_len && strncasecmp(range, candidate, cand_len) == 0 ? 2 : 0;
+}
+
+typedef struct {
+    int q[HTTPP_ACCEPT_MAX_SUPPORTED];
+    int spec[HTTPP_ACCEPT_MAX_SUPPORTED];
+} __accept_state_t;
+
+static inline void __accept_apply(int kind, __accept_state_t* st, const char* range, size_t range_len,
+                                  int q, const char* const* supported, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        int spec = __accept_match(kind, range, range_len, supported[i]);
+
+        if (spec > st->spec[i]) {
+            st->spec[i] = spec;
+            st->q[i] = q;
+        }
+    }
+}
+
+static int __accept_negotiate(int kind, httpp_span_t* header, const __accept_fast_path_t* fast,
+                              size_t fast_len, const char* const* supported, size_t n)
+{
+    if (n == 0 || n > HTTPP_ACCEPT_MAX_SUPPORTED)
+        return -1;
+
+    if (!header || !header->ptr)
+        return 0;
+
+    __accept_state_t st;
+    for (size_t i = 0; i < n; i++) {
+        st.q[i] = 0;
+        st.spec[i] = 0;
+    }
+
+    bool matched_fast = false;
+
+    for (size_t f = 0; f < fast_len; f++) {
+        if (fast[f].literal_len != header->length 
+            || memcmp(fast[f].literal, header->ptr, header->length) != 0)
+            continue;
+
+        for (size_t i = 0; i < fast[f].items_len; i++) {
+            const __accept_static_item_t* item = &fast[f].items[i];
+            __accept_apply(kind, &st, item->value, item->value_len, item->q, supported, n);
+        }
+
+        matched_fast = true;
+        break;
+    }
+
+    if (!matched_fast) {
+        httpp_accept_iter_t it;
+        httpp_accept_item_t item;
+
+        httpp_accept_iter_init(&it, header);
+        while (httpp_accept_next(&it, &item))
+            __accept_apply(kind, &st, item.value.ptr, item.value.length, item.q, supported, n);
+    }
+
+    int best = -1;
+    int best_q = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        int q = st.q[i];
+
+        // identity is always acceptable unless "identity;q=0" or "*;q=0"
+        if (kind == __ACCEPT_ENCODING && st.spec[i] == 0 && strcasecmp(supported[i], "identity") == 0)
+            q = 1;
+
+        if (q > best_q) {
+            best_q = q;
+            best = (int) i;
+        }
+    }
+
+    return best;
+}
+
+int httpp_negotiate_media(httpp_span_t* accept, const char* const* supported, size_t n)
+{
+    return __accept_negotiate(__ACCEPT_MEDIA, accept, __accept_media_fast,
+        sizeof(__accept_media_fast) / sizeof(__accept_media_fast[0]), supported, n);
+}
+
+int httpp_negotiate_encoding(httpp_span_t* accept_encoding, const char* const* supported, size_t n)
+{
+    return __accept_negotiate(__ACCEPT_ENCODING, accept_encoding, __accept_encoding_fast,
+        sizeof(__accept_encoding_fast) / sizeof(__accept_encoding_fast[0]), supported, n);
+}
+
+int httpp_negotiate_language(httpp_span_t* accept_language, const char* const* supported, size_t n)
+{
+    return __accept_negotiate(__ACCEPT_LANGUAGE, accept_language, __accept_language_fast,
+        sizeof(__accept_language_fast) / sizeof(__accept_language_fast[0]), supported, n);
+}
+
+#endif // HTTPP_IMPLEMENTATION
+#endif // _HTTPP_ACCEPT_HEADER
@@ -0,0 +1,204 @@
+#ifndef _HTTPP_COOKIE_HEADER
+#define _HTTPP_COOKIE_HEADER
+
+/*
+ * Cookie header (RFC 6265) iteration for httpp.
+ *
+ * Works on the value span of a `Cookie` header, name and value of each cookie
+ * are spans into the caller's buffer. Nothing is allocated and the buffer is not
+ * modified, unless httpp_cookie_decode is called.
+ *
+ *      httpp_header_t* h = httpp_req_find_header(&req, "Cookie");
+ *      httpp_cookie_iter_t it;
+ *      httpp_cookie_t c;
+ *
+ *      httpp_cookie_iter_init(&it, &h->value);
+ *      while (httpp_cookie_next(&it, &c))
+ *          ...
+ *
+ * Quoted values (name="value") are returned without the quotes, with `quoted` set.
+ * Pairs without '=' are returned with an empty name, the same way browsers treat them.
+ */
+
+#include "httpp.h"
+
+typedef struct {
+    httpp_span_t name;
+    httpp_span_t value;
+    bool quoted;
+} httpp_cookie_t;
+
+typedef struct {
+    char* itr;
+    char* end;
+} httpp_cookie_iter_t;
+
+// Prepares `it` to iterate over cookies in `header_value`
+void httpp_cookie_iter_init(httpp_cookie_iter_t* it, httpp_span_t* header_value);
+
+/*
+ * Stores the next cookie into `out`.
+ *   When there are no more cookies returns false.
+ */
+bool httpp_cookie_next(httpp_cookie_iter_t* it, httpp_cookie_t* out);
+
+/*
+ * Searches `header_value` for a cookie named `name` (case sensitive).
+ *   On failure returns false.
+ */
+bool httpp_cookie_find(httpp_span_t* header_value, const char* name, httpp_cookie_t* out);
+
+/*
+ * Same as httpp_cookie_find, but searches through every Cookie header of `req`.
+ *   On failure returns false.
+ */
+bool httpp_req_find_cookie(httpp_req_t* req, const char* name, httpp_cookie_t* out);
+
+/*
+ * Percent decodes cookie's value in place, this modifies the caller's buffer.
+ *   On malformed value returns false.
+ */
+bool httpp_cookie_decode(httpp_cookie_t* cookie);
+
+#ifdef HTTPP_IMPLEMENTATION
+
+#define __COOKIE_ISWS(c) ((c) == ' ' || (c) == '\t')
+
+void httpp_cookie_iter_init(httpp_cookie_iter_t* it, httpp_span_t* header_value)
+{
+    it->itr = header_value->ptr;
+    it->end = header_value->ptr + header_value->length;
+}
+
+// Fills `out` from a single "name=value" pair, without the ';'
+static void __cookie_split(char* pair, size_t len, httpp_cookie_t* out)
+{
+    LTRIM(pair, len);
+
+    while (len > 0 && __COOKIE_ISWS(pair[len - 1]))
+        len--;
+
+    char* eq = (char*) memchr(pair, '=', len);
+    char* value = pair;
+    size_t value_len = len;
+
+    out->name = (httpp_span_t){pair, 0, false};
+
+    if (eq) {
+        size_t name_len = eq - pair;
+        while (name_len > 0 && __COOKIE_ISWS(pair[name_len - 1]))
+            name_len--;
+
+        out->name.length = name_len;
+        value = eq + 1;
+        value_len = len - (eq - pair) - 1;
+
+        while (value_len > 0 && __COOKIE_ISWS(*value)) {
+            value++;
+            value_len--;
+        }
+    }
+
+    out->quoted = false;
+    if (value_len >= 2 && value[0] == '"' && value[value_len - 1] == '"') {
+        value++;
+        value_len -= 2;
+        out->quoted = true;
+    }
+
+    out->value = (httpp_span_t){value, value_len, false};
+}
+
+bool httpp_cookie_next(httpp_cookie_iter_t* it, httpp_cookie_t* out)
+{
+    while (it->itr < it->end) {
+        char* start = it->itr;
+        char* semi = (char*) memchr(start, ';', it->end - start);
+        char* stop = semi ? semi : it->end;
+
+        it->itr = semi ? semi + 1 : it->end;
+
+        size_t len = stop - start;
+        LTRIM(start, len);
+
+        if (len == 0)
+            continue; // Empty pair, e.g "a=1;;b=2"
+
+        __cookie_split(start, len, out);
+        return true;
+    }
+
+    return false;
+}
+
+bool httpp_cookie_find(httpp_span_t* header_value, const char* name, httpp_cookie_t* out)
+{
+    if (!header_value || !header_value->ptr || !name)
+        return false;
+
+    size_t name_len = strlen(name);
+    char*  base = header_value->ptr;
+    char*  end = base + header_value->length;
+    char*  itr = base;
+
+    if (name_len == 0)
+        return false;
+
+    while (itr < end) {
+        char* hit = (char*) __memfind(itr, end - itr, name, name_len);
+        if (!hit)
+            return false;
+
+        itr = hit + 1;
+
+        // Must be at the beginning of a pair ...
+        char* before = hit;
+        while (before > base && __COOKIE_ISWS(before[-1]))
+            before--;
+
+        if (before != base && before[-1] != ';')
+            continue;
+
+        // ... and be the whole name
+        char* after = hit + name_len;
+        while (after < end && __COOKIE_ISWS(*after))
+            after++;
+
+        if (after >= end || *after != '=')
+            continue;
+
+        char* semi = (char*) memchr(after, ';', end - after);
+        char* stop = semi ? semi : end;
+
+        __cookie_split(hit, stop - hit, out);
+        return true;
+    }
+
+    return false;
+}
+
+bool httpp_req_find_cookie(httpp_req_t* req, const char* name, httpp_cookie_t* out)
+{
+    if (!httpp_req_split_headers(req))
+        return false;
+
+    for (size_t i = 0; i < req->headers.length; i++) {
+        httpp_header_t* h = &req->headers.arr[i];
+
+        if (!httpp_span_case_eq(&h->name, "cookie"))
+            continue;
+
+        if (httpp_cookie_find(&h->value, name, out))
+            return true;
+    }
+
+    return false;
+}
+
+bool httpp_cookie_decode(httpp_cookie_t* cookie)
+{
+    return httpp_span_url_decode(&cookie->value, false);
+}
+
+#endif // HTTPP_IMPLEMENTATION
+#endif // _HTTPP_COOKIE_HEADER
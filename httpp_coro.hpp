@@ -0,0 +1,740 @@
+#ifndef _HTTPP_CORO_HPP_HEADER
+#define _HTTPP_CORO_HPP_HEADER
+
+/*
+ * C++20 coroutines on top of httpp.hpp. Partial reads are handled by the connection,
+ * a handler reads like blocking code:
+ *
+ *      httpp::coro::task<void> serve(httpp::coro::connection<httpp::coro::epoll_backend>& conn)
+ *      {
+ *          while (auto req = co_await conn.read_request()) {
+ *              auto body = co_await conn.read_body(*req);  // std::optional<std::string_view>
+ *              co_await conn.write_response(res);
+ *          }
+ *      }
+ *
+ * The I/O backend is a template parameter. It needs two awaitables, readable(fd)
+ * and writable(fd), which resume the coroutine once the non blocking fd is ready.
+ * epoll_backend is the reference one (edge triggered, single thread).
+ *
+ * Coroutine frames are not allocated per call: promise types take frames from a
+ * per thread pool of power of two blocks, a block is malloc'd the first time it is
+ * needed and then reused, so a connection in steady state doesn't allocate.
+ * Frames bigger than HTTPP_CORO_FRAME_SIZE fall back to operator new.
+ *
+ * Views of a request (route, headers, body) point into the connection buffer and
+ * are valid until the next read_request. connection is only compiled with HTTPP_POSIX.
+ */
+
+#include <coroutine>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "httpp.hpp"
+
+#ifdef __linux__
+# include <sys/epoll.h>
+#endif
+
+#ifndef HTTPP_CORO_FRAME_SIZE
+# define HTTPP_CORO_FRAME_SIZE 16384
+#endif
+
+namespace httpp {
+namespace coro {
+
+// Per thread free lists of power of two blocks (256 bytes up to HTTPP_CORO_FRAME_SIZE) for coroutine frames
+class frame_pool {
+public:
+    static void* allocate(size_t n)
+    {
+        if (n > HTTPP_CORO_FRAME_SIZE)
+            return ::operator new(n);
+
+        state& s = local();
+        size_t c = size_class(n);
+
+        if (s.free[c]) {
+            block* b = s.free[c];
+            s.free[c] = b->next;
+            return b;
+        }
+
+        s.blocks++;
+        return ::operator new(min_size << c);
+    }
+
+    static void deallocate(void* p, size_t n)
+    {
+        if (n > HTTPP_CORO_FRAME_SIZE) {
+            ::operator delete(p);
+            return;
+        }
+
+        state& s = local();
+        size_t c = size_class(n);
+        block* b = static_cast<block*>(p);
+
+        b->next = s.free[c];
+        s.free[c] = b;
+    }
+
+    // Number of blocks ever allocated by this thread
+    static size_t blocks() { return local().blocks; }
+
+private:
+    static constexpr size_t min_size = 256;
+    static constexpr size_t classes = 16;
+
+    struct block {
+        block* next;
+    };
+
+    struct state {
+        block* free[classes] = {};
+        size_t blocks = 0;
+
+        ~state()
+        {
+            for (block* head : free) {
+                while (head) {
+                    block* b = head;
+                    head = b->next;
+                    ::operator delete(b);
+                }
+            }
+        }
+    };
+
+    static size_t size_class(size_t n)
+    {
+        size_t c = 0;
+        while ((min_size << c) < n)
+            c++;
+        return c;
+    }
+
+    static state& local()
+    {
+        static thread_local state s;
+        return s;
+    }
+};
+
+struct pooled_promise {
+    static void* operator new(size_t n) { return frame_pool::allocate(n); }
+    static void operator delete(void* p, size_t n) { frame_pool::deallocate(p, n); }
+};
+
+template <typename T>
+class task;
+
+namespace detail {
+    // Resumes whoever awaited the task, the frame is destroyed by the task object
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+        void await_resume() noexcept {}
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            std::coroutine_handle<> next = h.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+    };
+
+    struct promise_base : pooled_promise {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr error;
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        final_awaiter final_suspend() noexcept { return {}; }
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    template <typename T>
+    struct promise : promise_base {
+        std::optional<T> value;
+
+        task<T> get_return_object();
+
+        template <typename U>
+        void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+    };
+
+    template <>
+    struct promise<void> : promise_base {
+        task<void> get_return_object();
+        void return_void() {}
+    };
+}
+
+/*
+ * Lazily started coroutine, runs when awaited. Awaiting resumes the caller through
+ * symmetric transfer, so deep await chains don't grow the stack.
+ */
+template <typename T = void>
+class [[nodiscard]] task {
+public:
+    using promise_type = detail::promise<T>;
+    using handle = std::coroutine_handle<promise_type>;
+
+    explicit task(handle h) : h_(h) {}
+    task(task&& o) noexcept : h_(std::exchange(o.h_, nullptr)) {}
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+
+    ~task()
+    {
+        if (h_)
+            h_.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+    {
+        h_.promise().continuation = caller;
+        return h_;
+    }
+
+    T await_resume()
+    {
+        if (h_.promise().error)
+            std::rethrow_exception(h_.promise().error);
+
+        if constexpr (!std::is_void_v<T>)
+            return std::move(*h_.promise().value);
+    }
+
+private:
+    handle h_;
+};
+
+template <typename T>
+task<T> detail::promise<T>::get_return_object()
+{
+    return task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+}
+
+inline task<void> detail::promise<void>::get_return_object()
+{
+    return task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+}
+
+namespace detail {
+    struct detached {
+        struct promise_type : pooled_promise {
+            detached get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    inline detached run_detached(task<void> t)
+    {
+        co_await t;
+    }
+}
+
+// Runs `t` until its first suspension, then leaves it to the backend. Exceptions terminate
+inline void spawn(task<void> t)
+{
+    detail::run_detached(std::move(t));
+}
+
+#ifdef __linux__
+// Edge triggered epoll backend, one per thread
+class epoll_backend {
+public:
+    epoll_backend() : epfd_(epoll_create1(EPOLL_CLOEXEC)) {}
+    ~epoll_backend()
+    {
+        if (epfd_ >= 0)
+            close(epfd_);
+    }
+
+    epoll_backend(const epoll_backend&) = delete;
+    epoll_backend& operator=(const epoll_backend&) = delete;
+
+    bool valid() const { return epfd_ >= 0; }
+
+    // Starts watching non blocking `fd`. On failure returns false
+    bool add(int fd)
+    {
+        if (fd < 0)
+            return false;
+
+        if ((size_t) fd >= waiters_.size())
+            waiters_.resize(fd + 1);
+
+        waiters_[fd] = {};
+
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = fd;
+        return epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) == 0;
+    }
+
+    void remove(int fd)
+    {
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+
+        if ((size_t) fd < waiters_.size())
+            waiters_[fd] = {};
+    }
+
+    struct wait {
+        epoll_backend& backend;
+        int fd;
+        bool write;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            slot& s = backend.waiters_[fd];
+            (write ? s.writer : s.reader) = h;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    wait readable(int fd) { return {*this, fd, false}; }
+    wait writable(int fd) { return {*this, fd, true}; }
+
+    /*
+     * Waits up to `timeout_ms` for events and resumes waiting coroutines.
+     *   On failure returns -1.
+     *
+     * On sucess returns number of events
+     */
+    int run_once(int timeout_ms)
+    {
+        struct epoll_event events[64];
+        int n = epoll_wait(epfd_, events, 64, timeout_ms);
+
+        if (n < 0)
+            return errno == EINTR ? 0 : -1;
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            uint32_t ev = events[i].events;
+            bool broken = ev & (EPOLLERR | EPOLLHUP | EPOLLRDHUP);
+
+            if ((size_t) fd >= waiters_.size())
+                continue;
+
+            // Resuming may remove fd, so take the handles first
+            std::coroutine_handle<> reader = (ev & EPOLLIN) || broken ? std::exchange(waiters_[fd].reader, nullptr) : nullptr;
+            std::coroutine_handle<> writer = (ev & EPOLLOUT) || broken ? std::exchange(waiters_[fd].writer, nullptr) : nullptr;
+
+            if (reader)
+                reader.resume();
+            if (writer)
+                writer.resume();
+        }
+
+        return n;
+    }
+
+private:
+    struct slot {
+        std::coroutine_handle<> reader;
+        std::coroutine_handle<> writer;
+    };
+
+    int epfd_;
+    std::vector<slot> waiters_;
+};
+#endif // __linux__
+
+#ifdef HTTPP_POSIX
+/*
+ * HTTP/1.x connection over non blocking `fd`. Requests are read into a fixed buffer
+ * of `Cap` bytes, so the header block plus a body read with read_body must fit it.
+ * A body the handler doesn't read is skipped by the next read_request. The fd is
+ * not closed by the connection.
+ */
+template <typename Backend, size_t Cap = 8192, size_t Headers = HTTPP_DEFAULT_HEADERS_ARR_CAP>
+class connection {
+public:
+    using request = basic_request<Headers>;
+
+    connection(Backend& backend, int fd) : backend_(backend), fd_(fd) {}
+
+    connection(const connection&) = delete;
+    connection& operator=(const connection&) = delete;
+
+    int fd() const { return fd_; }
+
+    /*
+     * Reads the next request's start line and headers. Body is not part of it,
+     * req.body() is empty, use read_body. The body of the previous request is
+     * skipped first if it wasn't read.
+     *   On EOF, error, malformed request or framing which can't be trusted (Content-Length
+     *   with Transfer-Encoding, a coding other than chunked) returns an empty optional.
+     */
+    task<std::optional<request>> read_request()
+    {
+        if (broken_ || !co_await skip_body())
+            co_return std::nullopt;
+
+        compact();
+
+        size_t scanned = 0;
+
+        for (;;) {
+            std::string_view data(buf_, len_);
+            size_t from = scanned > 3 ? scanned - 3 : 0;
+            size_t eoh = data.find("\r\n\r\n", from);
+
+            if (eoh != std::string_view::npos) {
+                size_t head_len = eoh + 4;
+                request req;
+
+                // Only the header block, so the lazy body is empty
+                char saved = buf_[head_len];
+                buf_[head_len] = '\0';
+                int off = req.parse(buf_, head_len);
+                buf_[head_len] = saved;
+
+                if (off < 0 || !frame(req))
+                    co_return std::nullopt;
+
+                consumed_ = head_len;
+                co_return std::optional<request>(std::move(req));
+            }
+
+            scanned = len_;
+
+            if (len_ == Cap || !co_await fill())
+                co_return std::nullopt;
+        }
+    }
+
+    /*
+     * Reads the body of `req`, which must be the last request read. Chunked bodies
+     * are decoded in place, trailer fields are dropped. A request without
+     * Content-Length or Transfer-Encoding has an empty body.
+     *   On EOF, error, malformed chunks or a body which doesn't fit returns an empty
+     *   optional, the connection can't read requests any more.
+     */
+    task<std::optional<std::string_view>> read_body(const request& req)
+    {
+        (void) req; // Framing was taken from it by read_request
+
+        if (chunked_) {
+            auto body = co_await read_chunked(true);
+            broken_ = !body;
+            co_return body;
+        }
+
+        size_t n = body_left_;
+
+        if (n > Cap - consumed_) {
+            broken_ = true;
+            co_return std::nullopt;
+        }
+
+        while (len_ - consumed_ < n) {
+            if (!co_await fill()) {
+                broken_ = true;
+                co_return std::nullopt;
+            }
+        }
+
+        std::string_view body(buf_ + consumed_, n);
+        consumed_ += n;
+        body_left_ = 0;
+        co_return std::optional<std::string_view>(body);
+    }
+
+    /*
+     * Writes all of `iov`, waiting while the socket is full. `iov` is modified.
+     *   On failure returns false.
+     */
+    task<bool> writev(struct iovec* iov, int iovcnt)
+    {
+        while (iovcnt > 0) {
+            ssize_t w = ::writev(fd_, iov, iovcnt);
+
+            if (w < 0) {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    co_return false;
+
+                co_await backend_.writable(fd_);
+                continue;
+            }
+
+            // Skip what was written
+            while (iovcnt > 0 && (size_t) w >= iov->iov_len) {
+                w -= iov->iov_len;
+                iov++;
+                iovcnt--;
+            }
+
+            if (iovcnt > 0) {
+                iov->iov_base = (char*) iov->iov_base + w;
+                iov->iov_len -= w;
+            }
+        }
+
+        co_return true;
+    }
+
+    task<bool> write(std::string_view data)
+    {
+        struct iovec iov = {const_cast<char*>(data.data()), data.size()};
+        co_return co_await writev(&iov, 1);
+    }
+
+    /*
+     * Writes one chunk of a chunked body. An empty `data` writes the last chunk.
+     *   On failure returns false.
+     */
+    task<bool> write_chunk(std::string_view data)
+    {
+        char size[20];
+        int size_len = snprintf(size, sizeof(size), "%zx\r\n", data.size());
+
+        struct iovec iov[3] = {
+            {size, (size_t) size_len},
+            {const_cast<char*>(data.data()), data.size()},
+            {const_cast<char*>(HTTPP_DELIMITER), HTTPP_DELIMITER_LEN}
+        };
+
+        co_return co_await writev(iov, 3);
+    }
+
+    // Serializes `res` with httpp_res_to_raw and writes it. On failure returns false
+    template <size_t N>
+    task<bool> write_response(basic_response<N>& res)
+    {
+        raw_response raw = res.to_raw();
+        if (!raw)
+            co_return false;
+
+        co_return co_await write(raw.view());
+    }
+
+private:
+    // Takes the body framing of `req` (RFC 9112, 6.3). On framing which can't be trusted returns false
+    bool frame(const request& req)
+    {
+        std::string_view te = req.header(header_name("Transfer-Encoding"));
+        std::string_view cl = req.header(header_name("Content-Length"));
+
+        body_left_ = 0;
+        chunked_ = false;
+
+        if (te.data()) {
+            while (!te.empty() && (te.front() == ' ' || te.front() == '\t'))
+                te.remove_prefix(1);
+            while (!te.empty() && (te.back() == ' ' || te.back() == '\t'))
+                te.remove_suffix(1);
+
+            // Both headers is a smuggling attempt, other codings can't be framed here
+            if (cl.data() || !case_eq(te, "chunked"))
+                return false;
+
+            chunked_ = true;
+            return true;
+        }
+
+        if (cl.data()) {
+            httpp_span_t value = {const_cast<char*>(cl.data()), cl.size(), false};
+            return httpp_parse_content_length(&value, &body_left_);
+        }
+
+        return true;
+    }
+
+    // Skips what's left of the body of the last request. On EOF, error or malformed chunks returns false
+    task<bool> skip_body()
+    {
+        if (chunked_) {
+            auto rest = co_await read_chunked(false);
+            co_return rest.has_value();
+        }
+
+        // Content-Length bodies may be bigger than the buffer, they go through it in parts
+        while (body_left_ > 0) {
+            size_t avail = len_ - consumed_;
+            size_t n = avail < body_left_ ? avail : body_left_;
+
+            consumed_ += n;
+            body_left_ -= n;
+
+            if (body_left_ > 0) {
+                compact();
+                if (!co_await fill())
+                    co_return false;
+            }
+        }
+
+        co_return true;
+    }
+
+    /*
+     * Decodes the chunked body at consumed_ in place: chunk data moves down over the
+     * chunk framing. With `keep` false chunk data is dropped too. Each chunk has to fit
+     * the buffer.
+     *   On EOF, error or malformed chunks returns an empty optional.
+     */
+    task<std::optional<std::string_view>> read_chunked(bool keep)
+    {
+        size_t start = consumed_;
+        size_t out = consumed_; // End of the decoded body, raw chunks follow it
+
+        for (;;) {
+            std::string_view raw(buf_ + out, len_ - out);
+            size_t eol = raw.find("\r\n");
+
+            if (eol == std::string_view::npos) {
+                if (len_ == Cap || !co_await fill())
+                    co_return std::nullopt;
+                continue;
+            }
+
+            // Hex size, then optional extensions which are ignored
+            size_t size = 0;
+            size_t i = 0;
+
+            for (; i < eol; i++) {
+                int d = hex_digit(raw[i]);
+                if (d < 0)
+                    break;
+                if (size > (Cap >> 4))
+                    co_return std::nullopt; // Can't fit anyway
+                size = size * 16 + d;
+            }
+
+            if (i == 0 || (i < eol && raw[i] != ';' && raw[i] != ' ' && raw[i] != '\t'))
+                co_return std::nullopt;
+
+            size_t data = out + eol + 2;
+
+            if (size == 0) {
+                // Trailer fields up to an empty line, dropped
+                size_t itr = data;
+
+                for (;;) {
+                    std::string_view rest(buf_ + itr, len_ - itr);
+                    size_t e = rest.find("\r\n");
+
+                    if (e == std::string_view::npos) {
+                        if (len_ == Cap || !co_await fill())
+                            co_return std::nullopt;
+                        continue;
+                    }
+
+                    itr += e + 2;
+                    if (e == 0)
+                        break;
+                }
+
+                drop(out, itr);
+                consumed_ = out;
+                chunked_ = false;
+                co_return std::optional<std::string_view>(std::string_view(buf_ + start, out - start));
+            }
+
+            if (data + size + 2 > Cap)
+                co_return std::nullopt;
+
+            while (len_ < data + size + 2) {
+                if (!co_await fill())
+                    co_return std::nullopt;
+            }
+
+            if (buf_[data + size] != '\r' || buf_[data + size + 1] != '\n')
+                co_return std::nullopt;
+
+            if (keep) {
+                memmove(buf_ + out, buf_ + data, size);
+                drop(out + size, data + size + 2);
+                out += size;
+            }
+            else
+                drop(out, data + size + 2);
+        }
+    }
+
+    static int hex_digit(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    // Removes buf_[from, to), the bytes after it move down
+    void drop(size_t from, size_t to)
+    {
+        memmove(buf_ + from, buf_ + to, len_ - to);
+        len_ -= to - from;
+        buf_[len_] = '\0';
+    }
+
+    // Reads more bytes, waiting while there are none. On EOF or error returns false
+    task<bool> fill()
+    {
+        for (;;) {
+            ssize_t r = ::read(fd_, buf_ + len_, Cap - len_);
+
+            if (r > 0) {
+                len_ += r;
+                buf_[len_] = '\0';
+                co_return true;
+            }
+
+            if (r == 0)
+                co_return false;
+
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                co_return false;
+
+            co_await backend_.readable(fd_);
+        }
+    }
+
+    // Drops bytes of the previous request, pipelined leftovers move to the front
+    void compact()
+    {
+        if (consumed_ == 0)
+            return;
+
+        memmove(buf_, buf_ + consumed_, len_ - consumed_);
+        len_ -= consumed_;
+        consumed_ = 0;
+        buf_[len_] = '\0';
+    }
+
+    Backend& backend_;
+    int fd_;
+    size_t len_ = 0;
+    size_t consumed_ = 0;
+    size_t body_left_ = 0; // Content-Length body of the last request not read yet
+    bool   chunked_ = false; // The last request has a chunked body not read yet
+    bool   broken_ = false;  // A body couldn't be read, the stream position is lost
+    char buf_[Cap + 1] = {}; // +1 for '\0', the parser relies on it
+};
+#endif // HTTPP_POSIX
+
+} // namespace coro
+} // namespace httpp
+
+#endif // _HTTPP_CORO_HPP_HEADER
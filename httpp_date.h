@@ -0,0 +1,178 @@
+#ifndef _HTTPP_DATE_HEADER
+#define _HTTPP_DATE_HEADER
+
+/*
+ * Cached Date header (RFC 9110, 6.6.1) for httpp.
+ *
+ * The IMF-fixdate string ("Sun, 06 Nov 1994 08:49:37 GMT") is formatted at most
+ * once per second, by whichever thread first notices the second has changed.
+ * Everyone else just gets a pointer to the cached string, no gmtime_r, no strftime.
+ *
+ *      httpp_res_add_date(&res);                              // Borrowed, nothing strdupped
+ *      httpp_res_template_set_date(&tmpl, httpp_date_get());  // Or patch a template
+ *
+ * The cache is double buffered: a new string is written into the inactive buffer
+ * and then published. A pointer returned by httpp_date_get stays valid for at least
+ * one second, which is plenty to serialize a response. If you need to keep it
+ * around for longer, copy it with httpp_date_copy.
+ *
+ * Thread safe, needs GCC or Clang atomic builtins.
+ */
+
+#include <time.h>
+#include "httpp.h"
+
+#define HTTPP_DATE_LEN 29
+
+// Formats `t` as IMF-fixdate into `out`, which must fit HTTPP_DATE_LEN bytes. No '\0' is written
+void httpp_date_format(time_t t, char* out);
+
+// Returns current date, HTTPP_DATE_LEN bytes long and '\0' terminated
+const char* httpp_date_get(void);
+
+// Same as httpp_date_get, as a borrowed span
+httpp_span_t httpp_date_span(void);
+
+// Copies current date into `out`, which must fit HTTPP_DATE_LEN + 1 bytes
+void httpp_date_copy(char* out);
+
+// Appends a "Date" header with the cached value to `res`, the value is borrowed
+httpp_header_t* httpp_res_add_date(httpp_res_t* res);
+
+#ifdef HTTPP_IMPLEMENTATION
+
+static const char __date_days[7][4] = {"Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed"};
+static const char __date_months[12][4] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+static char __date_bufs[2][HTTPP_DATE_LEN + 1] = {
+    "Thu, 01 Jan 1970 00:00:00 GMT", "Thu, 01 Jan 1970 00:00:00 GMT"
+};
+
+static long long __date_secs[2] = {0, 0};
+static int __date_idx = 0;
+static int __date_lock = 0;
+
+static inline void __date_2digits(char* out, unsigned v)
+{
+    out[0] = '0' + v / 10;
+    out[1] = '0' + v % 10;
+}
+
+typedef struct {
+    long long year;
+    unsigned  month; // 1-12
+    unsigned  day;
+    unsigned  hour;
+    unsigned  min;
+    unsigned  sec;
+    int       wday;  // 0 is Thursday, see __date_days
+} __date_civil_t;
+
+// Splits `t` into UTC calendar fields
+static void __date_civil(time_t t, __date_civil_t* out)
+{
+    long long secs = (long long) t;
+    long long days = secs / 86400;
+    long long rem = secs % 86400;
+
+    if (rem < 0) {
+        rem += 86400;
+        days--;
+    }
+
+    // 1970-01-01 was a Thursday
+    out->wday = (int) (days % 7);
+    if (out->wday < 0)
+        out->wday += 7;
+
+    // Civil from days, http://howardhinnant.github.io/date_algorithms.html
+    long long z = days + 719468;
+    long long era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned) (z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+
+    out->day = doy - (153 * mp + 2) / 5 + 1;
+    out->month = mp < 10 ? mp + 3 : mp - 9;
+    out->year = (long long) yoe + era * 400 + (out->month <= 2);
+
+    out->hour = (unsigned) (rem / 3600);
+    out->min = (unsigned) (rem / 60 % 60);
+    out->sec = (unsigned) (rem % 60);
+}
+
+void httpp_date_format(time_t t, char* out)
+{
+    __date_civil_t c;
+    __date_civil(t, &c);
+
+    memcpy(out, __date_days[c.wday], 3);
+    out[3] = ',';
+    out[4] = ' ';
+    __date_2digits(out + 5, c.day);
+    out[7] = ' ';
+    memcpy(out + 8, __date_months[c.month - 1], 3);
+    out[11] = ' ';
+    __date_2digits(out + 12, (unsigned) (c.year / 100 % 100));
+    __date_2digits(out + 14, (unsigned) (c.year % 100));
+    out[16] = ' ';
+    __date_2digits(out + 17, c.hour);
+    out[19] = ':';
+    __date_2digits(out + 20, c.min);
+    out[22] = ':';
+    __date_2digits(out + 23, c.sec);
+    memcpy(out + 25, " GMT", 4);
+}
+
+const char* httpp_date_get(void)
+{
+    long long now = (long long) time(NULL);
+    int idx = __atomic_load_n(&__date_idx, __ATOMIC_ACQUIRE);
+
+    if (__atomic_load_n(&__date_secs[idx], __ATOMIC_RELAXED) == now)
+        return __date_bufs[idx];
+
+    // Only one thread formats, the rest keep using the previous second for now
+    if (__atomic_exchange_n(&__date_lock, 1, __ATOMIC_ACQUIRE) == 0) {
+        idx = __atomic_load_n(&__date_idx, __ATOMIC_RELAXED);
+
+        if (__date_secs[idx] != now) {
+            int next = idx ^ 1;
+
+            httpp_date_format((time_t) now, __date_bufs[next]);
+            __atomic_store_n(&__date_secs[next], now, __ATOMIC_RELAXED);
+            __atomic_store_n(&__date_idx, next, __ATOMIC_RELEASE);
+            idx = next;
+        }
+
+        __atomic_store_n(&__date_lock, 0, __ATOMIC_RELEASE);
+    }
+
+    return __date_bufs[idx];
+}
+
+httpp_span_t httpp_date_span(void)
+{
+    return (httpp_span_t){(char*) httpp_date_get(), HTTPP_DATE_LEN, false};
+}
+
+void httpp_date_copy(char* out)
+{
+    memcpy(out, httpp_date_get(), HTTPP_DATE_LEN + 1);
+}
+
+httpp_header_t* httpp_res_add_date(httpp_res_t* res)
+{
+    httpp_header_t h = {
+        {(char*) "Date", 4, false},
+        httpp_date_span()
+    };
+
+    return httpp_headers_arr_append(&res->headers, h);
+}
+
+#endif // HTTPP_IMPLEMENTATION
+#endif // _HTTPP_DATE_HEADER
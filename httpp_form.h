@@ -0,0 +1,201 @@
+#ifndef _HTTPP_FORM_HEADER
+#define _HTTPP_FORM_HEADER
+
+/*
+ * application/x-www-form-urlencoded fields and query string parameters for httpp.
+ *
+ * Both are the same "name=value&name=value" format, so the same iterator walks a
+ * form body and the query part of a route. Name and value of each field are spans
+ * into the caller's buffer, nothing is allocated.
+ *
+ *      httpp_form_iter_t it;
+ *      httpp_form_field_t f;
+ *
+ *      httpp_form_iter_init(&it, &req.body);   // Or httpp_query_iter_init(&it, &req.route)
+ *      while (httpp_form_next(&it, &f)) {
+ *          httpp_form_decode(&f);
+ *          ...
+ *      }
+ *
+ * Fields are returned as they are on the wire. httpp_form_decode decodes '+' and
+ * percent escapes in place, with the same kernel as httpp_span_url_decode. Decoding
+ * modifies the buffer, so a decoded field must not be decoded again and the buffer
+ * can't be iterated for a second time after decoding.
+ */
+
+#include "httpp.h"
+
+typedef struct {
+    httpp_span_t name;
+    httpp_span_t value;
+} httpp_form_field_t;
+
+typedef struct {
+    char* itr;
+    char* end;
+} httpp_form_iter_t;
+
+// Prepares `it` to iterate over fields of a form body
+void httpp_form_iter_init(httpp_form_iter_t* it, httpp_span_t* body);
+
+// Prepares `it` to iterate over query parameters of `route`, which may have no query at all
+void httpp_query_iter_init(httpp_form_iter_t* it, httpp_span_t* route);
+
+/*
+ * Stores the next field into `out`. Fields without '=' have an empty value.
+ *   When there are no more fields returns false.
+ */
+bool httpp_form_next(httpp_form_iter_t* it, httpp_form_field_t* out);
+
+/*
+ * Decodes name and value of `field` in place, this modifies the caller's buffer.
+ *   On malformed percent escape returns false.
+ */
+bool httpp_form_decode(httpp_form_field_t* field);
+
+/*
+ * Searches `encoded` for the first field named `name`. Names are compared decoded,
+ * `name` itself is plain text. The value is not decoded.
+ *   On failure returns false.
+ */
+bool httpp_form_find(httpp_span_t* encoded, const char* name, httpp_form_field_t* out);
+
+// Same as httpp_form_find, on the body of `req`
+bool httpp_req_form_find(httpp_req_t* req, const char* name, httpp_form_field_t* out);
+
+// Same as httpp_form_find, on the query string of `req`
+bool httpp_req_query_find(httpp_req_t* req, const char* name, httpp_form_field_t* out);
+
+#ifdef HTTPP_IMPLEMENTATION
+
+void httpp_form_iter_init(httpp_form_iter_t* it, httpp_span_t* body)
+{
+    it->itr = body->ptr;
+    it->end = body->ptr + body->length;
+}
+
+void httpp_query_iter_init(httpp_form_iter_t* it, httpp_span_t* route)
+{
+    char* end = route->ptr + route->length;
+    char* q = (char*) memchr(route->ptr, '?', route->length);
+
+    if (!q) {
+        it->itr = it->end = end;
+        return;
+    }
+
+    char* fragment = (char*) memchr(q, '#', end - q);
+
+    it->itr = q + 1;
+    it->end = fragment ? fragment : end;
+}
+
+bool httpp_form_next(httpp_form_iter_t* it, httpp_form_field_t* out)
+{
+    while (it->itr < it->end) {
+        char* start = it->itr;
+        char* amp = (char*) memchr(start, '&', it->end - start);
+        char* stop = amp ? amp : it->end;
+
+        it->itr = amp ? amp + 1 : it->end;
+
+        if (stop == start)
+            continue; // Empty pair, e.g "a=1&&b=2"
+
+        char* eq = (char*) memchr(start, '=', stop - start);
+        char* name_end = eq ? eq : stop;
+        char* value = eq ? eq + 1 : stop;
+
+        out->name = (httpp_span_t){start, (size_t) (name_end - start), false};
+        out->value = (httpp_span_t){value, (size_t) (stop - value), false};
+        return true;
+    }
+
+    return false;
+}
+
+bool httpp_form_decode(httpp_form_field_t* field)
+{
+    return httpp_span_url_decode(&field->name, true)
+        && httpp_span_url_decode(&field->value, true);
+}
+
+// Compares encoded `enc` with plain `name` of `name_len` bytes, without touching the buffer
+static bool __form_name_eq(httpp_span_t* enc, const char* name, size_t name_len)
+{
+    const char* itr = enc->ptr;
+    const char* end = enc->ptr + enc->length;
+
+    // Encoded form is never shorter than the decoded one
+    if (enc->length < name_len)
+        return false;
+
+    for (size_t i = 0; i < name_len; i++) {
+        if (itr >= end)
+            return false;
+
+        char c = *itr++;
+
+        if (c == '+') {
+            c = ' ';
+        }
+        else if (c == '%') {
+            if (end - itr < 2)
+                return false;
+
+            int hi = __hexval(itr[0]);
+            int lo = __hexval(itr[1]);
+
+            if (hi < 0 || lo < 0)
+                return false;
+
+            c = (char) ((hi << 4) | lo);
+            itr += 2;
+        }
+
+        if (c != name[i])
+            return false;
+    }
+
+    return itr == end;
+}
+
+static bool __form_search(httpp_form_iter_t* it, const char* name, httpp_form_field_t* out)
+{
+    size_t name_len = strlen(name);
+
+    while (httpp_form_next(it, out)) {
+        if (__form_name_eq(&out->name, name, name_len))
+            return true;
+    }
+
+    return false;
+}
+
+bool httpp_form_find(httpp_span_t* encoded, const char* name, httpp_form_field_t* out)
+{
+    if (!encoded || !encoded->ptr || !name)
+        return false;
+
+    httpp_form_iter_t it;
+    httpp_form_iter_init(&it, encoded);
+    return __form_search(&it, name, out);
+}
+
+bool httpp_req_form_find(httpp_req_t* req, const char* name, httpp_form_field_t* out)
+{
+    return httpp_form_find(&req->body, name, out);
+}
+
+bool httpp_req_query_find(httpp_req_t* req, const char* name, httpp_form_field_t* out)
+{
+    if (!req->route.ptr || !name)
+        return false;
+
+    httpp_form_iter_t it;
+    httpp_query_iter_init(&it, &req->route);
+    return __form_search(&it, name, out);
+}
+
+#endif // HTTPP_IMPLEMENTATION
+#endif // _HTTPP_FORM_HEADER
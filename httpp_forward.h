@@ -0,0 +1,387 @@
+#ifndef _HTTPP_FORWARD_HEADER
+#define _HTTPP_FORWARD_HEADER
+
+/*
+ * Re-serialization of parsed requests, e.g for reverse proxies.
+ *
+ * Headers can be removed, replaced or inserted and the route rewritten. The result is
+ * a list of pieces (spans, or iovecs for writev) where everything that wasn't edited
+ * points straight into the original buffer. New values are referenced, not copied,
+ * so forwarding a request copies nothing at all:
+ *
+ *      httpp_forward_t fw;
+ *      httpp_forward_init(&fw, &req, buf);
+ *
+ *      httpp_forward_remove_hop_by_hop(&fw);
+ *      httpp_forward_replace(&fw, "Host", upstream, strlen(upstream));
+ *      httpp_forward_insert(&fw, "X-Forwarded-For", client_ip, ip_len);
+ *
+ *      struct iovec iov[64];
+ *      int n = httpp_forward_iov(&fw, iov, 64);
+ *      writev(upstream_fd, iov, n);
+ *
+ * `req` must be parsed from `buf` by httpp_parse_request (headers are expected in
+ * buffer order). After httpp_parse_request_lazy, call httpp_req_split_headers first.
+ * The buffer, names and values must stay alive until the pieces are written. The body
+ * of `req` is the last piece.
+ */
+
+#include "httpp.h"
+
+#define HTTPP_FORWARD_MAX_EDITS 16
+
+#define HTTPP_EDIT_REMOVE  0
+#define HTTPP_EDIT_REPLACE 1
+#define HTTPP_EDIT_INSERT  2
+
+typedef struct {
+    int          kind;
+    size_t       index;  // Header index for remove / replace
+    const char*  name;   // Header name for insert
+    httpp_span_t value;
+} httpp_forward_edit_t;
+
+typedef struct {
+    httpp_req_t* req;
+    char*        start;  // Beginning of the request in the original buffer
+    httpp_span_t route;  // New route, ptr is NULL if unchanged
+    httpp_forward_edit_t edits[HTTPP_FORWARD_MAX_EDITS];
+    size_t       edits_len;
+} httpp_forward_t;
+
+// Prepares `fw` for `req`, parsed from `buf`
+void httpp_forward_init(httpp_forward_t* fw, httpp_req_t* req, char* buf);
+
+/*
+ * Removes every header named `name`.
+ *   On failure (too many edits) returns -1.
+ *
+ * On sucess returns number of removed headers
+ */
+int httpp_forward_remove(httpp_forward_t* fw, const char* name);
+
+/*
+ * Removes hop-by-hop headers (RFC 9110, 7.6.1): Connection, the headers it lists,
+ * Keep-Alive, Proxy-Connection, TE, Trailer, Upgrade, Proxy-Authorization.
+ * Transfer-Encoding is kept, the body is forwarded as it is. Content-Length,
+ * Transfer-Encoding and Host are never removed because Connection lists them,
+ * without them the upstream would frame the forwarded body differently.
+ *   On failure returns false.
+ */
+bool httpp_forward_remove_hop_by_hop(httpp_forward_t* fw);
+
+/*
+ * Replaces value of the first header named `name`, or inserts it if there is none.
+ *   On failure returns false.
+ */
+bool httpp_forward_replace(httpp_forward_t* fw, const char* name, const char* value, size_t len);
+
+/*
+ * Adds a header at the end of the header block.
+ *   On failure returns false.
+ */
+bool httpp_forward_insert(httpp_forward_t* fw, const char* name, const char* value, size_t len);
+
+// Rewrites request target of the start line
+void httpp_forward_set_route(httpp_forward_t* fw, const char* route, size_t len);
+
+/*
+ * Stores pieces of the edited request into `out`, in order. Adjacent untouched
+ * stretches of the original buffer are merged into one piece.
+ *   When `out` is too small returns -1.
+ *
+ * On sucess returns number of pieces
+ */
+int httpp_forward_pieces(httpp_forward_t* fw, httpp_span_t* out, int max);
+
+// Length of the edited request, body included
+size_t httpp_forward_len(httpp_forward_t* fw);
+
+/*
+ * Edited request as one malloc'd, '\0' terminated string. Caller must free.
+ *   On failure returns NULL.
+ */
+char* httpp_forward_to_raw(httpp_forward_t* fw, size_t* out_len);
+
+#ifdef HTTPP_POSIX
+// Same as httpp_forward_pieces, as iovecs for writev
+int httpp_forward_iov(httpp_forward_t* fw, struct iovec* out, int max);
+#endif
+
+#ifdef HTTPP_IMPLEMENTATION
+
+void httpp_forward_init(httpp_forward_t* fw, httpp_req_t* req, char* buf)
+{
+    fw->req = req;
+    fw->start = buf;
+    fw->edits_len = 0;
+    httpp_span_init(&fw->route);
+}
+
+static httpp_forward_edit_t* __forward_edit_of(httpp_forward_t* fw, size_t index)
+{
+    for (size_t i = 0; i < fw->edits_len; i++) {
+        httpp_forward_edit_t* e = &fw->edits[i];
+
+        if (e->kind != HTTPP_EDIT_INSERT && e->index == index)
+            return e;
+    }
+
+    return NULL;
+}
+
+static bool __forward_push(httpp_forward_t* fw, int kind, size_t index, const char* name,
+                           const char* value, size_t len)
+{
+    httpp_forward_edit_t* e = kind == HTTPP_EDIT_INSERT ? NULL : __forward_edit_of(fw, index);
+
+    if (!e) {
+        if (fw->edits_len == HTTPP_FORWARD_MAX_EDITS)
+            return false;
+
+        e = &fw->edits[fw->edits_len++];
+    }
+
+    e->kind = kind;
+    e->index = index;
+    e->name = name;
+    e->value = (httpp_span_t){(char*) value, len, false};
+    return true;
+}
+
+int httpp_forward_remove(httpp_forward_t* fw, const char* name)
+{
+    httpp_headers_arr_t* hs = &fw->req->headers;
+    int removed = 0;
+
+    for (size_t i = 0; i < hs->length; i++) {
+        if (!httpp_span_case_eq(&hs->arr[i].name, name))
+            continue;
+
+        if (!__forward_push(fw, HTTPP_EDIT_REMOVE, i, NULL, NULL, 0))
+            return -1;
+
+        removed++;
+    }
+
+    return removed;
+}
+
+bool httpp_forward_remove_hop_by_hop(httpp_forward_t* fw)
+{
+    static const char* hop[] = {
+        "Connection", "Keep-Alive", "Proxy-Connection", "TE", "Trailer", "Upgrade",
+        "Proxy-Authorization"
+    };
+
+    // Framing of the forwarded request, Connection can't take it away
+    static const char* kept[] = {"Content-Length", "Transfer-Encoding", "Host"};
+
+    httpp_headers_arr_t* hs = &fw->req->headers;
+
+    // Headers listed in Connection are hop-by-hop too
+    for (size_t i = 0; i < hs->length; i++) {
+        if (!httpp_span_case_eq(&hs->arr[i].name, "connection"))
+            continue;
+
+        char* itr = hs->arr[i].value.ptr;
+        char* end = itr + hs->arr[i].value.length;
+
+        while (itr < end) {
+            char* comma = (char*) memchr(itr, ',', end - itr);
+            char* tok = itr;
+            size_t len = (comma ? comma : end) - itr;
+
+            itr = comma ? comma + 1 : end;
+
+            LTRIM(tok, len);
+            RTRIM(tok, len);
+
+            for (size_t k = 0; k < sizeof(kept) / sizeof(kept[0]) && len > 0; k++) {
+                if (strlen(kept[k]) == len && strncasecmp(kept[k], tok, len) == 0)
+                    len = 0;
+            }
+
+            for (size_t j = 0; j < hs->length && len > 0; j++) {
+                httpp_span_t* name = &hs->arr[j].name;
+
+                if (name->length == len && strncasecmp(name->ptr, tok, len) == 0
+                    && !__forward_push(fw, HTTPP_EDIT_REMOVE, j, NULL, NULL, 0))
+                    return false;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(hop) / sizeof(hop[0]); i++) {
+        if (httpp_forward_remove(fw, hop[i]) < 0)
+            return false;
+    }
+
+    return true;
+}
+
+bool httpp_forward_replace(httpp_forward_t* fw, const char* name, const char* value, size_t len)
+{
+    httpp_headers_arr_t* hs = &fw->req->headers;
+
+    for (size_t i = 0; i < hs->length; i++) {
+        if (httpp_span_case_eq(&hs->arr[i].name, name))
+            return __forward_push(fw, HTTPP_EDIT_REPLACE, i, NULL, value, len);
+    }
+
+    return httpp_forward_insert(fw, name, value, len);
+}
+
+bool httpp_forward_insert(httpp_forward_t* fw, const char* name, const char* value, size_t len)
+{
+    if (!name || !value)
+        return false;
+
+    return __forward_push(fw, HTTPP_EDIT_INSERT, 0, name, value, len);
+}
+
+void httpp_forward_set_route(httpp_forward_t* fw, const char* route, size_t len)
+{
+    fw->route = (httpp_span_t){(char*) route, len, false};
+}
+
+// Appends a piece, merging it with the previous one when they are contiguous
+static bool __forward_piece(httpp_span_t* out, int max, int* n, const char* ptr, size_t len)
+{
+    if (len == 0)
+        return true;
+
+    if (*n > 0 && out[*n - 1].ptr + out[*n - 1].length == ptr) {
+        out[*n - 1].length += len;
+        return true;
+    }
+
+    if (*n == max)
+        return false;
+
+    out[(*n)++] = (httpp_span_t){(char*) ptr, len, false};
+    return true;
+}
+
+#define __FORWARD_PIECE(p, l) do {                       \
+    if (!__forward_piece(out, max, &n, (p), (l)))        \
+        return -1;                                       \
+} while (0)
+
+int httpp_forward_pieces(httpp_forward_t* fw, httpp_span_t* out, int max)
+{
+    httpp_req_t* req = fw->req;
+    httpp_headers_arr_t* hs = &req->headers;
+    char* eoh = req->body.ptr - HTTPP_DELIMITER_LEN; // Empty line ending the header block
+    char* cur = fw->start;
+    int   n = 0;
+
+    if (fw->route.ptr) {
+        __FORWARD_PIECE(cur, req->route.ptr - cur);
+        __FORWARD_PIECE(fw->route.ptr, fw->route.length);
+        cur = req->route.ptr + req->route.length;
+    }
+
+    for (size_t i = 0; i < hs->length; i++) {
+        httpp_forward_edit_t* e = __forward_edit_of(fw, i);
+        httpp_header_t* h = &hs->arr[i];
+
+        if (!e)
+            continue;
+
+        if (e->kind == HTTPP_EDIT_REMOVE) {
+            char* next = i + 1 < hs->length ? hs->arr[i + 1].name.ptr : eoh;
+
+            __FORWARD_PIECE(cur, h->name.ptr - cur);
+            cur = next;
+        }
+        else {
+            // Name, colon and whitespace stay, so does the rest of the line
+            __FORWARD_PIECE(cur, h->value.ptr - cur);
+            __FORWARD_PIECE(e->value.ptr, e->value.length);
+            cur = h->value.ptr + h->value.length;
+        }
+    }
+
+    __FORWARD_PIECE(cur, eoh - cur);
+
+    for (size_t i = 0; i < fw->edits_len; i++) {
+        httpp_forward_edit_t* e = &fw->edits[i];
+
+        if (e->kind != HTTPP_EDIT_INSERT)
+            continue;
+
+        __FORWARD_PIECE(e->name, strlen(e->name));
+        __FORWARD_PIECE(": ", 2);
+        __FORWARD_PIECE(e->value.ptr, e->value.length);
+        __FORWARD_PIECE(HTTPP_DELIMITER, HTTPP_DELIMITER_LEN);
+    }
+
+    __FORWARD_PIECE(eoh, req->body.ptr + req->body.length - eoh);
+    return n;
+}
+
+#undef __FORWARD_PIECE
+
+// Worst case: every edit splits the original into two more pieces, an insert is 4 pieces
+#define __FORWARD_MAX_PIECES (4 + 4 * HTTPP_FORWARD_MAX_EDITS)
+
+size_t httpp_forward_len(httpp_forward_t* fw)
+{
+    httpp_span_t pieces[__FORWARD_MAX_PIECES];
+    int n = httpp_forward_pieces(fw, pieces, __FORWARD_MAX_PIECES);
+    size_t len = 0;
+
+    for (int i = 0; i < n; i++)
+        len += pieces[i].length;
+
+    return len;
+}
+
+char* httpp_forward_to_raw(httpp_forward_t* fw, size_t* out_len)
+{
+    httpp_span_t pieces[__FORWARD_MAX_PIECES];
+    int n = httpp_forward_pieces(fw, pieces, __FORWARD_MAX_PIECES);
+    size_t len = 0;
+
+    if (n < 0)
+        return NULL;
+
+    for (int i = 0; i < n; i++)
+        len += pieces[i].length;
+
+    char* raw = (char*) malloc(len + 1);
+    if (!raw)
+        return NULL;
+
+    char* itr = raw;
+    for (int i = 0; i < n; i++) {
+        memcpy(itr, pieces[i].ptr, pieces[i].length);
+        itr += pieces[i].length;
+    }
+
+    *itr = '\0';
+
+    if (out_len)
+        *out_len = len;
+
+    return raw;
+}
+
+#ifdef HTTPP_POSIX
+int httpp_forward_iov(httpp_forward_t* fw, struct iovec* out, int max)
+{
+    httpp_span_t pieces[__FORWARD_MAX_PIECES];
+    int n = httpp_forward_pieces(fw, pieces, max < __FORWARD_MAX_PIECES ? max : __FORWARD_MAX_PIECES);
+
+    for (int i = 0; i < n; i++) {
+        out[i].iov_base = pieces[i].ptr;
+        out[i].iov_len = pieces[i].length;
+    }
+
+    return n;
+}
+#endif
+
+#endif // HTTPP_IMPLEMENTATION
+#endif // _HTTPP_FORWARD_HEADER
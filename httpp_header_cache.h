@@ -0,0 +1,224 @@
+#ifndef _HTTPP_HEADER_CACHE_HEADER
+#define _HTTPP_HEADER_CACHE_HEADER
+
+/*
+ * Per connection cache of the previous header block, for keep-alive connections.
+ *
+ * Clients send nearly the same headers with every request on a connection (same
+ * User-Agent, Accept, Cookie, ...). The cache keeps a copy of the previous block and
+ * how each of its lines was split. When the next block is byte for byte the same,
+ * one memcmp replaces the whole header loop. Otherwise line `i` is compared with
+ * the previous line `i` and only lines that changed are parsed again.
+ *
+ *      httpp_header_cache_t* cache = malloc(sizeof(*cache)); // One per connection
+ *      httpp_header_cache_init(cache);
+ *
+ *      while (...) {
+ *          HTTPP_NEW_REQ(req, 32);
+ *          int off = httpp_parse_request_cached(buf, n, &req, cache);
+ *          ...
+ *      }
+ *
+ * Results are the same as of httpp_parse_request. Blocks bigger than
+ * HTTPP_HEADER_CACHE_SIZE or with more than HTTPP_HEADER_CACHE_LINES lines are
+ * parsed, but not cached.
+ */
+
+#include "httpp.h"
+
+#define HTTPP_HEADER_CACHE_SIZE  4096
+#define HTTPP_HEADER_CACHE_LINES 64
+
+typedef struct {
+    unsigned short start;     // Offset of the line in the block
+    unsigned short len;       // Without "\r\n"
+    unsigned short name_len;
+    unsigned short value_off; // Offset of the value in the line
+    unsigned short value_len;
+    bool known;               // Connection or Expect, applied to every request again
+} httpp_cached_line_t;
+
+typedef struct {
+    char   block[HTTPP_HEADER_CACHE_SIZE]; // Header lines of the previous request, empty line included
+    size_t block_len;                      // 0 when nothing is cached
+    httpp_cached_line_t lines[HTTPP_HEADER_CACHE_LINES];
+    size_t lines_len;
+    size_t hits;   // Requests with the same block as the previous one
+    size_t reused; // Lines reused from a block which changed
+} httpp_header_cache_t;
+
+void httpp_header_cache_init(httpp_header_cache_t* cache);
+
+/*
+ * Same as httpp_parse_request, header lines which didn't change since the previous
+ * request of `cache` are not parsed again. `cache` is updated with this request.
+ *   On failure returns -1.
+ *
+ * On sucess returns offset from the beginning of `buf` to the beginning of the dest->body.
+ */
+int httpp_parse_request_cached(char* buf, size_t n, httpp_req_t* dest, httpp_header_cache_t* cache);
+
+#ifdef HTTPP_IMPLEMENTATION
+
+void httpp_header_cache_init(httpp_header_cache_t* cache)
+{
+    cache->block_len = 0;
+    cache->lines_len = 0;
+    cache->hits = 0;
+    cache->reused = 0;
+}
+
+// Appends header of a line split the same way as `l`. On failure returns NULL
+static httpp_header_t* __cache_emit(httpp_req_t* dest, char* line, const httpp_cached_line_t* l)
+{
+    httpp_header_t h = {
+        {line, l->name_len, false},
+        {line + l->value_off, l->value_len, false},
+    };
+
+    return httpp_headers_arr_append(&dest->headers, h);
+}
+
+// Parses the rest of the block line by line, reusing lines of the cached one. Returns NULL on failure
+static char* __cache_parse_lines(char* block, char* end, httpp_req_t* dest,
+                                 httpp_header_cache_t* cache, char** body)
+{
+    httpp_cached_line_t lines[HTTPP_HEADER_CACHE_LINES];
+    size_t count = 0;
+    size_t i = 0;
+    bool   cacheable = true;
+    char*  itr = block;
+
+    *body = NULL;
+
+    for (; itr < end; i++) {
+        const httpp_cached_line_t* prev = i < cache->lines_len ? &cache->lines[i] : NULL;
+        httpp_cached_line_t l;
+        httpp_header_t* parsed;
+        char* next;
+
+        // "\r\n" is compared too, so the line can't just be longer now
+        if (prev && (size_t) (end - itr) >= (size_t) prev->len + HTTPP_DELIMITER_LEN
+            && memcmp(itr, cache->block + prev->start, prev->len + HTTPP_DELIMITER_LEN) == 0) {
+            l = *prev;
+
+            if ((parsed = __cache_emit(dest, itr, &l)) == NULL)
+                return NULL;
+
+            next = itr + l.len + HTTPP_DELIMITER_LEN;
+            cache->reused++;
+        }
+        else {
+            char* delim = strstr(itr, HTTPP_DELIMITER);
+
+            if (!delim)
+                break;
+
+            if (delim == itr) {
+                *body = delim + HTTPP_DELIMITER_LEN;
+                break;
+            }
+
+            if ((parsed = httpp_parse_header(&dest->headers, itr, delim - itr)) == NULL)
+                return NULL;
+
+            l.len = (unsigned short) (delim - itr);
+            l.name_len = (unsigned short) parsed->name.length;
+            l.value_off = (unsigned short) (parsed->value.ptr - itr);
+            l.value_len = (unsigned short) parsed->value.length;
+            l.known = (parsed->name.length == 10 && strncasecmp(itr, "connection", 10) == 0)
+                   || (parsed->name.length == 6 && strncasecmp(itr, "expect", 6) == 0);
+            next = delim + HTTPP_DELIMITER_LEN;
+        }
+
+        if (l.known)
+            __parse_known(dest, parsed);
+
+        l.start = (unsigned short) (itr - block);
+        itr = next;
+
+        // Offsets of lines past the cache size would not fit, such blocks are not kept anyway
+        if (count < HTTPP_HEADER_CACHE_LINES && itr - block <= HTTPP_HEADER_CACHE_SIZE)
+            lines[count++] = l;
+        else
+            cacheable = false;
+    }
+
+    if (!*body)
+        *body = itr; // No empty line, the same as httpp_parse_request
+
+    size_t block_len = *body - block;
+
+    if (cacheable && block_len <= HTTPP_HEADER_CACHE_SIZE && *body != itr) {
+        memcpy(cache->block, block, block_len);
+        memcpy(cache->lines, lines, count * sizeof(lines[0]));
+        cache->block_len = block_len;
+        cache->lines_len = count;
+    }
+    else {
+        cache->block_len = 0;
+        cache->lines_len = 0;
+    }
+
+    return itr;
+}
+
+int httpp_parse_request_cached(char* buf, size_t n, httpp_req_t* dest, httpp_header_cache_t* cache)
+{
+    if (buf == NULL || dest == NULL || cache == NULL)
+        return -1;
+
+    if (n == 0)
+        return 0;
+
+    char* end = buf + n;
+    char* body;
+    int   off;
+
+    if ((off = httpp_parse_start_line(buf, n, dest)) == -1)
+        return -1;
+
+    char* block = buf + off;
+
+    if (cache->block_len && (size_t) (end - block) >= cache->block_len
+        && memcmp(block, cache->block, cache->block_len) == 0) {
+        // Same block as before, only the spans move to the new buffer
+        for (size_t i = 0; i < cache->lines_len; i++) {
+            httpp_cached_line_t* l = &cache->lines[i];
+            httpp_header_t* h = __cache_emit(dest, block + l->start, l);
+
+            if (!h)
+                return -1;
+
+            if (l->known)
+                __parse_known(dest, h);
+        }
+
+        body = block + cache->block_len;
+        cache->hits++;
+    }
+    else if (!__cache_parse_lines(block, end, dest, cache, &body))
+        return -1;
+
+    dest->body.ptr = body;
+
+#ifdef HTTPP_CONSIDER_CONTENT_LENGTH
+    httpp_header_t* cl = httpp_find_header(*dest, "content-length");
+    size_t content_len = 0;
+
+    if (cl && !httpp_parse_content_length(&cl->value, &content_len))
+        return -1;
+
+    if (content_len <= n - (body - buf))
+        dest->body.length = content_len;
+    else
+        return -1;
+#else
+    dest->body.length = n - (body - buf);
+#endif
+
+    return body - buf;
+}
+
+#endif // HTTPP_IMPLEMENTATION
+#endif // _HTTPP_HEADER_CACHE_HEADER
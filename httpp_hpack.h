@@ -0,0 +1,853 @@
+#ifndef _HTTPP_HPACK_HEADER
+#define _HTTPP_HPACK_HEADER
+
+/*
+ * HPACK (RFC 7541) decoder for HTTP/2 header blocks, producing the same httpp_req_t
+ * the HTTP/1.1 parser does, so handlers don't care which protocol a request came by.
+ *
+ * Pseudo-headers are mapped to the request: :method to `method`, :path to `route`,
+ * :authority becomes a "host" header. Regular headers go to `headers.arr` in the
+ * order they came. The version is 2.0, keep_alive is true and the body is empty,
+ * DATA frames are up to the caller.
+ *
+ * One httpp_hpack_t per connection keeps the dynamic table, in a fixed ring buffer
+ * of HTTPP_HPACK_TABLE_SIZE bytes (the SETTINGS_HEADER_TABLE_SIZE to announce).
+ * Nothing is allocated:
+ *
+ *   - literals which are not Huffman coded are referenced in `block`
+ *   - Huffman coded literals are decoded into the caller's `arena`
+ *   - strings of the dynamic table are copied into `arena`, entries can be evicted
+ *     while the block is still being decoded
+ *   - strings of the static table point to constants
+ *
+ * So `block` and `arena` must outlive the spans of `dest`.
+ *
+ *      httpp_hpack_t* hp = malloc(sizeof(*hp)); // One per connection
+ *      httpp_hpack_init(hp);
+ *
+ *      HTTPP_NEW_REQ(req, 32);
+ *      char arena[8192];
+ *
+ *      switch (httpp_hpack_decode(hp, block, block_len, &req, arena, sizeof(arena))) {
+ *          case HTTPP_HPACK_ERROR:     ... // GOAWAY COMPRESSION_ERROR
+ *          case HTTPP_HPACK_MALFORMED: ... // RST_STREAM PROTOCOL_ERROR, the table is fine
+ *      }
+ *
+ * Huffman codes are decoded with a table of every HTTPP_HPACK_HUFF_BITS bit prefix:
+ * one lookup gives a symbol, or two when both codes fit (pairs of lowercase letters
+ * and digits mostly). The few longer codes use the canonical code ranges by length.
+ */
+
+#include "httpp.h"
+
+#define HTTPP_HPACK_TABLE_SIZE  4096
+#define HTTPP_HPACK_MAX_ENTRIES (HTTPP_HPACK_TABLE_SIZE / 32) // Every entry costs at least 32
+#define HTTPP_HPACK_STATIC_LEN  61
+#define HTTPP_HPACK_HUFF_BITS   11
+
+#define HTTPP_HPACK_ERROR     -1 // Block can't be decoded, the table is out of sync
+#define HTTPP_HPACK_MALFORMED -2 // Block decoded, but it's not a valid request
+
+typedef struct {
+    unsigned short off; // Start of the name in the ring, the value follows it
+    unsigned short name_len;
+    unsigned short value_len;
+} httpp_hpack_entry_t;
+
+typedef struct {
+    char   data[HTTPP_HPACK_TABLE_SIZE]; // Names and values, may wrap around
+    httpp_hpack_entry_t entries[HTTPP_HPACK_MAX_ENTRIES];
+    size_t first;    // Oldest entry
+    size_t count;
+    size_t tail;     // Where bytes of the next entry go
+    size_t size;     // RFC 7541, 4.1: name + value + 32 for every entry
+    size_t max_size; // Set by dynamic table size updates, at most HTTPP_HPACK_TABLE_SIZE
+} httpp_hpack_t;
+
+void httpp_hpack_init(httpp_hpack_t* hp);
+
+/*
+ * Decodes header block `block` (HEADERS and CONTINUATION fragments put together)
+ * into `dest`.
+ *   On undecodable block or when `arena` is too small returns HTTPP_HPACK_ERROR.
+ *   When the request is malformed returns HTTPP_HPACK_MALFORMED, the block is
+ *   still decoded to the end so the next one can be.
+ *
+ * On sucess returns number of `arena` bytes used.
+ */
+int httpp_hpack_decode(httpp_hpack_t* hp, const char* block, size_t n, httpp_req_t* dest,
+                       char* arena, size_t arena_cap);
+
+#ifdef HTTPP_IMPLEMENTATION
+
+typedef struct {
+    const char* name;
+    size_t      name_len;
+    const char* value;
+    size_t      value_len;
+} __hpack_entry_t;
+
+// RFC 7541, Appendix A
+static const __hpack_entry_t __hpack_static[HTTPP_HPACK_STATIC_LEN + 1] = {
+    {NULL, 0, NULL, 0},
+    {":authority", 10, "", 0},
+    {":method", 7, "GET", 3},
+    {":method", 7, "POST", 4},
+    {":path", 5, "/", 1},
+    {":path", 5, "/index.html", 11},
+    {":scheme", 7, "http", 4},
+    {":scheme", 7, "https", 5},
+    {":status", 7, "200", 3},
+    {":status", 7, "204", 3},
+    {":status", 7, "206", 3},
+    {":status", 7, "304", 3},
+    {":status", 7, "400", 3},
+    {":status", 7, "404", 3},
+    {":status", 7, "500", 3},
+    {"accept-charset", 14, "", 0},
+    {"accept-encoding", 15, "gzip, deflate", 13},
+    {"accept-language", 15, "", 0},
+    {"accept-ranges", 13, "", 0},
+    {"accept", 6, "", 0},
+    {"access-control-allow-origin", 27, "", 0},
+    {"age", 3, "", 0},
+    {"allow", 5, "", 0},
+    {"authorization", 13, "", 0},
+    {"cache-control", 13, "", 0},
+    {"content-disposition", 19, "", 0},
+    {"content-encoding", 16, "", 0},
+    {"content-language", 16, "", 0},
+    {"content-length", 14, "", 0},
+    {"content-location", 16, "", 0},
+    {"content-range", 13, "", 0},
+    {"content-type", 12, "", 0},
+    {"cookie", 6, "", 0},
+    {"date", 4, "", 0},
+    {"etag", 4, "", 0},
+    {"expect", 6, "", 0},
+    {"expires", 7, "", 0},
+    {"from", 4, "", 0},
+    {"host", 4, "", 0},
+    {"if-match", 8, "", 0},
+    {"if-modified-since", 17, "", 0},
+    {"if-none-match", 13, "", 0},
+    {"if-range", 8, "", 0},
+    {"if-unmodified-since", 19, "", 0},
+    {"last-modified", 13, "", 0},
+    {"link", 4, "", 0},
+    {"location", 8, "", 0},
+    {"max-forwards", 12, "", 0},
+    {"proxy-authenticate", 18, "", 0},
+    {"proxy-authorization", 19, "", 0},
+    {"range", 5, "", 0},
+    {"referer", 7, "", 0},
+    {"refresh", 7, "", 0},
+    {"retry-after", 11, "", 0},
+    {"server", 6, "", 0},
+    {"set-cookie", 10, "", 0},
+    {"strict-transport-security", 25, "", 0},
+    {"transfer-encoding", 17, "", 0},
+    {"user-agent", 10, "", 0},
+    {"vary", 4, "", 0},
+    {"via", 3, "", 0},
+    {"www-authenticate", 16, "", 0},
+};
+
+// Every HTTPP_HPACK_HUFF_BITS bit prefix: first symbol, second symbol, their code lengths
+// (bits 16-20 and 21-25, the second length is 0 if it doesn't fit), 0 if the code is longer
+static const unsigned int __hpack_huff_fast[1 << HTTPP_HPACK_HUFF_BITS] = {
+    0x0a53030, 0x0a53030, 0x0a53130, 0x0a53130, 0x0a53230, 0x0a53230, 0x0a56130, 0x0a56130,
+    0x0a56330, 0x0a56330, 0x0a56530, 0x0a56530, 0x0a56930, 0x0a56930, 0x0a56f30, 0x0a56f30,
+    0x0a57330, 0x0a57330, 0x0a57430, 0x0a57430, 0x0c52030, 0x0c52530, 0x0c52d30, 0x0c52e30,
+    0x0c52f30, 0x0c53330, 0x0c53430, 0x0c53530, 0x0c53630, 0x0c53730, 0x0c53830, 0x0c53930,
+    0x0c53d30, 0x0c54130, 0x0c55f30, 0x0c56230, 0x0c56430, 0x0c56630, 0x0c56730, 0x0c56830,
+    0x0c56c30, 0x0c56d30, 0x0c56e30, 0x0c57030, 0x0c57230, 0x0c57530, 0x0050030, 0x0050030,
+    0x0050030, 0x0050030, 0x0050030, 0x0050030, 0x0050030, 0x0050030, 0x0050030, 0x0050030,
+    0x0050030, 0x0050030, 0x0050030, 0x0050030, 0x0050030, 0x0050030, 0x0050030, 0x0050030,
+    0x0a53031, 0x0a53031, 0x0a53131, 0x0a53131, 0x0a53231, 0x0a53231, 0x0a56131, 0x0a56131,
+    0x0a56331, 0x0a56331, 0x0a56531, 0x0a56531, 0x0a56931, 0x0a56931, 0x0a56f31, 0x0a56f31,
+    0x0a57331, 0x0a57331, 0x0a57431, 0x0a57431, 0x0c52031, 0x0c52531, 0x0c52d31, 0x0c52e31,
+    0x0c52f31, 0x0c53331, 0x0c53431, 0x0c53531, 0x0c53631, 0x0c53731, 0x0c53831, 0x0c53931,
+    0x0c53d31, 0x0c54131, 0x0c55f31, 0x0c56231, 0x0c56431, 0x0c56631, 0x0c56731, 0x0c56831,
+    0x0c56c31, 0x0c56d31, 0x0c56e31, 0x0c57031, 0x0c57231, 0x0c57531, 0x0050031, 0x0050031,
+    0x0050031, 0x0050031, 0x0050031, 0x0050031, 0x0050031, 0x0050031, 0x0050031, 0x0050031,
+    0x0050031, 0x0050031, 0x0050031, 0x0050031, 0x0050031, 0x0050031, 0x0050031, 0x0050031,
+    0x0a53032, 0x0a53032, 0x0a53132, 0x0a53132, 0x0a53232, 0x0a53232, 0x0a56132, 0x0a56132,
+    0x0a56332, 0x0a56332, 0x0a56532, 0x0a56532, 0x0a56932, 0x0a56932, 0x0a56f32, 0x0a56f32,
+    0x0a57332, 0x0a57332, 0x0a57432, 0x0a57432, 0x0c52032, 0x0c52532, 0x0c52d32, 0x0c52e32,
+    0x0c52f32, 0x0c53332, 0x0c53432, 0x0c53532, 0x0c53632, 0x0c53732, 0x0c53832, 0x0c53932,
+    0x0c53d32, 0x0c54132, 0x0c55f32, 0x0c56232, 0x0c56432, 0x0c56632, 0x0c56732, 0x0c56832,
+    0x0c56c32, 0x0c56d32, 0x0c56e32, 0x0c57032, 0x0c57232, 0x0c57532, 0x0050032, 0x0050032,
+    0x0050032, 0x0050032, 0x0050032, 0x0050032, 0x0050032, 0x0050032, 0x0050032, 0x0050032,
+    0x0050032, 0x0050032, 0x0050032, 0x0050032, 0x0050032, 0x0050032, 0x0050032, 0x0050032,
+    0x0a53061, 0x0a53061, 0x0a53161, 0x0a53161, 0x0a53261, 0x0a53261, 0x0a56161, 0x0a56161,
+    0x0a56361, 0x0a56361, 0x0a56561, 0x0a56561, 0x0a56961, 0x0a56961, 0x0a56f61, 0x0a56f61,
+    0x0a57361, 0x0a57361, 0x0a57461, 0x0a57461, 0x0c52061, 0x0c52561, 0x0c52d61, 0x0c52e61,
+    0x0c52f61, 0x0c53361, 0x0c53461, 0x0c53561, 0x0c53661, 0x0c53761, 0x0c53861, 0x0c53961,
+    0x0c53d61, 0x0c54161, 0x0c55f61, 0x0c56261, 0x0c56461, 0x0c56661, 0x0c56761, 0x0c56861,
+    0x0c56c61, 0x0c56d61, 0x0c56e61, 0x0c57061, 0x0c57261, 0x0c57561, 0x0050061, 0x0050061,
+    0x0050061, 0x0050061, 0x0050061, 0x0050061, 0x0050061, 0x0050061, 0x0050061, 0x0050061,
+    0x0050061, 0x0050061, 0x0050061, 0x0050061, 0x0050061, 0x0050061, 0x0050061, 0x0050061,
+    0x0a53063, 0x0a53063, 0x0a53163, 0x0a53163, 0x0a53263, 0x0a53263, 0x0a56163, 0x0a56163,
+    0x0a56363, 0x0a56363, 0x0a56563, 0x0a56563, 0x0a56963, 0x0a56963, 0x0a56f63, 0x0a56f63,
+    0x0a57363, 0x0a57363, 0x0a57463, 0x0a57463, 0x0c52063, 0x0c52563, 0x0c52d63, 0x0c52e63,
+    0x0c52f63, 0x0c53363, 0x0c53463, 0x0c53563, 0x0c53663, 0x0c53763, 0x0c53863, 0x0c53963,
+    0x0c53d63, 0x0c54163, 0x0c55f63, 0x0c56263, 0x0c56463, 0x0c56663, 0x0c56763, 0x0c56863,
+    0x0c56c63, 0x0c56d63, 0x0c56e63, 0x0c57063, 0x0c57263, 0x0c57563, 0x0050063, 0x0050063,
+    0x0050063, 0x0050063, 0x0050063, 0x0050063, 0x0050063, 0x0050063, 0x0050063, 0x0050063,
+    0x0050063, 0x0050063, 0x0050063, 0x0050063, 0x0050063, 0x0050063, 0x0050063, 0x0050063,
+    0x0a53065, 0x0a53065, 0x0a53165, 0x0a53165, 0x0a53265, 0x0a53265, 0x0a56165, 0x0a56165,
+    0x0a56365, 0x0a56365, 0x0a56565, 0x0a56565, 0x0a56965, 0x0a56965, 0x0a56f65, 0x0a56f65,
+    0x0a57365, 0x0a57365, 0x0a57465, 0x0a57465, 0x0c52065, 0x0c52565, 0x0c52d65, 0x0c52e65,
+    0x0c52f65, 0x0c53365, 0x0c53465, 0x0c53565, 0x0c53665, 0x0c53765, 0x0c53865, 0x0c53965,
+    0x0c53d65, 0x0c54165, 0x0c55f65, 0x0c56265, 0x0c56465, 0x0c56665, 0x0c56765, 0x0c56865,
+    0x0c56c65, 0x0c56d65, 0x0c56e65, 0x0c57065, 0x0c57265, 0x0c57565, 0x0050065, 0x0050065,
+    0x0050065, 0x0050065, 0x0050065, 0x0050065, 0x0050065, 0x0050065, 0x0050065, 0x0050065,
+    0x0050065, 0x0050065, 0x0050065, 0x0050065, 0x0050065, 0x0050065, 0x0050065, 0x0050065,
+    0x0a53069, 0x0a53069, 0x0a53169, 0x0a53169, 0x0a53269, 0x0a53269, 0x0a56169, 0x0a56169,
+    0x0a56369, 0x0a56369, 0x0a56569, 0x0a56569, 0x0a56969, 0x0a56969, 0x0a56f69, 0x0a56f69,
+    0x0a57369, 0x0a57369, 0x0a57469, 0x0a57469, 0x0c52069, 0x0c52569, 0x0c52d69, 0x0c52e69,
+    0x0c52f69, 0x0c53369, 0x0c53469, 0x0c53569, 0x0c53669, 0x0c53769, 0x0c53869, 0x0c53969,
+    0x0c53d69, 0x0c54169, 0x0c55f69, 0x0c56269, 0x0c56469, 0x0c56669, 0x0c56769, 0x0c56869,
+    0x0c56c69, 0x0c56d69, 0x0c56e69, 0x0c57069, 0x0c57269, 0x0c57569, 0x0050069, 0x0050069,
+    0x0050069, 0x0050069, 0x0050069, 0x0050069, 0x0050069, 0x0050069, 0x0050069, 0x0050069,
+    0x0050069, 0x0050069, 0x0050069, 0x0050069, 0x0050069, 0x0050069, 0x0050069, 0x0050069,
+    0x0a5306f, 0x0a5306f, 0x0a5316f, 0x0a5316f, 0x0a5326f, 0x0a5326f, 0x0a5616f, 0x0a5616f,
+    0x0a5636f, 0x0a5636f, 0x0a5656f, 0x0a5656f, 0x0a5696f, 0x0a5696f, 0x0a56f6f, 0x0a56f6f,
+    0x0a5736f, 0x0a5736f, 0x0a5746f, 0x0a5746f, 0x0c5206f, 0x0c5256f, 0x0c52d6f, 0x0c52e6f,
+    0x0c52f6f, 0x0c5336f, 0x0c5346f, 0x0c5356f, 0x0c5366f, 0x0c5376f, 0x0c5386f, 0x0c5396f,
+    0x0c53d6f, 0x0c5416f, 0x0c55f6f, 0x0c5626f, 0x0c5646f, 0x0c5666f, 0x0c5676f, 0x0c5686f,
+    0x0c56c6f, 0x0c56d6f, 0x0c56e6f, 0x0c5706f, 0x0c5726f, 0x0c5756f, 0x005006f, 0x005006f,
+    0x005006f, 0x005006f, 0x005006f, 0x005006f, 0x005006f, 0x005006f, 0x005006f, 0x005006f,
+    0x005006f, 0x005006f, 0x005006f, 0x005006f, 0x005006f, 0x005006f, 0x005006f, 0x005006f,
+    0x0a53073, 0x0a53073, 0x0a53173, 0x0a53173, 0x0a53273, 0x0a53273, 0x0a56173, 0x0a56173,
+    0x0a56373, 0x0a56373, 0x0a56573, 0x0a56573, 0x0a56973, 0x0a56973, 0x0a56f73, 0x0a56f73,
+    0x0a57373, 0x0a57373, 0x0a57473, 0x0a57473, 0x0c52073, 0x0c52573, 0x0c52d73, 0x0c52e73,
+    0x0c52f73, 0x0c53373, 0x0c53473, 0x0c53573, 0x0c53673, 0x0c53773, 0x0c53873, 0x0c53973,
+    0x0c53d73, 0x0c54173, 0x0c55f73, 0x0c56273, 0x0c56473, 0x0c56673, 0x0c56773, 0x0c56873,
+    0x0c56c73, 0x0c56d73, 0x0c56e73, 0x0c57073, 0x0c57273, 0x0c57573, 0x0050073, 0x0050073,
+    0x0050073, 0x0050073, 0x0050073, 0x0050073, 0x0050073, 0x0050073, 0x0050073, 0x0050073,
+    0x0050073, 0x0050073, 0x0050073, 0x0050073, 0x0050073, 0x0050073, 0x0050073, 0x0050073,
+    0x0a53074, 0x0a53074, 0x0a53174, 0x0a53174, 0x0a53274, 0x0a53274, 0x0a56174, 0x0a56174,
+    0x0a56374, 0x0a56374, 0x0a56574, 0x0a56574, 0x0a56974, 0x0a56974, 0x0a56f74, 0x0a56f74,
+    0x0a57374, 0x0a57374, 0x0a57474, 0x0a57474, 0x0c52074, 0x0c52574, 0x0c52d74, 0x0c52e74,
+    0x0c52f74, 0x0c53374, 0x0c53474, 0x0c53574, 0x0c53674, 0x0c53774, 0x0c53874, 0x0c53974,
+    0x0c53d74, 0x0c54174, 0x0c55f74, 0x0c56274, 0x0c56474, 0x0c56674, 0x0c56774, 0x0c56874,
+    0x0c56c74, 0x0c56d74, 0x0c56e74, 0x0c57074, 0x0c57274, 0x0c57574, 0x0050074, 0x0050074,
+    0x0050074, 0x0050074, 0x0050074, 0x0050074, 0x0050074, 0x0050074, 0x0050074, 0x0050074,
+    0x0050074, 0x0050074, 0x0050074, 0x0050074, 0x0050074, 0x0050074, 0x0050074, 0x0050074,
+    0x0a63020, 0x0a63120, 0x0a63220, 0x0a66120, 0x0a66320, 0x0a66520, 0x0a66920, 0x0a66f20,
+    0x0a67320, 0x0a67420, 0x0060020, 0x0060020, 0x0060020, 0x0060020, 0x0060020, 0x0060020,
+    0x0060020, 0x0060020, 0x0060020, 0x0060020, 0x0060020, 0x0060020, 0x0060020, 0x0060020,
+    0x0060020, 0x0060020, 0x0060020, 0x0060020, 0x0060020, 0x0060020, 0x0060020, 0x0060020,
+    0x0a63025, 0x0a63125, 0x0a63225, 0x0a66125, 0x0a66325, 0x0a66525, 0x0a66925, 0x0a66f25,
+    0x0a67325, 0x0a67425, 0x0060025, 0x0060025, 0x0060025, 0x0060025, 0x0060025, 0x0060025,
+    0x0060025, 0x0060025, 0x0060025, 0x0060025, 0x0060025, 0x0060025, 0x0060025, 0x0060025,
+    0x0060025, 0x0060025, 0x0060025, 0x0060025, 0x0060025, 0x0060025, 0x0060025, 0x0060025,
+    0x0a6302d, 0x0a6312d, 0x0a6322d, 0x0a6612d, 0x0a6632d, 0x0a6652d, 0x0a6692d, 0x0a66f2d,
+    0x0a6732d, 0x0a6742d, 0x006002d, 0x006002d, 0x006002d, 0x006002d, 0x006002d, 0x006002d,
+    0x006002d, 0x006002d, 0x006002d, 0x006002d, 0x006002d, 0x006002d, 0x006002d, 0x006002d,
+    0x006002d, 0x006002d, 0x006002d, 0x006002d, 0x006002d, 0x006002d, 0x006002d, 0x006002d,
+    0x0a6302e, 0x0a6312e, 0x0a6322e, 0x0a6612e, 0x0a6632e, 0x0a6652e, 0x0a6692e, 0x0a66f2e,
+    0x0a6732e, 0x0a6742e, 0x006002e, 0x006002e, 0x006002e, 0x006002e, 0x006002e, 0x006002e,
+    0x006002e, 0x006002e, 0x006002e, 0x006002e, 0x006002e, 0x006002e, 0x006002e, 0x006002e,
+    0x006002e, 0x006002e, 0x006002e, 0x006002e, 0x006002e, 0x006002e, 0x006002e, 0x006002e,
+    0x0a6302f, 0x0a6312f, 0x0a6322f, 0x0a6612f, 0x0a6632f, 0x0a6652f, 0x0a6692f, 0x0a66f2f,
+    0x0a6732f, 0x0a6742f, 0x006002f, 0x006002f, 0x006002f, 0x006002f, 0x006002f, 0x006002f,
+    0x006002f, 0x006002f, 0x006002f, 0x006002f, 0x006002f, 0x006002f, 0x006002f, 0x006002f,
+    0x006002f, 0x006002f, 0x006002f, 0x006002f, 0x006002f, 0x006002f, 0x006002f, 0x006002f,
+    0x0a63033, 0x0a63133, 0x0a63233, 0x0a66133, 0x0a66333, 0x0a66533, 0x0a66933, 0x0a66f33,
+    0x0a67333, 0x0a67433, 0x0060033, 0x0060033, 0x0060033, 0x0060033, 0x0060033, 0x0060033,
+    0x0060033, 0x0060033, 0x0060033, 0x0060033, 0x0060033, 0x0060033, 0x0060033, 0x0060033,
+    0x0060033, 0x0060033, 0x0060033, 0x0060033, 0x0060033, 0x0060033, 0x0060033, 0x0060033,
+    0x0a63034, 0x0a63134, 0x0a63234, 0x0a66134, 0x0a66334, 0x0a66534, 0x0a66934, 0x0a66f34,
+    0x0a67334, 0x0a67434, 0x0060034, 0x0060034, 0x0060034, 0x0060034, 0x0060034, 0x0060034,
+    0x0060034, 0x0060034, 0x0060034, 0x0060034, 0x0060034, 0x0060034, 0x0060034, 0x0060034,
+    0x0060034, 0x0060034, 0x0060034, 0x0060034, 0x0060034, 0x0060034, 0x0060034, 0x0060034,
+    0x0a63035, 0x0a63135, 0x0a63235, 0x0a66135, 0x0a66335, 0x0a66535, 0x0a66935, 0x0a66f35,
+    0x0a67335, 0x0a67435, 0x0060035, 0x0060035, 0x0060035, 0x0060035, 0x0060035, 0x0060035,
+    0x0060035, 0x0060035, 0x0060035, 0x0060035, 0x0060035, 0x0060035, 0x0060035, 0x0060035,
+    0x0060035, 0x0060035, 0x0060035, 0x0060035, 0x0060035, 0x0060035, 0x0060035, 0x0060035,
+    0x0a63036, 0x0a63136, 0x0a63236, 0x0a66136, 0x0a66336, 0x0a66536, 0x0a66936, 0x0a66f36,
+    0x0a67336, 0x0a67436, 0x0060036, 0x0060036, 0x0060036, 0x0060036, 0x0060036, 0x0060036,
+    0x0060036, 0x0060036, 0x0060036, 0x0060036, 0x0060036, 0x0060036, 0x0060036, 0x0060036,
+    0x0060036, 0x0060036, 0x0060036, 0x0060036, 0x0060036, 0x0060036, 0x0060036, 0x0060036,
+    0x0a63037, 0x0a63137, 0x0a63237, 0x0a66137, 0x0a66337, 0x0a66537, 0x0a66937, 0x0a66f37,
+    0x0a67337, 0x0a67437, 0x0060037, 0x0060037, 0x0060037, 0x0060037, 0x0060037, 0x0060037,
+    0x0060037, 0x0060037, 0x0060037, 0x0060037, 0x0060037, 0x0060037, 0x0060037, 0x0060037,
+    0x0060037, 0x0060037, 0x0060037, 0x0060037, 0x0060037, 0x0060037, 0x0060037, 0x0060037,
+    0x0a63038, 0x0a63138, 0x0a63238, 0x0a66138, 0x0a66338, 0x0a66538, 0x0a66938, 0x0a66f38,
+    0x0a67338, 0x0a67438, 0x0060038, 0x0060038, 0x0060038, 0x0060038, 0x0060038, 0x0060038,
+    0x0060038, 0x0060038, 0x0060038, 0x0060038, 0x0060038, 0x0060038, 0x0060038, 0x0060038,
+    0x0060038, 0x0060038, 0x0060038, 0x0060038, 0x0060038, 0x0060038, 0x0060038, 0x0060038,
+    0x0a63039, 0x0a63139, 0x0a63239, 0x0a66139, 0x0a66339, 0x0a66539, 0x0a66939, 0x0a66f39,
+    0x0a67339, 0x0a67439, 0x0060039, 0x0060039, 0x0060039, 0x0060039, 0x0060039, 0x0060039,
+    0x0060039, 0x0060039, 0x0060039, 0x0060039, 0x0060039, 0x0060039, 0x0060039, 0x0060039,
+    0x0060039, 0x0060039, 0x0060039, 0x0060039, 0x0060039, 0x0060039, 0x0060039, 0x0060039,
+    0x0a6303d, 0x0a6313d, 0x0a6323d, 0x0a6613d, 0x0a6633d, 0x0a6653d, 0x0a6693d, 0x0a66f3d,
+    0x0a6733d, 0x0a6743d, 0x006003d, 0x006003d, 0x006003d, 0x006003d, 0x006003d, 0x006003d,
+    0x006003d, 0x006003d, 0x006003d, 0x006003d, 0x006003d, 0x006003d, 0x006003d, 0x006003d,
+    0x006003d, 0x006003d, 0x006003d, 0x006003d, 0x006003d, 0x006003d, 0x006003d, 0x006003d,
+    0x0a63041, 0x0a63141, 0x0a63241, 0x0a66141, 0x0a66341, 0x0a66541, 0x0a66941, 0x0a66f41,
+    0x0a67341, 0x0a67441, 0x0060041, 0x0060041, 0x0060041, 0x0060041, 0x0060041, 0x0060041,
+    0x0060041, 0x0060041, 0x0060041, 0x0060041, 0x0060041, 0x0060041, 0x0060041, 0x0060041,
+    0x0060041, 0x0060041, 0x0060041, 0x0060041, 0x0060041, 0x0060041, 0x0060041, 0x0060041,
+    0x0a6305f, 0x0a6315f, 0x0a6325f, 0x0a6615f, 0x0a6635f, 0x0a6655f, 0x0a6695f, 0x0a66f5f,
+    0x0a6735f, 0x0a6745f, 0x006005f, 0x006005f, 0x006005f, 0x006005f, 0x006005f, 0x006005f,
+    0x006005f, 0x006005f, 0x006005f, 0x006005f, 0x006005f, 0x006005f, 0x006005f, 0x006005f,
+    0x006005f, 0x006005f, 0x006005f, 0x006005f, 0x006005f, 0x006005f, 0x006005f, 0x006005f,
+    0x0a63062, 0x0a63162, 0x0a63262, 0x0a66162, 0x0a66362, 0x0a66562, 0x0a66962, 0x0a66f62,
+    0x0a67362, 0x0a67462, 0x0060062, 0x0060062, 0x0060062, 0x0060062, 0x0060062, 0x0060062,
+    0x0060062, 0x0060062, 0x0060062, 0x0060062, 0x0060062, 0x0060062, 0x0060062, 0x0060062,
+    0x0060062, 0x0060062, 0x0060062, 0x0060062, 0x0060062, 0x0060062, 0x0060062, 0x0060062,
+    0x0a63064, 0x0a63164, 0x0a63264, 0x0a66164, 0x0a66364, 0x0a66564, 0x0a66964, 0x0a66f64,
+    0x0a67364, 0x0a67464, 0x0060064, 0x0060064, 0x0060064, 0x0060064, 0x0060064, 0x0060064,
+    0x0060064, 0x0060064, 0x0060064, 0x0060064, 0x0060064, 0x0060064, 0x0060064, 0x0060064,
+    0x0060064, 0x0060064, 0x0060064, 0x0060064, 0x0060064, 0x0060064, 0x0060064, 0x0060064,
+    0x0a63066, 0x0a63166, 0x0a63266, 0x0a66166, 0x0a66366, 0x0a66566, 0x0a66966, 0x0a66f66,
+    0x0a67366, 0x0a67466, 0x0060066, 0x0060066, 0x0060066, 0x0060066, 0x0060066, 0x0060066,
+    0x0060066, 0x0060066, 0x0060066, 0x0060066, 0x0060066, 0x0060066, 0x0060066, 0x0060066,
+    0x0060066, 0x0060066, 0x0060066, 0x0060066, 0x0060066, 0x0060066, 0x0060066, 0x0060066,
+    0x0a63067, 0x0a63167, 0x0a63267, 0x0a66167, 0x0a66367, 0x0a66567, 0x0a66967, 0x0a66f67,
+    0x0a67367, 0x0a67467, 0x0060067, 0x0060067, 0x0060067, 0x0060067, 0x0060067, 0x0060067,
+    0x0060067, 0x0060067, 0x0060067, 0x0060067, 0x0060067, 0x0060067, 0x0060067, 0x0060067,
+    0x0060067, 0x0060067, 0x0060067, 0x0060067, 0x0060067, 0x0060067, 0x0060067, 0x0060067,
+    0x0a63068, 0x0a63168, 0x0a63268, 0x0a66168, 0x0a66368, 0x0a66568, 0x0a66968, 0x0a66f68,
+    0x0a67368, 0x0a67468, 0x0060068, 0x0060068, 0x0060068, 0x0060068, 0x0060068, 0x0060068,
+    0x0060068, 0x0060068, 0x0060068, 0x0060068, 0x0060068, 0x0060068, 0x0060068, 0x0060068,
+    0x0060068, 0x0060068, 0x0060068, 0x0060068, 0x0060068, 0x0060068, 0x0060068, 0x0060068,
+    0x0a6306c, 0x0a6316c, 0x0a6326c, 0x0a6616c, 0x0a6636c, 0x0a6656c, 0x0a6696c, 0x0a66f6c,
+    0x0a6736c, 0x0a6746c, 0x006006c, 0x006006c, 0x006006c, 0x006006c, 0x006006c, 0x006006c,
+    0x006006c, 0x006006c, 0x006006c, 0x006006c, 0x006006c, 0x006006c, 0x006006c, 0x006006c,
+    0x006006c, 0x006006c, 0x006006c, 0x006006c, 0x006006c, 0x006006c, 0x006006c, 0x006006c,
+    0x0a6306d, 0x0a6316d, 0x0a6326d, 0x0a6616d, 0x0a6636d, 0x0a6656d, 0x0a6696d, 0x0a66f6d,
+    0x0a6736d, 0x0a6746d, 0x006006d, 0x006006d, 0x006006d, 0x006006d, 0x006006d, 0x006006d,
+    0x006006d, 0x006006d, 0x006006d, 0x006006d, 0x006006d, 0x006006d, 0x006006d, 0x006006d,
+    0x006006d, 0x006006d, 0x006006d, 0x006006d, 0x006006d, 0x006006d, 0x006006d, 0x006006d,
+    0x0a6306e, 0x0a6316e, 0x0a6326e, 0x0a6616e, 0x0a6636e, 0x0a6656e, 0x0a6696e, 0x0a66f6e,
+    0x0a6736e, 0x0a6746e, 0x006006e, 0x006006e, 0x006006e, 0x006006e, 0x006006e, 0x006006e,
+    0x006006e, 0x006006e, 0x006006e, 0x006006e, 0x006006e, 0x006006e, 0x006006e, 0x006006e,
+    0x006006e, 0x006006e, 0x006006e, 0x006006e, 0x006006e, 0x006006e, 0x006006e, 0x006006e,
+    0x0a63070, 0x0a63170, 0x0a63270, 0x0a66170, 0x0a66370, 0x0a66570, 0x0a66970, 0x0a66f70,
+    0x0a67370, 0x0a67470, 0x0060070, 0x0060070, 0x0060070, 0x0060070, 0x0060070, 0x0060070,
+    0x0060070, 0x0060070, 0x0060070, 0x0060070, 0x0060070, 0x0060070, 0x0060070, 0x0060070,
+    0x0060070, 0x0060070, 0x0060070, 0x0060070, 0x0060070, 0x0060070, 0x0060070, 0x0060070,
+    0x0a63072, 0x0a63172, 0x0a63272, 0x0a66172, 0x0a66372, 0x0a66572, 0x0a66972, 0x0a66f72,
+    0x0a67372, 0x0a67472, 0x0060072, 0x0060072, 0x0060072, 0x0060072, 0x0060072, 0x0060072,
+    0x0060072, 0x0060072, 0x0060072, 0x0060072, 0x0060072, 0x0060072, 0x0060072, 0x0060072,
+    0x0060072, 0x0060072, 0x0060072, 0x0060072, 0x0060072, 0x0060072, 0x0060072, 0x0060072,
+    0x0a63075, 0x0a63175, 0x0a63275, 0x0a66175, 0x0a66375, 0x0a66575, 0x0a66975, 0x0a66f75,
+    0x0a67375, 0x0a67475, 0x0060075, 0x0060075, 0x0060075, 0x0060075, 0x0060075, 0x0060075,
+    0x0060075, 0x0060075, 0x0060075, 0x0060075, 0x0060075, 0x0060075, 0x0060075, 0x0060075,
+    0x0060075, 0x0060075, 0x0060075, 0x0060075, 0x0060075, 0x0060075, 0x0060075, 0x0060075,
+    0x007003a, 0x007003a, 0x007003a, 0x007003a, 0x007003a, 0x007003a, 0x007003a, 0x007003a,
+    0x007003a, 0x007003a, 0x007003a, 0x007003a, 0x007003a, 0x007003a, 0x007003a, 0x007003a,
+    0x0070042, 0x0070042, 0x0070042, 0x0070042, 0x0070042, 0x0070042, 0x0070042, 0x0070042,
+    0x0070042, 0x0070042, 0x0070042, 0x0070042, 0x0070042, 0x0070042, 0x0070042, 0x0070042,
+    0x0070043, 0x0070043, 0x0070043, 0x0070043, 0x0070043, 0x0070043, 0x0070043, 0x0070043,
+    0x0070043, 0x0070043, 0x0070043, 0x0070043, 0x0070043, 0x0070043, 0x0070043, 0x0070043,
+    0x0070044, 0x0070044, 0x0070044, 0x0070044, 0x0070044, 0x0070044, 0x0070044, 0x0070044,
+    0x0070044, 0x0070044, 0x0070044, 0x0070044, 0x0070044, 0x0070044, 0x0070044, 0x0070044,
+    0x0070045, 0x0070045, 0x0070045, 0x0070045, 0x0070045, 0x0070045, 0x0070045, 0x0070045,
+    0x0070045, 0x0070045, 0x0070045, 0x0070045, 0x0070045, 0x0070045, 0x0070045, 0x0070045,
+    0x0070046, 0x0070046, 0x0070046, 0x0070046, 0x0070046, 0x0070046, 0x0070046, 0x0070046,
+    0x0070046, 0x0070046, 0x0070046, 0x0070046, 0x0070046, 0x0070046, 0x0070046, 0x0070046,
+    0x0070047, 0x0070047, 0x0070047, 0x0070047, 0x0070047, 0x0070047, 0x0070047, 0x0070047,
+    0x0070047, 0x0070047, 0x0070047, 0x0070047, 0x0070047, 0x0070047, 0x0070047, 0x0070047,
+    0x0070048, 0x0070048, 0x0070048, 0x0070048, 0x0070048, 0x0070048, 0x0070048, 0x0070048,
+    0x0070048, 0x0070048, 0x0070048, 0x0070048, 0x0070048, 0x0070048, 0x0070048, 0x0070048,
+    0x0070049, 0x0070049, 0x0070049, 0x0070049, 0x0070049, 0x0070049, 0x0070049, 0x0070049,
+    0x0070049, 0x0070049, 0x0070049, 0x0070049, 0x0070049, 0x0070049, 0x0070049, 0x0070049,
+    0x007004a, 0x007004a, 0x007004a, 0x007004a, 0x007004a, 0x007004a, 0x007004a, 0x007004a,
+    0x007004a, 0x007004a, 0x007004a, 0x007004a, 0x007004a, 0x007004a, 0x007004a, 0x007004a,
+    0x007004b, 0x007004b, 0x007004b, 0x007004b, 0x007004b, 0x007004b, 0x007004b, 0x007004b,
+    0x007004b, 0x007004b, 0x007004b, 0x007004b, 0x007004b, 0x007004b, 0x007004b, 0x007004b,
+    0x007004c, 0x007004c, 0x007004c, 0x007004c, 0x007004c, 0x007004c, 0x007004c, 0x007004c,
+    0x007004c, 0x007004c, 0x007004c, 0x007004c, 0x007004c, 0x007004c, 0x007004c, 0x007004c,
+    0x007004d, 0x007004d, 0x007004d, 0x007004d, 0x007004d, 0x007004d, 0x007004d, 0x007004d,
+    0x007004d, 0x007004d, 0x007004d, 0x007004d, 0x007004d, 0x007004d, 0x007004d, 0x007004d,
+    0x007004e, 0x007004e, 0x007004e, 0x007004e, 0x007004e, 0x007004e, 0x007004e, 0x007004e,
+    0x007004e, 0x007004e, 0x007004e, 0x007004e, 0x007004e, 0x007004e, 0x007004e, 0x007004e,
+    0x007004f, 0x007004f, 0x007004f, 0x007004f, 0x007004f, 0x007004f, 0x007004f, 0x007004f,
+    0x007004f, 0x007004f, 0x007004f, 0x007004f, 0x007004f, 0x007004f, 0x007004f, 0x007004f,
+    0x0070050, 0x0070050, 0x0070050, 0x0070050, 0x0070050, 0x0070050, 0x0070050, 0x0070050,
+    0x0070050, 0x0070050, 0x0070050, 0x0070050, 0x0070050, 0x0070050, 0x0070050, 0x0070050,
+    0x0070051, 0x0070051, 0x0070051, 0x0070051, 0x0070051, 0x0070051, 0x0070051, 0x0070051,
+    0x0070051, 0x0070051, 0x0070051, 0x0070051, 0x0070051, 0x0070051, 0x0070051, 0x0070051,
+    0x0070052, 0x0070052, 0x0070052, 0x0070052, 0x0070052, 0x0070052, 0x0070052, 0x0070052,
+    0x0070052, 0x0070052, 0x0070052, 0x0070052, 0x0070052, 0x0070052, 0x0070052, 0x0070052,
+    0x0070053, 0x0070053, 0x0070053, 0x0070053, 0x0070053, 0x0070053, 0x0070053, 0x0070053,
+    0x0070053, 0x0070053, 0x0070053, 0x0070053, 0x0070053, 0x0070053, 0x0070053, 0x0070053,
+    0x0070054, 0x0070054, 0x0070054, 0x0070054, 0x0070054, 0x0070054, 0x0070054, 0x0070054,
+    0x0070054, 0x0070054, 0x0070054, 0x0070054, 0x0070054, 0x0070054, 0x0070054, 0x0070054,
+    0x0070055, 0x0070055, 0x0070055, 0x0070055, 0x0070055, 0x0070055, 0x0070055, 0x0070055,
+    0x0070055, 0x0070055, 0x0070055, 0x0070055, 0x0070055, 0x0070055, 0x0070055, 0x0070055,
+    0x0070056, 0x0070056, 0x0070056, 0x0070056, 0x0070056, 0x0070056, 0x0070056, 0x0070056,
+    0x0070056, 0x0070056, 0x0070056, 0x0070056, 0x0070056, 0x0070056, 0x0070056, 0x0070056,
+    0x0070057, 0x0070057, 0x0070057, 0x0070057, 0x0070057, 0x0070057, 0x0070057, 0x0070057,
+    0x0070057, 0x0070057, 0x0070057, 0x0070057, 0x0070057, 0x0070057, 0x0070057, 0x0070057,
+    0x0070059, 0x0070059, 0x0070059, 0x0070059, 0x0070059, 0x0070059, 0x0070059, 0x0070059,
+    0x0070059, 0x0070059, 0x0070059, 0x0070059, 0x0070059, 0x0070059, 0x0070059, 0x0070059,
+    0x007006a, 0x007006a, 0x007006a, 0x007006a, 0x007006a, 0x007006a, 0x007006a, 0x007006a,
+    0x007006a, 0x007006a, 0x007006a, 0x007006a, 0x007006a, 0x007006a, 0x007006a, 0x007006a,
+    0x007006b, 0x007006b, 0x007006b, 0x007006b, 0x007006b, 0x007006b, 0x007006b, 0x007006b,
+    0x007006b, 0x007006b, 0x007006b, 0x007006b, 0x007006b, 0x007006b, 0x007006b, 0x007006b,
+    0x0070071, 0x0070071, 0x0070071, 0x0070071, 0x0070071, 0x0070071, 0x0070071, 0x0070071,
+    0x0070071, 0x0070071, 0x0070071, 0x0070071, 0x0070071, 0x0070071, 0x0070071, 0x0070071,
+    0x0070076, 0x0070076, 0x0070076, 0x0070076, 0x0070076, 0x0070076, 0x0070076, 0x0070076,
+    0x0070076, 0x0070076, 0x0070076, 0x0070076, 0x0070076, 0x0070076, 0x0070076, 0x0070076,
+    0x0070077, 0x0070077, 0x0070077, 0x0070077, 0x0070077, 0x0070077, 0x0070077, 0x0070077,
+    0x0070077, 0x0070077, 0x0070077, 0x0070077, 0x0070077, 0x0070077, 0x0070077, 0x0070077,
+    0x0070078, 0x0070078, 0x0070078, 0x0070078, 0x0070078, 0x0070078, 0x0070078, 0x0070078,
+    0x0070078, 0x0070078, 0x0070078, 0x0070078, 0x0070078, 0x0070078, 0x0070078, 0x0070078,
+    0x0070079, 0x0070079, 0x0070079, 0x0070079, 0x0070079, 0x0070079, 0x0070079, 0x0070079,
+    0x0070079, 0x0070079, 0x0070079, 0x0070079, 0x0070079, 0x0070079, 0x0070079, 0x0070079,
+    0x007007a, 0x007007a, 0x007007a, 0x007007a, 0x007007a, 0x007007a, 0x007007a, 0x007007a,
+    0x007007a, 0x007007a, 0x007007a, 0x007007a, 0x007007a, 0x007007a, 0x007007a, 0x007007a,
+    0x0080026, 0x0080026, 0x0080026, 0x0080026, 0x0080026, 0x0080026, 0x0080026, 0x0080026,
+    0x008002a, 0x008002a, 0x008002a, 0x008002a, 0x008002a, 0x008002a, 0x008002a, 0x008002a,
+    0x008002c, 0x008002c, 0x008002c, 0x008002c, 0x008002c, 0x008002c, 0x008002c, 0x008002c,
+    0x008003b, 0x008003b, 0x008003b, 0x008003b, 0x008003b, 0x008003b, 0x008003b, 0x008003b,
+    0x0080058, 0x0080058, 0x0080058, 0x0080058, 0x0080058, 0x0080058, 0x0080058, 0x0080058,
+    0x008005a, 0x008005a, 0x008005a, 0x008005a, 0x008005a, 0x008005a, 0x008005a, 0x008005a,
+    0x00a0021, 0x00a0021, 0x00a0022, 0x00a0022, 0x00a0028, 0x00a0028, 0x00a0029, 0x00a0029,
+    0x00a003f, 0x00a003f, 0x00b0027, 0x00b002b, 0x00b007c, 0x0000000, 0x0000000, 0x0000000,
+};
+
+// Canonical code: first code, number of codes and index of the first symbol in __hpack_huff_sorted by length
+static const unsigned int __hpack_huff_first[31] = {
+    0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x14, 0x5c,
+    0xf8, 0x0, 0x3f8, 0x7fa, 0xffa, 0x1ff8, 0x3ffc, 0x7ffc,
+    0x0, 0x0, 0x0, 0x7fff0, 0xfffe6, 0x1fffdc, 0x3fffd2, 0x7fffd8,
+    0xffffea, 0x1ffffec, 0x3ffffe0, 0x7ffffde, 0xfffffe2, 0x0, 0x3ffffffc,
+};
+static const unsigned short __hpack_huff_count[31] = {
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+    0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4,
+};
+static const unsigned short __hpack_huff_base[31] = {
+    0, 0, 0, 0, 0, 0, 10, 36, 68, 0, 74, 79, 82, 84, 90, 92,
+    0, 0, 0, 95, 98, 106, 119, 145, 174, 186, 190, 205, 224, 0, 253,
+};
+
+// Symbols ordered by code length, then by value
+static const unsigned short __hpack_huff_sorted[257] = {
+    48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46, 47, 51,
+    52, 53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102, 103, 104, 108, 109,
+    110, 112, 114, 117, 58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+    77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89, 106, 107, 113, 118,
+    119, 120, 121, 122, 38, 42, 44, 59, 88, 90, 33, 34, 40, 41, 63, 39,
+    43, 124, 35, 62, 0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+    179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+    163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+    158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239, 9, 142,
+    144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+    212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+    2, 3, 4, 5, 6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+    21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220, 249, 10, 13, 22,
+    256,
+};
+
+
+void httpp_hpack_init(httpp_hpack_t* hp)
+{
+    hp->first = 0;
+    hp->count = 0;
+    hp->tail = 0;
+    hp->size = 0;
+    hp->max_size = HTTPP_HPACK_TABLE_SIZE;
+}
+
+// Integer with an N-bit prefix (RFC 7541, 5.1). On failure returns false
+static bool __hpack_int(const unsigned char** itr, const unsigned char* end, int prefix, size_t* out)
+{
+    size_t max = ((size_t) 1 << prefix) - 1;
+    size_t v = *(*itr)++ & max;
+
+    if (v < max) {
+        *out = v;
+        return true;
+    }
+
+    for (int shift = 0; *itr < end && shift <= 28; shift += 7) {
+        unsigned char b = *(*itr)++;
+
+        v += (size_t) (b & 127) << shift;
+        if (!(b & 128)) {
+            *out = v;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Decodes Huffman coded `src` into `out`.
+ *   On invalid code, EOS or padding longer than 7 bits returns -1.
+ *
+ * On sucess returns the decoded length
+ */
+static ptrdiff_t __hpack_huffman(const unsigned char* src, size_t n, char* out, size_t cap)
+{
+    uint64_t acc = 0; // Bits not consumed yet, from the top
+    int      bits = 0;
+    size_t   pos = 0;
+    size_t   len = 0;
+
+    for (;;) {
+        while (bits <= 56 && pos < n) {
+            acc |= (uint64_t) src[pos++] << (56 - bits);
+            bits += 8;
+        }
+
+        if (bits == 0)
+            break;
+
+        unsigned int e = __hpack_huff_fast[acc >> (64 - HTTPP_HPACK_HUFF_BITS)];
+        int first_len = (e >> 16) & 31;
+        int pair_len = first_len + (e >> 21);
+        unsigned sym = 257;
+        int code_len = first_len;
+
+        // Two symbols at once, most of the time for lowercase text
+        if (e >> 21 && pair_len <= bits) {
+            if (cap - len < 2)
+                return -1;
+
+            out[len++] = (char) (e & 0xFF);
+            out[len++] = (char) (e >> 8);
+            acc <<= pair_len;
+            bits -= pair_len;
+            continue;
+        }
+
+        if (e && first_len <= bits)
+            sym = e & 0xFF;
+        else if (!e) {
+            for (code_len = HTTPP_HPACK_HUFF_BITS + 1; code_len <= 30 && code_len <= bits; code_len++) {
+                unsigned code = (unsigned) (acc >> (64 - code_len));
+
+                if (code - __hpack_huff_first[code_len] < __hpack_huff_count[code_len]) {
+                    sym = __hpack_huff_sorted[__hpack_huff_base[code_len] + code - __hpack_huff_first[code_len]];
+                    break;
+                }
+            }
+        }
+
+        // Nothing fits in the last bits, they must be padding: a prefix of EOS (all ones)
+        if (sym == 257) {
+            if (pos < n || bits > 7 || (acc >> (64 - bits)) != ((uint64_t) 1 << bits) - 1)
+                return -1;
+            break;
+        }
+
+        if (sym == 256 || len >= cap)
+            return -1;
+
+        out[len++] = (char) sym;
+        acc <<= code_len;
+        bits -= code_len;
+    }
+
+    return len;
+}
+
+typedef struct {
+    char*  ptr;
+    size_t cap;
+    size_t len;
+} __hpack_arena_t;
+
+// String literal (RFC 7541, 5.2). On failure returns false
+static bool __hpack_string(const unsigned char** itr, const unsigned char* end,
+                           __hpack_arena_t* arena, httpp_span_t* out)
+{
+    if (*itr >= end)
+        return false;
+
+    bool   huffman = (**itr & 0x80) != 0;
+    size_t len;
+
+    if (!__hpack_int(itr, end, 7, &len) || len > (size_t) (end - *itr))
+        return false;
+
+    if (!huffman) {
+        *out = (httpp_span_t){(char*) *itr, len, false};
+        *itr += len;
+        return true;
+    }
+
+    char* dst = arena->ptr + arena->len;
+    ptrdiff_t decoded = __hpack_huffman(*itr, len, dst, arena->cap - arena->len);
+
+    if (decoded < 0)
+        return false;
+
+    arena->len += decoded;
+    *itr += len;
+    *out = (httpp_span_t){dst, (size_t) decoded, false};
+    return true;
+}
+
+// Copies `len` bytes of the ring from `off` into the arena. On failure returns false
+static bool __hpack_copy_out(httpp_hpack_t* hp, size_t off, size_t len,
+                             __hpack_arena_t* arena, httpp_span_t* out)
+{
+    if (arena->cap - arena->len < len)
+        return false;
+
+    char* dst = arena->ptr + arena->len;
+
+    if (off + len <= HTTPP_HPACK_TABLE_SIZE)
+        memcpy(dst, hp->data + off, len);
+    else {
+        size_t first = HTTPP_HPACK_TABLE_SIZE - off;
+
+        memcpy(dst, hp->data + off, first);
+        memcpy(dst + first, hp->data, len - first);
+    }
+
+    arena->len += len;
+    *out = (httpp_span_t){dst, len, false};
+    return true;
+}
+
+// Name (and value when `value` is not NULL) of entry `index`. On failure returns false
+static bool __hpack_lookup(httpp_hpack_t* hp, size_t index, __hpack_arena_t* arena,
+                           httpp_span_t* name, httpp_span_t* value)
+{
+    if (index == 0)
+        return false;
+
+    if (index <= HTTPP_HPACK_STATIC_LEN) {
+        const __hpack_entry_t* e = &__hpack_static[index];
+
+        *name = (httpp_span_t){(char*) e->name, e->name_len, false};
+        if (value)
+            *value = (httpp_span_t){(char*) e->value, e->value_len, false};
+        return true;
+    }
+
+    // Dynamic index 62 is the newest entry
+    size_t d = index - HTTPP_HPACK_STATIC_LEN - 1;
+    if (d >= hp->count)
+        return false;
+
+    httpp_hpack_entry_t* e = &hp->entries[(hp->first + hp->count - 1 - d) % HTTPP_HPACK_MAX_ENTRIES];
+
+    if (!__hpack_copy_out(hp, e->off, e->name_len, arena, name))
+        return false;
+
+    return !value || __hpack_copy_out(hp, (e->off + e->name_len) % HTTPP_HPACK_TABLE_SIZE,
+                                      e->value_len, arena, value);
+}
+
+static void __hpack_evict(httpp_hpack_t* hp, size_t limit)
+{
+    while (hp->count > 0 && hp->size > limit) {
+        httpp_hpack_entry_t* e = &hp->entries[hp->first];
+
+        hp->size -= e->name_len + e->value_len + 32;
+        hp->first = (hp->first + 1) % HTTPP_HPACK_MAX_ENTRIES;
+        hp->count--;
+    }
+}
+
+static void __hpack_ring_write(httpp_hpack_t* hp, const char* src, size_t len)
+{
+    if (hp->tail + len <= HTTPP_HPACK_TABLE_SIZE)
+        memcpy(hp->data + hp->tail, src, len);
+    else {
+        size_t first = HTTPP_HPACK_TABLE_SIZE - hp->tail;
+
+        memcpy(hp->data + hp->tail, src, first);
+        memcpy(hp->data, src + first, len - first);
+    }
+
+    hp->tail = (hp->tail + len) % HTTPP_HPACK_TABLE_SIZE;
+}
+
+// Adds an entry (RFC 7541, 4.4), `name` and `value` must not point into the ring
+static void __hpack_insert(httpp_hpack_t* hp, httpp_span_t* name, httpp_span_t* value)
+{
+    size_t size = name->length + value->length + 32;
+
+    if (size > hp->max_size) {
+        __hpack_evict(hp, 0); // Too big, the table just ends up empty
+        return;
+    }
+
+    __hpack_evict(hp, hp->max_size - size);
+
+    // Live bytes never exceed max_size - 32 * count, so nothing live is overwritten
+    httpp_hpack_entry_t* e = &hp->entries[(hp->first + hp->count) % HTTPP_HPACK_MAX_ENTRIES];
+
+    e->off = (unsigned short) hp->tail;
+    e->name_len = (unsigned short) name->length;
+    e->value_len = (unsigned short) value->length;
+
+    __hpack_ring_write(hp, name->ptr, name->length);
+    __hpack_ring_write(hp, value->ptr, value->length);
+
+    hp->size += size;
+    hp->count++;
+}
+
+#define __HPACK_PSEUDO_METHOD    1
+#define __HPACK_PSEUDO_SCHEME    2
+#define __HPACK_PSEUDO_PATH      4
+#define __HPACK_PSEUDO_AUTHORITY 8
+
+// Applies one decoded field to `dest`. If the request is malformed returns false
+static bool __hpack_field(httpp_req_t* dest, httpp_span_t* name, httpp_span_t* value,
+                          int* pseudo, bool* regular)
+{
+    if (name->length > 0 && name->ptr[0] == ':') {
+        int bit = httpp_span_eq(name, ":method")    ? __HPACK_PSEUDO_METHOD
+                : httpp_span_eq(name, ":scheme")    ? __HPACK_PSEUDO_SCHEME
+                : httpp_span_eq(name, ":path")      ? __HPACK_PSEUDO_PATH
+                : httpp_span_eq(name, ":authority") ? __HPACK_PSEUDO_AUTHORITY
+                : 0;
+
+        // RFC 9113, 8.3: known, once each, before regular headers
+        if (!bit || (*pseudo & bit) || *regular)
+            return false;
+
+        *pseudo |= bit;
+
+        if (bit == __HPACK_PSEUDO_METHOD) {
+            char method_buf[HTTPP_MAX_METHOD_LENGTH + 1];
+
+            if (value->length == 0 || value->length > HTTPP_MAX_METHOD_LENGTH)
+                return false;
+
+            SETSTR(method_buf, value->ptr, value->length);
+            dest->method = httpp_string_to_method(method_buf);
+        }
+        else if (bit == __HPACK_PSEUDO_PATH) {
+            if (value->length == 0)
+                return false;
+            dest->route = *value;
+        }
+        else if (bit == __HPACK_PSEUDO_AUTHORITY) {
+            httpp_header_t host = {{(char*) "host", 4, false}, *value};
+            return httpp_headers_arr_append(&dest->headers, host) != NULL;
+        }
+
+        return true;
+    }
+
+    *regular = true;
+
+    // RFC 9113, 8.2: lowercase names, no connection specific headers
+    for (size_t i = 0; i < name->length; i++) {
+        if (name->ptr[i] >= 'A' && name->ptr[i] <= 'Z')
+            return false;
+    }
+
+    if (httpp_span_eq(name, "connection") || httpp_span_eq(name, "keep-alive")
+        || httpp_span_eq(name, "proxy-connection") || httpp_span_eq(name, "transfer-encoding")
+        || httpp_span_eq(name, "upgrade"))
+        return false;
+
+    httpp_header_t* h = httpp_headers_arr_append(&dest->headers, (httpp_header_t){*name, *value});
+
+    if (h && name->length == 6 && memcmp(name->ptr, "expect", 6) == 0)
+        __parse_expect(dest, value);
+
+    return h != NULL;
+}
+
+int httpp_hpack_decode(httpp_hpack_t* hp, const char* block, size_t n, httpp_req_t* dest,
+                       char* arena, size_t arena_cap)
+{
+    if (hp == NULL || block == NULL || dest == NULL)
+        return HTTPP_HPACK_ERROR;
+
+    const unsigned char* itr = (const unsigned char*) block;
+    const unsigned char* end = itr + n;
+    __hpack_arena_t a = {arena, arena ? arena_cap : 0, 0};
+
+    bool malformed = false;
+    bool regular = false;
+    bool fields = false;
+    int  pseudo = 0;
+
+    dest->method = HTTPP_METHOD_UNKNOWN;
+    httpp_span_init(&dest->route);
+    httpp_span_init(&dest->body);
+    dest->version = (httpp_span_t){(char*) "HTTP/2", 6, false};
+    dest->version_major = 2;
+    dest->version_minor = 0;
+    dest->keep_alive = true;
+    dest->upgrade = false;
+    dest->conn_close = false;
+    dest->expect_continue = false;
+    httpp_span_init(&dest->unsplit);
+
+    while (itr < end) {
+        httpp_span_t name, value;
+        size_t index;
+        bool   indexing = false;
+
+        if (*itr & 0x80) {
+            // Indexed field (6.1)
+            if (!__hpack_int(&itr, end, 7, &index) || !__hpack_lookup(hp, index, &a, &name, &value))
+                return HTTPP_HPACK_ERROR;
+        }
+        else if ((*itr & 0xE0) == 0x20) {
+            // Dynamic table size update (6.3), only before the first field
+            if (fields || !__hpack_int(&itr, end, 5, &index) || index > HTTPP_HPACK_TABLE_SIZE)
+                return HTTPP_HPACK_ERROR;
+
+            hp->max_size = index;
+            __hpack_evict(hp, index);
+            continue;
+        }
+        else {
+            // Literal with incremental indexing (6.2.1), without (6.2.2) or never indexed (6.2.3)
+            indexing = (*itr & 0xC0) == 0x40;
+
+            if (!__hpack_int(&itr, end, indexing ? 6 : 4, &index))
+                return HTTPP_HPACK_ERROR;
+
+            if (index == 0 ? !__hpack_string(&itr, end, &a, &name)
+                           : !__hpack_lookup(hp, index, &a, &name, NULL))
+                return HTTPP_HPACK_ERROR;
+
+            if (!__hpack_string(&itr, end, &a, &value))
+                return HTTPP_HPACK_ERROR;
+
+            if (indexing)
+                __hpack_insert(hp, &name, &value);
+        }
+
+        fields = true;
+
+        // A malformed request still has to be decoded to the end, the table depends on it
+        if (!malformed && !__hpack_field(dest, &name, &value, &pseudo, &regular))
+            malformed = true;
+    }
+
+    // CONNECT has only :method and :authority (RFC 9113, 8.5)
+    if (dest->method == HTTPP_METHOD_CONNECT)
+        malformed |= pseudo != (__HPACK_PSEUDO_METHOD | __HPACK_PSEUDO_AUTHORITY);
+    else {
+        int required = __HPACK_PSEUDO_METHOD | __HPACK_PSEUDO_SCHEME | __HPACK_PSEUDO_PATH;
+        malformed |= (pseudo & required) != required;
+    }
+
+    return malformed ? HTTPP_HPACK_MALFORMED : (int) a.len;
+}
+
+#undef __HPACK_PSEUDO_METHOD
+#undef __HPACK_PSEUDO_SCHEME
+#undef __HPACK_PSEUDO_PATH
+#undef __HPACK_PSEUDO_AUTHORITY
+
+#endif // HTTPP_IMPLEMENTATION
+#endif // _HTTPP_HPACK_HEADER
@@ -0,0 +1,562 @@
+#ifndef _HTTPP_LOG_HEADER
+#define _HTTPP_LOG_HEADER
+
+/*
+ * Access log lines formatted straight from the spans of a parsed request, POSIX only
+ * (HTTPP_POSIX).
+ *
+ * The format is compiled once into a list of operations, with nginx style variables:
+ *
+ *      $remote_addr $time_local $time_iso8601 $request $request_method $request_uri
+ *      $server_protocol $status $body_bytes_sent $request_time $http_<name>
+ *
+ * $http_user_agent is the User-Agent header, "_" stands for "-". ${name} can be used
+ * when a variable is followed by a letter. Values are escaped, literals are not.
+ *
+ * Lines go into a buffer owned by one thread and reach the file descriptor in
+ * large writes, when the buffer is full or on httpp_log_flush. Nothing is
+ * allocated, times are formatted once a second per buffer.
+ *
+ *      httpp_log_format_t fmt; // Shared, read only
+ *      httpp_log_format_init(&fmt, HTTPP_LOG_COMBINED, HTTPP_LOG_ESCAPE_DEFAULT);
+ *
+ *      static __thread char mem[64 * 1024];
+ *      static __thread httpp_log_t log;
+ *      httpp_log_init(&log, mem, sizeof(mem), fd);
+ *
+ *      httpp_log_entry_t e = {&req, remote_addr, 200, body_len, duration_us, now};
+ *      httpp_log_write(&log, &fmt, &e);
+ *
+ * Times are UTC. A line longer than the whole buffer is cut, it still ends with '\n'.
+ */
+
+#include <time.h>
+#include "httpp.h"
+#include "httpp_date.h"
+
+#ifdef HTTPP_POSIX
+
+#define HTTPP_LOG_MAX_OPS    64
+#define HTTPP_LOG_FORMAT_MAX 512 // Literals and header names of a format
+
+// nginx escape=default: '"', '\' and bytes outside of 0x20-0x7e as \xHH
+#define HTTPP_LOG_ESCAPE_DEFAULT 0
+// JSON strings: \" \\ \n \r \t \b \f, other control bytes as \u00HH, UTF-8 is kept
+#define HTTPP_LOG_ESCAPE_JSON    1
+
+#define HTTPP_LOG_COMMON \
+    "$remote_addr - - [$time_local] \"$request\" $status $body_bytes_sent"
+
+#define HTTPP_LOG_COMBINED \
+    HTTPP_LOG_COMMON " \"$http_referer\" \"$http_user_agent\""
+
+typedef struct {
+    unsigned char  op;
+    unsigned short off; // Literal or header name in `text`
+    unsigned short len;
+} httpp_log_op_t;
+
+typedef struct {
+    char           text[HTTPP_LOG_FORMAT_MAX];
+    httpp_log_op_t ops[HTTPP_LOG_MAX_OPS];
+    size_t         ops_len;
+    int            escape;
+} httpp_log_format_t;
+
+// What a line is made of besides the request
+typedef struct {
+    httpp_req_t* req;
+    httpp_span_t remote_addr;
+    int          status;
+    size_t       bytes_sent;
+    uint64_t     duration_us;
+    time_t       time;
+} httpp_log_entry_t;
+
+typedef struct {
+    char*  data;
+    size_t cap;
+    size_t len;
+    int    fd;
+    size_t flushes;
+    time_t time;              // Second of the cached times, -1 if none
+    char   time_local[26];    // "10/Oct/2000:13:55:36 +0000"
+    char   time_iso8601[25];  // "2000-10-10T13:55:36+00:00"
+} httpp_log_t;
+
+/*
+ * Compiles `fmt` into `dest`, values are escaped with `escape`.
+ *   On unknown variable or when the format doesn't fit `dest` returns false.
+ */
+bool httpp_log_format_init(httpp_log_format_t* dest, const char* fmt, int escape);
+
+// Prepares `log` to collect lines in `buf` of `cap` bytes and write them to `fd`
+void httpp_log_init(httpp_log_t* log, char* buf, size_t cap, int fd);
+
+/*
+ * Appends a line for `e` to `log`, writing the collected lines out first when it
+ * doesn't fit.
+ *   On write error returns false, the line is cut to the space left in the buffer.
+ */
+bool httpp_log_write(httpp_log_t* log, const httpp_log_format_t* fmt, const httpp_log_entry_t* e);
+
+/*
+ * Writes collected lines to the file descriptor.
+ *   On failure returns false, lines which were not written are kept.
+ */
+bool httpp_log_flush(httpp_log_t* log);
+
+#ifdef HTTPP_IMPLEMENTATION
+
+enum {
+    __LOG_LITERAL,
+    __LOG_REMOTE_ADDR,
+    __LOG_TIME_LOCAL,
+    __LOG_TIME_ISO8601,
+    __LOG_REQUEST,
+    __LOG_METHOD,
+    __LOG_URI,
+    __LOG_PROTOCOL,
+    __LOG_STATUS,
+    __LOG_BYTES_SENT,
+    __LOG_REQUEST_TIME,
+    __LOG_HEADER,
+};
+
+static const struct {
+    const char* name;
+    size_t      len;
+    int         op;
+} __log_vars[] = {
+    {"remote_addr", 11, __LOG_REMOTE_ADDR},
+    {"time_local", 10, __LOG_TIME_LOCAL},
+    {"time_iso8601", 12, __LOG_TIME_ISO8601},
+    {"request", 7, __LOG_REQUEST},
+    {"request_method", 14, __LOG_METHOD},
+    {"request_uri", 11, __LOG_URI},
+    {"server_protocol", 15, __LOG_PROTOCOL},
+    {"status", 6, __LOG_STATUS},
+    {"body_bytes_sent", 15, __LOG_BYTES_SENT},
+    {"request_time", 12, __LOG_REQUEST_TIME},
+};
+
+static const char __log_digits[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const char __log_hex[] = "0123456789ABCDEF";
+
+static bool __log_add_op(httpp_log_format_t* dest, size_t* text_len, int op, const char* s, size_t len)
+{
+    if (dest->ops_len == HTTPP_LOG_MAX_OPS || *text_len + len > HTTPP_LOG_FORMAT_MAX)
+        return false;
+
+    httpp_log_op_t* o = &dest->ops[dest->ops_len++];
+
+    o->op = (unsigned char) op;
+    o->off = (unsigned short) *text_len;
+    o->len = (unsigned short) len;
+
+    for (size_t i = 0; i < len; i++)
+        dest->text[*text_len + i] = op == __LOG_HEADER && s[i] == '_' ? '-' : s[i];
+
+    *text_len += len;
+    return true;
+}
+
+static inline bool __log_name_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+bool httpp_log_format_init(httpp_log_format_t* dest, const char* fmt, int escape)
+{
+    if (dest == NULL || fmt == NULL)
+        return false;
+
+    size_t text_len = 0;
+    const char* itr = fmt;
+    const char* literal = fmt;
+
+    dest->ops_len = 0;
+    dest->escape = escape;
+
+    while (*itr) {
+        if (*itr != '$') {
+            itr++;
+            continue;
+        }
+
+        bool braced = itr[1] == '{';
+        const char* name = itr + 1 + braced;
+        const char* end = name;
+
+        while (__log_name_char(*end))
+            end++;
+
+        if (end == name || (braced && *end != '}')) {
+            itr++; // Just a '$'
+            continue;
+        }
+
+        if (itr > literal && !__log_add_op(dest, &text_len, __LOG_LITERAL, literal, itr - literal))
+            return false;
+
+        size_t len = end - name;
+        bool   found = false;
+
+        if (len > 5 && memcmp(name, "http_", 5) == 0) {
+            if (!__log_add_op(dest, &text_len, __LOG_HEADER, name + 5, len - 5))
+                return false;
+            found = true;
+        }
+
+        for (size_t i = 0; !found && i < sizeof(__log_vars) / sizeof(__log_vars[0]); i++) {
+            if (__log_vars[i].len == len && memcmp(__log_vars[i].name, name, len) == 0) {
+                if (!__log_add_op(dest, &text_len, __log_vars[i].op, NULL, 0))
+                    return false;
+                found = true;
+            }
+        }
+
+        if (!found)
+            return false;
+
+        itr = end + braced;
+        literal = itr;
+    }
+
+    return itr == literal || __log_add_op(dest, &text_len, __LOG_LITERAL, literal, itr - literal);
+}
+
+void httpp_log_init(httpp_log_t* log, char* buf, size_t cap, int fd)
+{
+    log->data = buf;
+    log->cap = cap;
+    log->len = 0;
+    log->fd = fd;
+    log->flushes = 0;
+    log->time = (time_t) -1;
+}
+
+// Output of one line, stops at `end` and remembers that it did
+typedef struct {
+    char* p;
+    char* end;
+    bool  full;
+} __log_out_t;
+
+static inline void __log_put(__log_out_t* w, const char* s, size_t len)
+{
+    size_t room = w->end - w->p;
+
+    if (len > room) {
+        len = room;
+        w->full = true;
+    }
+
+    memcpy(w->p, s, len);
+    w->p += len;
+}
+
+static inline void __log_uint(__log_out_t* w, uint64_t v)
+{
+    char  tmp[20];
+    char* p = tmp + sizeof(tmp);
+
+    // Two digits at a time
+    while (v >= 100) {
+        unsigned r = (unsigned) (v % 100);
+        v /= 100;
+        p -= 2;
+        memcpy(p, __log_digits + 2 * r, 2);
+    }
+
+    if (v >= 10) {
+        p -= 2;
+        memcpy(p, __log_digits + 2 * v, 2);
+    }
+    else
+        *--p = (char) ('0' + v);
+
+    __log_put(w, p, tmp + sizeof(tmp) - p);
+}
+
+// Length of the prefix of `s` which can be written as is
+static inline size_t __log_clean_run(const char* s, size_t n, int escape)
+{
+    size_t i = 0;
+
+#ifdef HTTPP_SSE2
+    const __m128i ctl = _mm_set1_epi8(0x1F);
+    const __m128i del = _mm_set1_epi8(0x7F);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (s + i));
+        __m128i bad = _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, ctl), ctl),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+
+        if (escape == HTTPP_LOG_ESCAPE_DEFAULT)
+            bad = _mm_or_si128(bad, _mm_cmpeq_epi8(_mm_max_epu8(v, del), v));
+
+        int mask = _mm_movemask_epi8(bad);
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+
+    for (; i < n; i++) {
+        unsigned char c = (unsigned char) s[i];
+
+        if (c < 0x20 || c == '"' || c == '\\' || (escape == HTTPP_LOG_ESCAPE_DEFAULT && c >= 0x7F))
+            return i;
+    }
+
+    return n;
+}
+
+static void __log_escaped(__log_out_t* w, const char* s, size_t n, int escape)
+{
+    size_t i = 0;
+
+    while (i < n) {
+        size_t run = __log_clean_run(s + i, n - i, escape);
+
+        __log_put(w, s + i, run);
+        i += run;
+
+        if (i == n)
+            break;
+
+        unsigned char c = (unsigned char) s[i++];
+        char   seq[6] = {'\\', 0, 0, 0, 0, 0};
+        size_t len = 2;
+
+        if (escape == HTTPP_LOG_ESCAPE_JSON) {
+            switch (c) {
+                case '"':  seq[1] = '"';  break;
+                case '\\': seq[1] = '\\'; break;
+                case '\n': seq[1] = 'n';  break;
+                case '\r': seq[1] = 'r';  break;
+                case '\t': seq[1] = 't';  break;
+                case '\b': seq[1] = 'b';  break;
+                case '\f': seq[1] = 'f';  break;
+                default:
+                    memcpy(seq + 1, "u00", 3);
+                    seq[4] = __log_hex[c >> 4];
+                    seq[5] = __log_hex[c & 15];
+                    len = 6;
+            }
+        }
+        else {
+            seq[1] = 'x';
+            seq[2] = __log_hex[c >> 4];
+            seq[3] = __log_hex[c & 15];
+            len = 4;
+        }
+
+        __log_put(w, seq, len);
+    }
+}
+
+// A value which may be missing: "-" in the default escaping, nothing in JSON
+static inline void __log_value(__log_out_t* w, const char* s, size_t n, int escape)
+{
+    if (s == NULL || n == 0) {
+        if (escape == HTTPP_LOG_ESCAPE_DEFAULT)
+            __log_put(w, "-", 1);
+        return;
+    }
+
+    __log_escaped(w, s, n, escape);
+}
+
+static void __log_update_time(httpp_log_t* log, time_t t)
+{
+    __date_civil_t c;
+    char* l = log->time_local;
+    char* iso = log->time_iso8601;
+
+    __date_civil(t, &c);
+
+    // "10/Oct/2000:13:55:36 +0000"
+    __date_2digits(l, c.day);
+    l[2] = '/';
+    memcpy(l + 3, __date_months[c.month - 1], 3);
+    l[6] = '/';
+    __date_2digits(l + 7, (unsigned) (c.year / 100 % 100));
+    __date_2digits(l + 9, (unsigned) (c.year % 100));
+    l[11] = ':';
+    __date_2digits(l + 12, c.hour);
+    l[14] = ':';
+    __date_2digits(l + 15, c.min);
+    l[17] = ':';
+    __date_2digits(l + 18, c.sec);
+    memcpy(l + 20, " +0000", 6);
+
+    // "2000-10-10T13:55:36+00:00"
+    memcpy(iso, l + 7, 4);
+    iso[4] = '-';
+    __date_2digits(iso + 5, c.month);
+    iso[7] = '-';
+    memcpy(iso + 8, l, 2);
+    iso[10] = 'T';
+    memcpy(iso + 11, l + 12, 8);
+    memcpy(iso + 19, "+00:00", 6);
+
+    log->time = t;
+}
+
+static void __log_header(__log_out_t* w, httpp_req_t* req, const char* name, size_t len, int escape)
+{
+    httpp_req_split_headers(req);
+
+    for (size_t i = 0; i < req->headers.length; i++) {
+        httpp_header_t* h = &req->headers.arr[i];
+
+        if (h->name.length == len && strncasecmp(h->name.ptr, name, len) == 0) {
+            __log_value(w, h->value.ptr, h->value.length, escape);
+            return;
+        }
+    }
+
+    __log_value(w, NULL, 0, escape);
+}
+
+// Formats the line at `w`, the caller adds '\n'
+static void __log_line(__log_out_t* w, httpp_log_t* log, const httpp_log_format_t* fmt,
+                       const httpp_log_entry_t* e)
+{
+    httpp_req_t* req = e->req;
+    int escape = fmt->escape;
+    const char* method = httpp_method_to_string(req->method);
+
+    for (size_t i = 0; i < fmt->ops_len; i++) {
+        const httpp_log_op_t* o = &fmt->ops[i];
+
+        switch (o->op) {
+            case __LOG_LITERAL:
+                __log_put(w, fmt->text + o->off, o->len);
+                break;
+
+            case __LOG_REMOTE_ADDR:
+                __log_value(w, e->remote_addr.ptr, e->remote_addr.length, escape);
+                break;
+
+            case __LOG_TIME_LOCAL:
+            case __LOG_TIME_ISO8601:
+                if (log->time != e->time)
+                    __log_update_time(log, e->time);
+
+                if (o->op == __LOG_TIME_LOCAL)
+                    __log_put(w, log->time_local, sizeof(log->time_local));
+                else
+                    __log_put(w, log->time_iso8601, sizeof(log->time_iso8601));
+                break;
+
+            case __LOG_REQUEST:
+                __log_put(w, method, strlen(method));
+                __log_put(w, " ", 1);
+                __log_value(w, req->route.ptr, req->route.length, escape);
+                __log_put(w, " ", 1);
+                __log_value(w, req->version.ptr, req->version.length, escape);
+                break;
+
+            case __LOG_METHOD:
+                __log_put(w, method, strlen(method));
+                break;
+
+            case __LOG_URI:
+                __log_value(w, req->route.ptr, req->route.length, escape);
+                break;
+
+            case __LOG_PROTOCOL:
+                __log_value(w, req->version.ptr, req->version.length, escape);
+                break;
+
+            case __LOG_STATUS:
+                __log_uint(w, (uint64_t) (e->status > 0 ? e->status : 0));
+                break;
+
+            case __LOG_BYTES_SENT:
+                __log_uint(w, e->bytes_sent);
+                break;
+
+            case __LOG_REQUEST_TIME: {
+                // Seconds with milliseconds, "0.042"
+                unsigned ms = (unsigned) (e->duration_us / 1000 % 1000);
+                char frac[4] = {'.', (char) ('0' + ms / 100), __log_digits[2 * (ms % 100)],
+                                __log_digits[2 * (ms % 100) + 1]};
+
+                __log_uint(w, e->duration_us / 1000000);
+                __log_put(w, frac, 4);
+                break;
+            }
+
+            case __LOG_HEADER:
+                __log_header(w, req, fmt->text + o->off, o->len, escape);
+                break;
+        }
+    }
+}
+
+bool httpp_log_flush(httpp_log_t* log)
+{
+    size_t off = 0;
+
+    while (off < log->len) {
+        ssize_t n = write(log->fd, log->data + off, log->len - off);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n <= 0) {
+            memmove(log->data, log->data + off, log->len - off);
+            log->len -= off;
+            return false;
+        }
+
+        off += n;
+    }
+
+    log->len = 0;
+    log->flushes++;
+    return true;
+}
+
+bool httpp_log_write(httpp_log_t* log, const httpp_log_format_t* fmt, const httpp_log_entry_t* e)
+{
+    if (log == NULL || fmt == NULL || e == NULL || e->req == NULL || log->cap == 0)
+        return false;
+
+    // Not even room for '\n'
+    if (log->len == log->cap && !httpp_log_flush(log))
+        return false;
+
+    bool ok = true;
+
+    for (int attempt = 0;; attempt++) {
+        // One byte is kept for '\n'
+        __log_out_t w = {log->data + log->len, log->data + log->cap - 1, false};
+
+        __log_line(&w, log, fmt, e);
+
+        // Doesn't fit after other lines, write them out and format it again. When
+        // that fails the line is cut to what's left
+        if (w.full && log->len > 0 && attempt == 0) {
+            ok = httpp_log_flush(log);
+            continue;
+        }
+
+        *w.p++ = '\n';
+        log->len = w.p - log->data;
+        return ok;
+    }
+}
+
+#endif // HTTPP_IMPLEMENTATION
+#endif // HTTPP_POSIX
+#endif // _HTTPP_LOG_HEADER
@@ -0,0 +1,419 @@
+#ifndef _HTTPP_MULTIPART_HEADER
+#define _HTTPP_MULTIPART_HEADER
+
+/*
+ * Streaming multipart/form-data (RFC 7578, RFC 2046) parser for httpp.
+ *
+ * The parser is resumable: feed it the body in as many pieces as it arrives
+ * (e.g from httpp_body_stream_t callbacks) or all at once. For every part it calls
+ *
+ *      on_part_begin(ctx, headers)  - part headers, parsed with httpp_parse_header
+ *      on_part_data(ctx, data, len) - part content, zero or more times
+ *      on_part_end(ctx)
+ *
+ * Content is never copied: `data` points into the buffer passed to
+ * httpp_multipart_feed, so when the whole body is fed at once every part usually
+ * arrives as a single span. Only a piece of a delimiter split between two feeds
+ * and the part headers are kept inside httpp_multipart_t, nothing is allocated.
+ * Header spans are only valid during on_part_begin.
+ *
+ * Delimiters are searched with the same SIMD assisted substring search httpp
+ * uses elsewhere.
+ *
+ *      httpp_span_t boundary;
+ *      httpp_multipart_t mp;
+ *
+ *      httpp_multipart_boundary(&content_type->value, &boundary);
+ *      httpp_multipart_init(&mp, &boundary, &callbacks, ctx);
+ *      httpp_multipart_feed(&mp, req.body.ptr, req.body.length);
+ */
+
+#include "httpp.h"
+
+#define HTTPP_MULTIPART_MAX_BOUNDARY 70 // RFC 2046
+#define HTTPP_MULTIPART_MAX_HEAD 1024   // Max size of headers of a single part
+#define HTTPP_MULTIPART_MAX_HEADERS 8
+
+typedef struct {
+    // Each returns 0 to continue, anything else aborts parsing
+    int (*on_part_begin)(void* ctx, httpp_headers_arr_t* headers);
+    int (*on_part_data)(void* ctx, const char* data, size_t len);
+    int (*on_part_end)(void* ctx);
+} httpp_multipart_callbacks_t;
+
+typedef struct {
+    char   delim[HTTPP_MULTIPART_MAX_BOUNDARY + 4]; // "\r\n--" boundary
+    size_t delim_len;
+    char   carry[HTTPP_MULTIPART_MAX_BOUNDARY + 4]; // Delimiter prefix at the end of the previous feed
+    size_t carry_len;
+    char   head[HTTPP_MULTIPART_MAX_HEAD];
+    size_t head_len;
+    httpp_header_t headers_arr[HTTPP_MULTIPART_MAX_HEADERS];
+    httpp_headers_arr_t headers;
+    int    state;
+    bool   in_part;
+    const httpp_multipart_callbacks_t* cb;
+    void*  ctx;
+} httpp_multipart_t;
+
+/*
+ * Extracts boundary parameter from Content-Type header value, quotes are removed
+ *   If it's not multipart or there is no valid boundary returns false.
+ */
+bool httpp_multipart_boundary(httpp_span_t* content_type, httpp_span_t* out);
+
+/*
+ * Prepares `mp` for a body delimited by `boundary`.
+ *   If boundary is empty or too long returns false.
+ */
+bool httpp_multipart_init(httpp_multipart_t* mp, httpp_span_t* boundary,
+                          const httpp_multipart_callbacks_t* cb, void* ctx);
+
+/*
+ * Parses next `n` bytes of the body.
+ *   On malformed body or when a callback aborts returns -1.
+ *
+ * On sucess returns 0
+ */
+int httpp_multipart_feed(httpp_multipart_t* mp, const char* data, size_t n);
+
+// Whether the closing delimiter was seen
+bool httpp_multipart_done(httpp_multipart_t* mp);
+
+/*
+ * Reads name and filename parameters of a part's Content-Disposition header.
+ * `filename` may be NULL. Missing parameters are set to an empty span.
+ *   If there is no Content-Disposition returns false.
+ */
+bool httpp_multipart_disposition(httpp_headers_arr_t* headers, httpp_span_t* name, httpp_span_t* filename);
+
+#ifdef HTTPP_IMPLEMENTATION
+
+#define __MP_DATA        0
+#define __MP_AFTER_DELIM 1
+#define __MP_DASH        2
+#define __MP_CR          3
+#define __MP_HEADERS     4
+#define __MP_END         5
+#define __MP_ERROR       6
+
+#define __MP_ISWS(c) ((c) == ' ' || (c) == '\t')
+
+/*
+ * Finds parameter `param` (e.g "boundary") in a "; a=b; c="d"" list. Pairs are read
+ * left to right, so a ';' or "name=" inside a quoted value is never taken for a
+ * parameter. Quoted values are returned without quotes, backslash escapes are kept.
+ */
+static bool __mp_param(const char* itr, const char* end, const char* param, httpp_span_t* out)
+{
+    size_t param_len = strlen(param);
+
+    // The type (or disposition) itself comes first
+    itr = (const char*) memchr(itr, ';', end - itr);
+
+    while (itr && itr < end) {
+        itr++;
+        while (itr < end && __MP_ISWS(*itr))
+            itr++;
+
+        const char* key = itr;
+        while (itr < end && *itr != '=' && *itr != ';')
+            itr++;
+
+        if (itr == end || *itr == ';')
+            continue; // Parameter without value
+
+        size_t key_len = itr - key;
+        const char* v = ++itr;
+        const char* v_end;
+
+        if (itr < end && *itr == '"') {
+            v = ++itr;
+            while (itr < end && *itr != '"')
+                itr += *itr == '\\' ? 2 : 1;
+
+            if (itr >= end)
+                return false; // Unterminated quoted string
+
+            v_end = itr++;
+        }
+        else {
+            while (itr < end && *itr != ';')
+                itr++;
+
+            v_end = itr;
+            while (v_end > v && __MP_ISWS(v_end[-1]))
+                v_end--;
+        }
+
+        if (key_len == param_len && strncasecmp(key, param, param_len) == 0) {
+            if (v_end == v && v == end)
+                return false; // "boundary=" with nothing after it
+
+            *out = (httpp_span_t){(char*) v, (size_t) (v_end - v), false};
+            return true;
+        }
+
+        itr = (const char*) memchr(itr, ';', end - itr);
+    }
+
+    return false;
+}
+
+bool httpp_multipart_boundary(httpp_span_t* content_type, httpp_span_t* out)
+{
+    if (!content_type || !content_type->ptr)
+        return false;
+
+    const char* itr = content_type->ptr;
+    const char* end = itr + content_type->length;
+
+    if (content_type->length < 10 || strncasecmp(itr, "multipart/", 10) != 0)
+        return false;
+
+    if (!__mp_param(itr, end, "boundary", out))
+        return false;
+
+    return out->length > 0 && out->length <= HTTPP_MULTIPART_MAX_BOUNDARY;
+}
+
+bool httpp_multipart_disposition(httpp_headers_arr_t* headers, httpp_span_t* name, httpp_span_t* filename)
+{
+    httpp_header_t* h = httpp_headers_arr_find(headers, "Content-Disposition");
+    if (!h)
+        return false;
+
+    const char* itr = h->value.ptr;
+    const char* end = itr + h->value.length;
+
+    if (!__mp_param(itr, end, "name", name))
+        *name = (httpp_span_t){(char*) end, 0, false};
+
+    if (filename && !__mp_param(itr, end, "filename", filename))
+        *filename = (httpp_span_t){(char*) end, 0, false};
+
+    return true;
+}
+
+bool httpp_multipart_init(httpp_multipart_t* mp, httpp_span_t* boundary,
+                          const httpp_multipart_callbacks_t* cb, void* ctx)
+{
+    if (!boundary || boundary->length == 0 || boundary->length > HTTPP_MULTIPART_MAX_BOUNDARY)
+        return false;
+
+    memcpy(mp->delim, "\r\n--", 4);
+    memcpy(mp->delim + 4, boundary->ptr, boundary->length);
+    mp->delim_len = boundary->length + 4;
+
+    // The body starts with "--boundary", pretend the "\r\n" before it was already seen
+    memcpy(mp->carry, "\r\n", 2);
+    mp->carry_len = 2;
+
+    mp->head_len = 0;
+    mp->headers.arr = mp->headers_arr;
+    mp->headers.capacity = HTTPP_MULTIPART_MAX_HEADERS;
+    mp->headers.length = 0;
+    mp->state = __MP_DATA;
+    mp->in_part = false;
+    mp->cb = cb;
+    mp->ctx = ctx;
+    return true;
+}
+
+bool httpp_multipart_done(httpp_multipart_t* mp)
+{
+    return mp->state == __MP_END;
+}
+
+static inline int __mp_emit(httpp_multipart_t* mp, const char* data, size_t len)
+{
+    // Outside of a part it's the preamble, which is ignored
+    if (!mp->in_part || len == 0 || !mp->cb->on_part_data)
+        return 0;
+
+    return mp->cb->on_part_data(mp->ctx, data, len);
+}
+
+static inline int __mp_delimiter(httpp_multipart_t* mp)
+{
+    mp->state = __MP_AFTER_DELIM;
+
+    if (!mp->in_part)
+        return 0;
+
+    mp->in_part = false;
+    return mp->cb->on_part_end ? mp->cb->on_part_end(mp->ctx) : 0;
+}
+
+// Parses accumulated part headers, `len` excludes the final empty line
+static int __mp_headers(httpp_multipart_t* mp, size_t len)
+{
+    char* itr = mp->head;
+    char* end = mp->head + len;
+
+    mp->headers.length = 0;
+
+    while (itr < end) {
+        char* eol = (char*) __memfind(itr, end - itr, HTTPP_DELIMITER, HTTPP_DELIMITER_LEN);
+        size_t line_len = (eol ? eol : end) - itr;
+
+        if (line_len > 0 && httpp_parse_header(&mp->headers, itr, line_len) == NULL)
+            return -1;
+
+        itr += line_len + HTTPP_DELIMITER_LEN;
+    }
+
+    mp->in_part = true;
+    return mp->cb->on_part_begin ? mp->cb->on_part_begin(mp->ctx, &mp->headers) : 0;
+}
+
+// Handles __MP_DATA, returns number of consumed bytes or -1
+static ptrdiff_t __mp_data(httpp_multipart_t* mp, const char* data, size_t n)
+{
+    if (mp->carry_len) {
+        size_t need = mp->delim_len - mp->carry_len;
+        size_t cmp = n < need ? n : need;
+
+        if (memcmp(data, mp->delim + mp->carry_len, cmp) == 0) {
+            if (cmp < need) {
+                memcpy(mp->carry + mp->carry_len, data, cmp);
+                mp->carry_len += cmp;
+                return cmp;
+            }
+
+            mp->carry_len = 0;
+            return __mp_delimiter(mp) ? -1 : (ptrdiff_t) cmp;
+        }
+
+        // Boundaries can't contain '\r', so no suffix of carry can start a delimiter either
+        size_t carry_len = mp->carry_len;
+        mp->carry_len = 0;
+
+        return __mp_emit(mp, mp->carry, carry_len) ? -1 : 0;
+    }
+
+    const char* hit = __memfind(data, n, mp->delim, mp->delim_len);
+
+    if (hit) {
+        if (__mp_emit(mp, data, hit - data))
+            return -1;
+
+        return __mp_delimiter(mp) ? -1 : (hit - data) + (ptrdiff_t) mp->delim_len;
+    }
+
+    // Keep the longest tail which might be the beginning of a delimiter
+    size_t tail = n < mp->delim_len - 1 ? n : mp->delim_len - 1;
+    const char* keep = data + n;
+    const char* cr = data + n - tail;
+
+    while ((cr = (const char*) memchr(cr, '\r', data + n - cr)) != NULL) {
+        if (memcmp(cr, mp->delim, data + n - cr) == 0) {
+            keep = cr;
+            break;
+        }
+        cr++;
+    }
+
+    if (__mp_emit(mp, data, keep - data))
+        return -1;
+
+    mp->carry_len = data + n - keep;
+    memcpy(mp->carry, keep, mp->carry_len);
+    return n;
+}
+
+// Handles __MP_HEADERS, returns number of consumed bytes or -1
+static ptrdiff_t __mp_head(httpp_multipart_t* mp, const char* data, size_t n)
+{
+    size_t old_len = mp->head_len;
+    size_t space = HTTPP_MULTIPART_MAX_HEAD - old_len;
+    size_t copy = n < space ? n : space;
+
+    memcpy(mp->head + old_len, data, copy);
+    mp->head_len += copy;
+
+    // No headers at all, the part starts with an empty line
+    if (mp->head_len >= 2 && memcmp(mp->head, HTTPP_DELIMITER, 2) == 0) {
+        mp->head_len = 0;
+        mp->state = __MP_DATA;
+        return __mp_headers(mp, 0) ? -1 : (ptrdiff_t) (2 - old_len);
+    }
+
+    size_t from = old_len > 3 ? old_len - 3 : 0;
+    const char* eoh = __memfind(mp->head + from, mp->head_len - from, "\r\n\r\n", 4);
+
+    if (!eoh) {
+        if (mp->head_len == HTTPP_MULTIPART_MAX_HEAD)
+            return -1;
+        return copy;
+    }
+
+    size_t head_len = eoh - mp->head;
+    mp->state = __MP_DATA;
+    mp->head_len = 0;
+
+    if (__mp_headers(mp, head_len + HTTPP_DELIMITER_LEN))
+        return -1;
+
+    return head_len + 4 - old_len;
+}
+
+int httpp_multipart_feed(httpp_multipart_t* mp, const char* data, size_t n)
+{
+    size_t pos = 0;
+
+    while (pos < n) {
+        ptrdiff_t used = 1;
+        char c = data[pos];
+
+        switch (mp->state) {
+            case __MP_DATA:
+                used = __mp_data(mp, data + pos, n - pos);
+                break;
+
+            case __MP_AFTER_DELIM:
+                if (c == '-')
+                    mp->state = __MP_DASH;
+                else if (c == '\r')
+                    mp->state = __MP_CR;
+                else if (!__MP_ISWS(c)) // Transport padding
+                    used = -1;
+                break;
+
+            case __MP_DASH:
+                if (c != '-')
+                    used = -1;
+                mp->state = __MP_END;
+                break;
+
+            case __MP_CR:
+                if (c != '\n')
+                    used = -1;
+                mp->state = __MP_HEADERS;
+                mp->head_len = 0;
+                break;
+
+            case __MP_HEADERS:
+                used = __mp_head(mp, data + pos, n - pos);
+                break;
+
+            case __MP_END:
+                return 0; // Epilogue is ignored
+
+            default:
+                return -1;
+        }
+
+        if (used < 0) {
+            mp->state = __MP_ERROR;
+            return -1;
+        }
+
+        pos += used;
+    }
+
+    return 0;
+}
+
+#endif // HTTPP_IMPLEMENTATION
+#endif // _HTTPP_MULTIPART_HEADER
@@ -0,0 +1,438 @@
+#ifndef _HTTPP_PROXY_HEADER
+#define _HTTPP_PROXY_HEADER
+
+/*
+ * PROXY protocol (HAProxy, text v1 and binary v2) preamble for httpp.
+ *
+ * A load balancer sends the preamble once, at the beginning of the connection,
+ * before the first request. httpp_parse_proxy_request parses and validates it
+ * and parses the request right after it, in the same buffer: nothing is shifted
+ * or copied. Following requests on the connection go to httpp_parse_request as
+ * usual.
+ *
+ *      httpp_proxy_t proxy;
+ *      HTTPP_NEW_REQ(req, 32);
+ *
+ *      int off = httpp_parse_proxy_request(buf, n, &proxy, &req);
+ *      if (off == HTTPP_PROXY_INCOMPLETE)
+ *          ... // Read more
+ *
+ * Addresses are spans into the buffer: text for v1 ("192.0.2.1"), bytes in network
+ * order for v2 (4, 16 or 108 for AF_UNIX). Ports are in host order. TLVs of v2 are
+ * validated, CRC32C included when present, and can be iterated with
+ * httpp_proxy_tlv_next.
+ *
+ * A connection without a preamble is an error. Where the load balancer is
+ * required, accepting one would let clients reach the server directly with any
+ * address they like.
+ */
+
+#include "httpp.h"
+
+#define HTTPP_PROXY_ERROR      -1
+#define HTTPP_PROXY_INCOMPLETE -2 // More bytes are needed to tell
+
+#define HTTPP_PROXY_V1_MAX     107 // Longest v1 line, "\r\n" included
+#define HTTPP_PROXY_V2_HEADER  16  // Signature, version and command, family, length
+
+#define HTTPP_PROXY_UNSPEC 0
+#define HTTPP_PROXY_INET   1
+#define HTTPP_PROXY_INET6  2
+#define HTTPP_PROXY_UNIX   3
+
+#define HTTPP_PROXY_STREAM 1
+#define HTTPP_PROXY_DGRAM  2
+
+#define HTTPP_PROXY_TLV_ALPN      0x01
+#define HTTPP_PROXY_TLV_AUTHORITY 0x02
+#define HTTPP_PROXY_TLV_CRC32C    0x03
+#define HTTPP_PROXY_TLV_NOOP      0x04
+#define HTTPP_PROXY_TLV_UNIQUE_ID 0x05
+#define HTTPP_PROXY_TLV_SSL       0x20
+#define HTTPP_PROXY_TLV_NETNS     0x30
+
+typedef struct {
+    int  version;        // 1 or 2
+    bool local;          // Connection of the proxy itself (v2 LOCAL, v1 UNKNOWN), addresses aren't set
+    int  family;         // HTTPP_PROXY_UNSPEC, HTTPP_PROXY_INET, HTTPP_PROXY_INET6, HTTPP_PROXY_UNIX
+    int  transport;      // HTTPP_PROXY_STREAM or HTTPP_PROXY_DGRAM, 0 if unspecified
+    httpp_span_t src;
+    httpp_span_t dst;
+    unsigned short src_port;
+    unsigned short dst_port;
+    httpp_span_t tlvs;   // v2 TLVs, empty for v1
+} httpp_proxy_t;
+
+typedef struct {
+    unsigned char type;
+    httpp_span_t  value;
+} httpp_proxy_tlv_t;
+
+typedef struct {
+    char* itr;
+    char* end;
+} httpp_proxy_tlv_iter_t;
+
+/*
+ * Parses the PROXY preamble at the beginning of `buf` into `dest`.
+ *   On malformed or missing preamble returns HTTPP_PROXY_ERROR.
+ *   When `buf` ends before the preamble does returns HTTPP_PROXY_INCOMPLETE.
+ *
+ * On sucess returns the preamble length, the first request starts there.
+ */
+int httpp_parse_proxy(char* buf, size_t n, httpp_proxy_t* dest);
+
+/*
+ * Parses the PROXY preamble into `proxy` and the request following it into `dest`.
+ *   On failure returns HTTPP_PROXY_ERROR, HTTPP_PROXY_INCOMPLETE the same as httpp_parse_proxy
+ *   and also when nothing follows the preamble yet.
+ *
+ * On sucess returns offset from the beginning of `buf` to the beginning of the dest->body.
+ */
+int httpp_parse_proxy_request(char* buf, size_t n, httpp_proxy_t* proxy, httpp_req_t* dest);
+
+// Prepares `it` to iterate over TLVs of `proxy`
+void httpp_proxy_tlv_iter_init(httpp_proxy_tlv_iter_t* it, httpp_proxy_t* proxy);
+
+/*
+ * Stores the next TLV into `out`, SSL sub-TLVs are not visited.
+ *   When there are no more TLVs returns false.
+ */
+bool httpp_proxy_tlv_next(httpp_proxy_tlv_iter_t* it, httpp_proxy_tlv_t* out);
+
+/*
+ * Searches TLVs of `proxy` for the first one of `type`.
+ *   On failure returns false.
+ */
+bool httpp_proxy_find_tlv(httpp_proxy_t* proxy, unsigned char type, httpp_proxy_tlv_t* out);
+
+#ifdef HTTPP_IMPLEMENTATION
+
+static const char __proxy_v2_sig[12] = {'\r', '\n', '\r', '\n', '\0', '\r', '\n', 'Q', 'U', 'I', 'T', '\n'};
+
+// Reflected Castagnoli polynomial, 4 bits at a time
+static const uint32_t __proxy_crc32c_nibble[16] = {
+    0x00000000, 0x105ec76f, 0x20bd8ede, 0x30e349b1, 0x417b1dbc, 0x5125dad3, 0x61c69362, 0x7198540d,
+    0x82f63b78, 0x92a8fc17, 0xa24bb5a6, 0xb21572c9, 0xc38d26c4, 0xd3d3e1ab, 0xe330a81a, 0xf36e6f75,
+};
+
+// `skip` is where the checksum itself is, its bytes are taken as zeros
+static uint32_t __proxy_crc32c(const unsigned char* p, size_t n, const unsigned char* skip)
+{
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (size_t i = 0; i < n; i++) {
+        unsigned char b = (p + i >= skip && p + i < skip + 4) ? 0 : p[i];
+
+        crc ^= b;
+        crc = (crc >> 4) ^ __proxy_crc32c_nibble[crc & 15];
+        crc = (crc >> 4) ^ __proxy_crc32c_nibble[crc & 15];
+    }
+
+    return ~crc;
+}
+
+static inline unsigned __proxy_u16(const unsigned char* p)
+{
+    return (unsigned) p[0] << 8 | p[1];
+}
+
+// Decimal port without leading zeros. On failure returns false
+static bool __proxy_v1_port(const char* p, size_t len, unsigned short* out)
+{
+    unsigned v = 0;
+
+    if (len == 0 || len > 5 || (len > 1 && p[0] == '0'))
+        return false;
+
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] < '0' || p[i] > '9')
+            return false;
+        v = v * 10 + (p[i] - '0');
+    }
+
+    if (v > 65535)
+        return false;
+
+    *out = (unsigned short) v;
+    return true;
+}
+
+// Dotted quad, or the characters an IPv6 address can have. On failure returns false
+static bool __proxy_v1_addr(const char* p, size_t len, int family)
+{
+    if (family == HTTPP_PROXY_INET) {
+        const char* end = p + len;
+
+        for (int part = 0; part < 4; part++) {
+            const char* start = p;
+
+            while (p < end && p - start < 3 && *p >= '0' && *p <= '9')
+                p++;
+
+            // Three digits are at most 255, the same as comparing them as text
+            if (p == start || (p - start == 3 && memcmp(start, "255", 3) > 0))
+                return false;
+
+            if (part < 3 && (p == end || *p++ != '.'))
+                return false;
+        }
+
+        return p == end;
+    }
+
+    if (len < 2 || len > 45)
+        return false;
+
+    for (size_t i = 0; i < len; i++) {
+        char c = p[i] | 0x20;
+
+        if (!((p[i] >= '0' && p[i] <= '9') || (c >= 'a' && c <= 'f') || p[i] == ':' || p[i] == '.'))
+            return false;
+    }
+
+    return true;
+}
+
+static int __proxy_v1(char* buf, size_t n, httpp_proxy_t* dest)
+{
+    size_t max = n < HTTPP_PROXY_V1_MAX ? n : HTTPP_PROXY_V1_MAX;
+    char*  lf = (char*) memchr(buf, '\n', max);
+
+    if (!lf)
+        return n < HTTPP_PROXY_V1_MAX ? HTTPP_PROXY_INCOMPLETE : HTTPP_PROXY_ERROR;
+
+    if (lf[-1] != '\r')
+        return HTTPP_PROXY_ERROR;
+
+    char* end = lf - 1;
+    char* itr = buf + 6; // "PROXY "
+    char* fields[5];
+    size_t lens[5];
+    int count = 0;
+
+    dest->version = 1;
+    dest->transport = HTTPP_PROXY_STREAM;
+
+    // "UNKNOWN" may be followed by anything, it's ignored
+    if ((size_t) (end - itr) >= 7 && memcmp(itr, "UNKNOWN", 7) == 0 && (end - itr == 7 || itr[7] == ' ')) {
+        dest->local = true;
+        dest->family = HTTPP_PROXY_UNSPEC;
+        dest->transport = 0;
+        return lf + 1 - buf;
+    }
+
+    if ((size_t) (end - itr) < 5 || memcmp(itr, "TCP", 3) != 0 || (itr[3] != '4' && itr[3] != '6') || itr[4] != ' ')
+        return HTTPP_PROXY_ERROR;
+
+    dest->family = itr[3] == '4' ? HTTPP_PROXY_INET : HTTPP_PROXY_INET6;
+    itr += 5;
+
+    // Exactly four fields separated by single spaces
+    while (count < 5) {
+        char* sp = (char*) memchr(itr, ' ', end - itr);
+        char* stop = sp ? sp : end;
+
+        fields[count] = itr;
+        lens[count++] = stop - itr;
+
+        if (!sp)
+            break;
+        itr = sp + 1;
+    }
+
+    if (count != 4 || !__proxy_v1_addr(fields[0], lens[0], dest->family)
+        || !__proxy_v1_addr(fields[1], lens[1], dest->family)
+        || !__proxy_v1_port(fields[2], lens[2], &dest->src_port)
+        || !__proxy_v1_port(fields[3], lens[3], &dest->dst_port))
+        return HTTPP_PROXY_ERROR;
+
+    dest->local = false;
+    dest->src = (httpp_span_t){fields[0], lens[0], false};
+    dest->dst = (httpp_span_t){fields[1], lens[1], false};
+    return lf + 1 - buf;
+}
+
+// Checks that `p` is a sequence of whole TLVs, and what's inside of those which have a known format
+static bool __proxy_v2_tlvs(const unsigned char* p, size_t n, const unsigned char* header, size_t header_len,
+                            bool nested)
+{
+    while (n > 0) {
+        if (n < 3)
+            return false;
+
+        unsigned char type = p[0];
+        size_t len = __proxy_u16(p + 1);
+        const unsigned char* value = p + 3;
+
+        if (len > n - 3)
+            return false;
+
+        if (!nested) {
+            switch (type) {
+                case HTTPP_PROXY_TLV_CRC32C:
+                    if (len != 4)
+                        return false;
+                    if (__proxy_crc32c(header, header_len, value)
+                        != ((uint32_t) __proxy_u16(value) << 16 | __proxy_u16(value + 2)))
+                        return false;
+                    break;
+
+                case HTTPP_PROXY_TLV_UNIQUE_ID:
+                    if (len > 128)
+                        return false;
+                    break;
+
+                case HTTPP_PROXY_TLV_SSL:
+                    // Client flags and verify result, then sub-TLVs
+                    if (len < 5 || !__proxy_v2_tlvs(value + 5, len - 5, header, header_len, true))
+                        return false;
+                    break;
+            }
+        }
+
+        p += 3 + len;
+        n -= 3 + len;
+    }
+
+    return true;
+}
+
+static int __proxy_v2(char* buf, size_t n, httpp_proxy_t* dest)
+{
+    const unsigned char* p = (const unsigned char*) buf;
+
+    if (n < HTTPP_PROXY_V2_HEADER)
+        return HTTPP_PROXY_INCOMPLETE;
+
+    size_t len = __proxy_u16(p + 14);
+    size_t total = HTTPP_PROXY_V2_HEADER + len;
+    int    command = p[12] & 0x0F;
+    size_t addr_len;
+
+    if ((p[12] >> 4) != 2 || command > 1)
+        return HTTPP_PROXY_ERROR;
+
+    dest->version = 2;
+    dest->local = command == 0;
+    dest->family = p[13] >> 4;
+    dest->transport = p[13] & 0x0F;
+
+    switch (dest->family) {
+        case HTTPP_PROXY_UNSPEC: addr_len = 0;   break;
+        case HTTPP_PROXY_INET:   addr_len = 12;  break;
+        case HTTPP_PROXY_INET6:  addr_len = 36;  break;
+        case HTTPP_PROXY_UNIX:   addr_len = 216; break;
+        default: return HTTPP_PROXY_ERROR;
+    }
+
+    if (dest->transport > HTTPP_PROXY_DGRAM)
+        return HTTPP_PROXY_ERROR;
+
+    if (n < total)
+        return HTTPP_PROXY_INCOMPLETE;
+
+    // LOCAL may come with any address block, it isn't looked at
+    if (dest->local)
+        addr_len = addr_len <= len ? addr_len : len;
+    else if (len < addr_len)
+        return HTTPP_PROXY_ERROR;
+
+    const unsigned char* tlvs = p + HTTPP_PROXY_V2_HEADER + addr_len;
+
+    if (!__proxy_v2_tlvs(tlvs, len - addr_len, p, total, false))
+        return HTTPP_PROXY_ERROR;
+
+    dest->tlvs = (httpp_span_t){(char*) tlvs, len - addr_len, false};
+
+    if (!dest->local && dest->family != HTTPP_PROXY_UNSPEC) {
+        char*  addr = buf + HTTPP_PROXY_V2_HEADER;
+        size_t size = dest->family == HTTPP_PROXY_INET ? 4 : dest->family == HTTPP_PROXY_INET6 ? 16 : 108;
+
+        dest->src = (httpp_span_t){addr, size, false};
+        dest->dst = (httpp_span_t){addr + size, size, false};
+
+        if (dest->family != HTTPP_PROXY_UNIX) {
+            dest->src_port = (unsigned short) __proxy_u16(p + HTTPP_PROXY_V2_HEADER + 2 * size);
+            dest->dst_port = (unsigned short) __proxy_u16(p + HTTPP_PROXY_V2_HEADER + 2 * size + 2);
+        }
+    }
+
+    return (int) total;
+}
+
+int httpp_parse_proxy(char* buf, size_t n, httpp_proxy_t* dest)
+{
+    if (buf == NULL || dest == NULL)
+        return HTTPP_PROXY_ERROR;
+
+    httpp_span_init(&dest->src);
+    httpp_span_init(&dest->dst);
+    httpp_span_init(&dest->tlvs);
+    dest->src_port = 0;
+    dest->dst_port = 0;
+
+    // A prefix of either signature can't be told apart from a preamble yet
+    if (n >= 6 && memcmp(buf, "PROXY ", 6) == 0)
+        return __proxy_v1(buf, n, dest);
+
+    if (n >= sizeof(__proxy_v2_sig) && memcmp(buf, __proxy_v2_sig, sizeof(__proxy_v2_sig)) == 0)
+        return __proxy_v2(buf, n, dest);
+
+    if ((n < 6 && memcmp(buf, "PROXY ", n) == 0)
+        || (n < sizeof(__proxy_v2_sig) && memcmp(buf, __proxy_v2_sig, n) == 0))
+        return HTTPP_PROXY_INCOMPLETE;
+
+    return HTTPP_PROXY_ERROR;
+}
+
+int httpp_parse_proxy_request(char* buf, size_t n, httpp_proxy_t* proxy, httpp_req_t* dest)
+{
+    int off = httpp_parse_proxy(buf, n, proxy);
+
+    if (off < 0)
+        return off;
+
+    if ((size_t) off == n)
+        return HTTPP_PROXY_INCOMPLETE;
+
+    int body = httpp_parse_request(buf + off, n - off, dest);
+
+    return body < 0 ? HTTPP_PROXY_ERROR : off + body;
+}
+
+void httpp_proxy_tlv_iter_init(httpp_proxy_tlv_iter_t* it, httpp_proxy_t* proxy)
+{
+    it->itr = proxy->tlvs.ptr;
+    it->end = proxy->tlvs.ptr + proxy->tlvs.length;
+}
+
+bool httpp_proxy_tlv_next(httpp_proxy_tlv_iter_t* it, httpp_proxy_tlv_t* out)
+{
+    // Validated by httpp_parse_proxy, every TLV is whole
+    if (it->itr == NULL || it->end - it->itr < 3)
+        return false;
+
+    size_t len = __proxy_u16((const unsigned char*) it->itr + 1);
+
+    out->type = (unsigned char) it->itr[0];
+    out->value = (httpp_span_t){it->itr + 3, len, false};
+    it->itr += 3 + len;
+    return true;
+}
+
+bool httpp_proxy_find_tlv(httpp_proxy_t* proxy, unsigned char type, httpp_proxy_tlv_t* out)
+{
+    httpp_proxy_tlv_iter_t it;
+
+    httpp_proxy_tlv_iter_init(&it, proxy);
+    while (httpp_proxy_tlv_next(&it, out)) {
+        if (out->type == type)
+            return true;
+    }
+
+    return false;
+}
+
+#endif // HTTPP_IMPLEMENTATION
+#endif // _HTTPP_PROXY_HEADER
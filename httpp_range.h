@@ -0,0 +1,546 @@
+#ifndef _HTTPP_RANGE_HEADER
+#define _HTTPP_RANGE_HEADER
+
+/*
+ * Conditional requests (RFC 9110, 13) and Range requests (RFC 9110, 14) for httpp.
+ *
+ * Given what the server knows about the resource (ETag, modification time, length),
+ * httpp_evaluate_conditional looks at If-Match, If-Unmodified-Since, If-None-Match,
+ * If-Modified-Since, If-Range and Range of the request, in the order RFC 9110
+ * requires, and decides what to respond with:
+ *
+ *   200 - send the whole resource
+ *   206 - send `ranges` only (one range: Content-Range, more: multipart/byteranges)
+ *   304 - Not Modified, no body
+ *   412 - Precondition Failed
+ *   416 - Range Not Satisfiable, send "Content-Range: bytes * / length" (no spaces)
+ *
+ * Nothing is allocated and the request is not modified.
+ *
+ *      httpp_resource_t resource = {"\"v1\"", st.st_mtime, st.st_size};
+ *      httpp_cond_result_t result;
+ *
+ *      switch (httpp_evaluate_conditional(&req, &resource, &result)) { ... }
+ */
+
+#include <time.h>
+#include "httpp.h"
+
+// Requests with more ranges than this are served as a whole (200)
+#define HTTPP_MAX_RANGES 16
+
+typedef struct {
+    size_t start;
+    size_t length;
+} httpp_range_t;
+
+typedef struct {
+    const char* etag;  // Entity tag with quotes, e.g "\"abc\"" or "W/\"abc\"". NULL if there is none
+    time_t      mtime; // Last modification time, -1 if unknown
+    size_t      length;
+} httpp_resource_t;
+
+typedef struct {
+    int status;
+    httpp_range_t ranges[HTTPP_MAX_RANGES];
+    size_t ranges_len;
+} httpp_cond_result_t;
+
+/*
+ * Evaluates conditional and range headers of `req` against `resource`.
+ * Stores the decision into `out` and returns out->status
+ */
+int httpp_evaluate_conditional(httpp_req_t* req, httpp_resource_t* resource, httpp_cond_result_t* out);
+
+/*
+ * Parses "bytes=0-99,200-,-50" for a resource of `length` bytes into `out`.
+ * Unsatisfiable ranges are dropped.
+ *   On invalid syntax or too many ranges returns -1.
+ *
+ * On sucess returns the number of satisfiable ranges, 0 means 416
+ */
+int httpp_parse_range(httpp_span_t* value, size_t length, httpp_range_t* out, size_t out_cap);
+
+/*
+ * Parses HTTP-date in any of the three formats recipients must accept
+ * (IMF-fixdate, RFC 850, asctime).
+ *   On failure returns -1.
+ */
+time_t httpp_parse_http_date(const char* str, size_t len);
+
+/*
+ * Writes Content-Range value ("bytes 0-99/1234") for `range` into `out`.
+ * Pass NULL `range` for the 416 form ("bytes * / 1234", without spaces).
+ * Returns the written length, or -1 if `out` is too small
+ */
+int httpp_content_range(httpp_range_t* range, size_t length, char* out, size_t out_len);
+
+#ifdef HTTPP_POSIX
+/*
+ * Builds multipart/byteranges body for `result` as iovecs. Part headers are written
+ * into `scratch`, part contents point into `body`. If `body` is NULL, content iovecs
+ * have NULL iov_base and the caller sends ranges[i] from the file itself.
+ * The response Content-Type should be "multipart/byteranges; boundary=<boundary>".
+ * Total body length is stored into `content_length`.
+ *   If `scratch` or `iov` is too small returns -1.
+ *
+ * On sucess returns number of used iovecs (2 * ranges + 1)
+ */
+int httpp_range_multipart_iov(httpp_cond_result_t* result, size_t length, const char* content_type,
+                              const char* boundary, const char* body, char* scratch, size_t scratch_len,
+                              struct iovec* iov, size_t iov_cap, size_t* content_length);
+#endif
+
+#ifdef HTTPP_IMPLEMENTATION
+
+#define __RANGE_ISWS(c) ((c) == ' ' || (c) == '\t')
+
+static const char __range_months[12][4] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+static int __range_digits(const char* s, size_t n)
+{
+    int v = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9')
+            return -1;
+        v = v * 10 + (s[i] - '0');
+    }
+
+    return v;
+}
+
+static int __range_month(const char* s)
+{
+    for (int i = 0; i < 12; i++) {
+        if (memcmp(s, __range_months[i], 3) == 0)
+            return i + 1;
+    }
+
+    return -1;
+}
+
+// "08:49:37" into seconds since midnight
+static long __range_time(const char* s)
+{
+    if (s[2] != ':' || s[5] != ':')
+        return -1;
+
+    int h = __range_digits(s, 2);
+    int m = __range_digits(s + 3, 2);
+    int sec = __range_digits(s + 6, 2);
+
+    if (h < 0 || h > 23 || m < 0 || m > 59 || sec < 0 || sec > 60)
+        return -1;
+
+    return h * 3600L + m * 60L + sec;
+}
+
+static time_t __range_mktime(int year, int month, int day, long secs)
+{
+    if (year < 1970 || month < 1 || day < 1 || day > 31 || secs < 0)
+        return -1;
+
+    // Days from civil, http://howardhinnant.github.io/date_algorithms.html
+    long long y = year - (month <= 2);
+    long long era = y / 400;
+    unsigned yoe = (unsigned) (y - era * 400);
+    unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    long long days = era * 146097 + (long long) doe - 719468;
+
+    return (time_t) (days * 86400 + secs);
+}
+
+time_t httpp_parse_http_date(const char* s, size_t n)
+{
+    int day, month, year;
+    long secs;
+
+    if (n == 29 && s[3] == ',') {
+        // Sun, 06 Nov 1994 08:49:37 GMT
+        if (s[4] != ' ' || s[7] != ' ' || s[11] != ' ' || s[16] != ' ' || memcmp(s + 25, " GMT", 4) != 0)
+            return -1;
+
+        day = __range_digits(s + 5, 2);
+        month = __range_month(s + 8);
+        year = __range_digits(s + 12, 4);
+        secs = __range_time(s + 17);
+    }
+    else if (n == 24 && s[3] == ' ') {
+        // Sun Nov  6 08:49:37 1994
+        if (s[7] != ' ' || s[10] != ' ' || s[19] != ' ')
+            return -1;
+
+        month = __range_month(s + 4);
+        day = s[8] == ' ' ? __range_digits(s + 9, 1) : __range_digits(s + 8, 2);
+        secs = __range_time(s + 11);
+        year = __range_digits(s + 20, 4);
+    }
+    else {
+        // Sunday, 06-Nov-94 08:49:37 GMT
+        const char* comma = (const char*) memchr(s, ',', n);
+        if (!comma || (size_t) (s + n - comma) != 24)
+            return -1;
+
+        const char* d = comma + 2;
+        if (comma[1] != ' ' || d[2] != '-' || d[6] != '-' || d[9] != ' ' || memcmp(d + 18, " GMT", 4) != 0)
+            return -1;
+
+        day = __range_digits(d, 2);
+        month = __range_month(d + 3);
+        year = __range_digits(d + 7, 2);
+        secs = __range_time(d + 10);
+
+        if (year >= 0)
+            year += year >= 70 ? 1900 : 2000;
+    }
+
+    if (day < 0 || month < 0 || year < 0 || secs < 0)
+        return -1;
+
+    return __range_mktime(year, month, day, secs);
+}
+
+static bool __range_parse_size(const char* s, const char* end, size_t* out)
+{
+    if (s == end)
+        return false;
+
+    size_t v = 0;
+    for (; s < end; s++) {
+        if (*s < '0' || *s > '9')
+            return false;
+
+        if (v > ((size_t) -1 - 9) / 10)
+            return false; // Overflow
+
+        v = v * 10 + (*s - '0');
+    }
+
+    *out = v;
+    return true;
+}
+
+int httpp_parse_range(httpp_span_t* value, size_t length, httpp_range_t* out, size_t out_cap)
+{
+    const char* itr = value->ptr;
+    const char* end = value->ptr + value->length;
+
+    if (value->length < 6 || strncasecmp(itr, "bytes=", 6) != 0)
+        return -1;
+
+    itr += 6;
+
+    size_t count = 0;
+    size_t specs = 0;
+
+    while (itr < end) {
+        const char* comma = (const char*) memchr(itr, ',', end - itr);
+        const char* stop = comma ? comma : end;
+        const char* s = itr;
+        const char* e = stop;
+
+        itr = comma ? comma + 1 : end;
+
+        while (s < e && __RANGE_ISWS(*s)) s++;
+        while (e > s && __RANGE_ISWS(e[-1])) e--;
+
+        if (s == e)
+            continue;
+
+        if (++specs > out_cap)
+            return -1;
+
+        const char* dash = (const char*) memchr(s, '-', e - s);
+        if (!dash)
+            return -1;
+
+        size_t first, last;
+
+        if (dash == s) {
+            // Suffix, last N bytes
+            if (!__range_parse_size(dash + 1, e, &last))
+                return -1;
+
+            if (last == 0 || length == 0)
+                continue;
+
+            first = last >= length ? 0 : length - last;
+            last = length - 1;
+        }
+        else {
+            if (!__range_parse_size(s, dash, &first))
+                return -1;
+
+            if (dash + 1 == e)
+                last = first > length - 1 ? first : length - 1;
+            else if (!__range_parse_size(dash + 1, e, &last))
+                return -1;
+
+            if (last < first)
+                return -1;
+
+            if (first >= length)
+                continue; // Unsatisfiable
+
+            if (last >= length)
+                last = length - 1;
+        }
+
+        out[count].start = first;
+        out[count].length = last - first + 1;
+        count++;
+    }
+
+    return specs == 0 ? -1 : (int) count;
+}
+
+/*
+ * Checks whether `etag` matches any entity tag in the list `value` ("*" or "a", W/"b")
+ * With `weak` W/ prefixes are ignored, otherwise weak tags never match. "*" matches
+ * any current representation, even one without an entity tag.
+ */
+static bool __range_etag_match(httpp_span_t* value, const char* etag, bool weak)
+{
+    size_t etag_len = etag ? strlen(etag) : 0;
+    bool etag_weak = etag_len > 2 && etag[0] == 'W' && etag[1] == '/';
+
+    if (etag_weak) {
+        etag += 2;
+        etag_len -= 2;
+    }
+
+    // Nothing but "*" can match
+    bool tags_match = etag && (weak || !etag_weak);
+
+    const char* itr = value->ptr;
+    const char* end = value->ptr + value->length;
+
+    while (itr < end) {
+        const char* comma = (const char*) memchr(itr, ',', end - itr);
+        const char* s = itr;
+        const char* e = comma ? comma : end;
+
+        itr = comma ? comma + 1 : end;
+
+        while (s < e && __RANGE_ISWS(*s)) s++;
+        while (e > s && __RANGE_ISWS(e[-1])) e--;
+
+        if (e - s == 1 && *s == '*')
+            return true;
+
+        if (!tags_match)
+            continue;
+
+        if (e - s > 2 && s[0] == 'W' && s[1] == '/') {
+            if (!weak)
+                continue;
+            s += 2;
+        }
+
+        if ((size_t) (e - s) == etag_len && memcmp(s, etag, etag_len) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+static inline time_t __range_header_date(httpp_header_t* h)
+{
+    return httpp_parse_http_date(h->value.ptr, h->value.length);
+}
+
+int httpp_evaluate_conditional(httpp_req_t* req, httpp_resource_t* resource, httpp_cond_result_t* out)
+{
+    bool get_or_head = req->method == HTTPP_METHOD_GET || req->method == HTTPP_METHOD_HEAD;
+    httpp_header_t* h;
+
+    out->ranges_len = 0;
+
+    // 1. If-Match, 2. If-Unmodified-Since
+    if ((h = httpp_req_find_header(req, "If-Match")) != NULL) {
+        if (!__range_etag_match(&h->value, resource->etag, false))
+            return out->status = 412;
+    }
+    else if ((h = httpp_req_find_header(req, "If-Unmodified-Since")) != NULL) {
+        time_t since = __range_header_date(h);
+
+        if (since != -1 && resource->mtime != -1 && resource->mtime > since)
+            return out->status = 412;
+    }
+
+    // 3. If-None-Match, 4. If-Modified-Since
+    if ((h = httpp_req_find_header(req, "If-None-Match")) != NULL) {
+        if (__range_etag_match(&h->value, resource->etag, true))
+            return out->status = get_or_head ? 304 : 412;
+    }
+    else if (get_or_head && (h = httpp_req_find_header(req, "If-Modified-Since")) != NULL) {
+        time_t since = __range_header_date(h);
+
+        if (since != -1 && resource->mtime != -1 && resource->mtime <= since)
+            return out->status = 304;
+    }
+
+    out->status = 200;
+
+    // 5. Range, only for GET
+    if (req->method != HTTPP_METHOD_GET)
+        return out->status;
+
+    httpp_header_t* range = httpp_req_find_header(req, "Range");
+    if (!range)
+        return out->status;
+
+    if ((h = httpp_req_find_header(req, "If-Range")) != NULL) {
+        bool fresh;
+
+        if (h->value.length > 0 && (h->value.ptr[0] == '"' || h->value.ptr[0] == 'W'))
+            fresh = __range_etag_match(&h->value, resource->etag, false);
+        else
+            fresh = resource->mtime != -1 && __range_header_date(h) == resource->mtime;
+
+        if (!fresh)
+            return out->status;
+    }
+
+    int n = httpp_parse_range(&range->value, resource->length, out->ranges, HTTPP_MAX_RANGES);
+
+    if (n == -1)
+        return out->status; // Invalid or too many ranges are ignored
+
+    if (n == 0)
+        return out->status = 416;
+
+    out->ranges_len = n;
+    return out->status = 206;
+}
+
+// Writes decimal `v` to `out`, returns written length
+static size_t __range_utoa(size_t v, char* out)
+{
+    char   tmp[20];
+    size_t n = 0;
+
+    do {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+
+    for (size_t i = 0; i < n; i++)
+        out[i] = tmp[n - 1 - i];
+
+    return n;
+}
+
+int httpp_content_range(httpp_range_t* range, size_t length, char* out, size_t out_len)
+{
+    char   buf[80];
+    size_t n = 6;
+
+    memcpy(buf, "bytes ", 6);
+
+    if (range) {
+        n += __range_utoa(range->start, buf + n);
+        buf[n++] = '-';
+        n += __range_utoa(range->start + range->length - 1, buf + n);
+    }
+    else {
+        buf[n++] = '*';
+    }
+
+    buf[n++] = '/';
+    n += __range_utoa(length, buf + n);
+
+    if (n + 1 > out_len)
+        return -1;
+
+    memcpy(out, buf, n);
+    out[n] = '\0';
+    return (int) n;
+}
+
+#ifdef HTTPP_POSIX
+int httpp_range_multipart_iov(httpp_cond_result_t* result, size_t length, const char* content_type,
+                              const char* boundary, const char* body, char* scratch, size_t scratch_len,
+                              struct iovec* iov, size_t iov_cap, size_t* content_length)
+{
+    size_t boundary_len = strlen(boundary);
+    size_t type_len = content_type ? strlen(content_type) : 0;
+    size_t used = 0;
+    size_t niov = 0;
+    size_t total = 0;
+
+    if (iov_cap < result->ranges_len * 2 + 1)
+        return -1;
+
+    for (size_t i = 0; i < result->ranges_len; i++) {
+        httpp_range_t* r = &result->ranges[i];
+        char cr[80];
+        int cr_len = httpp_content_range(r, length, cr, sizeof(cr));
+
+        // [CRLF] "--" boundary CRLF [Content-Type: t CRLF] "Content-Range: " cr CRLF CRLF
+        size_t need = (i ? 2 : 0) + 2 + boundary_len + 2
+                    + (type_len ? 14 + type_len + 2 : 0)
+                    + 15 + cr_len + 4;
+
+        if (used + need > scratch_len)
+            return -1;
+
+        char* p = scratch + used;
+        char* start = p;
+
+        if (i) {
+            memcpy(p, "\r\n", 2);
+            p += 2;
+        }
+
+        memcpy(p, "--", 2);                  p += 2;
+        memcpy(p, boundary, boundary_len);   p += boundary_len;
+        memcpy(p, "\r\n", 2);                p += 2;
+
+        if (type_len) {
+            memcpy(p, "Content-Type: ", 14); p += 14;
+            memcpy(p, content_type, type_len); p += type_len;
+            memcpy(p, "\r\n", 2);            p += 2;
+        }
+
+        memcpy(p, "Content-Range: ", 15);    p += 15;
+        memcpy(p, cr, cr_len);               p += cr_len;
+        memcpy(p, "\r\n\r\n", 4);            p += 4;
+
+        iov[niov].iov_base = start;
+        iov[niov].iov_len = p - start;
+        niov++;
+
+        iov[niov].iov_base = body ? (void*) (body + r->start) : NULL;
+        iov[niov].iov_len = r->length;
+        niov++;
+
+        used += p - start;
+        total += (p - start) + r->length;
+    }
+
+    // CRLF "--" boundary "--" CRLF
+    size_t need = 2 + 2 + boundary_len + 2 + 2;
+    if (used + need > scratch_len)
+        return -1;
+
+    char* p = scratch + used;
+    memcpy(p, "\r\n--", 4);
+    memcpy(p + 4, boundary, boundary_len);
+    memcpy(p + 4 + boundary_len, "--\r\n", 4);
+
+    iov[niov].iov_base = p;
+    iov[niov].iov_len = need;
+    niov++;
+
+    *content_length = total + need;
+    return (int) niov;
+}
+#endif // HTTPP_POSIX
+
+#endif // HTTPP_IMPLEMENTATION
+#endif // _HTTPP_RANGE_HEADER
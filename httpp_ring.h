@@ -0,0 +1,337 @@
+#ifndef _HTTPP_RING_HEADER
+#define _HTTPP_RING_HEADER
+
+/*
+ * Receive buffer for keep-alive connections, POSIX only (HTTPP_POSIX).
+ *
+ * The buffer is a "magic" ring: the same memory is mapped twice, back to back, so
+ * data which wraps around the end of the ring is still contiguous in memory. The
+ * parser always sees one flat buffer and pipelined leftovers never have to be moved
+ * to the front.
+ *
+ *      httpp_ring_t ring;
+ *      httpp_ring_init(&ring, 16 * 1024, 1024 * 1024);
+ *
+ *      httpp_ring_recv(&ring, sock);
+ *      while ((n = httpp_ring_parse(&ring, &req)) > 0) {
+ *          ...                              // Spans of req point into the ring
+ *          httpp_ring_consume(&ring, n);    // Now they don't
+ *      }
+ *
+ * httpp_ring_parse frames a whole request: start line, headers and the Content-Length
+ * body. Requests with Transfer-Encoding are returned without body, its bytes stay
+ * in the ring for the caller.
+ *
+ * Between parse and consume the spans are live and the ring is never remapped. When
+ * a header block doesn't fit, httpp_ring_recv doubles the ring (up to `max_size`),
+ * which copies the data to a new mapping, but only when no spans are live.
+ *
+ * ftruncate and shm_open are POSIX.1-2001, with -std=c11 they are only declared when
+ * _POSIX_C_SOURCE 200809L (or _DEFAULT_SOURCE) is defined before the first #include.
+ * memfd_create and anonymous reservations are used when the default feature set
+ * is on (-std=gnu11 or _DEFAULT_SOURCE), shm_open and a file mapping otherwise.
+ */
+
+#include "httpp.h"
+
+#ifdef HTTPP_POSIX
+#include <sys/mman.h>
+#include <limits.h>
+
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif
+
+#if defined(__STRICT_ANSI__) && !defined(_POSIX_C_SOURCE) && !defined(_XOPEN_SOURCE)
+# error "httpp_ring.h: define _POSIX_C_SOURCE 200809L (or _DEFAULT_SOURCE) before the first #include"
+#endif
+
+// syscall and MAP_ANONYMOUS come with the same feature set, one tells about the other
+#if defined(MAP_ANONYMOUS) && defined(__linux__) && defined(SYS_memfd_create)
+# define __RING_MEMFD
+#endif
+
+typedef struct {
+    char*  base;
+    size_t cap;     // Size of one mapping, multiple of the page size
+    size_t max;
+    size_t head;    // Offset of the first unconsumed byte, always < cap
+    size_t tail;    // head + number of unconsumed bytes
+    size_t scanned; // Bytes after head already searched for the end of headers
+    bool   live;    // Spans returned by httpp_ring_parse are in use
+} httpp_ring_t;
+
+/*
+ * Maps a ring of at least `size` bytes, which may grow up to `max_size`. Both are
+ * capped at INT_MAX, the length of a parsed request has to fit the return value.
+ *   On failure returns false.
+ */
+bool httpp_ring_init(httpp_ring_t* ring, size_t size, size_t max_size);
+
+void httpp_ring_free(httpp_ring_t* ring);
+
+// Unconsumed bytes, contiguous even if they wrap around
+#define httpp_ring_data(ring) ((ring)->base + (ring)->head)
+#define httpp_ring_len(ring)  ((ring)->tail - (ring)->head)
+
+// Returns pointer to the free space and stores its size into `avail`
+char* httpp_ring_space(httpp_ring_t* ring, size_t* avail);
+
+// Marks `n` bytes written into httpp_ring_space as data
+void httpp_ring_produce(httpp_ring_t* ring, size_t n);
+
+/*
+ * Moves data to a ring twice as big. Not possible while spans are live.
+ *   On failure returns false.
+ */
+bool httpp_ring_grow(httpp_ring_t* ring);
+
+/*
+ * Reads from `fd` into the free space, growing a full ring if possible.
+ *   Returns the same as read(2). A full ring which can't grow fails with ENOBUFS.
+ */
+ssize_t httpp_ring_recv(httpp_ring_t* ring, int fd);
+
+/*
+ * Parses the request at the front of the ring into `dest`.
+ *   On malformed request returns -1, also when its framing is ambiguous: Content-Length
+ *   repeated with different values, or together with Transfer-Encoding (RFC 9112, 6.3).
+ *   When the request is not complete yet returns 0.
+ *
+ * On sucess returns length of the request, spans of `dest` stay valid until
+ * httpp_ring_consume.
+ */
+int httpp_ring_parse(httpp_ring_t* ring, httpp_req_t* dest);
+
+// Drops `n` bytes from the front of the ring, spans returned by httpp_ring_parse are dead after it
+void httpp_ring_consume(httpp_ring_t* ring, size_t n);
+
+#ifdef HTTPP_IMPLEMENTATION
+
+// Shared memory object which is only reachable through `fd`
+static int __ring_memfd(void)
+{
+#ifdef __RING_MEMFD
+    return (int) syscall(SYS_memfd_create, "httpp_ring", 1 /* MFD_CLOEXEC */);
+#else
+    static unsigned counter = 0;
+    char name[64];
+
+    snprintf(name, sizeof(name), "/httpp-ring-%ld-%u", (long) getpid(), counter++);
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0)
+        shm_unlink(name);
+
+    return fd;
+#endif
+}
+
+// Maps `cap` bytes twice in a row. On failure returns NULL
+static char* __ring_map(size_t cap)
+{
+    int fd = __ring_memfd();
+    if (fd < 0)
+        return NULL;
+
+    char* base = NULL;
+
+    if (ftruncate(fd, (off_t) cap) != 0)
+        goto done;
+
+    // Reserve both halves first, so nothing else gets mapped in between
+#ifdef MAP_ANONYMOUS
+    base = (char*) mmap(NULL, cap * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#else
+    base = (char*) mmap(NULL, cap * 2, PROT_NONE, MAP_PRIVATE, fd, 0); // Never touched, past EOF is fine
+#endif
+    if (base == MAP_FAILED) {
+        base = NULL;
+        goto done;
+    }
+
+    if (mmap(base, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+        || mmap(base + cap, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, cap * 2);
+        base = NULL;
+    }
+
+done:
+    close(fd);
+    return base;
+}
+
+static size_t __ring_round(size_t size)
+{
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    return size < page ? page : (size + page - 1) / page * page;
+}
+
+bool httpp_ring_init(httpp_ring_t* ring, size_t size, size_t max_size)
+{
+    size_t cap = __ring_round(size < INT_MAX ? size : INT_MAX);
+    char*  base;
+
+    if (cap > INT_MAX || (base = __ring_map(cap)) == NULL)
+        return false;
+
+    ring->base = base;
+    ring->cap = cap;
+    ring->max = max_size < cap ? cap : max_size < INT_MAX ? max_size : INT_MAX;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->scanned = 0;
+    ring->live = false;
+    return true;
+}
+
+void httpp_ring_free(httpp_ring_t* ring)
+{
+    if (ring->base)
+        munmap(ring->base, ring->cap * 2);
+
+    ring->base = NULL;
+    ring->cap = 0;
+}
+
+char* httpp_ring_space(httpp_ring_t* ring, size_t* avail)
+{
+    *avail = ring->cap - (ring->tail - ring->head);
+    return ring->base + ring->tail;
+}
+
+void httpp_ring_produce(httpp_ring_t* ring, size_t n)
+{
+    ring->tail += n;
+}
+
+bool httpp_ring_grow(httpp_ring_t* ring)
+{
+    if (ring->live || ring->cap * 2 > ring->max)
+        return false;
+
+    size_t len = ring->tail - ring->head;
+    char*  base = __ring_map(ring->cap * 2);
+
+    if (!base)
+        return false;
+
+    memcpy(base, ring->base + ring->head, len);
+    munmap(ring->base, ring->cap * 2);
+
+    ring->base = base;
+    ring->cap *= 2;
+    ring->head = 0;
+    ring->tail = len;
+    return true;
+}
+
+ssize_t httpp_ring_recv(httpp_ring_t* ring, int fd)
+{
+    size_t avail;
+    char*  space = httpp_ring_space(ring, &avail);
+
+    if (avail == 0) {
+        if (!httpp_ring_grow(ring)) {
+            errno = ENOBUFS;
+            return -1;
+        }
+
+        space = httpp_ring_space(ring, &avail);
+    }
+
+    ssize_t r = read(fd, space, avail);
+
+    if (r > 0)
+        ring->tail += r;
+
+    return r;
+}
+
+int httpp_ring_parse(httpp_ring_t* ring, httpp_req_t* dest)
+{
+    char*  buf = httpp_ring_data(ring);
+    size_t len = httpp_ring_len(ring);
+
+    // Only the new bytes are searched, the end of headers may start 3 bytes back
+    size_t from = ring->scanned > 3 ? ring->scanned - 3 : 0;
+    const char* eoh = __memfind(buf + from, len - from, "\r\n\r\n", 4);
+
+    if (!eoh) {
+        ring->scanned = len;
+        return 0;
+    }
+
+    size_t head_len = eoh - buf + 4;
+    char*  end = buf + head_len - HTTPP_DELIMITER_LEN;
+    size_t content_len = 0;
+    bool   has_content_len = false;
+    bool   chunked = false;
+    int    off;
+
+    dest->headers.length = 0;
+
+    if ((off = httpp_parse_start_line(buf, head_len, dest)) == -1)
+        return -1;
+
+    // Same header loop as httpp_parse_request, framing is decided in the same pass
+    for (char* itr = buf + off; itr < end;) {
+        char* delim = (char*) __memfind(itr, end - itr + HTTPP_DELIMITER_LEN, HTTPP_DELIMITER, HTTPP_DELIMITER_LEN);
+        httpp_header_t* parsed = httpp_parse_header(&dest->headers, itr, delim - itr);
+
+        if (!parsed)
+            return -1;
+
+        __parse_known(dest, parsed);
+
+        if (httpp_span_case_eq(&parsed->name, "content-length")) {
+            size_t v;
+
+            // A later value must not replace an earlier one, peers could pick different ones
+            if (!httpp_parse_content_length(&parsed->value, &v) || (has_content_len && v != content_len))
+                return -1;
+
+            content_len = v;
+            has_content_len = true;
+        }
+        else if (httpp_span_case_eq(&parsed->name, "transfer-encoding"))
+            chunked = true;
+
+        itr = delim + HTTPP_DELIMITER_LEN;
+    }
+
+    // Chunked bodies are the caller's business, a Content-Length next to them is ambiguous
+    if (chunked && has_content_len)
+        return -1;
+
+    if (content_len > ring->max - head_len)
+        return -1; // Could never fit, also when head_len + content_len would wrap
+
+    if (content_len > len - head_len) {
+        ring->scanned = head_len - 1; // Next search starts right at the end of headers
+        return 0;
+    }
+
+    dest->body.ptr = buf + head_len;
+    dest->body.length = content_len;
+    ring->live = true;
+
+    return (int) (head_len + content_len);
+}
+
+void httpp_ring_consume(httpp_ring_t* ring, size_t n)
+{
+    ring->head += n;
+    ring->scanned = 0;
+    ring->live = false;
+
+    // Both offsets are moved back by a whole ring, the data itself stays where it is
+    if (ring->head >= ring->cap) {
+        ring->head -= ring->cap;
+        ring->tail -= ring->cap;
+    }
+}
+
+#endif // HTTPP_IMPLEMENTATION
+#endif // HTTPP_POSIX
+#endif // _HTTPP_RING_HEADER
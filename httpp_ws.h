@@ -0,0 +1,533 @@
+#ifndef _HTTPP_WS_HEADER
+#define _HTTPP_WS_HEADER
+
+/*
+ * WebSocket (RFC 6455) for connections upgraded from an httpp parsed request.
+ *
+ * The handshake answer is computed with a built-in SHA-1 and base64 and written into
+ * a caller buffer, nothing is allocated and no crypto library is needed:
+ *
+ *      char answer[HTTPP_WS_HANDSHAKE_LEN];
+ *      int len = httpp_ws_handshake(&req, answer); // -1 if it's not a valid upgrade
+ *      write(sock, answer, len);
+ *
+ * Frames are parsed by a resumable parser, fed in any number of pieces like
+ * httpp_multipart_t. Payload is unmasked in place (16 bytes at a time with SSE2) and
+ * handed over as spans of the fed buffer, never copied:
+ *
+ *      on_frame_begin(ctx, frame)             - header of a frame is complete
+ *      on_frame_data(ctx, frame, data, len)   - unmasked payload, zero or more times
+ *      on_frame_end(ctx, frame)               - frame->fin ends the message too
+ *
+ * Fragmented messages are checked (continuations only inside a message, control
+ * frames may come in between), frame->message tells which message a continuation
+ * belongs to. Frames are written with httpp_ws_frame_header, the payload goes out
+ * separately (e.g writev), so it isn't copied either.
+ */
+
+#include "httpp.h"
+
+#define HTTPP_WS_CONTINUATION 0x0
+#define HTTPP_WS_TEXT         0x1
+#define HTTPP_WS_BINARY       0x2
+#define HTTPP_WS_CLOSE        0x8
+#define HTTPP_WS_PING         0x9
+#define HTTPP_WS_PONG         0xA
+
+#define HTTPP_WS_ACCEPT_LEN    28  // base64 of a SHA-1
+#define HTTPP_WS_HANDSHAKE_LEN 129 // 101 response with Sec-WebSocket-Accept
+#define HTTPP_WS_MAX_HEADER    14  // Longest frame header
+
+typedef struct {
+    int      opcode;  // HTTPP_WS_CONTINUATION for later fragments of a message
+    int      message; // Opcode of the message the frame belongs to
+    bool     fin;
+    uint64_t length;
+} httpp_ws_frame_t;
+
+typedef struct {
+    // Each returns 0 to continue, anything else aborts parsing
+    int (*on_frame_begin)(void* ctx, const httpp_ws_frame_t* frame);
+    int (*on_frame_data)(void* ctx, const httpp_ws_frame_t* frame, char* data, size_t len);
+    int (*on_frame_end)(void* ctx, const httpp_ws_frame_t* frame);
+} httpp_ws_callbacks_t;
+
+typedef struct {
+    httpp_ws_frame_t frame;
+    unsigned char head[HTTPP_WS_MAX_HEADER];
+    size_t   head_len;
+    uint64_t left;        // Payload bytes of the frame not delivered yet
+    unsigned char mask[4];
+    size_t   mask_off;
+    bool     masked;
+    bool     server;      // Frames come from a client, they must be masked
+    int      message;     // Opcode of the unfinished fragmented message, 0 if none
+    uint64_t max_len;
+    int      state;
+    const httpp_ws_callbacks_t* cb;
+    void*    ctx;
+} httpp_ws_parser_t;
+
+/*
+ * Whether `req` is a valid WebSocket opening handshake: GET, HTTP/1.1 or newer,
+ * Connection: upgrade, Upgrade: websocket, Sec-WebSocket-Version: 13 and a key.
+ */
+bool httpp_ws_is_upgrade(httpp_req_t* req);
+
+/*
+ * Computes Sec-WebSocket-Accept for `key` into `out`, NUL terminated.
+ *   If the key is not 24 bytes long (base64 of 16 bytes) returns false.
+ */
+bool httpp_ws_accept(const char* key, size_t key_len, char out[HTTPP_WS_ACCEPT_LEN + 1]);
+
+/*
+ * Writes the 101 response accepting `req` into `out`.
+ *   If `req` is not a valid upgrade returns -1.
+ *
+ * On sucess returns length of the response, always HTTPP_WS_HANDSHAKE_LEN
+ */
+int httpp_ws_handshake(httpp_req_t* req, char out[HTTPP_WS_HANDSHAKE_LEN]);
+
+/*
+ * Prepares `p` for frames of one connection. `server` is true when the frames come
+ * from a client. Frames with payload longer than `max_len` are rejected.
+ */
+void httpp_ws_parser_init(httpp_ws_parser_t* p, bool server, uint64_t max_len,
+                          const httpp_ws_callbacks_t* cb, void* ctx);
+
+/*
+ * Parses next `n` bytes of the connection, payload is unmasked inside `data`.
+ *   On protocol error or when a callback aborts returns -1, the parser stays failed.
+ *
+ * On sucess returns 0
+ */
+int httpp_ws_feed(httpp_ws_parser_t* p, char* data, size_t n);
+
+// XORs `len` bytes with `mask`, `offset` is the position of data[0] in the payload
+void httpp_ws_mask(char* data, size_t len, const unsigned char mask[4], size_t offset);
+
+/*
+ * Writes a frame header into `out`. `mask` is NULL for server frames, clients
+ * must pass one and mask the payload with httpp_ws_mask.
+ *
+ * Returns length of the header
+ */
+size_t httpp_ws_frame_header(char out[HTTPP_WS_MAX_HEADER], int opcode, bool fin,
+                             uint64_t len, const unsigned char* mask);
+
+#ifdef HTTPP_IMPLEMENTATION
+
+#define __WS_HEAD    0
+#define __WS_PAYLOAD 1
+#define __WS_ERROR   2
+
+#define __WS_ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+// SHA-1 (RFC 3174), only used for the handshake, so kept small rather than fast
+static void __ws_sha1(const unsigned char* data, size_t len, unsigned char out[20])
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    unsigned char block[64];
+    size_t total = len;
+    size_t blocks = (len + 8) / 64 + 1;
+
+    for (size_t b = 0; b < blocks; b++) {
+        uint32_t w[80];
+
+        // Message, then 0x80, zeros and the bit length in the last 8 bytes
+        for (size_t i = 0; i < 64; i++) {
+            size_t pos = b * 64 + i;
+
+            if (pos < total)
+                block[i] = data[pos];
+            else if (pos == total)
+                block[i] = 0x80;
+            else if (b == blocks - 1 && i >= 56)
+                block[i] = (unsigned char) ((uint64_t) total * 8 >> (8 * (63 - i)));
+            else
+                block[i] = 0;
+        }
+
+        for (int i = 0; i < 16; i++)
+            w[i] = (uint32_t) block[i * 4] << 24 | (uint32_t) block[i * 4 + 1] << 16
+                 | (uint32_t) block[i * 4 + 2] << 8 | block[i * 4 + 3];
+
+        for (int i = 16; i < 80; i++)
+            w[i] = __WS_ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], bb = h[1], c = h[2], d = h[3], e = h[4];
+
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+
+            if (i < 20)      { f = (bb & c) | (~bb & d);           k = 0x5A827999; }
+            else if (i < 40) { f = bb ^ c ^ d;                     k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (bb & c) | (bb & d) | (c & d);  k = 0x8F1BBCDC; }
+            else             { f = bb ^ c ^ d;                     k = 0xCA62C1D6; }
+
+            uint32_t t = __WS_ROL(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = __WS_ROL(bb, 30);
+            bb = a;
+            a = t;
+        }
+
+        h[0] += a;
+        h[1] += bb;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    for (int i = 0; i < 20; i++)
+        out[i] = (unsigned char) (h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+// Standard base64 with padding, `out` gets 4 * ((len + 2) / 3) bytes
+static void __ws_base64(const unsigned char* data, size_t len, char* out)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t) data[i] << 16;
+
+        if (i + 1 < len) v |= (uint32_t) data[i + 1] << 8;
+        if (i + 2 < len) v |= data[i + 2];
+
+        *out++ = alphabet[v >> 18 & 63];
+        *out++ = alphabet[v >> 12 & 63];
+        *out++ = i + 1 < len ? alphabet[v >> 6 & 63] : '=';
+        *out++ = i + 2 < len ? alphabet[v & 63] : '=';
+    }
+}
+
+// Whether comma separated `value` has `token`, case insensitive
+static bool __ws_has_token(httpp_span_t* value, const char* token)
+{
+    size_t token_len = strlen(token);
+    char*  itr = value->ptr;
+    char*  end = value->ptr + value->length;
+
+    while (itr < end) {
+        char*  comma = (char*) memchr(itr, ',', end - itr);
+        char*  tok = itr;
+        size_t len = (comma ? comma : end) - itr;
+
+        itr = comma ? comma + 1 : end;
+
+        LTRIM(tok, len);
+        RTRIM(tok, len);
+
+        if (len == token_len && strncasecmp(tok, token, len) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+bool httpp_ws_is_upgrade(httpp_req_t* req)
+{
+    // Connection of a lazily parsed request sets `upgrade` only once split
+    if (!httpp_req_split_headers(req))
+        return false;
+
+    if (req->method != HTTPP_METHOD_GET || !req->upgrade)
+        return false;
+
+    if (req->version_major < 1 || (req->version_major == 1 && req->version_minor < 1))
+        return false;
+
+    httpp_header_t* upgrade = httpp_req_find_header(req, "upgrade");
+    httpp_header_t* version = httpp_req_find_header(req, "sec-websocket-version");
+    httpp_header_t* key = httpp_req_find_header(req, "sec-websocket-key");
+
+    return upgrade && __ws_has_token(&upgrade->value, "websocket")
+        && version && httpp_span_eq(&version->value, "13")
+        && key && key->value.length == 24;
+}
+
+bool httpp_ws_accept(const char* key, size_t key_len, char out[HTTPP_WS_ACCEPT_LEN + 1])
+{
+    static const char guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    unsigned char input[24 + sizeof(guid) - 1];
+    unsigned char digest[20];
+
+    if (key_len != 24)
+        return false;
+
+    memcpy(input, key, 24);
+    memcpy(input + 24, guid, sizeof(guid) - 1);
+
+    __ws_sha1(input, sizeof(input), digest);
+    __ws_base64(digest, sizeof(digest), out);
+    out[HTTPP_WS_ACCEPT_LEN] = '\0';
+
+    return true;
+}
+
+int httpp_ws_handshake(httpp_req_t* req, char out[HTTPP_WS_HANDSHAKE_LEN])
+{
+    static const char head[] =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: ";
+
+    char accept[HTTPP_WS_ACCEPT_LEN + 1];
+
+    if (!httpp_ws_is_upgrade(req))
+        return -1;
+
+    httpp_header_t* key = httpp_req_find_header(req, "sec-websocket-key");
+    if (!httpp_ws_accept(key->value.ptr, key->value.length, accept))
+        return -1;
+
+    char* itr = out;
+
+    memcpy(itr, head, sizeof(head) - 1);
+    itr += sizeof(head) - 1;
+    memcpy(itr, accept, HTTPP_WS_ACCEPT_LEN);
+    itr += HTTPP_WS_ACCEPT_LEN;
+    memcpy(itr, "\r\n\r\n", 4);
+    itr += 4;
+
+    return (int) (itr - out);
+}
+
+void httpp_ws_parser_init(httpp_ws_parser_t* p, bool server, uint64_t max_len,
+                          const httpp_ws_callbacks_t* cb, void* ctx)
+{
+    p->head_len = 0;
+    p->left = 0;
+    p->mask_off = 0;
+    p->masked = false;
+    p->server = server;
+    p->message = 0;
+    p->max_len = max_len;
+    p->state = __WS_HEAD;
+    p->cb = cb;
+    p->ctx = ctx;
+}
+
+void httpp_ws_mask(char* data, size_t len, const unsigned char mask[4], size_t offset)
+{
+    // The mask repeats every 4 bytes, so a 16 byte copy of it lines up with any block of 16 or 8
+    unsigned char m[16];
+    size_t i = 0;
+
+    for (int j = 0; j < 16; j++)
+        m[j] = mask[(offset + j) & 3];
+
+#ifdef HTTPP_SSE2
+    __m128i key = _mm_loadu_si128((const __m128i*) m);
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (data + i));
+        _mm_storeu_si128((__m128i*) (data + i), _mm_xor_si128(v, key));
+    }
+#endif
+
+    uint64_t key8;
+    memcpy(&key8, m, 8);
+
+    for (; i + 8 <= len; i += 8) {
+        uint64_t v;
+        memcpy(&v, data + i, 8);
+        v ^= key8;
+        memcpy(data + i, &v, 8);
+    }
+
+    for (; i < len; i++)
+        data[i] ^= m[i & 15];
+}
+
+size_t httpp_ws_frame_header(char out[HTTPP_WS_MAX_HEADER], int opcode, bool fin,
+                             uint64_t len, const unsigned char* mask)
+{
+    unsigned char* o = (unsigned char*) out;
+    size_t n = 2;
+
+    o[0] = (unsigned char) ((fin ? 0x80 : 0) | (opcode & 0x0F));
+
+    if (len < 126)
+        o[1] = (unsigned char) len;
+    else if (len <= 0xFFFF) {
+        o[1] = 126;
+        o[2] = (unsigned char) (len >> 8);
+        o[3] = (unsigned char) len;
+        n = 4;
+    }
+    else {
+        o[1] = 127;
+        for (int i = 0; i < 8; i++)
+            o[2 + i] = (unsigned char) (len >> (56 - 8 * i));
+        n = 10;
+    }
+
+    if (mask) {
+        o[1] |= 0x80;
+        memcpy(o + n, mask, 4);
+        n += 4;
+    }
+
+    return n;
+}
+
+// Length of the frame header so far known from its first 2 bytes
+static size_t __ws_head_need(httpp_ws_parser_t* p)
+{
+    if (p->head_len < 2)
+        return 2;
+
+    size_t need = 2 + ((p->head[1] & 0x80) ? 4 : 0);
+    unsigned len7 = p->head[1] & 0x7F;
+
+    return need + (len7 == 126 ? 2 : len7 == 127 ? 8 : 0);
+}
+
+// Decodes and checks a complete frame header. On protocol error returns false
+static bool __ws_head_done(httpp_ws_parser_t* p)
+{
+    unsigned char* h = p->head;
+    httpp_ws_frame_t* f = &p->frame;
+    unsigned len7 = h[1] & 0x7F;
+    size_t pos = 2;
+
+    f->fin = (h[0] & 0x80) != 0;
+    f->opcode = h[0] & 0x0F;
+    p->masked = (h[1] & 0x80) != 0;
+
+    if (h[0] & 0x70)
+        return false; // No extension was negotiated, RSV bits must be 0
+
+    if (p->masked != p->server)
+        return false; // Clients always mask, servers never do
+
+    if (len7 == 126) {
+        f->length = (uint64_t) h[2] << 8 | h[3];
+        pos = 4;
+    }
+    else if (len7 == 127) {
+        f->length = 0;
+        for (int i = 0; i < 8; i++)
+            f->length = f->length << 8 | h[2 + i];
+        pos = 10;
+
+        if (f->length >> 63)
+            return false;
+    }
+    else
+        f->length = len7;
+
+    if (p->masked)
+        memcpy(p->mask, h + pos, 4);
+
+    if (f->length > p->max_len)
+        return false;
+
+    switch (f->opcode) {
+        case HTTPP_WS_CONTINUATION:
+            if (!p->message)
+                return false;
+            f->message = p->message;
+            break;
+
+        case HTTPP_WS_TEXT:
+        case HTTPP_WS_BINARY:
+            if (p->message)
+                return false; // Previous message is not finished
+            f->message = f->opcode;
+            break;
+
+        case HTTPP_WS_CLOSE:
+        case HTTPP_WS_PING:
+        case HTTPP_WS_PONG:
+            // Control frames can't be fragmented, they may come between fragments
+            if (!f->fin || len7 > 125)
+                return false;
+            f->message = f->opcode;
+            return true;
+
+        default:
+            return false;
+    }
+
+    p->message = f->fin ? 0 : f->message;
+    return true;
+}
+
+#define __WS_CALL(p, fn, ...) \
+    ((p)->cb->fn ? (p)->cb->fn((p)->ctx, __VA_ARGS__) : 0)
+
+int httpp_ws_feed(httpp_ws_parser_t* p, char* data, size_t n)
+{
+    size_t pos = 0;
+
+    if (p->state == __WS_ERROR)
+        return -1;
+
+    while (pos < n) {
+        if (p->state == __WS_HEAD) {
+            size_t need = __ws_head_need(p);
+
+            // Header bytes are collected one by one, the length is known after 2
+            while (p->head_len < need && pos < n) {
+                p->head[p->head_len++] = (unsigned char) data[pos++];
+                need = __ws_head_need(p);
+            }
+
+            if (p->head_len < need)
+                break;
+
+            p->head_len = 0;
+
+            if (!__ws_head_done(p) || __WS_CALL(p, on_frame_begin, &p->frame) != 0)
+                goto fail;
+
+            p->left = p->frame.length;
+            p->mask_off = 0;
+
+            if (p->left == 0) {
+                if (__WS_CALL(p, on_frame_end, &p->frame) != 0)
+                    goto fail;
+                continue;
+            }
+
+            p->state = __WS_PAYLOAD;
+            continue;
+        }
+
+        size_t take = n - pos < p->left ? n - pos : (size_t) p->left;
+        char*  chunk = data + pos;
+
+        if (p->masked)
+            httpp_ws_mask(chunk, take, p->mask, p->mask_off);
+
+        pos += take;
+        p->left -= take;
+        p->mask_off += take;
+
+        if (__WS_CALL(p, on_frame_data, &p->frame, chunk, take) != 0)
+            goto fail;
+
+        if (p->left == 0) {
+            p->state = __WS_HEAD;
+
+            if (__WS_CALL(p, on_frame_end, &p->frame) != 0)
+                goto fail;
+        }
+    }
+
+    return 0;
+
+fail:
+    p->state = __WS_ERROR;
+    return -1;
+}
+
+#undef __WS_CALL
+#undef __WS_ROL
+
+#endif // HTTPP_IMPLEMENTATION
+#endif // _HTTPP_WS_HEADER
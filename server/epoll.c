@@ -0,0 +1,414 @@
+/*
+ * Reference multi-core HTTP/1.1 server built on httpp.
+ *
+ * Every worker thread owns its own listening socket (SO_REUSEPORT lets the
+ * kernel shard incoming connections between them) and its own edge-triggered
+ * epoll loop, so workers never share any state. Connections are kept alive
+ * unless the client asks otherwise, and pipelined requests are served
+ * in order from the same read buffer.
+ *
+ * Build:
+ *      gcc -O3 -pthread server/epoll.c -o epoll-server
+ *
+ * Usage:
+ *      ./epoll-server [port] [threads]
+ *
+ * Linux only.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define HTTPP_TRIM_HEADER_VALUES // Optional whitespace around Content-Length digits
+#define HTTPP_IMPLEMENTATION
+#include "../httpp.h"
+
+#define SERVER_DEFAULT_PORT 8080
+#define SERVER_MAX_EVENTS 256
+#define SERVER_BACKLOG 4096
+
+// Requests with a header block bigger than this are answered with 431
+#define SERVER_CONN_BUF_CAP 8192
+
+#define SERVER_BODY "Hello, World!"
+
+typedef struct {
+    int    fd;
+    size_t len;
+    // Pending output, only used when the socket could not take the whole response
+    char*  out;
+    size_t out_len;
+    size_t out_off;
+    bool   closing; // Close once the pending output is sent
+    char   buf[SERVER_CONN_BUF_CAP + 1]; // +1 for '\0', httpp_parse_request relies on it
+} conn_t;
+
+typedef struct {
+    int port;
+    int cpu;
+} worker_t;
+
+static char*  ok_res;
+static size_t ok_res_len;
+static char*  too_large_res;
+static size_t too_large_res_len;
+
+// epoll_event.data.ptr of the listening socket
+static char listen_marker;
+
+static int open_listener(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd == -1)
+        return -1;
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == -1)
+        goto fail;
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) == -1)
+        goto fail;
+
+    if (listen(fd, SERVER_BACKLOG) == -1)
+        goto fail;
+
+    return fd;
+
+fail:
+    close(fd);
+    return -1;
+}
+
+static char* build_response(int code, const char* body, size_t* out_len)
+{
+    char len_str[32];
+    snprintf(len_str, sizeof(len_str), "%zu", strlen(body));
+
+    HTTPP_NEW_RES(res, 4, code);
+    httpp_res_add_header(&res, "Server", "httpp");
+    httpp_res_add_header(&res, "Content-Type", "text/plain");
+    httpp_res_add_header(&res, "Content-Length", len_str);
+    httpp_res_set_body(res, (char*) body, strlen(body));
+
+    char* raw = httpp_res_to_raw(&res, out_len);
+    httpp_res_free_added(&res);
+    return raw;
+}
+
+static void conn_close(conn_t* c)
+{
+    close(c->fd);
+    free(c->out);
+    free(c);
+}
+
+/*
+ * Writes as much of `data` as the socket takes.
+ * Whatever is left is copied to c->out and flushed on EPOLLOUT.
+ *   On failure returns -1.
+ */
+static int conn_send(conn_t* c, const char* data, size_t n)
+{
+    if (c->out_len == c->out_off) {
+        while (n > 0) {
+            ssize_t w = send(c->fd, data, n, MSG_NOSIGNAL);
+
+            if (w == -1) {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN)
+                    break;
+                return -1;
+            }
+
+            data += w;
+            n -= w;
+        }
+
+        if (n == 0)
+            return 0;
+
+        c->out_len = c->out_off = 0;
+    }
+
+    char* grown = (char*) realloc(c->out, c->out_len + n);
+    if (!grown)
+        return -1;
+
+    memcpy(grown + c->out_len, data, n);
+    c->out = grown;
+    c->out_len += n;
+    return 0;
+}
+
+static int conn_flush(conn_t* c)
+{
+    while (c->out_off < c->out_len) {
+        ssize_t w = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+
+        if (w == -1) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+
+        c->out_off += w;
+    }
+
+    c->out_len = c->out_off = 0;
+    return 0;
+}
+
+static bool conn_pending(conn_t* c)
+{
+    return c->out_off < c->out_len;
+}
+
+/*
+ * Serves every complete request currently in c->buf.
+ *   On failure or when the connection can be closed right away returns -1.
+ *   When the response is still queued c->closing is set instead.
+ */
+static int conn_process(conn_t* c)
+{
+    size_t off = 0;
+
+    while (off < c->len) {
+        char*  start = c->buf + off;
+        size_t avail = c->len - off;
+
+        char* eoh = (char*) memmem(start, avail, "\r\n\r\n", 4);
+        if (!eoh)
+            break;
+
+        size_t head_len = eoh - start + 4;
+        char saved = start[head_len];
+        start[head_len] = '\0'; // Keep the parser inside of this request
+
+        HTTPP_NEW_REQ(req, HTTPP_DEFAULT_HEADERS_ARR_CAP);
+        int ret = httpp_parse_request(start, head_len, &req);
+        start[head_len] = saved;
+
+        if (ret == -1)
+            return -1;
+
+        size_t body_len = 0;
+        httpp_header_t* cl = httpp_find_header(req, "Content-Length");
+
+        // Digits only, a sign or an overflow would move `off` into the middle of a request
+        if (cl && !httpp_parse_content_length(&cl->value, &body_len))
+            return -1;
+
+        if (head_len + body_len > SERVER_CONN_BUF_CAP)
+            return -1;
+
+        if (head_len + body_len > avail)
+            break; // Body is not here yet
+
+        if (conn_send(c, ok_res, ok_res_len) == -1)
+            return -1;
+
+        off += head_len + body_len;
+
+        if (!req.keep_alive) {
+            c->closing = true;
+            break;
+        }
+    }
+
+    if (off > 0) {
+        memmove(c->buf, c->buf + off, c->len - off);
+        c->len -= off;
+    }
+
+    if (!c->closing && c->len == SERVER_CONN_BUF_CAP) {
+        if (conn_send(c, too_large_res, too_large_res_len) == -1)
+            return -1;
+        c->closing = true;
+    }
+
+    // Closing now would cut off the queued response, EPOLLOUT finishes it
+    if (c->closing)
+        return conn_pending(c) ? 0 : -1;
+
+    return 0;
+}
+
+static int conn_read(conn_t* c)
+{
+    // Anything after the last request is ignored
+    while (!c->closing) {
+        ssize_t r = recv(c->fd, c->buf + c->len, SERVER_CONN_BUF_CAP - c->len, 0);
+
+        if (r == 0)
+            return -1;
+
+        if (r == -1) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+
+        c->len += r;
+        c->buf[c->len] = '\0';
+
+        if (conn_process(c) == -1)
+            return -1;
+    }
+
+    return 0;
+}
+
+static void accept_all(int epfd, int lfd)
+{
+    for (;;) {
+        int fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK);
+
+        if (fd == -1) {
+            if (errno == EINTR)
+                continue;
+            return; // EAGAIN, or out of fds
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        conn_t* c = (conn_t*) malloc(sizeof(conn_t));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+
+        c->fd = fd;
+        c->len = 0;
+        c->out = NULL;
+        c->out_len = c->out_off = 0;
+        c->closing = false;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = c;
+
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1)
+            conn_close(c);
+    }
+}
+
+static void* worker_run(void* arg)
+{
+    worker_t* w = (worker_t*) arg;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    int lfd = open_listener(w->port);
+    if (lfd == -1) {
+        perror("listen");
+        exit(1);
+    }
+
+    int epfd = epoll_create1(0);
+    if (epfd == -1) {
+        perror("epoll_create1");
+        exit(1);
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &listen_marker;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev);
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+
+    for (;;) {
+        int n = epoll_wait(epfd, events, SERVER_MAX_EVENTS, -1);
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == &listen_marker) {
+                accept_all(epfd, lfd);
+                continue;
+            }
+
+            conn_t* c = (conn_t*) events[i].data.ptr;
+            uint32_t e = events[i].events;
+
+            if (e & (EPOLLERR | EPOLLHUP)) {
+                conn_close(c);
+                continue;
+            }
+
+            if ((e & EPOLLOUT) && conn_flush(c) == -1) {
+                conn_close(c);
+                continue;
+            }
+
+            if (c->closing) {
+                if (!conn_pending(c))
+                    conn_close(c);
+                continue;
+            }
+
+            if ((e & (EPOLLIN | EPOLLRDHUP)) && conn_read(c) == -1)
+                conn_close(c);
+        }
+    }
+
+    return NULL;
+}
+
+int main(int argc, char** argv)
+{
+    int port = argc > 1 ? atoi(argv[1]) : SERVER_DEFAULT_PORT;
+    int threads = argc > 2 ? atoi(argv[2]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (threads < 1)
+        threads = 1;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    ok_res = build_response(200, SERVER_BODY, &ok_res_len);
+    too_large_res = build_response(431, "", &too_large_res_len);
+
+    if (!ok_res || !too_large_res) {
+        fprintf(stderr, "Failed to build responses\n");
+        return 1;
+    }
+
+    pthread_t* tids = (pthread_t*) malloc(sizeof(pthread_t) * threads);
+    worker_t* workers = (worker_t*) malloc(sizeof(worker_t) * threads);
+    int cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int i = 0; i < threads; i++) {
+        workers[i].port = port;
+        workers[i].cpu = i % cpus;
+        pthread_create(&tids[i], NULL, worker_run, &workers[i]);
+    }
+
+    printf("Listening on :%d with %d threads\n", port, threads);
+
+    for (int i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+
+    return 0;
+}
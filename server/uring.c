@@ -0,0 +1,669 @@
+/*
+ * Reference multi-core HTTP/1.1 server built on httpp and io_uring.
+ *
+ * Same shape as server/epoll.c (one worker per core, SO_REUSEPORT sharding,
+ * keep-alive, pipelining) but without a syscall per read:
+ *   - connections are accepted with a single multishot accept
+ *   - each connection has a single multishot recv which picks its buffers from
+ *     a provided buffer ring, requests are parsed straight out of those buffers.
+ *     Only the tail of a request split between two buffers is copied.
+ *   - responses are sent with IORING_OP_SENDMSG, the iovecs point at the
+ *     serialized header block and at the body, nothing is copied per request.
+ *
+ * The ring is driven through raw syscalls, so there is no dependency on liburing.
+ *
+ * Build:
+ *      gcc -O3 -pthread server/uring.c -o uring-server
+ *
+ * Usage:
+ *      ./uring-server [port] [threads]
+ *
+ * Linux 6.0+ only.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define HTTPP_TRIM_HEADER_VALUES // Optional whitespace around Content-Length digits
+#define HTTPP_IMPLEMENTATION
+#include "../httpp.h"
+
+#define SERVER_DEFAULT_PORT 8080
+#define SERVER_BACKLOG 4096
+#define SERVER_RING_ENTRIES 4096
+
+// Provided buffers, one group per worker
+#define SERVER_BUF_GROUP 0
+#define SERVER_BUF_COUNT 4096 // Must be a power of 2
+#define SERVER_BUF_SIZE  4096
+
+// Requests with a header block bigger than this are rejected
+#define SERVER_CARRY_CAP 8192
+
+// Max responses batched into a single sendmsg, 2 iovecs each
+#define SERVER_MAX_BATCH 16
+
+#define SERVER_BODY "Hello, World!"
+
+#define OP_ACCEPT 1ull
+#define OP_RECV   2ull
+#define OP_SEND   3ull
+
+#define USER_DATA(op, fd) (((op) << 32) | (uint32_t) (fd))
+#define USER_DATA_OP(ud) ((ud) >> 32)
+#define USER_DATA_FD(ud) ((int) ((ud) & 0xffffffff))
+
+#define load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+typedef struct {
+    int fd;
+    unsigned  sq_tail;      // Local tail, published on submit
+    unsigned  sq_submitted;
+    unsigned* sq_head;
+    unsigned* sq_ktail;
+    unsigned* sq_mask;
+    unsigned* sq_entries;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    struct io_uring_buf_ring* br;
+    char* bufs;
+} ring_t;
+
+typedef struct {
+    int    fd;
+    bool   recv_armed;
+    bool   send_inflight;
+    bool   closing;
+    bool   close_after; // Client doesn't keep the connection alive, close once responses are out
+    size_t pending;   // Responses waiting for the in flight sendmsg to complete
+    size_t carry_len; // Bytes of an incomplete request carried over from the previous buffer
+    struct msghdr msg;
+    struct iovec  iov[SERVER_MAX_BATCH * 2];
+    char   carry[SERVER_CARRY_CAP + 1];
+} conn_t;
+
+typedef struct {
+    int port;
+    int cpu;
+} worker_t;
+
+static struct iovec ok_head;
+static struct iovec ok_body = {SERVER_BODY, sizeof(SERVER_BODY) - 1};
+static int max_fds;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args)
+{
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static int ring_init(ring_t* r)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+
+    if ((r->fd = sys_io_uring_setup(SERVER_RING_ENTRIES, &p)) == -1)
+        return -1;
+
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP))
+        return -1;
+
+    size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    size_t size = sq_size > cq_size ? sq_size : cq_size;
+
+    char* sq = (char*) mmap(NULL, size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED)
+        return -1;
+
+    r->sqes = (struct io_uring_sqe*) mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED)
+        return -1;
+
+    r->sq_head    = (unsigned*) (sq + p.sq_off.head);
+    r->sq_ktail   = (unsigned*) (sq + p.sq_off.tail);
+    r->sq_mask    = (unsigned*) (sq + p.sq_off.ring_mask);
+    r->sq_entries = (unsigned*) (sq + p.sq_off.ring_entries);
+    r->sq_array   = (unsigned*) (sq + p.sq_off.array);
+    r->sq_tail = r->sq_submitted = *r->sq_ktail;
+
+    r->cq_head = (unsigned*) (sq + p.cq_off.head);
+    r->cq_tail = (unsigned*) (sq + p.cq_off.tail);
+    r->cq_mask = (unsigned*) (sq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*) (sq + p.cq_off.cqes);
+
+    // Provided buffer ring
+    size_t br_size = SERVER_BUF_COUNT * sizeof(struct io_uring_buf);
+    r->br = (struct io_uring_buf_ring*) mmap(NULL, br_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (r->br == MAP_FAILED)
+        return -1;
+
+    // +1 for '\0' after each buffer, httpp_parse_request relies on it
+    r->bufs = (char*) malloc((size_t) SERVER_BUF_COUNT * (SERVER_BUF_SIZE + 1));
+    if (!r->bufs)
+        return -1;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t) (uintptr_t) r->br;
+    reg.ring_entries = SERVER_BUF_COUNT;
+    reg.bgid = SERVER_BUF_GROUP;
+
+    if (sys_io_uring_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+        return -1;
+
+    for (unsigned i = 0; i < SERVER_BUF_COUNT; i++) {
+        struct io_uring_buf* b = &r->br->bufs[i];
+        b->addr = (uint64_t) (uintptr_t) (r->bufs + (size_t) i * (SERVER_BUF_SIZE + 1));
+        b->len = SERVER_BUF_SIZE;
+        b->bid = i;
+    }
+
+    store_release(&r->br->tail, (uint16_t) SERVER_BUF_COUNT);
+    return 0;
+}
+
+static inline char* ring_buf(ring_t* r, unsigned bid)
+{
+    return r->bufs + (size_t) bid * (SERVER_BUF_SIZE + 1);
+}
+
+// Gives buffer `bid` back to the kernel
+static inline void ring_recycle(ring_t* r, unsigned bid)
+{
+    uint16_t tail = r->br->tail;
+    struct io_uring_buf* b = &r->br->bufs[tail & (SERVER_BUF_COUNT - 1)];
+
+    b->addr = (uint64_t) (uintptr_t) ring_buf(r, bid);
+    b->len = SERVER_BUF_SIZE;
+    b->bid = bid;
+
+    store_release(&r->br->tail, (uint16_t) (tail + 1));
+}
+
+static int ring_submit(ring_t* r, unsigned wait_nr)
+{
+    unsigned to_submit = r->sq_tail - r->sq_submitted;
+    store_release(r->sq_ktail, r->sq_tail);
+
+    int ret;
+    do {
+        ret = sys_io_uring_enter(r->fd, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret == -1 && errno == EINTR);
+
+    if (ret >= 0)
+        r->sq_submitted += ret;
+
+    return ret;
+}
+
+static struct io_uring_sqe* ring_get_sqe(ring_t* r)
+{
+    if (r->sq_tail - load_acquire(r->sq_head) >= *r->sq_entries)
+        ring_submit(r, 0);
+
+    if (r->sq_tail - load_acquire(r->sq_head) >= *r->sq_entries)
+        return NULL;
+
+    unsigned idx = r->sq_tail & *r->sq_mask;
+    struct io_uring_sqe* sqe = &r->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    r->sq_tail++;
+    return sqe;
+}
+
+static int open_listener(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1)
+        return -1;
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == -1)
+        goto fail;
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) == -1)
+        goto fail;
+
+    if (listen(fd, SERVER_BACKLOG) == -1)
+        goto fail;
+
+    return fd;
+
+fail:
+    close(fd);
+    return -1;
+}
+
+// Builds the header block of the response, the body is sent from its own iovec
+static char* build_head(const char* body, size_t* out_len)
+{
+    char len_str[32];
+    snprintf(len_str, sizeof(len_str), "%zu", strlen(body));
+
+    HTTPP_NEW_RES(res, 4, 200);
+    httpp_res_add_header(&res, "Server", "httpp");
+    httpp_res_add_header(&res, "Content-Type", "text/plain");
+    httpp_res_add_header(&res, "Content-Length", len_str);
+
+    char* raw = httpp_res_to_raw(&res, out_len);
+    httpp_res_free_added(&res);
+    return raw;
+}
+
+static int arm_accept(ring_t* r, int lfd)
+{
+    struct io_uring_sqe* sqe = ring_get_sqe(r);
+    if (!sqe)
+        return -1;
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = lfd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = USER_DATA(OP_ACCEPT, lfd);
+    return 0;
+}
+
+static int arm_recv(ring_t* r, conn_t* c)
+{
+    struct io_uring_sqe* sqe = ring_get_sqe(r);
+    if (!sqe)
+        return -1;
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = SERVER_BUF_GROUP;
+    sqe->user_data = USER_DATA(OP_RECV, c->fd);
+
+    c->recv_armed = true;
+    return 0;
+}
+
+// Sends up to SERVER_MAX_BATCH of the pending responses in one sendmsg
+static int send_pending(ring_t* r, conn_t* c)
+{
+    if (c->send_inflight || c->pending == 0)
+        return 0;
+
+    struct io_uring_sqe* sqe = ring_get_sqe(r);
+    if (!sqe)
+        return -1;
+
+    size_t batch = c->pending < SERVER_MAX_BATCH ? c->pending : SERVER_MAX_BATCH;
+
+    for (size_t i = 0; i < batch; i++) {
+        c->iov[i * 2] = ok_head;
+        c->iov[i * 2 + 1] = ok_body;
+    }
+
+    memset(&c->msg, 0, sizeof(c->msg));
+    c->msg.msg_iov = c->iov;
+    c->msg.msg_iovlen = batch * 2;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = c->fd;
+    sqe->addr = (uint64_t) (uintptr_t) &c->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    sqe->user_data = USER_DATA(OP_SEND, c->fd);
+
+    c->pending -= batch;
+    c->send_inflight = true;
+    return 0;
+}
+
+/*
+ * Shuts the connection down. The fd is closed and `c` freed only once the
+ * multishot recv and the in flight sendmsg (if any) are done with it.
+ */
+static void conn_close(conn_t** conns, conn_t* c)
+{
+    if (!c->closing) {
+        c->closing = true;
+        shutdown(c->fd, SHUT_RDWR);
+    }
+
+    if (c->recv_armed || c->send_inflight)
+        return;
+
+    conns[c->fd] = NULL;
+    close(c->fd);
+    free(c);
+}
+
+/*
+ * Counts every complete request in `buf` into c->pending.
+ * `buf[n]` must be writable, it is used for '\0' termination.
+ *   On failure or when the connection should be closed returns -1.
+ *
+ * On sucess returns the number of consumed bytes.
+ */
+static ssize_t conn_process(conn_t* c, char* buf, size_t n)
+{
+    size_t off = 0;
+
+    while (off < n) {
+        char*  start = buf + off;
+        size_t avail = n - off;
+
+        char* eoh = (char*) memmem(start, avail, "\r\n\r\n", 4);
+        if (!eoh)
+            break;
+
+        size_t head_len = eoh - start + 4;
+        char saved = start[head_len];
+        start[head_len] = '\0';
+
+        HTTPP_NEW_REQ(req, HTTPP_DEFAULT_HEADERS_ARR_CAP);
+        int ret = httpp_parse_request(start, head_len, &req);
+        start[head_len] = saved;
+
+        if (ret == -1)
+            return -1;
+
+        size_t body_len = 0;
+        httpp_header_t* cl = httpp_find_header(req, "Content-Length");
+
+        // Digits only, a sign or an overflow would move `off` into the middle of a request
+        if (cl && !httpp_parse_content_length(&cl->value, &body_len))
+            return -1;
+
+        if (head_len + body_len > SERVER_CARRY_CAP)
+            return -1;
+
+        if (head_len + body_len > avail)
+            break;
+
+        c->pending++;
+        off += head_len + body_len;
+
+        if (!req.keep_alive) {
+            c->close_after = true;
+            break;
+        }
+    }
+
+    return off;
+}
+
+// Handles `n` bytes received into provided buffer `data`
+static int conn_recv(conn_t* c, char* data, size_t n)
+{
+    if (c->carry_len == 0) {
+        // Fast path, parse straight out of the kernel filled buffer
+        ssize_t used = conn_process(c, data, n);
+        if (used == -1)
+            return -1;
+
+        if ((size_t) used < n) {
+            if (n - used > SERVER_CARRY_CAP)
+                return -1;
+
+            memcpy(c->carry, data + used, n - used);
+            c->carry_len = n - used;
+        }
+
+        return 0;
+    }
+
+    // The request is split between buffers
+    if (c->carry_len + n > SERVER_CARRY_CAP)
+        return -1;
+
+    memcpy(c->carry + c->carry_len, data, n);
+    c->carry_len += n;
+
+    ssize_t used = conn_process(c, c->carry, c->carry_len);
+    if (used == -1)
+        return -1;
+
+    memmove(c->carry, c->carry + used, c->carry_len - used);
+    c->carry_len -= used;
+    return 0;
+}
+
+static void handle_accept(ring_t* r, conn_t** conns, int lfd, struct io_uring_cqe* cqe)
+{
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+        arm_accept(r, lfd);
+
+    int fd = cqe->res;
+    if (fd < 0)
+        return;
+
+    if (fd >= max_fds) {
+        close(fd);
+        return;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    conn_t* c = (conn_t*) malloc(sizeof(conn_t));
+    if (!c) {
+        close(fd);
+        return;
+    }
+
+    c->fd = fd;
+    c->recv_armed = false;
+    c->send_inflight = false;
+    c->closing = false;
+    c->close_after = false;
+    c->pending = 0;
+    c->carry_len = 0;
+    conns[fd] = c;
+
+    if (arm_recv(r, c) == -1)
+        conn_close(conns, c);
+}
+
+static void handle_recv(ring_t* r, conn_t** conns, conn_t* c, struct io_uring_cqe* cqe)
+{
+    bool more = cqe->flags & IORING_CQE_F_MORE;
+
+    if (!more)
+        c->recv_armed = false;
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+        if (cqe->res > 0 && !c->closing && !c->close_after) {
+            char* data = ring_buf(r, bid);
+            data[cqe->res] = '\0';
+
+            if (conn_recv(c, data, cqe->res) == -1 || send_pending(r, c) == -1) {
+                ring_recycle(r, bid);
+                conn_close(conns, c);
+                return;
+            }
+        }
+
+        ring_recycle(r, bid);
+    }
+
+    if (c->close_after && !c->send_inflight) {
+        conn_close(conns, c);
+        return;
+    }
+
+    if (cqe->res == -ENOBUFS && !c->closing) {
+        // Ran out of provided buffers, just rearm once they are back
+        if (!more && arm_recv(r, c) == 0)
+            return;
+    }
+
+    if (cqe->res <= 0 || c->closing) {
+        conn_close(conns, c);
+        return;
+    }
+
+    if (!more && arm_recv(r, c) == -1)
+        conn_close(conns, c);
+}
+
+static void handle_send(ring_t* r, conn_t** conns, conn_t* c, struct io_uring_cqe* cqe)
+{
+    c->send_inflight = false;
+
+    if (cqe->res < 0 || c->closing) {
+        conn_close(conns, c);
+        return;
+    }
+
+    if (send_pending(r, c) == -1 || (c->close_after && !c->send_inflight))
+        conn_close(conns, c);
+}
+
+static void* worker_run(void* arg)
+{
+    worker_t* w = (worker_t*) arg;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    ring_t r;
+    if (ring_init(&r) == -1) {
+        perror("io_uring");
+        exit(1);
+    }
+
+    int lfd = open_listener(w->port);
+    if (lfd == -1) {
+        perror("listen");
+        exit(1);
+    }
+
+    conn_t** conns = (conn_t**) calloc(max_fds, sizeof(conn_t*));
+    if (!conns) {
+        perror("calloc");
+        exit(1);
+    }
+
+    arm_accept(&r, lfd);
+
+    for (;;) {
+        if (ring_submit(&r, 1) == -1 && errno != EBUSY) {
+            perror("io_uring_enter");
+            exit(1);
+        }
+
+        unsigned head = *r.cq_head;
+        unsigned tail = load_acquire(r.cq_tail);
+
+        for (; head != tail; head++) {
+            struct io_uring_cqe* cqe = &r.cqes[head & *r.cq_mask];
+            uint64_t op = USER_DATA_OP(cqe->user_data);
+            int fd = USER_DATA_FD(cqe->user_data);
+
+            if (op == OP_ACCEPT) {
+                handle_accept(&r, conns, fd, cqe);
+                continue;
+            }
+
+            conn_t* c = conns[fd];
+            if (!c)
+                continue;
+
+            if (op == OP_RECV)
+                handle_recv(&r, conns, c, cqe);
+            else if (op == OP_SEND)
+                handle_send(&r, conns, c, cqe);
+        }
+
+        store_release(r.cq_head, head);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char** argv)
+{
+    int port = argc > 1 ? atoi(argv[1]) : SERVER_DEFAULT_PORT;
+    int threads = argc > 2 ? atoi(argv[2]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (threads < 1)
+        threads = 1;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    max_fds = (int) rl.rlim_cur;
+
+    size_t head_len;
+    ok_head.iov_base = build_head(SERVER_BODY, &head_len);
+    ok_head.iov_len = head_len;
+
+    if (!ok_head.iov_base) {
+        fprintf(stderr, "Failed to build response\n");
+        return 1;
+    }
+
+    pthread_t* tids = (pthread_t*) malloc(sizeof(pthread_t) * threads);
+    worker_t* workers = (worker_t*) malloc(sizeof(worker_t) * threads);
+    int cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int i = 0; i < threads; i++) {
+        workers[i].port = port;
+        workers[i].cpu = i % cpus;
+        pthread_create(&tids[i], NULL, worker_run, &workers[i]);
+    }
+
+    printf("Listening on :%d with %d threads (io_uring)\n", port, threads);
+
+    for (int i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+
+    return 0;
+}
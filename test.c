@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -6,8 +7,22 @@
 #include <string.h>
 
 #define HTTPP_TRIM_HEADER_VALUES
+#define HTTPP_POSIX
 #define HTTPP_IMPLEMENTATION
 #include "httpp.h"
+#include "httpp_cookie.h"
+#include "httpp_accept.h"
+#include "httpp_date.h"
+#include "httpp_range.h"
+#include "httpp_multipart.h"
+#include "httpp_form.h"
+#include "httpp_ring.h"
+#include "httpp_forward.h"
+#include "httpp_header_cache.h"
+#include "httpp_ws.h"
+#include "httpp_hpack.h"
+#include "httpp_proxy.h"
+#include "httpp_log.h"
 
 int tests_run = 0;
 int tests_failed = 0;
@@ -108,11 +123,17 @@ void test_invalid_start_line()
         int r1 = httpp_parse_start_line(raw1, strlen(raw1), &req1);
         ASSERT(r1 == -1 || req1.method == HTTPP_METHOD_UNKNOWN);
 
-        char* raw2 = "GET / HTTP/1.0\r\n";
+        char* raw2 = "GET / HTTP/2.0\r\n";
         HTTPP_NEW_REQ(req2, 10);
 
         int r2 = httpp_parse_start_line(raw2, strlen(raw2), &req2);
         ASSERT(r2 == -1);
+
+        char* raw3 = "GET / HTTPS/11\r\n";
+        HTTPP_NEW_REQ(req3, 10);
+
+        int r3 = httpp_parse_start_line(raw3, strlen(raw3), &req3);
+        ASSERT(r3 == -1);
     }
 }
 
@@ -420,6 +441,1982 @@ void test_edge()
     }
 }
 
+void test_url_decode()
+{
+    TEST("Percent decoding") {
+        char* buf = mkbuf("a%20b+c%2Fd");
+        httpp_span_t s = {buf, strlen(buf), false};
+
+        ASSERT(httpp_span_url_decode(&s, true));
+        ASSERT(httpp_span_eq(&s, "a b c/d"));
+
+        char* bad = mkbuf("abc%2");
+        httpp_span_t b = {bad, strlen(bad), false};
+        ASSERT(!httpp_span_url_decode(&b, false));
+
+        free(buf);
+        free(bad);
+    }
+}
+
+void test_cookies()
+{
+    TEST("Cookie iteration and lookup") {
+        char* raw = 
+            "GET / HTTP/1.1\r\n"
+            "Cookie: wp_ozh_wsa_visits=2; wp_ozh_wsa_visit_lasttime=xxxxxxxxxx; "
+            "__utma=xxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.x; "
+            "q=\"quoted value\";; flag; enc=a%3Db\r\n"
+            "Cookie: second=2\r\n"
+            "\r\n";
+
+        char* buf = mkbuf(raw);
+        HTTPP_NEW_REQ(req, 10);
+        ASSERT(httpp_parse_request(buf, strlen(buf), &req) > 0);
+
+        httpp_header_t* h = httpp_find_header(req, "Cookie");
+        httpp_cookie_iter_t it;
+        httpp_cookie_t c;
+        size_t count = 0;
+
+        httpp_cookie_iter_init(&it, &h->value);
+        while (httpp_cookie_next(&it, &c)) {
+            if (count == 0) {
+                ASSERT(httpp_span_eq(&c.name, "wp_ozh_wsa_visits"));
+                ASSERT(httpp_span_eq(&c.value, "2"));
+            }
+            if (count == 3) {
+                ASSERT(httpp_span_eq(&c.name, "q"));
+                ASSERT(httpp_span_eq(&c.value, "quoted value"));
+                ASSERT(c.quoted);
+            }
+            if (count == 4) {
+                ASSERT(c.name.length == 0);
+                ASSERT(httpp_span_eq(&c.value, "flag"));
+            }
+            count++;
+        }
+        ASSERT_EQ_INT(count, 6);
+
+        // "wp_ozh_wsa_visit" is a prefix of other names, must not match them
+        ASSERT(!httpp_cookie_find(&h->value, "wp_ozh_wsa_visit", &c));
+        ASSERT(!httpp_cookie_find(&h->value, "xxxxxxxxxx", &c));
+
+        ASSERT(httpp_cookie_find(&h->value, "wp_ozh_wsa_visit_lasttime", &c));
+        ASSERT(httpp_span_eq(&c.value, "xxxxxxxxxx"));
+
+        ASSERT(httpp_req_find_cookie(&req, "second", &c));
+        ASSERT(httpp_span_eq(&c.value, "2"));
+
+        ASSERT(httpp_cookie_find(&h->value, "enc", &c));
+        ASSERT(httpp_cookie_decode(&c));
+        ASSERT(httpp_span_eq(&c.value, "a=b"));
+
+        free(buf);
+    }
+}
+
+void test_accept()
+{
+    TEST("q-values and content negotiation") {
+        ASSERT_EQ_INT(httpp_parse_qvalue("1", 1), 1000);
+        ASSERT_EQ_INT(httpp_parse_qvalue("0.8", 3), 800);
+        ASSERT_EQ_INT(httpp_parse_qvalue("0.125", 5), 125);
+        ASSERT_EQ_INT(httpp_parse_qvalue("1.5", 3), -1);
+        ASSERT_EQ_INT(httpp_parse_qvalue("0.1234", 6), -1);
+
+        char* raw = "text/html;level=1 ; q=0.5, , application/json";
+        httpp_span_t accept = {raw, strlen(raw), false};
+        httpp_accept_iter_t it;
+        httpp_accept_item_t item;
+
+        httpp_accept_iter_init(&it, &accept);
+        ASSERT(httpp_accept_next(&it, &item));
+        ASSERT(httpp_span_eq(&item.value, "text/html"));
+        ASSERT(httpp_span_eq(&item.params, "level=1"));
+        ASSERT_EQ_INT(item.q, 500);
+        ASSERT(httpp_accept_next(&it, &item));
+        ASSERT(httpp_span_eq(&item.value, "application/json"));
+        ASSERT_EQ_INT(item.q, 1000);
+        ASSERT(!httpp_accept_next(&it, &item));
+
+        const char* media[] = {"application/protobuf", "application/json"};
+        ASSERT_EQ_INT(httpp_negotiate_media(&accept, media, 2), 1);
+
+        char* browser = "text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8";
+        httpp_span_t bs = {browser, strlen(browser), false};
+        const char* html_or_json[] = {"application/json", "text/html"};
+        ASSERT_EQ_INT(httpp_negotiate_media(&bs, html_or_json, 2), 1);
+        ASSERT_EQ_INT(httpp_negotiate_media(NULL, html_or_json, 2), 0);
+
+        const char* encodings[] = {"br", "gzip", "identity"};
+        char* e1 = "gzip,deflate";
+        char* e2 = "br;q=0.2, gzip;q=0.9";
+        char* e3 = "*;q=0, deflate";
+        char* e4 = "gzip;q=0, identity;q=0";
+        httpp_span_t s1 = {e1, strlen(e1), false};
+        httpp_span_t s2 = {e2, strlen(e2), false};
+        httpp_span_t s3 = {e3, strlen(e3), false};
+        httpp_span_t s4 = {e4, strlen(e4), false};
+
+        ASSERT_EQ_INT(httpp_negotiate_encoding(&s1, encodings, 3), 1);
+        ASSERT_EQ_INT(httpp_negotiate_encoding(&s2, encodings, 3), 1);
+        ASSERT_EQ_INT(httpp_negotiate_encoding(&s3, encodings, 3), -1);
+        ASSERT_EQ_INT(httpp_negotiate_encoding(&s4, encodings, 3), -1);
+
+        const char* langs[] = {"en-US", "ja"};
+        char* l1 = "ja,en-us;q=0.7,en;q=0.3";
+        char* l2 = "en;q=0.9, fr";
+        httpp_span_t ls1 = {l1, strlen(l1), false};
+        httpp_span_t ls2 = {l2, strlen(l2), false};
+        ASSERT_EQ_INT(httpp_negotiate_language(&ls1, langs, 2), 1);
+        ASSERT_EQ_INT(httpp_negotiate_language(&ls2, langs, 2), 0);
+    }
+}
+
+void test_response_template()
+{
+    TEST("Response templates") {
+        HTTPP_NEW_RES(res, 4, 200);
+        httpp_res_add_header(&res, "Server", "httpp");
+        httpp_res_add_header(&res, "Content-Type", "text/plain");
+        httpp_res_add_header(&res, "Content-Length", "999");
+
+        httpp_res_template_t tmpl;
+        int slots = HTTPP_SLOT_CONTENT_LENGTH | HTTPP_SLOT_DATE | HTTPP_SLOT_REQUEST_ID;
+        ASSERT(httpp_res_template_init(&tmpl, &res, slots));
+        httpp_res_free_added(&res);
+
+        // Never a blank Content-Length, even before it's set
+        ASSERT(tmpl.content_length_off > 0);
+        ASSERT(memcmp(tmpl.raw + tmpl.content_length_off, "           0\r\n", 14) == 0);
+
+        ASSERT(httpp_res_template_set_content_length(&tmpl, 1234));
+        ASSERT(!httpp_res_template_set_content_length(&tmpl, (size_t) 1e13));
+        httpp_res_template_set_date(&tmpl, "Sun, 06 Nov 1994 08:49:37 GMT");
+        ASSERT(httpp_res_template_set_request_id(&tmpl, "abc", 3));
+
+        char* raw = httpp_span_to_str(&(httpp_span_t){tmpl.raw, tmpl.raw_len, false});
+        ASSERT(strncmp(raw, "HTTP/1.1 200 OK\r\nServer: httpp\r\nContent-Type: text/plain\r\n", 58) == 0);
+        ASSERT(strstr(raw, "999") == NULL);
+        ASSERT(strstr(raw, "Content-Length:         1234\r\n") != NULL);
+        ASSERT(strstr(raw, "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n") != NULL);
+        ASSERT(strstr(raw, "X-Request-Id: abc ") != NULL);
+        ASSERT(strcmp(raw + tmpl.raw_len - 4, "\r\n\r\n") == 0);
+
+        httpp_res_template_t clone = {0};
+        ASSERT(httpp_res_template_clone(&clone, &tmpl));
+        ASSERT(httpp_res_template_set_content_length(&clone, 5));
+        ASSERT(memcmp(clone.raw, tmpl.raw, tmpl.raw_len) != 0);
+
+        struct iovec iov[2];
+        ASSERT_EQ_INT(httpp_res_template_iov(&clone, "Hello", 5, iov), 2);
+        ASSERT(iov[0].iov_len == clone.raw_len && iov[1].iov_len == 5);
+
+        free(raw);
+        httpp_res_template_free(&tmpl);
+        httpp_res_template_free(&clone);
+    }
+}
+
+void test_date()
+{
+    TEST("Cached Date header") {
+        char out[HTTPP_DATE_LEN + 1] = {0};
+
+        httpp_date_format(784111777, out);
+        ASSERT_EQ_STR(out, "Sun, 06 Nov 1994 08:49:37 GMT");
+
+        httpp_date_format(951782400, out); // Leap day
+        ASSERT_EQ_STR(out, "Tue, 29 Feb 2000 00:00:00 GMT");
+
+        time_t now = time(NULL);
+        char expected[64];
+        struct tm tm = *gmtime(&now);
+        strftime(expected, sizeof(expected), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+        const char* cached = httpp_date_get();
+        ASSERT(strlen(cached) == HTTPP_DATE_LEN);
+        ASSERT(httpp_date_get() == cached || time(NULL) != now);
+        ASSERT(strcmp(cached, expected) == 0 || time(NULL) != now);
+
+        HTTPP_NEW_RES(res, 2, 204);
+        ASSERT(httpp_res_add_date(&res) != NULL);
+
+        size_t raw_len;
+        char* raw = httpp_res_to_raw(&res, &raw_len);
+        ASSERT(raw != NULL && strstr(raw, "Date: ") != NULL);
+        ASSERT(strlen(raw) == raw_len);
+        free(raw);
+    }
+}
+
+void test_file_body()
+{
+    TEST("File bodies") {
+        char path[] = "/tmp/httpp-test-XXXXXX";
+        int fd = mkstemp(path);
+        ASSERT(fd != -1);
+        unlink(path);
+
+        const char* content = "0123456789abcdefghij";
+        ASSERT(write(fd, content, 20) == 20);
+
+        HTTPP_NEW_RES(res, 2, 200);
+        httpp_res_add_header(&res, "Content-Length", "10");
+        httpp_res_set_body_file(res, fd, 5, 10);
+
+        size_t raw_len;
+        char* raw = httpp_res_to_raw(&res, &raw_len);
+        ASSERT(raw != NULL);
+        ASSERT(strcmp(raw + raw_len - 4, "\r\n\r\n") == 0); // Header block only
+        free(raw);
+
+        int sv[2];
+        ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+
+        httpp_file_sender_t sender;
+        ASSERT(httpp_file_sender_init(&sender, &res));
+        ASSERT_EQ_INT(httpp_file_sender_send(&sender, sv[0]), 1);
+
+        char got[256] = {0};
+        size_t got_len = 0;
+        ssize_t r;
+
+        close(sv[0]);
+        while ((r = read(sv[1], got + got_len, sizeof(got) - 1 - got_len)) > 0)
+            got_len += r;
+
+        ASSERT(got_len == sender.head_len + 10);
+        ASSERT(strcmp(got + sender.head_len, "56789abcde") == 0);
+
+        httpp_file_sender_free(&sender);
+        httpp_res_free_added(&res);
+        close(sv[1]);
+        close(fd);
+    }
+}
+
+void test_conditional_and_range()
+{
+    TEST("HTTP-date parsing") {
+        ASSERT(httpp_parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT", 29) == 784111777);
+        ASSERT(httpp_parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT", 30) == 784111777);
+        ASSERT(httpp_parse_http_date("Sun Nov  6 08:49:37 1994", 24) == 784111777);
+        ASSERT(httpp_parse_http_date("Sun, 06 Nov 1994 08:49:37 UTC", 29) == -1);
+        ASSERT(httpp_parse_http_date("yesterday", 9) == -1);
+    }
+
+    TEST("Range parsing") {
+        httpp_range_t r[4];
+        httpp_span_t v1 = {"bytes=0-99, 200-, -50", 21, false};
+        ASSERT_EQ_INT(httpp_parse_range(&v1, 1000, r, 4), 3);
+        ASSERT(r[0].start == 0 && r[0].length == 100);
+        ASSERT(r[1].start == 200 && r[1].length == 800);
+        ASSERT(r[2].start == 950 && r[2].length == 50);
+
+        httpp_span_t v2 = {"bytes=5000-", 11, false};
+        ASSERT_EQ_INT(httpp_parse_range(&v2, 1000, r, 4), 0);
+
+        httpp_span_t v3 = {"bytes=9-3", 9, false};
+        ASSERT_EQ_INT(httpp_parse_range(&v3, 1000, r, 4), -1);
+
+        httpp_span_t v4 = {"items=0-1", 9, false};
+        ASSERT_EQ_INT(httpp_parse_range(&v4, 1000, r, 4), -1);
+    }
+
+    TEST("Conditional request evaluation") {
+        struct {
+            char* raw;
+            int status;
+            size_t ranges;
+        } table[] = {
+            { "GET / HTTP/1.1\r\n\r\n", 200, 0 },
+            { "GET / HTTP/1.1\r\nIf-None-Match: \"x\", W/\"v1\"\r\n\r\n", 304, 0 },
+            { "PUT / HTTP/1.1\r\nIf-None-Match: *\r\n\r\n", 412, 0 },
+            { "GET / HTTP/1.1\r\nIf-Match: \"nope\"\r\n\r\n", 412, 0 },
+            { "GET / HTTP/1.1\r\nIf-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n", 304, 0 },
+            { "GET / HTTP/1.1\r\nIf-Modified-Since: Sat, 05 Nov 1994 08:49:37 GMT\r\n\r\n", 200, 0 },
+            { "GET / HTTP/1.1\r\nIf-Unmodified-Since: Sat, 05 Nov 1994 08:49:37 GMT\r\n\r\n", 412, 0 },
+            { "GET / HTTP/1.1\r\nRange: bytes=0-9\r\n\r\n", 206, 1 },
+            { "GET / HTTP/1.1\r\nRange: bytes=0-9,20-29\r\n\r\n", 206, 2 },
+            { "GET / HTTP/1.1\r\nRange: bytes=100-\r\n\r\n", 416, 0 },
+            { "HEAD / HTTP/1.1\r\nRange: bytes=0-9\r\n\r\n", 200, 0 },
+            { "GET / HTTP/1.1\r\nRange: bytes=0-9\r\nIf-Range: \"v1\"\r\n\r\n", 206, 1 },
+            { "GET / HTTP/1.1\r\nRange: bytes=0-9\r\nIf-Range: \"v0\"\r\n\r\n", 200, 0 },
+        };
+
+        httpp_resource_t resource = {"\"v1\"", 784111777, 100};
+
+        for (size_t i = 0; i < ARR_LEN(table); i++) {
+            HTTPP_NEW_REQ(req, 10);
+            httpp_cond_result_t result;
+
+            ASSERT(httpp_parse_request(table[i].raw, strlen(table[i].raw), &req) > 0);
+            ASSERT_EQ_INT(httpp_evaluate_conditional(&req, &resource, &result), table[i].status);
+            ASSERT(result.ranges_len == table[i].ranges);
+        }
+    }
+
+    TEST("* matches resources without or with a weak entity tag") {
+        const char* etags[] = {NULL, "W/\"v1\""};
+        struct {
+            char* raw;
+            int status;
+        } table[] = {
+            { "PUT / HTTP/1.1\r\nIf-Match: *\r\n\r\n", 200 },
+            { "GET / HTTP/1.1\r\nIf-None-Match: *\r\n\r\n", 304 },
+            { "PUT / HTTP/1.1\r\nIf-None-Match:  * \r\n\r\n", 412 },
+            { "PUT / HTTP/1.1\r\nIf-Match: \"v1\"\r\n\r\n", 412 }, // Weak tags never match strongly
+        };
+
+        for (size_t e = 0; e < ARR_LEN(etags); e++) {
+            httpp_resource_t resource = {etags[e], 784111777, 100};
+
+            for (size_t i = 0; i < ARR_LEN(table); i++) {
+                HTTPP_NEW_REQ(req, 10);
+                httpp_cond_result_t result = {0};
+
+                ASSERT(httpp_parse_request(table[i].raw, strlen(table[i].raw), &req) > 0);
+                ASSERT_EQ_INT(httpp_evaluate_conditional(&req, &resource, &result), table[i].status);
+            }
+        }
+    }
+
+    TEST("multipart/byteranges framing") {
+        const char* body = "0123456789abcdefghijklmnopqrstuvwxyz";
+        httpp_cond_result_t result = {206, {{0, 3}, {10, 2}}, 2};
+        char scratch[512];
+        struct iovec iov[5];
+        size_t content_len = 0;
+        char cr[64];
+
+        ASSERT_EQ_INT(httpp_content_range(&result.ranges[1], 36, cr, sizeof(cr)), 14);
+        ASSERT_EQ_STR(cr, "bytes 10-11/36");
+        httpp_content_range(NULL, 36, cr, sizeof(cr));
+        ASSERT_EQ_STR(cr, "bytes */36");
+
+        int n = httpp_range_multipart_iov(&result, 36, "text/plain", "SEP", body, 
+                    scratch, sizeof(scratch), iov, 5, &content_len);
+        ASSERT_EQ_INT(n, 5);
+
+        char out[512];
+        size_t off = 0;
+        for (int i = 0; i < n; i++) {
+            memcpy(out + off, iov[i].iov_base, iov[i].iov_len);
+            off += iov[i].iov_len;
+        }
+        out[off] = '\0';
+
+        ASSERT(off == content_len);
+        ASSERT_EQ_STR(out, 
+            "--SEP\r\nContent-Type: text/plain\r\nContent-Range: bytes 0-2/36\r\n\r\n012"
+            "\r\n--SEP\r\nContent-Type: text/plain\r\nContent-Range: bytes 10-11/36\r\n\r\nab"
+            "\r\n--SEP--\r\n");
+    }
+}
+
+void test_version_and_connection()
+{
+    struct {
+        char* raw;
+        int minor;
+        bool keep_alive;
+        bool upgrade;
+    } table[] = {
+        { "GET / HTTP/1.1\r\nHost: ex\r\n\r\n", 1, true, false },
+        { "GET / HTTP/1.1\r\nConnection: close\r\n\r\n", 1, false, false },
+        { "GET / HTTP/1.1\r\nConnection: Upgrade\r\nUpgrade: websocket\r\n\r\n", 1, true, true },
+        { "GET / HTTP/1.1\r\nconnection: keep-alive , UPGRADE\r\n\r\n", 1, true, true },
+        { "GET / HTTP/1.0\r\nHost: ex\r\n\r\n", 0, false, false },
+        { "GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n", 0, true, false },
+        { "HEAD / HTTP/1.0\r\nConnection: close\r\n\r\n", 0, false, false },
+        // "close" wins over "keep-alive" in any order, also across Connection headers
+        { "GET / HTTP/1.1\r\nConnection: close, keep-alive\r\n\r\n", 1, false, false },
+        { "GET / HTTP/1.0\r\nConnection: keep-alive, close\r\n\r\n", 0, false, false },
+        { "GET / HTTP/1.0\r\nConnection: close\r\nConnection: keep-alive\r\n\r\n", 0, false, false },
+    };
+
+    TEST("HTTP version and Connection tokens") {
+        for (size_t i = 0; i < ARR_LEN(table); i++) {
+            HTTPP_NEW_REQ(req, 10);
+
+            ASSERT(httpp_parse_request(table[i].raw, strlen(table[i].raw), &req) > 0);
+            ASSERT_EQ_INT(req.version_major, 1);
+            ASSERT_EQ_INT(req.version_minor, table[i].minor);
+            ASSERT_EQ_INT(req.keep_alive, table[i].keep_alive);
+            ASSERT_EQ_INT(req.upgrade, table[i].upgrade);
+        }
+    }
+}
+
+struct body_sink {
+    char   data[64];
+    size_t len;
+    size_t calls;
+    size_t pause_at;
+};
+
+int body_sink_cb(void* ctx, const char* data, size_t len)
+{
+    struct body_sink* sink = ctx;
+
+    memcpy(sink->data + sink->len, data, len);
+    sink->len += len;
+    sink->calls++;
+
+    return sink->calls == sink->pause_at ? HTTPP_BODY_PAUSE : 0;
+}
+
+struct body_source {
+    const char* data;
+    size_t len;
+};
+
+ptrdiff_t body_source_read(void* io, char* buf, size_t cap)
+{
+    struct body_source* src = io;
+    size_t n = src->len < cap ? src->len : cap;
+
+    memcpy(buf, src->data, n);
+    src->data += n;
+    src->len -= n;
+    return n;
+}
+
+void test_body_stream()
+{
+    char* raw = 
+        "POST /upload HTTP/1.1\r\n"
+        "Content-Length: 20\r\n"
+        "\r\n"
+        "0123456";
+
+    TEST("Streaming body, push") {
+        HTTPP_NEW_REQ(req, 4);
+        ASSERT(httpp_parse_request(raw, strlen(raw), &req) > 0);
+
+        struct body_sink sink = {.pause_at = 3};
+        httpp_body_stream_t stream;
+        ASSERT(httpp_body_stream_init(&stream, &req, 4, body_sink_cb, &sink) == 0);
+
+        // Prefix (7 bytes) goes first in pieces of 4, then the rest until pause
+        const char* more = "789abcdefghijNEXT";
+        ptrdiff_t used = httpp_body_stream_feed(&stream, more, strlen(more));
+        ASSERT_EQ_INT(used, 4);
+        ASSERT_EQ_INT(sink.calls, 3);
+
+        used += httpp_body_stream_feed(&stream, more + used, strlen(more) - used);
+        ASSERT_EQ_INT(used, 13);
+        ASSERT(httpp_body_stream_done(&stream));
+        ASSERT(sink.len == 20 && memcmp(sink.data, "0123456789abcdefghij", 20) == 0);
+    }
+
+    TEST("Streaming body, pull") {
+        HTTPP_NEW_REQ(req, 4);
+        ASSERT(httpp_parse_request(raw, strlen(raw), &req) > 0);
+
+        httpp_body_stream_t stream;
+        ASSERT(httpp_body_stream_init(&stream, &req, 0, NULL, NULL) == 0);
+
+        struct body_source src = {"789abcdefghijNEXT", 17};
+        char out[64];
+        size_t total = 0;
+        ptrdiff_t r;
+
+        while ((r = httpp_body_stream_read(&stream, out + total, 5, body_source_read, &src)) > 0)
+            total += r;
+
+        ASSERT_EQ_INT(r, 0);
+        ASSERT(total == 20 && memcmp(out, "0123456789abcdefghij", 20) == 0);
+        ASSERT(src.len == 4); // "NEXT" is left unread
+    }
+
+    TEST("Streaming body, rejected framing") {
+        char* chunked = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+        char* bad_len = "POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n";
+        httpp_body_stream_t stream;
+
+        HTTPP_NEW_REQ(req1, 4);
+        httpp_parse_request(chunked, strlen(chunked), &req1);
+        ASSERT(httpp_body_stream_init(&stream, &req1, 0, NULL, NULL) == -1);
+
+        HTTPP_NEW_REQ(req2, 4);
+        httpp_parse_request(bad_len, strlen(bad_len), &req2);
+        ASSERT(httpp_body_stream_init(&stream, &req2, 0, NULL, NULL) == -1);
+    }
+}
+
+struct part_sink {
+    char   names[4][16];
+    char   data[4][32];
+    size_t lens[4];
+    size_t parts;
+    size_t ended;
+};
+
+int part_sink_begin(void* ctx, httpp_headers_arr_t* headers)
+{
+    struct part_sink* sink = ctx;
+    httpp_span_t name;
+
+    if (sink->parts == 4 || !httpp_multipart_disposition(headers, &name, NULL))
+        return -1;
+
+    snprintf(sink->names[sink->parts], 16, "%.*s", (int) name.length, name.ptr);
+    sink->lens[sink->parts++] = 0;
+    return 0;
+}
+
+int part_sink_data(void* ctx, const char* data, size_t len)
+{
+    struct part_sink* sink = ctx;
+    size_t i = sink->parts - 1;
+
+    memcpy(sink->data[i] + sink->lens[i], data, len);
+    sink->lens[i] += len;
+    return 0;
+}
+
+int part_sink_end(void* ctx)
+{
+    ((struct part_sink*) ctx)->ended++;
+    return 0;
+}
+
+void test_multipart()
+{
+    const httpp_multipart_callbacks_t cb = {part_sink_begin, part_sink_data, part_sink_end};
+    char content_type[] = "multipart/form-data; charset=utf-8; boundary=\"xYz\"";
+    char body[] =
+        "preamble\r\n"
+        "--xYz\r\n"
+        "Content-Disposition: form-data; name=\"a\"\r\n"
+        "\r\n"
+        "hello\r\n--xY world\r\n"
+        "--xYz  \r\n"
+        "Content-Disposition: form-data; name=\"f\"; filename=\"f.txt\"\r\n"
+        "Content-Type: text/plain\r\n"
+        "\r\n"
+        "\r\n\r\n\r\n"
+        "--xYz--\r\n"
+        "epilogue";
+
+    TEST("Multipart boundary") {
+        httpp_span_t ct = {content_type, strlen(content_type), false};
+        httpp_span_t b = {0};
+
+        ASSERT(httpp_multipart_boundary(&ct, &b));
+        ASSERT(b.length == 3 && memcmp(b.ptr, "xYz", 3) == 0);
+
+        char plain[] = "text/plain; boundary=x";
+        httpp_span_t p = {plain, strlen(plain), false};
+        ASSERT(!httpp_multipart_boundary(&p, &b));
+    }
+
+    // Whole body at once, then every possible split into pieces of `step` bytes
+    size_t steps[] = {sizeof(body), 1, 2, 3, 5, 7};
+
+    for (size_t s = 0; s < ARR_LEN(steps); s++) {
+        TEST("Multipart parts") {
+            httpp_span_t b = {"xYz", 3, false};
+            httpp_multipart_t mp;
+            struct part_sink sink = {0};
+            size_t n = strlen(body);
+
+            ASSERT(httpp_multipart_init(&mp, &b, &cb, &sink));
+
+            for (size_t off = 0; off < n; off += steps[s]) {
+                size_t len = n - off < steps[s] ? n - off : steps[s];
+                ASSERT_EQ_INT(httpp_multipart_feed(&mp, body + off, len), 0);
+            }
+
+            ASSERT(httpp_multipart_done(&mp));
+            ASSERT_EQ_INT(sink.parts, 2);
+            ASSERT_EQ_INT(sink.ended, 2);
+            ASSERT_EQ_STR(sink.names[0], "a");
+            ASSERT_EQ_STR(sink.names[1], "f");
+            ASSERT(sink.lens[0] == 17 && memcmp(sink.data[0], "hello\r\n--xY world", 17) == 0);
+            ASSERT(sink.lens[1] == 4 && memcmp(sink.data[1], "\r\n\r\n", 4) == 0);
+        }
+    }
+
+    TEST("Multipart malformed") {
+        httpp_span_t b = {"xYz", 3, false};
+        httpp_multipart_t mp;
+        struct part_sink sink = {0};
+
+        char bad[] = "--xYz\r\nno colon here\r\n\r\ndata";
+        ASSERT(httpp_multipart_init(&mp, &b, &cb, &sink));
+        ASSERT_EQ_INT(httpp_multipart_feed(&mp, bad, strlen(bad)), -1);
+
+        char garbage[] = "--xYzjunk";
+        ASSERT(httpp_multipart_init(&mp, &b, &cb, &sink));
+        ASSERT_EQ_INT(httpp_multipart_feed(&mp, garbage, strlen(garbage)), -1);
+    }
+
+    TEST("Multipart disposition skips quoted values") {
+        char value[] = "form-data; filename=\"x;name=admin\"; name=\"user\"";
+        char escaped[] = "form-data; filename=\"a\\\";name=b\"; name=c";
+        char open[] = "form-data; filename=\"x;name=admin";
+        httpp_header_t h = {{"Content-Disposition", 19, false}, {value, strlen(value), false}};
+        httpp_headers_arr_t hs = {&h, 1, 1};
+        httpp_span_t name = {0}, filename = {0};
+
+        ASSERT(httpp_multipart_disposition(&hs, &name, &filename));
+        ASSERT(httpp_span_eq(&name, "user"));
+        ASSERT(httpp_span_eq(&filename, "x;name=admin"));
+
+        h.value = (httpp_span_t){escaped, strlen(escaped), false};
+        ASSERT(httpp_multipart_disposition(&hs, &name, &filename));
+        ASSERT(httpp_span_eq(&name, "c"));
+        ASSERT(httpp_span_eq(&filename, "a\\\";name=b"));
+
+        h.value = (httpp_span_t){open, strlen(open), false};
+        ASSERT(httpp_multipart_disposition(&hs, &name, &filename));
+        ASSERT_EQ_INT(name.length, 0);
+    }
+}
+
+void test_form()
+{
+    TEST("Form fields") {
+        char body[] = "a=1&&b+c=x+y%21&flag&%41%42=&last=%E2%82%AC";
+        httpp_span_t span = {body, strlen(body), false};
+        httpp_form_iter_t it;
+        httpp_form_field_t f;
+
+        const char* names[] = {"a", "b c", "flag", "AB", "last"};
+        const char* values[] = {"1", "x y!", "", "", "\xE2\x82\xAC"};
+        size_t n = 0;
+
+        httpp_form_iter_init(&it, &span);
+        while (httpp_form_next(&it, &f)) {
+            ASSERT(n < ARR_LEN(names));
+            ASSERT(httpp_form_decode(&f));
+            ASSERT(f.name.length == strlen(names[n]) && memcmp(f.name.ptr, names[n], f.name.length) == 0);
+            ASSERT(f.value.length == strlen(values[n]) && memcmp(f.value.ptr, values[n], f.value.length) == 0);
+            n++;
+        }
+        ASSERT_EQ_INT(n, 5);
+    }
+
+    TEST("Form find") {
+        char body[] = "user=bob&pass+word=s%3Dcret&bad=%4";
+        httpp_span_t span = {body, strlen(body), false};
+        httpp_form_field_t f;
+
+        ASSERT(httpp_form_find(&span, "pass word", &f));
+        ASSERT(f.value.length == 8 && memcmp(f.value.ptr, "s%3Dcret", 8) == 0);
+        ASSERT(httpp_form_decode(&f));
+        ASSERT(f.value.length == 6 && memcmp(f.value.ptr, "s=cret", 6) == 0);
+
+        ASSERT(!httpp_form_find(&span, "use", &f));
+        ASSERT(!httpp_form_find(&span, "missing", &f));
+        ASSERT(httpp_form_find(&span, "bad", &f));
+        ASSERT(!httpp_form_decode(&f));
+    }
+
+    TEST("Query string") {
+        char raw[] = "GET /search?q=hello+world&page=2#top HTTP/1.1\r\nHost: x\r\n\r\n";
+        HTTPP_NEW_REQ(req, 4);
+        ASSERT(httpp_parse_request(raw, strlen(raw), &req) > 0);
+
+        httpp_form_field_t f = {0};
+        ASSERT(httpp_req_query_find(&req, "page", &f));
+        ASSERT(f.value.length == 1 && f.value.ptr[0] == '2');
+        ASSERT(httpp_req_query_find(&req, "q", &f));
+        ASSERT(httpp_form_decode(&f));
+        ASSERT(f.value.length == 11 && memcmp(f.value.ptr, "hello world", 11) == 0);
+
+        char plain[] = "/no/query";
+        httpp_span_t route = {plain, strlen(plain), false};
+        httpp_form_iter_t it;
+        httpp_query_iter_init(&it, &route);
+        ASSERT(!httpp_form_next(&it, &f));
+    }
+}
+
+void ring_put(httpp_ring_t* ring, const char* data)
+{
+    size_t avail;
+    char* space = httpp_ring_space(ring, &avail);
+    size_t n = strlen(data);
+
+    assert(n <= avail);
+    memcpy(space, data, n);
+    httpp_ring_produce(ring, n);
+}
+
+void test_ring()
+{
+    TEST("Ring wrap around") {
+        httpp_ring_t ring;
+        ASSERT(httpp_ring_init(&ring, 1, 64 * 1024));
+        ASSERT(ring.cap >= 4096);
+
+        // Move the head close to the end, so the next requests wrap
+        size_t filler = ring.cap - 20;
+        size_t avail;
+        memset(httpp_ring_space(&ring, &avail), 'x', filler);
+        httpp_ring_produce(&ring, filler);
+        httpp_ring_consume(&ring, filler);
+
+        ring_put(&ring,
+            "POST /wrap HTTP/1.1\r\n"
+            "Content-Length: 5\r\n"
+            "Connection: close\r\n"
+            "\r\n"
+            "hello"
+            "GET /next HTTP/1.1\r\nHo");
+
+        HTTPP_NEW_REQ(req, 4);
+        int n = httpp_ring_parse(&ring, &req);
+        ASSERT(n > 0);
+        ASSERT(httpp_span_eq(&req.route, "/wrap"));
+        ASSERT(req.body.length == 5 && memcmp(req.body.ptr, "hello", 5) == 0);
+        ASSERT(!req.keep_alive);
+
+        // Spans are live, the ring can't move
+        ASSERT(!httpp_ring_grow(&ring));
+        httpp_ring_consume(&ring, n);
+        ASSERT(ring.head < ring.cap);
+
+        HTTPP_NEW_REQ(next, 4);
+        ASSERT_EQ_INT(httpp_ring_parse(&ring, &next), 0);
+        ring_put(&ring, "st: a\r\n\r\n");
+        n = httpp_ring_parse(&ring, &next);
+        ASSERT_EQ_INT(n, (int) strlen("GET /next HTTP/1.1\r\nHost: a\r\n\r\n"));
+        ASSERT(httpp_span_eq(&next.route, "/next") && next.body.length == 0);
+        ASSERT(next.keep_alive);
+        httpp_ring_consume(&ring, n);
+        ASSERT_EQ_INT(httpp_ring_len(&ring), 0);
+
+        httpp_ring_free(&ring);
+    }
+
+    TEST("Ring rejects ambiguous framing") {
+        const char* bad[] = {
+            "POST / HTTP/1.1\r\nContent-Length: 0\r\nContent-Length: 50\r\n\r\n",
+            "POST / HTTP/1.1\r\nContent-Length: 5\r\nTransfer-Encoding: chunked\r\n\r\n",
+            "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 5\r\n\r\n",
+        };
+
+        for (size_t i = 0; i < ARR_LEN(bad); i++) {
+            httpp_ring_t ring;
+            HTTPP_NEW_REQ(req, 4);
+
+            ASSERT(httpp_ring_init(&ring, 1, 4096));
+            ring_put(&ring, bad[i]);
+            ASSERT_EQ_INT(httpp_ring_parse(&ring, &req), -1);
+            httpp_ring_free(&ring);
+        }
+
+        // The same value twice is one length
+        httpp_ring_t ring;
+        HTTPP_NEW_REQ(req, 4);
+        ASSERT(httpp_ring_init(&ring, 1, 4096));
+        ring_put(&ring, "POST / HTTP/1.1\r\nContent-Length: 2\r\nContent-Length: 2\r\n\r\nok");
+        ASSERT(httpp_ring_parse(&ring, &req) > 0);
+        ASSERT(req.body.length == 2);
+        httpp_ring_free(&ring);
+
+        // A length close to SIZE_MAX must not wrap around the limit
+        HTTPP_NEW_REQ(huge, 4);
+        ASSERT(httpp_ring_init(&ring, 1, (size_t) -1));
+        ASSERT(ring.max == INT_MAX);
+        ring_put(&ring, "POST / HTTP/1.1\r\nContent-Length: 18446744073709551615\r\n\r\n");
+        ASSERT_EQ_INT(httpp_ring_parse(&ring, &huge), -1);
+        httpp_ring_free(&ring);
+    }
+
+    TEST("Ring growth and recv") {
+        httpp_ring_t ring;
+        int fds[2];
+
+        ASSERT(httpp_ring_init(&ring, 4096, 8192));
+        ASSERT(pipe(fds) == 0);
+
+        // Header block bigger than the ring
+        char big[6000];
+        memset(big, 'a', sizeof(big));
+        memcpy(big, "GET / HTTP/1.1\r\nX-Big: ", 23);
+        memcpy(big + sizeof(big) - 4, "\r\n\r\n", 4);
+
+        for (size_t off = 0; off < sizeof(big);) {
+            ssize_t w = write(fds[1], big + off, sizeof(big) - off > 4096 ? 4096 : sizeof(big) - off);
+            ASSERT(w > 0);
+            off += w;
+
+            while (httpp_ring_len(&ring) < off)
+                ASSERT(httpp_ring_recv(&ring, fds[0]) > 0);
+        }
+
+        ASSERT_EQ_INT(ring.cap, 8192);
+
+        HTTPP_NEW_REQ(req, 4);
+        ASSERT_EQ_INT(httpp_ring_parse(&ring, &req), (int) sizeof(big));
+        ASSERT_EQ_INT(req.headers.arr[0].value.length, sizeof(big) - 27);
+
+        // Full and can't grow any more
+        size_t avail;
+        char* space = httpp_ring_space(&ring, &avail);
+        memset(space, 'b', avail);
+        httpp_ring_produce(&ring, avail);
+        ASSERT(httpp_ring_recv(&ring, fds[0]) == -1 && errno == ENOBUFS);
+
+        close(fds[0]);
+        close(fds[1]);
+        httpp_ring_free(&ring);
+    }
+}
+
+void test_forward()
+{
+    char raw[] =
+        "POST /api/items?x=1 HTTP/1.1\r\n"
+        "Host: public.example.com\r\n"
+        "Connection: keep-alive, X-Hop\r\n"
+        "X-Hop: 1\r\n"
+        "Content-Length: 4\r\n"
+        "Keep-Alive: timeout=5\r\n"
+        "Accept: */*\r\n"
+        "\r\n"
+        "body";
+
+    TEST("Forward without edits") {
+        HTTPP_NEW_REQ(req, 8);
+        ASSERT(httpp_parse_request(raw, strlen(raw), &req) > 0);
+
+        httpp_forward_t fw;
+        httpp_forward_init(&fw, &req, raw);
+
+        httpp_span_t pieces[4] = {{0}};
+        ASSERT_EQ_INT(httpp_forward_pieces(&fw, pieces, 4), 1);
+        ASSERT(pieces[0].ptr == raw && pieces[0].length == strlen(raw));
+    }
+
+    TEST("Forward with edits") {
+        HTTPP_NEW_REQ(req, 8);
+        ASSERT(httpp_parse_request(raw, strlen(raw), &req) > 0);
+
+        httpp_forward_t fw;
+        httpp_forward_init(&fw, &req, raw);
+
+        ASSERT(httpp_forward_remove_hop_by_hop(&fw));
+        ASSERT(httpp_forward_replace(&fw, "host", "backend:8080", 12));
+        ASSERT(httpp_forward_insert(&fw, "X-Forwarded-For", "10.0.0.1", 8));
+        httpp_forward_set_route(&fw, "/items?x=1", 10);
+
+        const char* expected =
+            "POST /items?x=1 HTTP/1.1\r\n"
+            "Host: backend:8080\r\n"
+            "Content-Length: 4\r\n"
+            "Accept: */*\r\n"
+            "X-Forwarded-For: 10.0.0.1\r\n"
+            "\r\n"
+            "body";
+
+        size_t len = 0;
+        char* out = httpp_forward_to_raw(&fw, &len);
+        ASSERT_EQ_STR(out, expected);
+        ASSERT_EQ_INT(len, strlen(expected));
+        ASSERT_EQ_INT(httpp_forward_len(&fw), len);
+        free(out);
+
+        // Untouched stretches point into the original buffer
+        struct iovec iov[32];
+        int n = httpp_forward_iov(&fw, iov, 32);
+        size_t copied = 0;
+
+        ASSERT(n > 0);
+        for (int i = 0; i < n; i++) {
+            char* p = iov[i].iov_base;
+            if (p < raw || p >= raw + sizeof(raw))
+                copied += iov[i].iov_len;
+        }
+        ASSERT_EQ_INT(copied, strlen("/items?x=1") + strlen("backend:8080")
+                              + strlen("X-Forwarded-For") + 2 + strlen("10.0.0.1") + 2);
+
+        ASSERT_EQ_INT(httpp_forward_iov(&fw, iov, 2), -1);
+    }
+
+    TEST("Forward keeps framing headers listed in Connection") {
+        char smuggle[] =
+            "POST /items HTTP/1.1\r\n"
+            "Host: example.com\r\n"
+            "Content-Length: 23\r\n"
+            "Connection: Content-Length, Host\r\n"
+            "\r\n"
+            "GET /admin HTTP/1.1\r\n\r\n";
+
+        HTTPP_NEW_REQ(req, 8);
+        ASSERT(httpp_parse_request(smuggle, strlen(smuggle), &req) > 0);
+
+        httpp_forward_t fw;
+        httpp_forward_init(&fw, &req, smuggle);
+        ASSERT(httpp_forward_remove_hop_by_hop(&fw));
+
+        const char* expected =
+            "POST /items HTTP/1.1\r\n"
+            "Host: example.com\r\n"
+            "Content-Length: 23\r\n"
+            "\r\n"
+            "GET /admin HTTP/1.1\r\n\r\n";
+
+        char* out = httpp_forward_to_raw(&fw, NULL);
+        ASSERT_EQ_STR(out, expected);
+        free(out);
+    }
+}
+
+void test_scan()
+{
+    char raw[] =
+        "POST /upload HTTP/1.0\r\n"
+        "Host:  example.com  \r\n"
+        "User-Agent: test\r\n"
+        "Connection: keep-alive\r\n"
+        "Content-Length: 5\r\n"
+        "host: second\r\n"
+        "\r\n"
+        "hello"
+        "GET /next HTTP/1.1\r\n";
+
+    TEST("Scan only") {
+        httpp_scan_header_t wanted[] = {HTTPP_SCAN_HEADER("Host"), HTTPP_SCAN_HEADER("X-Missing")};
+        httpp_scan_t scan = {0};
+
+        int head_len = httpp_scan_request(raw, strlen(raw), &scan, wanted, ARR_LEN(wanted));
+        ASSERT(head_len > 0);
+        ASSERT_EQ_INT(scan.header_len, (size_t) head_len);
+        ASSERT(memcmp(raw + head_len, "hello", 5) == 0);
+        ASSERT_EQ_INT(scan.body_len, 5);
+        ASSERT(!scan.chunked);
+        ASSERT(scan.keep_alive);
+        ASSERT_EQ_INT(scan.method, HTTPP_METHOD_POST);
+        ASSERT(httpp_span_eq(&scan.route, "/upload"));
+        ASSERT(httpp_span_eq(&wanted[0].value, "example.com"));
+        ASSERT(wanted[1].value.ptr == NULL);
+    }
+
+    TEST("Scan incomplete and malformed") {
+        httpp_scan_t scan = {0};
+        httpp_scan_header_t wanted[] = {HTTPP_SCAN_HEADER("Host")};
+
+        char partial[] = "GET / HTTP/1.1\r\nHost: a\r\n";
+        ASSERT_EQ_INT(httpp_scan_request(partial, strlen(partial), &scan, wanted, 1), 0);
+
+        char chunked[] = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+        ASSERT(httpp_scan_request(chunked, strlen(chunked), &scan, wanted, 1) > 0);
+        ASSERT(scan.chunked && scan.body_len == 0);
+
+        char same[] = "POST / HTTP/1.1\r\nContent-Length: 3\r\ncontent-length: 3\r\n\r\n";
+        ASSERT(httpp_scan_request(same, strlen(same), &scan, wanted, 1) > 0);
+        ASSERT(!scan.chunked && scan.body_len == 3);
+
+        char bad[][80] = {
+            "GET / HTTP/1.1\r\nno colon\r\n\r\n",
+            "GET / HTTP/1.1\r\n folded: x\r\n\r\n",
+            "GET / HTTP/1.1\r\nContent-Length: x\r\n\r\n",
+            "GET / HTTP/1.1\r\nBare: lf\nHost: a\r\n\r\n",
+            "GET /\r\n\r\n",
+            // Ambiguous framing
+            "POST / HTTP/1.1\r\nContent-Length: 0\r\nContent-Length: 50\r\n\r\n",
+            "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 3\r\n\r\n",
+            "POST / HTTP/1.1\r\nContent-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n",
+        };
+
+        for (size_t i = 0; i < ARR_LEN(bad); i++)
+            ASSERT_EQ_INT(httpp_scan_request(bad[i], strlen(bad[i]), &scan, wanted, 1), -1);
+    }
+}
+
+void test_parse_lazy()
+{
+    char raw[] =
+        "GET /lazy HTTP/1.1\r\n"
+        "Host: example.com\r\n"
+        "Connection: close\r\n"
+        "Cookie: a=1\r\n"
+        "\r\n"
+        "tail";
+
+    TEST("Lazy parse splits headers on demand") {
+        HTTPP_NEW_REQ(req, 8);
+
+        ASSERT_EQ_INT(httpp_parse_request_lazy(raw, strlen(raw), &req), (int) strlen(raw) - 4);
+        ASSERT(httpp_span_eq(&req.route, "/lazy"));
+        ASSERT(httpp_span_eq(&req.body, "tail"));
+
+        // Nothing split yet, Connection not applied
+        ASSERT_EQ_INT(req.headers.length, 0);
+        ASSERT(req.keep_alive);
+
+        // The plain lookup only sees the array
+        ASSERT(httpp_find_header(req, "host") == NULL);
+
+        httpp_header_t* host = httpp_req_find_header(&req, "host");
+        ASSERT(host && httpp_span_eq(&host->value, "example.com"));
+        ASSERT_EQ_INT(req.headers.length, 3);
+        ASSERT(!req.keep_alive);
+
+        // Split only once, later calls reuse the array
+        ASSERT(httpp_req_split_headers(&req));
+        ASSERT_EQ_INT(req.headers.length, 3);
+        ASSERT(httpp_find_header(req, "cookie") == &req.headers.arr[2]);
+
+        // A full parse into the same request drops the block
+        ASSERT(httpp_parse_request_lazy(raw, strlen(raw), &req) > 0);
+        ASSERT(httpp_parse_request(raw, strlen(raw), &req) > 0);
+        ASSERT(req.unsplit.ptr == NULL);
+    }
+
+    TEST("Headers array set up by hand") {
+        httpp_header_t arr[2];
+        httpp_headers_arr_t hs;
+
+        hs.arr = arr;
+        hs.capacity = 2;
+        hs.length = 0;
+
+        char line[] = "Host: a";
+        ASSERT(httpp_parse_header(&hs, line, strlen(line)) != NULL);
+        ASSERT(httpp_headers_arr_find(&hs, "host") == &arr[0]);
+    }
+
+    TEST("Lazy parse without headers") {
+        char empty[] = "GET / HTTP/1.1\r\n\r\n";
+        HTTPP_NEW_REQ(req, 8);
+
+        ASSERT_EQ_INT(httpp_parse_request_lazy(empty, strlen(empty), &req), (int) strlen(empty));
+        ASSERT(httpp_req_split_headers(&req));
+        ASSERT_EQ_INT(req.headers.length, 0);
+        ASSERT_EQ_INT(req.body.length, 0);
+    }
+
+    TEST("Lazy parse reports bad headers when split") {
+        char bad[] = "GET / HTTP/1.1\r\nHost: a\r\nno colon\r\n\r\n";
+        char open[] = "GET / HTTP/1.1\r\nHost: a\r\n";
+        HTTPP_NEW_REQ(req, 8);
+
+        ASSERT_EQ_INT(httpp_parse_request_lazy(open, strlen(open), &req), -1);
+
+        httpp_req_init(&req, req_headers, 8);
+        ASSERT(httpp_parse_request_lazy(bad, strlen(bad), &req) > 0);
+        ASSERT(!httpp_req_split_headers(&req));
+        ASSERT(httpp_req_find_header(&req, "host") == NULL);
+    }
+
+    TEST("Request helpers split lazily parsed headers") {
+        char post[] = "POST /up HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello";
+        char chunked[] = "POST /up HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+        httpp_body_stream_t stream;
+
+        HTTPP_NEW_REQ(req, 8);
+        ASSERT(httpp_parse_request_lazy(post, strlen(post), &req) > 0);
+        ASSERT_EQ_INT(httpp_body_stream_init(&stream, &req, 0, NULL, NULL), 0);
+        ASSERT(stream.content_length == 5 && stream.pending_len == 5);
+
+        httpp_req_init(&req, req_headers, 8);
+        ASSERT(httpp_parse_request_lazy(chunked, strlen(chunked), &req) > 0);
+        ASSERT_EQ_INT(httpp_body_stream_init(&stream, &req, 0, NULL, NULL), -1);
+
+        char ws[] =
+            "GET /chat HTTP/1.1\r\n"
+            "Host: a\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "\r\n";
+        char out[HTTPP_WS_HANDSHAKE_LEN];
+
+        httpp_req_init(&req, req_headers, 8);
+        ASSERT(httpp_parse_request_lazy(ws, strlen(ws), &req) > 0);
+        ASSERT_EQ_INT(httpp_ws_handshake(&req, out), HTTPP_WS_HANDSHAKE_LEN);
+
+        char range[] = "GET / HTTP/1.1\r\nRange: bytes=0-9\r\nIf-Range: \"v1\"\r\n\r\n";
+        httpp_resource_t resource = {"\"v1\"", 784111777, 100};
+        httpp_cond_result_t result;
+
+        httpp_req_init(&req, req_headers, 8);
+        ASSERT(httpp_parse_request_lazy(range, strlen(range), &req) > 0);
+        ASSERT_EQ_INT(httpp_evaluate_conditional(&req, &resource, &result), 206);
+
+        char cookie[] = "GET / HTTP/1.1\r\nCookie: a=1; b=2\r\n\r\n";
+        httpp_cookie_t c;
+
+        httpp_req_init(&req, req_headers, 8);
+        ASSERT(httpp_parse_request_lazy(cookie, strlen(cookie), &req) > 0);
+        ASSERT(httpp_req_find_cookie(&req, "b", &c) && httpp_span_eq(&c.value, "2"));
+
+        httpp_log_format_t fmt;
+        httpp_log_t log;
+        char buf[64];
+        httpp_span_t addr = {"10.0.0.1", 8, false};
+        httpp_log_entry_t e = {&req, addr, 200, 0, 0, 0};
+
+        httpp_req_init(&req, req_headers, 8);
+        ASSERT(httpp_parse_request_lazy(raw, strlen(raw), &req) > 0);
+        ASSERT(httpp_log_format_init(&fmt, "${http_host}", HTTPP_LOG_ESCAPE_DEFAULT));
+        httpp_log_init(&log, buf, sizeof(buf), -1);
+        ASSERT(httpp_log_write(&log, &fmt, &e));
+        buf[log.len] = '\0';
+        ASSERT_EQ_STR(buf, "example.com\n");
+    }
+}
+
+void test_allowlist()
+{
+    const char* names[] = {"Host", "Content-Type", "Authorization", "X-Request-Id"};
+
+    TEST("Allowlist lookups") {
+        httpp_allowlist_t al;
+        ASSERT(httpp_allowlist_init(&al, names, ARR_LEN(names)));
+
+        ASSERT(httpp_allowlist_has(&al, "host", 4));
+        ASSERT(httpp_allowlist_has(&al, "CONTENT-TYPE", 12));
+        ASSERT(httpp_allowlist_has(&al, "x-request-id", 12));
+        ASSERT(!httpp_allowlist_has(&al, "Hosts", 5));
+        ASSERT(!httpp_allowlist_has(&al, "Content-Length", 14));
+        ASSERT(!httpp_allowlist_has(&al, "", 0));
+
+        const char* dup[] = {"Host", "host"};
+        const char* empty[] = {""};
+        ASSERT(!httpp_allowlist_init(&al, dup, 2));
+        ASSERT(!httpp_allowlist_init(&al, empty, 1));
+    }
+
+    TEST("Allowlist of names differing in one letter") {
+        const char* fetch[] = {"Sec-Fetch-Site", "Sec-Fetch-Mode"};
+        const char* browser[] = {
+            "Sec-Fetch-Site", "Sec-Fetch-Mode", "Sec-Fetch-Dest", "Sec-Fetch-User",
+            "Sec-CH-UA", "Sec-CH-UA-Mobile", "Sec-CH-UA-Platform", "Accept-Language",
+        };
+        httpp_allowlist_t al;
+
+        ASSERT(httpp_allowlist_init(&al, fetch, ARR_LEN(fetch)));
+        ASSERT(httpp_allowlist_init(&al, browser, ARR_LEN(browser)));
+
+        for (size_t i = 0; i < ARR_LEN(browser); i++)
+            ASSERT(httpp_allowlist_has(&al, browser[i], strlen(browser[i])));
+
+        ASSERT(!httpp_allowlist_has(&al, "Sec-Fetch-Hide", 14));
+        ASSERT(!httpp_allowlist_has(&al, "Sec-CH-UA-Model", 15));
+
+        // A full list of generated names fits as well
+        char gen[HTTPP_ALLOWLIST_MAX][16];
+        const char* full[HTTPP_ALLOWLIST_MAX];
+
+        for (size_t i = 0; i < HTTPP_ALLOWLIST_MAX; i++) {
+            snprintf(gen[i], sizeof(gen[i]), "X-Header-%02zu", i);
+            full[i] = gen[i];
+        }
+        ASSERT(httpp_allowlist_init(&al, full, HTTPP_ALLOWLIST_MAX));
+    }
+
+    TEST("Parse keeps allowed headers only") {
+        char raw[] =
+            "POST /upload HTTP/1.1\r\n"
+            "Host: example.com\r\n"
+            "User-Agent: curl\r\n"
+            "Accept: */*\r\n"
+            "Accept-Language: en\r\n"
+            "Connection: close\r\n"
+            "content-type: text/plain\r\n"
+            "Cookie: a=1\r\n"
+            "\r\n"
+            "data";
+
+        httpp_allowlist_t al;
+        ASSERT(httpp_allowlist_init(&al, names, ARR_LEN(names)));
+
+        // Two slots are enough for seven headers
+        HTTPP_NEW_REQ(req, 2);
+        ASSERT_EQ_INT(httpp_parse_request_allow(raw, strlen(raw), &req, &al), (int) strlen(raw) - 4);
+        ASSERT_EQ_INT(req.headers.length, 2);
+        ASSERT(httpp_span_eq(&req.headers.arr[0].value, "example.com"));
+        ASSERT(httpp_span_eq(&req.headers.arr[1].value, "text/plain"));
+        ASSERT(httpp_find_header(req, "cookie") == NULL);
+        ASSERT(!req.keep_alive); // Connection is applied without being kept
+        ASSERT(httpp_span_eq(&req.body, "data"));
+
+        // Skipped headers are still validated
+        char bad[] = "GET / HTTP/1.1\r\nHost: a\r\nno colon\r\n\r\n";
+        httpp_req_init(&req, req_headers, 2);
+        ASSERT_EQ_INT(httpp_parse_request_allow(bad, strlen(bad), &req, &al), -1);
+    }
+}
+
+// Cached parse of `raw` must give the same request as httpp_parse_request
+static bool cached_matches_full(char* raw, httpp_header_cache_t* cache)
+{
+    HTTPP_NEW_REQ(full, 16);
+    HTTPP_NEW_REQ(cached, 16);
+
+    int a = httpp_parse_request(raw, strlen(raw), &full);
+    int b = httpp_parse_request_cached(raw, strlen(raw), &cached, cache);
+
+    if (a != b || full.headers.length != cached.headers.length || full.keep_alive != cached.keep_alive)
+        return false;
+
+    for (size_t i = 0; i < full.headers.length; i++) {
+        httpp_header_t* x = &full.headers.arr[i];
+        httpp_header_t* y = &cached.headers.arr[i];
+
+        if (x->name.ptr != y->name.ptr || x->name.length != y->name.length
+            || x->value.ptr != y->value.ptr || x->value.length != y->value.length)
+            return false;
+    }
+
+    return full.body.ptr == cached.body.ptr && full.body.length == cached.body.length;
+}
+
+void test_header_cache()
+{
+    char first[] =
+        "GET / HTTP/1.1\r\nHost: example.com\r\nUser-Agent: test\r\nCookie: s=1\r\nAccept: */*\r\n\r\n";
+    char same[] =
+        "GET /app.js HTTP/1.1\r\nHost: example.com\r\nUser-Agent: test\r\nCookie: s=1\r\nAccept: */*\r\n\r\n";
+    char cookie[] =
+        "GET /img.png HTTP/1.1\r\nHost: example.com\r\nUser-Agent: test\r\nCookie: s=22\r\nAccept: */*\r\n\r\nbody";
+    char closing[] =
+        "GET /bye HTTP/1.1\r\nHost: example.com\r\nUser-Agent: test\r\nCookie: s=22\r\nConnection: close\r\n\r\n";
+
+    TEST("Header cache gives the same result as the full parse") {
+        httpp_header_cache_t* cache = malloc(sizeof(*cache));
+        httpp_header_cache_init(cache);
+
+        ASSERT(cached_matches_full(first, cache));
+        ASSERT_EQ_INT(cache->hits, 0);
+        ASSERT_EQ_INT(cache->lines_len, 4);
+
+        ASSERT(cached_matches_full(same, cache));
+        ASSERT_EQ_INT(cache->hits, 1);
+
+        // Host and User-Agent are reused, Cookie is parsed, Accept is reused again
+        ASSERT(cached_matches_full(cookie, cache));
+        ASSERT_EQ_INT(cache->reused, 3);
+
+        ASSERT(cached_matches_full(closing, cache));
+        ASSERT(cached_matches_full(closing, cache));
+        ASSERT_EQ_INT(cache->hits, 2);
+
+        char bad[] = "GET / HTTP/1.1\r\nHost: example.com\r\nno colon\r\n\r\n";
+        HTTPP_NEW_REQ(req, 16);
+        ASSERT_EQ_INT(httpp_parse_request_cached(bad, strlen(bad), &req, cache), -1);
+
+        free(cache);
+    }
+}
+
+typedef struct {
+    char   data[128 * 1024];
+    size_t len;
+    int    frames;
+    int    messages;
+    int    last_message;
+} ws_sink_t;
+
+static int ws_on_data(void* ctx, const httpp_ws_frame_t* frame, char* data, size_t len)
+{
+    ws_sink_t* sink = ctx;
+
+    // Control frames are not part of the message
+    if (frame->opcode & 0x8)
+        return 0;
+
+    memcpy(sink->data + sink->len, data, len);
+    sink->len += len;
+    return 0;
+}
+
+static int ws_on_end(void* ctx, const httpp_ws_frame_t* frame)
+{
+    ws_sink_t* sink = ctx;
+
+    sink->frames++;
+    if (frame->fin && !(frame->opcode & 0x8)) {
+        sink->messages++;
+        sink->last_message = frame->message;
+    }
+    return 0;
+}
+
+static const httpp_ws_callbacks_t ws_callbacks = {NULL, ws_on_data, ws_on_end};
+
+// Feeds `n` bytes of `raw` in pieces of `step` into a fresh parser
+static int ws_feed_steps(ws_sink_t* sink, bool server, char* raw, size_t n, size_t step)
+{
+    httpp_ws_parser_t p;
+    httpp_ws_parser_init(&p, server, 1 << 20, &ws_callbacks, sink);
+
+    memset(sink, 0, sizeof(*sink));
+
+    for (size_t off = 0; off < n; off += step) {
+        if (httpp_ws_feed(&p, raw + off, off + step < n ? step : n - off) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+void test_ws()
+{
+    TEST("WebSocket handshake") {
+        char accept[HTTPP_WS_ACCEPT_LEN + 1];
+
+        // RFC 6455, 1.3
+        ASSERT(httpp_ws_accept("dGhlIHNhbXBsZSBub25jZQ==", 24, accept));
+        ASSERT(strcmp(accept, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == 0);
+        ASSERT(!httpp_ws_accept("short", 5, accept));
+
+        char raw[] =
+            "GET /chat HTTP/1.1\r\n"
+            "Host: server.example.com\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: keep-alive, Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "\r\n";
+
+        HTTPP_NEW_REQ(req, 8);
+        ASSERT(httpp_parse_request(raw, strlen(raw), &req) > 0);
+        ASSERT(httpp_ws_is_upgrade(&req));
+
+        char out[HTTPP_WS_HANDSHAKE_LEN];
+        const char expected[] =
+            "HTTP/1.1 101 Switching Protocols\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"
+            "\r\n";
+
+        ASSERT_EQ_INT(httpp_ws_handshake(&req, out), HTTPP_WS_HANDSHAKE_LEN);
+        ASSERT(sizeof(expected) - 1 == HTTPP_WS_HANDSHAKE_LEN && memcmp(out, expected, HTTPP_WS_HANDSHAKE_LEN) == 0);
+
+        char plain[] = "GET /chat HTTP/1.1\r\nHost: a\r\nUpgrade: websocket\r\n\r\n";
+        HTTPP_NEW_REQ(no, 8);
+        ASSERT(httpp_parse_request(plain, strlen(plain), &no) > 0);
+        ASSERT(!httpp_ws_is_upgrade(&no));
+        ASSERT_EQ_INT(httpp_ws_handshake(&no, out), -1);
+    }
+
+    TEST("WebSocket frames in any pieces") {
+        static ws_sink_t sink;
+
+        // RFC 6455, 5.7: masked "Hello", then fragmented unmasked "Hel" + ping + "lo"
+        char masked[] = "\x81\x85\x37\xfa\x21\x3d\x7f\x9f\x4d\x51\x58";
+        char fragmented[] = "\x01\x03Hel\x89\x00\x80\x02lo";
+
+        for (size_t step = 1; step <= 12; step++) {
+            char copy[sizeof(masked)];
+            memcpy(copy, masked, sizeof(masked));
+
+            ASSERT_EQ_INT(ws_feed_steps(&sink, true, copy, sizeof(masked) - 1, step), 0);
+            ASSERT(sink.len == 5 && memcmp(sink.data, "Hello", 5) == 0);
+            ASSERT(sink.messages == 1 && sink.last_message == HTTPP_WS_TEXT);
+
+            ASSERT_EQ_INT(ws_feed_steps(&sink, false, fragmented, sizeof(fragmented) - 1, step), 0);
+            ASSERT(sink.len == 5 && memcmp(sink.data, "Hello", 5) == 0);
+            ASSERT(sink.frames == 3 && sink.messages == 1);
+        }
+    }
+
+    TEST("WebSocket frame round trip") {
+        static ws_sink_t sink;
+        static char wire[2 * 70000 + 64];
+        static char payload[70000];
+        unsigned char mask[4] = {0xde, 0xad, 0xbe, 0xef};
+        size_t sizes[] = {0, 125, 200, 70000};
+
+        for (size_t i = 0; i < sizeof(payload); i++)
+            payload[i] = (char) (i * 7);
+
+        for (size_t i = 0; i < ARR_LEN(sizes); i++) {
+            size_t n = httpp_ws_frame_header(wire, HTTPP_WS_BINARY, true, sizes[i], mask);
+            memcpy(wire + n, payload, sizes[i]);
+            httpp_ws_mask(wire + n, sizes[i], mask, 0);
+
+            ASSERT_EQ_INT(n, sizes[i] < 126 ? 6 : sizes[i] <= 0xFFFF ? 8 : 14);
+            ASSERT_EQ_INT(ws_feed_steps(&sink, true, wire, n + sizes[i], 4093), 0);
+            ASSERT(sink.len == sizes[i] && memcmp(sink.data, payload, sizes[i]) == 0);
+            ASSERT(sink.messages == 1 && sink.last_message == HTTPP_WS_BINARY);
+        }
+    }
+
+    TEST("WebSocket protocol errors") {
+        static ws_sink_t sink;
+        char unmasked[] = "\x81\x02hi";            // From a client
+        char rsv[] = "\xc1\x00";                   // RSV1 without extension
+        char orphan[] = "\x80\x00";                // Continuation outside a message
+        char interleaved[] = "\x01\x01" "a" "\x01\x01" "b"; // New message before FIN
+        char long_ping[] = "\x89\x7e\x00\x7e";     // Control frame over 125 bytes
+        char fragmented_ping[] = "\x09\x00";
+
+        ASSERT_EQ_INT(ws_feed_steps(&sink, true, unmasked, 4, 4), -1);
+        ASSERT_EQ_INT(ws_feed_steps(&sink, false, rsv, 2, 2), -1);
+        ASSERT_EQ_INT(ws_feed_steps(&sink, false, orphan, 2, 2), -1);
+        ASSERT_EQ_INT(ws_feed_steps(&sink, false, interleaved, 6, 6), -1);
+        ASSERT_EQ_INT(ws_feed_steps(&sink, false, long_ping, 4, 4), -1);
+        ASSERT_EQ_INT(ws_feed_steps(&sink, false, fragmented_ping, 2, 2), -1);
+    }
+}
+
+// Decodes `len` bytes of `bytes`, the request goes to `req`
+static int hpack(httpp_hpack_t* hp, const unsigned char* bytes, size_t len, httpp_req_t* req,
+                 char* arena, size_t arena_cap)
+{
+    req->headers.length = 0;
+    return httpp_hpack_decode(hp, (const char*) bytes, len, req, arena, arena_cap);
+}
+
+void test_hpack()
+{
+    // RFC 7541, C.3 and C.4: the same three requests without and with Huffman coding
+    static const unsigned char raw1[] = {0x82, 0x86, 0x84, 0x41, 0x0f, 'w', 'w', 'w', '.', 'e', 'x', 'a', 'm',
+                                         'p', 'l', 'e', '.', 'c', 'o', 'm'};
+    static const unsigned char raw2[] = {0x82, 0x86, 0x84, 0xbe, 0x58, 0x08, 'n', 'o', '-', 'c', 'a', 'c', 'h', 'e'};
+    static const unsigned char raw3[] = {0x82, 0x87, 0x85, 0xbf, 0x40, 0x0a, 'c', 'u', 's', 't', 'o', 'm', '-', 'k',
+                                         'e', 'y', 0x0c, 'c', 'u', 's', 't', 'o', 'm', '-', 'v', 'a', 'l', 'u', 'e'};
+    static const unsigned char huff1[] = {0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b,
+                                          0xa0, 0xab, 0x90, 0xf4, 0xff};
+    static const unsigned char huff2[] = {0x82, 0x86, 0x84, 0xbe, 0x58, 0x86, 0xa8, 0xeb, 0x10, 0x64, 0x9c, 0xbf};
+    static const unsigned char huff3[] = {0x82, 0x87, 0x85, 0xbf, 0x40, 0x88, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xa9,
+                                          0x7d, 0x7f, 0x89, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xb8, 0xe8, 0xb4, 0xbf};
+
+    const unsigned char* blocks[2][3] = {{raw1, raw2, raw3}, {huff1, huff2, huff3}};
+    size_t lens[2][3] = {{sizeof(raw1), sizeof(raw2), sizeof(raw3)}, {sizeof(huff1), sizeof(huff2), sizeof(huff3)}};
+
+    for (int h = 0; h < 2; h++) TEST(h ? "HPACK RFC 7541 C.4 requests" : "HPACK RFC 7541 C.3 requests") {
+        static httpp_hpack_t hp;
+        char arena[256];
+        HTTPP_NEW_REQ(req, 8);
+
+        httpp_hpack_init(&hp);
+
+        int used = hpack(&hp, blocks[h][0], lens[h][0], &req, arena, sizeof(arena));
+        ASSERT_EQ_INT(used, h ? 15 : 0);
+        ASSERT_EQ_INT(req.method, HTTPP_METHOD_GET);
+        ASSERT(httpp_span_eq(&req.route, "/"));
+        ASSERT_EQ_INT(req.version_major, 2);
+        ASSERT(req.keep_alive);
+        ASSERT_EQ_INT(req.body.length, 0);
+        ASSERT_EQ_INT(req.headers.length, 1);
+        ASSERT(httpp_span_eq(&req.headers.arr[0].name, "host"));
+        ASSERT(httpp_span_eq(&req.headers.arr[0].value, "www.example.com"));
+        ASSERT_EQ_INT(hp.size, 57);
+
+        used = hpack(&hp, blocks[h][1], lens[h][1], &req, arena, sizeof(arena));
+        ASSERT(used >= 15); // Host comes from the dynamic table
+        ASSERT_EQ_INT(req.headers.length, 2);
+        ASSERT(httpp_span_eq(&req.headers.arr[0].value, "www.example.com"));
+        ASSERT(httpp_span_eq(&req.headers.arr[1].name, "cache-control"));
+        ASSERT(httpp_span_eq(&req.headers.arr[1].value, "no-cache"));
+        ASSERT_EQ_INT(hp.size, 110);
+
+        used = hpack(&hp, blocks[h][2], lens[h][2], &req, arena, sizeof(arena));
+        ASSERT(used >= 0);
+        ASSERT(httpp_span_eq(&req.route, "/index.html"));
+        ASSERT_EQ_INT(req.headers.length, 2);
+        ASSERT(httpp_span_eq(&req.headers.arr[0].value, "www.example.com"));
+        ASSERT(httpp_span_eq(&req.headers.arr[1].name, "custom-key"));
+        ASSERT(httpp_span_eq(&req.headers.arr[1].value, "custom-value"));
+        ASSERT_EQ_INT(hp.count, 3);
+        ASSERT_EQ_INT(hp.size, 164);
+    }
+
+    TEST("HPACK dynamic table eviction") {
+        static httpp_hpack_t hp;
+        char arena[256];
+        HTTPP_NEW_REQ(req, 8);
+        unsigned char block[128] = {0x82, 0x86, 0x84, 0x40, 0x05, 'x', '-', 'k', 'e', 'y', 60};
+
+        httpp_hpack_init(&hp);
+
+        // 97 bytes an entry, the ring wraps around several times
+        for (int i = 0; i < 200; i++) {
+            memset(block + 11, 'a' + i % 26, 60);
+            ASSERT_EQ_INT(hpack(&hp, block, 71, &req, arena, sizeof(arena)), 0);
+        }
+
+        ASSERT_EQ_INT(hp.count, HTTPP_HPACK_TABLE_SIZE / 97);
+        ASSERT(hp.size <= HTTPP_HPACK_TABLE_SIZE);
+
+        // Newest is 62, oldest is 62 + count - 1
+        unsigned char refs[] = {0x82, 0x86, 0x84, 0xbe, 0x80 | (62 + 41)};
+        ASSERT_EQ_INT(hpack(&hp, refs, sizeof(refs), &req, arena, sizeof(arena)), 2 * 65);
+        ASSERT_EQ_INT(req.headers.length, 2);
+        ASSERT(httpp_span_eq(&req.headers.arr[0].name, "x-key"));
+        ASSERT(req.headers.arr[0].value.length == 60 && req.headers.arr[0].value.ptr[59] == 'a' + 199 % 26);
+        ASSERT(req.headers.arr[1].value.length == 60 && req.headers.arr[1].value.ptr[0] == 'a' + (199 - 41) % 26);
+
+        refs[4] = 0x80 | (62 + 42);
+        ASSERT_EQ_INT(hpack(&hp, refs, sizeof(refs), &req, arena, sizeof(arena)), HTTPP_HPACK_ERROR);
+
+        // Size update to 0 empties the table
+        unsigned char empty[] = {0x20, 0x82, 0x86, 0x84};
+        ASSERT_EQ_INT(hpack(&hp, empty, sizeof(empty), &req, arena, sizeof(arena)), 0);
+        ASSERT_EQ_INT(hp.count, 0);
+        ASSERT_EQ_INT(hp.size, 0);
+
+        // Entries bigger than the table are not added
+        ASSERT_EQ_INT(hpack(&hp, block, 71, &req, arena, sizeof(arena)), 0);
+        ASSERT_EQ_INT(hp.count, 0);
+    }
+
+    TEST("HPACK errors") {
+        static httpp_hpack_t hp;
+        char arena[32];
+        HTTPP_NEW_REQ(req, 8);
+
+        httpp_hpack_init(&hp);
+
+        static const unsigned char zero[] = {0x80};
+        static const unsigned char no_entry[] = {0x82, 0xbe};
+        static const unsigned char late_update[] = {0x82, 0x3f, 0xe1, 0x1f};
+        static const unsigned char big_update[] = {0x3f, 0xe2, 0x1f};
+        static const unsigned char short_string[] = {0x82, 0x86, 0x84, 0x01, 0x05, 'a', 'b'};
+        static const unsigned char long_int[] = {0x82, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+        static const unsigned char long_padding[] = {0x82, 0x86, 0x84, 0x01, 0x82, 0xff, 0xff};
+        static const unsigned char eos[] = {0x82, 0x86, 0x84, 0x01, 0x84, 0xff, 0xff, 0xff, 0xff};
+        static const unsigned char bad_padding[] = {0x82, 0x86, 0x84, 0x01, 0x81, 0x00};
+
+        ASSERT_EQ_INT(hpack(&hp, zero, sizeof(zero), &req, arena, sizeof(arena)), HTTPP_HPACK_ERROR);
+        ASSERT_EQ_INT(hpack(&hp, no_entry, sizeof(no_entry), &req, arena, sizeof(arena)), HTTPP_HPACK_ERROR);
+        ASSERT_EQ_INT(hpack(&hp, late_update, sizeof(late_update), &req, arena, sizeof(arena)), HTTPP_HPACK_ERROR);
+        ASSERT_EQ_INT(hpack(&hp, big_update, sizeof(big_update), &req, arena, sizeof(arena)), HTTPP_HPACK_ERROR);
+        ASSERT_EQ_INT(hpack(&hp, short_string, sizeof(short_string), &req, arena, sizeof(arena)), HTTPP_HPACK_ERROR);
+        ASSERT_EQ_INT(hpack(&hp, long_int, sizeof(long_int), &req, arena, sizeof(arena)), HTTPP_HPACK_ERROR);
+        ASSERT_EQ_INT(hpack(&hp, long_padding, sizeof(long_padding), &req, arena, sizeof(arena)), HTTPP_HPACK_ERROR);
+        ASSERT_EQ_INT(hpack(&hp, eos, sizeof(eos), &req, arena, sizeof(arena)), HTTPP_HPACK_ERROR);
+        ASSERT_EQ_INT(hpack(&hp, bad_padding, sizeof(bad_padding), &req, arena, sizeof(arena)), HTTPP_HPACK_ERROR);
+
+        // Huffman output doesn't fit the arena
+        ASSERT_EQ_INT(hpack(&hp, huff1, sizeof(huff1), &req, arena, 8), HTTPP_HPACK_ERROR);
+        ASSERT_EQ_INT(hpack(&hp, huff1, sizeof(huff1), &req, NULL, 0), HTTPP_HPACK_ERROR);
+    }
+
+    TEST("HPACK malformed requests") {
+        static httpp_hpack_t hp;
+        char arena[64];
+        HTTPP_NEW_REQ(req, 8);
+
+        httpp_hpack_init(&hp);
+
+        static const unsigned char no_path[] = {0x82, 0x86};
+        static const unsigned char upper[] = {0x82, 0x86, 0x84, 0x00, 0x01, 'X', 0x01, 'y'};
+        static const unsigned char late_pseudo[] = {0x82, 0x86, 0x00, 0x01, 'x', 0x01, 'y', 0x84};
+        static const unsigned char twice[] = {0x82, 0x86, 0x84, 0x83};
+        static const unsigned char unknown[] = {0x82, 0x86, 0x84, 0x00, 0x03, ':', 'x', 'y', 0x00};
+        static const unsigned char status[] = {0x82, 0x86, 0x84, 0x88};
+        static const unsigned char connect[] = {0x00, 0x07, ':', 'm', 'e', 't', 'h', 'o', 'd', 0x07, 'C', 'O', 'N',
+                                                'N', 'E', 'C', 'T', 0x01, 0x03, 'a', ':', '1'};
+
+        ASSERT_EQ_INT(hpack(&hp, no_path, sizeof(no_path), &req, arena, sizeof(arena)), HTTPP_HPACK_MALFORMED);
+        ASSERT_EQ_INT(hpack(&hp, upper, sizeof(upper), &req, arena, sizeof(arena)), HTTPP_HPACK_MALFORMED);
+        ASSERT_EQ_INT(hpack(&hp, late_pseudo, sizeof(late_pseudo), &req, arena, sizeof(arena)), HTTPP_HPACK_MALFORMED);
+        ASSERT_EQ_INT(hpack(&hp, twice, sizeof(twice), &req, arena, sizeof(arena)), HTTPP_HPACK_MALFORMED);
+        ASSERT_EQ_INT(hpack(&hp, unknown, sizeof(unknown), &req, arena, sizeof(arena)), HTTPP_HPACK_MALFORMED);
+        ASSERT_EQ_INT(hpack(&hp, status, sizeof(status), &req, arena, sizeof(arena)), HTTPP_HPACK_MALFORMED);
+
+        ASSERT_EQ_INT(hpack(&hp, connect, sizeof(connect), &req, arena, sizeof(arena)), 0);
+        ASSERT_EQ_INT(req.method, HTTPP_METHOD_CONNECT);
+        ASSERT(httpp_span_eq(&req.headers.arr[0].value, "a:1"));
+
+        // Connection specific header, the entry is still added so the next block decodes
+        static const unsigned char conn[] = {0x82, 0x86, 0x84, 0x40, 0x0a, 'c', 'o', 'n', 'n', 'e', 'c', 't', 'i',
+                                             'o', 'n', 0x05, 'c', 'l', 'o', 's', 'e'};
+        static const unsigned char after[] = {0x82, 0x86, 0x84, 0xbe};
+
+        ASSERT_EQ_INT(hpack(&hp, conn, sizeof(conn), &req, arena, sizeof(arena)), HTTPP_HPACK_MALFORMED);
+        ASSERT_EQ_INT(hp.count, 1);
+        ASSERT_EQ_INT(hpack(&hp, after, sizeof(after), &req, arena, sizeof(arena)), HTTPP_HPACK_MALFORMED);
+        ASSERT_EQ_INT(req.headers.length, 0); // Rejected fields are not appended
+
+        // Headers array is full
+        HTTPP_NEW_REQ(small, 1);
+        small.headers.length = 0;
+        ASSERT_EQ_INT(httpp_hpack_decode(&hp, (const char*) huff3, sizeof(huff3), &small, arena, sizeof(arena)),
+                      HTTPP_HPACK_ERROR); // :authority refers to an entry this table doesn't have
+        static const unsigned char two[] = {0x82, 0x86, 0x84, 0x41, 0x01, 'a', 0x58, 0x01, 'b'};
+        ASSERT_EQ_INT(httpp_hpack_decode(&hp, (const char*) two, sizeof(two), &small, arena, sizeof(arena)),
+                      HTTPP_HPACK_MALFORMED);
+    }
+}
+
+void test_proxy()
+{
+    TEST("PROXY v1 followed by a request") {
+        char raw[] = "PROXY TCP4 192.0.2.1 198.51.100.2 56324 443\r\nGET /a HTTP/1.1\r\nHost: example.com\r\n\r\nbody";
+        httpp_proxy_t proxy;
+        HTTPP_NEW_REQ(req, 8);
+
+        int off = httpp_parse_proxy_request(raw, strlen(raw), &proxy, &req);
+        ASSERT_EQ_INT(off, (int) strlen(raw) - 4);
+        ASSERT_EQ_INT(proxy.version, 1);
+        ASSERT(!proxy.local);
+        ASSERT_EQ_INT(proxy.family, HTTPP_PROXY_INET);
+        ASSERT_EQ_INT(proxy.transport, HTTPP_PROXY_STREAM);
+        ASSERT(httpp_span_eq(&proxy.src, "192.0.2.1"));
+        ASSERT(httpp_span_eq(&proxy.dst, "198.51.100.2"));
+        ASSERT(proxy.src.ptr == raw + 11); // Not copied
+        ASSERT_EQ_INT(proxy.src_port, 56324);
+        ASSERT_EQ_INT(proxy.dst_port, 443);
+        ASSERT_EQ_INT(proxy.tlvs.length, 0);
+        ASSERT_EQ_INT(req.method, HTTPP_METHOD_GET);
+        ASSERT(httpp_span_eq(&req.route, "/a"));
+        ASSERT_EQ_INT(req.headers.length, 1);
+        ASSERT(httpp_span_eq(&req.body, "body"));
+
+        char v6[] = "PROXY TCP6 2001:db8::1 ::1 1 65535\r\n";
+        ASSERT_EQ_INT(httpp_parse_proxy(v6, strlen(v6), &proxy), (int) strlen(v6));
+        ASSERT_EQ_INT(proxy.family, HTTPP_PROXY_INET6);
+        ASSERT(httpp_span_eq(&proxy.src, "2001:db8::1"));
+        ASSERT(httpp_span_eq(&proxy.dst, "::1"));
+        ASSERT_EQ_INT(proxy.src_port, 1);
+        ASSERT_EQ_INT(proxy.dst_port, 65535);
+
+        char unknown[] = "PROXY UNKNOWN ffff::1 ::1 1 2\r\nGET";
+        ASSERT_EQ_INT(httpp_parse_proxy(unknown, strlen(unknown), &proxy), (int) strlen(unknown) - 3);
+        ASSERT(proxy.local);
+        ASSERT(proxy.src.ptr == NULL);
+
+        char bare[] = "PROXY UNKNOWN\r\n";
+        ASSERT_EQ_INT(httpp_parse_proxy(bare, strlen(bare), &proxy), (int) strlen(bare));
+    }
+
+    TEST("PROXY v1 malformed and incomplete") {
+        httpp_proxy_t proxy;
+        const char* bad[] = {
+            "PROXY TCP4 192.0.2.256 198.51.100.2 1 2\r\n",
+            "PROXY TCP4 192.0.2 198.51.100.2 1 2\r\n",
+            "PROXY TCP4 192.0.2.1 198.51.100.2 1 65536\r\n",
+            "PROXY TCP4 192.0.2.1 198.51.100.2 01 2\r\n",
+            "PROXY TCP4 192.0.2.1  198.51.100.2 1 2\r\n",
+            "PROXY TCP4 192.0.2.1 198.51.100.2 1 2 3\r\n",
+            "PROXY TCP4 192.0.2.1 198.51.100.2 1\r\n",
+            "PROXY TCP6 2001:db8::g ::1 1 2\r\n",
+            "PROXY UDP4 192.0.2.1 198.51.100.2 1 2\r\n",
+            "PROXY TCP4 192.0.2.1 198.51.100.2 1 2\n",
+            "GET / HTTP/1.1\r\n\r\n",
+            "PROXYTCP4\r\n",
+        };
+
+        for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+            char buf[128];
+            strcpy(buf, bad[i]);
+            ASSERT_EQ_INT(httpp_parse_proxy(buf, strlen(buf), &proxy), HTTPP_PROXY_ERROR);
+        }
+
+        char part[] = "PROXY TCP4 192.0.2.1 198.51.100.2 1 2\r";
+        ASSERT_EQ_INT(httpp_parse_proxy(part, strlen(part), &proxy), HTTPP_PROXY_INCOMPLETE);
+        ASSERT_EQ_INT(httpp_parse_proxy(part, 3, &proxy), HTTPP_PROXY_INCOMPLETE);
+        ASSERT_EQ_INT(httpp_parse_proxy(part, 0, &proxy), HTTPP_PROXY_INCOMPLETE);
+
+        // No line end within the longest possible line
+        char longer[HTTPP_PROXY_V1_MAX + 8] = "PROXY TCP6 ";
+        memset(longer + 11, '1', sizeof(longer) - 12);
+        longer[sizeof(longer) - 1] = '\0';
+        ASSERT_EQ_INT(httpp_parse_proxy(longer, strlen(longer), &proxy), HTTPP_PROXY_ERROR);
+
+        // The request isn't there yet
+        char alone[] = "PROXY TCP4 192.0.2.1 198.51.100.2 1 2\r\n";
+        HTTPP_NEW_REQ(req, 8);
+        ASSERT_EQ_INT(httpp_parse_proxy_request(alone, strlen(alone), &proxy, &req), HTTPP_PROXY_INCOMPLETE);
+    }
+
+    // 192.0.2.1:56324 -> 198.51.100.2:443, ALPN h2, AUTHORITY example.com, CRC32C, SSL with TLSv1.3
+    static const unsigned char v2[] = {
+        0x0d, 0x0a, 0x0d, 0x0a, 0x00, 0x0d, 0x0a, 0x51, 0x55, 0x49, 0x54, 0x0a, 0x21, 0x11, 0x00, 0x38,
+        0xc0, 0x00, 0x02, 0x01, 0xc6, 0x33, 0x64, 0x02, 0xdc, 0x04, 0x01, 0xbb, 0x01, 0x00, 0x02, 0x68,
+        0x32, 0x02, 0x00, 0x0b, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x63, 0x6f, 0x6d, 0x03,
+        0x00, 0x04, 0xdf, 0x68, 0xd9, 0x85, 0x20, 0x00, 0x0f, 0x01, 0x00, 0x00, 0x00, 0x00, 0x21, 0x00,
+        0x07, 0x54, 0x4c, 0x53, 0x76, 0x31, 0x2e, 0x33,
+    };
+
+    TEST("PROXY v2 followed by a request") {
+        char raw[256];
+        const char* http = "GET /b HTTP/1.1\r\nHost: example.com\r\n\r\n";
+        size_t n = sizeof(v2) + strlen(http);
+        httpp_proxy_t proxy;
+        httpp_proxy_tlv_t tlv = {0, {NULL, 0, false}};
+        HTTPP_NEW_REQ(req, 8);
+
+        memcpy(raw, v2, sizeof(v2));
+        memcpy(raw + sizeof(v2), http, strlen(http));
+
+        ASSERT_EQ_INT(httpp_parse_proxy_request(raw, n, &proxy, &req), (int) n);
+        ASSERT_EQ_INT(proxy.version, 2);
+        ASSERT(!proxy.local);
+        ASSERT_EQ_INT(proxy.family, HTTPP_PROXY_INET);
+        ASSERT_EQ_INT(proxy.transport, HTTPP_PROXY_STREAM);
+        ASSERT(proxy.src.ptr == raw + 16 && proxy.src.length == 4);
+        ASSERT(memcmp(proxy.src.ptr, "\xc0\x00\x02\x01", 4) == 0);
+        ASSERT(memcmp(proxy.dst.ptr, "\xc6\x33\x64\x02", 4) == 0);
+        ASSERT_EQ_INT(proxy.src_port, 56324);
+        ASSERT_EQ_INT(proxy.dst_port, 443);
+        ASSERT(httpp_span_eq(&req.route, "/b"));
+
+        ASSERT(httpp_proxy_find_tlv(&proxy, HTTPP_PROXY_TLV_ALPN, &tlv));
+        ASSERT(httpp_span_eq(&tlv.value, "h2"));
+        ASSERT(httpp_proxy_find_tlv(&proxy, HTTPP_PROXY_TLV_AUTHORITY, &tlv));
+        ASSERT(httpp_span_eq(&tlv.value, "example.com"));
+        ASSERT(httpp_proxy_find_tlv(&proxy, HTTPP_PROXY_TLV_SSL, &tlv));
+        ASSERT_EQ_INT(tlv.value.length, 15);
+        ASSERT(!httpp_proxy_find_tlv(&proxy, HTTPP_PROXY_TLV_UNIQUE_ID, &tlv));
+
+        httpp_proxy_tlv_iter_t it;
+        int count = 0;
+        httpp_proxy_tlv_iter_init(&it, &proxy);
+        while (httpp_proxy_tlv_next(&it, &tlv))
+            count++;
+        ASSERT_EQ_INT(count, 4);
+
+        // Every prefix is incomplete
+        bool all = true;
+        for (size_t i = 0; i < sizeof(v2); i++)
+            all &= httpp_parse_proxy(raw, i, &proxy) == HTTPP_PROXY_INCOMPLETE;
+        ASSERT(all);
+    }
+
+    TEST("PROXY v2 validation") {
+        char raw[128];
+        httpp_proxy_t proxy;
+
+        // Checksum doesn't match
+        memcpy(raw, v2, sizeof(v2));
+        raw[20] = 1;
+        ASSERT_EQ_INT(httpp_parse_proxy(raw, sizeof(v2), &proxy), HTTPP_PROXY_ERROR);
+
+        // Version 1 in the binary format, unknown command, family, transport
+        int bytes[][2] = {{12, 0x11}, {12, 0x22}, {13, 0x41}, {13, 0x13}};
+        for (size_t i = 0; i < sizeof(bytes) / sizeof(bytes[0]); i++) {
+            memcpy(raw, v2, sizeof(v2));
+            raw[bytes[i][0]] = (char) bytes[i][1];
+            ASSERT_EQ_INT(httpp_parse_proxy(raw, sizeof(v2), &proxy), HTTPP_PROXY_ERROR);
+        }
+
+        // TLV longer than what's left
+        memcpy(raw, v2, sizeof(v2));
+        raw[30] = 0x40;
+        ASSERT_EQ_INT(httpp_parse_proxy(raw, sizeof(v2), &proxy), HTTPP_PROXY_ERROR);
+
+        // LOCAL from a health check, no addresses, a trailing NOOP
+        static const unsigned char local[] = {
+            0x0d, 0x0a, 0x0d, 0x0a, 0x00, 0x0d, 0x0a, 0x51, 0x55, 0x49, 0x54, 0x0a, 0x20, 0x00, 0x00, 0x04,
+            0x04, 0x00, 0x01, 0x00,
+        };
+        memcpy(raw, local, sizeof(local));
+        ASSERT_EQ_INT(httpp_parse_proxy(raw, sizeof(local), &proxy), (int) sizeof(local));
+        ASSERT(proxy.local);
+        ASSERT(proxy.src.ptr == NULL);
+        ASSERT_EQ_INT(proxy.tlvs.length, 4);
+
+        // Address block of INET6 is cut short
+        static const unsigned char short6[] = {
+            0x0d, 0x0a, 0x0d, 0x0a, 0x00, 0x0d, 0x0a, 0x51, 0x55, 0x49, 0x54, 0x0a, 0x21, 0x21, 0x00, 0x04,
+            0x00, 0x00, 0x00, 0x00,
+        };
+        memcpy(raw, short6, sizeof(short6));
+        ASSERT_EQ_INT(httpp_parse_proxy(raw, sizeof(short6), &proxy), HTTPP_PROXY_ERROR);
+    }
+}
+
+void test_expect()
+{
+    TEST("Expect: 100-continue") {
+        char raw[] = "PUT /upload HTTP/1.1\r\nHost: a\r\nContent-Length: 10485760\r\nExpect:  100-Continue \r\n\r\n";
+        HTTPP_NEW_REQ(req, 8);
+
+        ASSERT(httpp_parse_request(raw, strlen(raw), &req) == (int) strlen(raw));
+        ASSERT(req.expect_continue);
+        ASSERT(req.keep_alive);
+
+        // HTTP/1.0 clients can't ask for it, other expectations are only headers
+        char old[] = "PUT /upload HTTP/1.0\r\nExpect: 100-continue\r\n\r\n";
+        char other[] = "PUT /upload HTTP/1.1\r\nExpect: 200-ok\r\n\r\n";
+        char none[] = "PUT /upload HTTP/1.1\r\nExpected: 100-continue\r\n\r\n";
+        HTTPP_NEW_REQ(r2, 8);
+
+        ASSERT(httpp_parse_request(old, strlen(old), &r2) > 0);
+        ASSERT(!r2.expect_continue);
+        ASSERT(httpp_parse_request(other, strlen(other), &r2) > 0);
+        ASSERT(!r2.expect_continue);
+        ASSERT(httpp_parse_request(none, strlen(none), &r2) > 0);
+        ASSERT(!r2.expect_continue);
+    }
+
+    TEST("Expect with the other parsers") {
+        char raw[] = "POST /f HTTP/1.1\r\nHost: a\r\nExpect: 100-continue\r\nContent-Length: 3\r\n\r\n";
+
+        // Looked at even when not allowlisted
+        const char* names[] = {"Host"};
+        httpp_allowlist_t allow;
+        HTTPP_NEW_REQ(a, 1);
+        ASSERT(httpp_allowlist_init(&allow, names, 1));
+        ASSERT(httpp_parse_request_allow(raw, strlen(raw), &a, &allow) > 0);
+        ASSERT(a.expect_continue);
+        ASSERT_EQ_INT(a.headers.length, 1);
+
+        // Lazy: only once the headers are split
+        HTTPP_NEW_REQ(l, 8);
+        ASSERT(httpp_parse_request_lazy(raw, strlen(raw), &l) > 0);
+        ASSERT(!l.expect_continue);
+        ASSERT(httpp_req_split_headers(&l));
+        ASSERT(l.expect_continue);
+
+        // Cached: the second request takes the whole block from the cache
+        static httpp_header_cache_t cache;
+        httpp_header_cache_init(&cache);
+        for (int i = 0; i < 2; i++) {
+            HTTPP_NEW_REQ(c, 8);
+            ASSERT(httpp_parse_request_cached(raw, strlen(raw), &c, &cache) > 0);
+            ASSERT(c.expect_continue);
+        }
+        ASSERT_EQ_INT(cache.hits, 1);
+
+        // HTTP/2
+        static const unsigned char block[] = {0x82, 0x86, 0x84, 0x00, 0x06, 'e', 'x', 'p', 'e', 'c', 't',
+                                              0x0c, '1', '0', '0', '-', 'c', 'o', 'n', 't', 'i', 'n', 'u', 'e'};
+        static httpp_hpack_t hp;
+        char arena[16];
+        HTTPP_NEW_REQ(h2, 8);
+        httpp_hpack_init(&hp);
+        ASSERT_EQ_INT(httpp_hpack_decode(&hp, (const char*) block, sizeof(block), &h2, arena, sizeof(arena)), 0);
+        ASSERT(h2.expect_continue);
+    }
+
+    TEST("Interim responses") {
+        ASSERT_EQ_INT(strlen(HTTPP_CONTINUE), HTTPP_CONTINUE_LEN);
+        ASSERT(strcmp(HTTPP_CONTINUE, "HTTP/1.1 100 Continue\r\n\r\n") == 0);
+
+        const char* links[] = {"</app.css>; rel=preload; as=style", "</app.js>; rel=preload; as=script"};
+        const char expected[] =
+            "HTTP/1.1 103 Early Hints\r\n"
+            "Link: </app.css>; rel=preload; as=style\r\n"
+            "Link: </app.js>; rel=preload; as=script\r\n"
+            "\r\n";
+        char out[256];
+
+        ASSERT_EQ_INT(httpp_early_hints(out, sizeof(out), links, 2), (int) sizeof(expected) - 1);
+        ASSERT(memcmp(out, expected, sizeof(expected) - 1) == 0);
+
+        // Exactly as long as needed, one byte short
+        ASSERT_EQ_INT(httpp_early_hints(out, sizeof(expected) - 1, links, 2), (int) sizeof(expected) - 1);
+        ASSERT_EQ_INT(httpp_early_hints(out, sizeof(expected) - 2, links, 2), -1);
+        ASSERT_EQ_INT(httpp_early_hints(out, 28, NULL, 0), 28);
+        ASSERT_EQ_INT(httpp_early_hints(out, 27, NULL, 0), -1);
+    }
+}
+
+void test_log()
+{
+    TEST("Access log lines") {
+        char raw[] = "GET /index.html?q=1 HTTP/1.1\r\nHost: a\r\nUser-Agent: curl/8.0\r\n\r\n";
+        httpp_span_t addr = {"10.0.0.1", 8, false};
+        httpp_log_format_t fmt;
+        httpp_log_t log;
+        char buf[512];
+        HTTPP_NEW_REQ(req, 8);
+
+        ASSERT(httpp_parse_request(raw, strlen(raw), &req) > 0);
+        ASSERT(httpp_log_format_init(&fmt, HTTPP_LOG_COMBINED, HTTPP_LOG_ESCAPE_DEFAULT));
+
+        httpp_log_init(&log, buf, sizeof(buf), -1);
+        httpp_log_entry_t e = {&req, addr, 200, 1234, 42500, 784111777};
+        ASSERT(httpp_log_write(&log, &fmt, &e));
+        buf[log.len] = '\0';
+        ASSERT_EQ_STR(buf, "10.0.0.1 - - [06/Nov/1994:08:49:37 +0000] \"GET /index.html?q=1 HTTP/1.1\" "
+                           "200 1234 \"-\" \"curl/8.0\"\n");
+
+        const char* json = "{\"time\":\"$time_iso8601\",\"method\":\"$request_method\",\"uri\":\"$request_uri\","
+                           "\"status\":$status,\"rt\":$request_time,\"host\":\"${http_host}\",\"ref\":\"$http_referer\"}";
+        ASSERT(httpp_log_format_init(&fmt, json, HTTPP_LOG_ESCAPE_JSON));
+
+        httpp_log_init(&log, buf, sizeof(buf), -1);
+        ASSERT(httpp_log_write(&log, &fmt, &e));
+        buf[log.len] = '\0';
+        ASSERT_EQ_STR(buf, "{\"time\":\"1994-11-06T08:49:37+00:00\",\"method\":\"GET\",\"uri\":\"/index.html?q=1\","
+                           "\"status\":200,\"rt\":0.042,\"host\":\"a\",\"ref\":\"\"}\n");
+
+        // Unknown variables are an error, a lone '$' is text
+        ASSERT(!httpp_log_format_init(&fmt, "$nope", HTTPP_LOG_ESCAPE_DEFAULT));
+        ASSERT(httpp_log_format_init(&fmt, "${status", HTTPP_LOG_ESCAPE_DEFAULT));
+        ASSERT(fmt.ops_len == 1 && fmt.ops[0].len == 8);
+        ASSERT(httpp_log_format_init(&fmt, "$ $status$", HTTPP_LOG_ESCAPE_DEFAULT));
+        httpp_log_init(&log, buf, sizeof(buf), -1);
+        ASSERT(httpp_log_write(&log, &fmt, &e));
+        buf[log.len] = '\0';
+        ASSERT_EQ_STR(buf, "$ 200$\n");
+    }
+
+    TEST("Access log escaping") {
+        // Bytes to escape in the first 16 byte block and in the tail after it
+        char raw[] = "GET /a\"b HTTP/1.1\r\nUser-Agent: 0123456789abcd\\ef\x01g\xc3\xa9\x7f\r\n\r\n";
+        httpp_span_t addr = {"::1", 3, false};
+        httpp_log_format_t fmt;
+        httpp_log_t log;
+        char buf[256];
+        HTTPP_NEW_REQ(req, 8);
+
+        ASSERT(httpp_parse_request(raw, strlen(raw), &req) > 0);
+        httpp_log_entry_t e = {&req, addr, 404, 0, 0, 0};
+
+        ASSERT(httpp_log_format_init(&fmt, "$request_uri $http_user_agent", HTTPP_LOG_ESCAPE_DEFAULT));
+        httpp_log_init(&log, buf, sizeof(buf), -1);
+        ASSERT(httpp_log_write(&log, &fmt, &e));
+        buf[log.len] = '\0';
+        ASSERT_EQ_STR(buf, "/a\\x22b 0123456789abcd\\x5Cef\\x01g\\xC3\\xA9\\x7F\n");
+
+        ASSERT(httpp_log_format_init(&fmt, "$request_uri $http_user_agent", HTTPP_LOG_ESCAPE_JSON));
+        httpp_log_init(&log, buf, sizeof(buf), -1);
+        ASSERT(httpp_log_write(&log, &fmt, &e));
+        buf[log.len] = '\0';
+        ASSERT_EQ_STR(buf, "/a\\\"b 0123456789abcd\\\\ef\\u0001g\xc3\xa9\x7f\n");
+    }
+
+    TEST("Access log batching") {
+        char raw[] = "GET /x HTTP/1.1\r\n\r\n";
+        httpp_span_t addr = {"1.2.3.4", 7, false};
+        httpp_log_format_t fmt;
+        httpp_log_t log;
+        char buf[64];
+        char out[256] = {0};
+        int fds[2];
+        HTTPP_NEW_REQ(req, 4);
+
+        ASSERT(pipe(fds) == 0);
+        ASSERT(httpp_parse_request(raw, strlen(raw), &req) > 0);
+        ASSERT(httpp_log_format_init(&fmt, "$remote_addr $request $status", HTTPP_LOG_ESCAPE_DEFAULT));
+
+        // 28 bytes a line, two fit in the buffer
+        httpp_log_init(&log, buf, sizeof(buf), fds[1]);
+        httpp_log_entry_t e = {&req, addr, 200, 0, 0, 0};
+        for (int i = 0; i < 5; i++)
+            ASSERT(httpp_log_write(&log, &fmt, &e));
+
+        ASSERT_EQ_INT(log.flushes, 2);
+        ASSERT_EQ_INT(log.len, 28);
+        ASSERT(httpp_log_flush(&log));
+        ASSERT_EQ_INT(log.len, 0);
+
+        ASSERT_EQ_INT(read(fds[0], out, sizeof(out) - 1), 5 * 28);
+        ASSERT(strncmp(out, "1.2.3.4 GET /x HTTP/1.1 200\n1.2.3.4 GET /x HTTP/1.1 200\n", 56) == 0);
+
+        // Longer than the whole buffer: cut, still one line
+        ASSERT(httpp_log_format_init(&fmt, "$request $request $request", HTTPP_LOG_ESCAPE_DEFAULT));
+        httpp_log_init(&log, buf, 16, fds[1]);
+        ASSERT(httpp_log_write(&log, &fmt, &e));
+        ASSERT_EQ_INT(log.len, 16);
+        ASSERT(memcmp(buf, "GET /x HTTP/1.1\n", 16) == 0);
+
+        close(fds[0]);
+        close(fds[1]);
+    }
+}
+
 int main() 
 {
     test_start_line_basic();
@@ -433,6 +2430,28 @@ int main()
     test_totally_invalid();
     test_binary_body();
     test_edge(); 
+    test_version_and_connection();
+    test_body_stream();
+    test_url_decode();
+    test_cookies();
+    test_accept();
+    test_response_template();
+    test_date();
+    test_file_body();
+    test_conditional_and_range();
+    test_multipart();
+    test_form();
+    test_ring();
+    test_forward();
+    test_scan();
+    test_parse_lazy();
+    test_allowlist();
+    test_header_cache();
+    test_ws();
+    test_hpack();
+    test_proxy();
+    test_expect();
+    test_log();
 
     printf("Tests run: %d, Failures: %d\n", tests_run, tests_failed);
     return tests_failed ? 1 : 0;
@@ -0,0 +1,333 @@
+// Tests of the C++ interface, g++ -std=c++17 test.cpp
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#define HTTPP_POSIX
+#define HTTPP_IMPLEMENTATION
+#include "httpp.hpp"
+
+#if __cplusplus >= 202002L && defined(__linux__)
+# define TEST_CORO
+# include "httpp_coro.hpp"
+#endif
+
+using namespace httpp::literals;
+
+int tests_run = 0;
+int tests_failed = 0;
+
+const char* current_test_name = NULL;
+
+#define TEST(name) \
+    for (current_test_name = name; current_test_name; current_test_name = NULL) \
+        if (1)
+
+#define ASSERT(expr) do { \
+    tests_run++; \
+    if (!(expr)) { \
+        fprintf(stderr, "[FAIL]: %d: %s: assertion `%s` failed\n", __LINE__, current_test_name, #expr); \
+        tests_failed++; \
+    } \
+} while (0)
+
+static_assert(httpp::name_hash("Content-Length") == httpp::name_hash("content-length"), "");
+static_assert("Host"_h.hash == httpp::name_hash("HOST"), "");
+
+void test_request()
+{
+    char raw[] =
+        "POST /items HTTP/1.1\r\n"
+        "Host: example.com\r\n"
+        "Content-Length: 4\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "body";
+
+    TEST("Request views") {
+        httpp::request req;
+        ASSERT(req.parse(raw, strlen(raw)) > 0);
+
+        ASSERT(req.method() == HTTPP_METHOD_POST);
+        ASSERT(req.method_name() == "POST");
+        ASSERT(req.route() == "/items");
+        ASSERT(req.body() == "body");
+        ASSERT(!req.keep_alive());
+        ASSERT(req.header("host"_h) == "example.com");
+        ASSERT(req.header("X-Missing"_h).empty());
+        ASSERT(req.headers().size() == 3);
+
+        size_t n = 0;
+        for (httpp::header h : req.headers())
+            n += !h.name.empty();
+        ASSERT(n == 3);
+
+        // Moved request keeps working, its headers array moves along
+        httpp::request moved = std::move(req);
+        ASSERT(moved.header("Content-Length"_h) == "4");
+    }
+}
+
+void test_response()
+{
+    TEST("Response RAII") {
+        httpp::response res(404);
+        ASSERT(res.add_header("Content-Type", "text/plain"));
+
+        std::string server = "httpp";
+        ASSERT(res.borrow_header("Server", server));
+        res.body("not found");
+
+        // Added headers are freed once, by the response that owns them
+        httpp::response moved = std::move(res);
+        ASSERT(res.headers().size() == 0);
+        ASSERT(moved.headers().find("content-type"_h) == "text/plain");
+
+        httpp::raw_response raw = moved.to_raw();
+        ASSERT(raw);
+        ASSERT(raw.view().find("Server: httpp\r\n") != std::string_view::npos);
+        ASSERT(raw.view().substr(raw.size() - 9) == "not found");
+    }
+}
+
+void test_parser()
+{
+    char raw[] =
+        "GET /ws HTTP/1.1\r\n"
+        "X-1: a\r\nX-2: b\r\nX-3: c\r\nX-4: d\r\nX-5: e\r\nX-6: f\r\nX-7: g\r\n"
+        "X-8: h\r\nX-9: i\r\nX-10: j\r\nX-11: k\r\nX-12: l\r\nX-13: m\r\nX-14: n\r\n"
+        "X-15: o\r\nX-16: p\r\nX-17: q\r\nX-18: r\r\nX-19: s\r\nX-20: t\r\nX-21: u\r\n"
+        "HOST: example.com\r\n"
+        "Connection: Upgrade\r\n"
+        "Upgrade: websocket\r\n"
+        "Host: second\r\n"
+        "\r\n";
+
+    TEST("Parser with a compile time header set") {
+        httpp::parser<httpp::hdr::host, httpp::hdr::upgrade, httpp::hdr::content_length> p;
+
+        // More headers than the default array capacity, the rest is skipped
+        ASSERT(p.parse(raw, strlen(raw)) == (int) strlen(raw));
+        ASSERT(p.route() == "/ws");
+        ASSERT(p.get<httpp::hdr::host>() == "example.com");
+        ASSERT(p.get<httpp::hdr::upgrade>() == "websocket");
+        ASSERT(!p.has<httpp::hdr::content_length>());
+        ASSERT(p.upgrade() && p.keep_alive());
+    }
+
+    TEST("Parser lets close win over keep-alive") {
+        char both[] = "GET / HTTP/1.0\r\nConnection: close, keep-alive\r\nConnection: Keep-Alive\r\n\r\n";
+        httpp::parser<httpp::hdr::host> p;
+
+        ASSERT(p.parse(both, strlen(both)) > 0);
+        ASSERT(!p.keep_alive());
+    }
+
+    TEST("Parser flags Expect: 100-continue") {
+        char upload[] = "PUT /f HTTP/1.1\r\nExpect: 100-Continue\r\nContent-Length: 9\r\n\r\n";
+        httpp::parser<httpp::hdr::content_length> p;
+
+        ASSERT(p.parse(upload, strlen(upload)) > 0);
+        ASSERT(p.expect_continue());
+
+        httpp::request req;
+        ASSERT(req.parse(upload, strlen(upload)) > 0);
+        ASSERT(req.expect_continue());
+
+        ASSERT(p.parse(raw, strlen(raw)) > 0);
+        ASSERT(!p.expect_continue());
+    }
+
+    TEST("Parser rejects what the C parser rejects") {
+        char bad[] = "GET / HTTP/1.1\r\n bad: header\r\n\r\n";
+        httpp::parser<httpp::hdr::host> p;
+        ASSERT(p.parse(bad, strlen(bad)) == -1);
+    }
+
+#if __cplusplus >= 202002L
+    TEST("Parser with named headers") {
+        char req[] = "GET / HTTP/1.1\r\nx-api-key: secret\r\n\r\n";
+        httpp::parser<httpp::hdr::named<"X-Api-Key">> p;
+
+        ASSERT(p.parse(req, strlen(req)) > 0);
+        ASSERT(p.get<httpp::hdr::named<"X-Api-Key">>() == "secret");
+    }
+#endif
+}
+
+#ifdef TEST_CORO
+using coro_conn = httpp::coro::connection<httpp::coro::epoll_backend, 256>;
+
+struct coro_log {
+    std::string routes;
+    std::string bodies;
+    int served = 0;
+    bool done = false;
+};
+
+httpp::coro::task<void> coro_serve(coro_conn& conn, coro_log& log)
+{
+    httpp::response res(200);
+    res.body("ok");
+
+    while (auto req = co_await conn.read_request()) {
+        auto body = co_await conn.read_body(*req);
+        if (!body)
+            break;
+
+        log.routes += std::string(req->route()) + " ";
+        log.bodies += std::string(*body);
+        log.served++;
+
+        if (!co_await conn.write_response(res))
+            break;
+    }
+
+    co_await conn.write_chunk("bye");
+    co_await conn.write_chunk("");
+    log.done = true;
+}
+
+// Reads bodies of /read only
+httpp::coro::task<void> coro_serve_some(coro_conn& conn, coro_log& log)
+{
+    while (auto req = co_await conn.read_request()) {
+        log.routes += std::string(req->route()) + " ";
+        log.served++;
+
+        if (req->route() == "/read") {
+            auto body = co_await conn.read_body(*req);
+            if (!body)
+                break;
+            log.bodies += std::string(*body);
+        }
+    }
+
+    log.done = true;
+}
+
+void test_coro()
+{
+    TEST("Coroutine connection") {
+        int sv[2];
+        ASSERT(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) == 0);
+
+        httpp::coro::epoll_backend backend;
+        ASSERT(backend.valid() && backend.add(sv[0]));
+
+        coro_conn conn(backend, sv[0]);
+        coro_log log;
+
+        // Two pipelined requests at once, the third one split in the middle of the body
+        const char* first =
+            "POST /a HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc"
+            "GET /b HTTP/1.1\r\n\r\n"
+            "POST /c HTTP/1.1\r\nContent-Len";
+        const char* rest = "gth: 4\r\n\r\nde";
+
+        ASSERT(write(sv[1], first, strlen(first)) == (ssize_t) strlen(first));
+        httpp::coro::spawn(coro_serve(conn, log));
+        backend.run_once(0);
+        ASSERT(log.served == 2);
+
+        ASSERT(write(sv[1], rest, strlen(rest)) == (ssize_t) strlen(rest));
+        backend.run_once(100);
+        ASSERT(log.served == 2);
+
+        size_t blocks = httpp::coro::frame_pool::blocks();
+
+        ASSERT(write(sv[1], "fg", 2) == 2);
+        backend.run_once(100);
+        ASSERT(log.served == 3);
+
+        // Frames of later requests reuse pooled blocks
+        char more[] = "GET /d HTTP/1.1\r\n\r\n";
+        for (int i = 0; i < 10; i++) {
+            ASSERT(write(sv[1], more, strlen(more)) == (ssize_t) strlen(more));
+            backend.run_once(100);
+        }
+        ASSERT(log.served == 13);
+        ASSERT(httpp::coro::frame_pool::blocks() == blocks);
+
+        shutdown(sv[1], SHUT_WR);
+        backend.run_once(100);
+        ASSERT(log.done);
+        ASSERT(log.routes.substr(0, 9) == "/a /b /c ");
+        ASSERT(log.bodies == "abcdefg");
+
+        char out[4096];
+        std::string wire;
+        ssize_t r;
+        while ((r = read(sv[1], out, sizeof(out))) > 0)
+            wire.append(out, r);
+
+        size_t ok = 0;
+        for (size_t pos = 0; (pos = wire.find("HTTP/1.1 200 OK\r\n", pos)) != std::string::npos; pos++)
+            ok++;
+        ASSERT(ok == 13);
+        ASSERT(wire.size() >= 13 && wire.substr(wire.size() - 13) == "3\r\nbye\r\n0\r\n\r\n");
+
+        backend.remove(sv[0]);
+        close(sv[0]);
+        close(sv[1]);
+    }
+
+    TEST("Coroutine connection skips unread bodies, decodes chunked ones") {
+        int sv[2];
+        ASSERT(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) == 0);
+
+        httpp::coro::epoll_backend backend;
+        ASSERT(backend.valid() && backend.add(sv[0]));
+
+        coro_conn conn(backend, sv[0]);
+        coro_log log;
+
+        // /skip bodies are never read, the one of /big is bigger than the 256 byte buffer
+        std::string big(600, 'x');
+        std::string wire =
+            "POST /skip HTTP/1.1\r\nContent-Length: 20\r\n\r\nGET /smuggled HTTP/1.1\r\n"
+            "POST /read HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3;x=y\r\nabc\r\nA\r\n0123456789\r\n0\r\nT: 1\r\n\r\n"
+            "POST /skip HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nGET /\r\n0\r\n\r\n"
+            "POST /big HTTP/1.1\r\nContent-Length: 600\r\n\r\n" + big +
+            "POST /read HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n2\r\nhi\r\n0\r\n\r\n";
+
+        httpp::coro::spawn(coro_serve_some(conn, log));
+
+        // In small pieces, chunk lines and data get split
+        for (size_t off = 0; off < wire.size(); off += 50) {
+            std::string piece = wire.substr(off, 50);
+            ASSERT(write(sv[1], piece.data(), piece.size()) == (ssize_t) piece.size());
+            backend.run_once(100);
+        }
+
+        ASSERT(log.routes == "/skip /read /skip /big /read ");
+        ASSERT(log.bodies == "abc0123456789hi");
+
+        // Content-Length with Transfer-Encoding is not served
+        const char* both = "POST /read HTTP/1.1\r\nContent-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n";
+        ASSERT(write(sv[1], both, strlen(both)) == (ssize_t) strlen(both));
+        backend.run_once(100);
+        ASSERT(log.done);
+        ASSERT(log.served == 5);
+
+        backend.remove(sv[0]);
+        close(sv[0]);
+        close(sv[1]);
+    }
+}
+#endif
+
+int main()
+{
+    test_request();
+    test_response();
+    test_parser();
+#ifdef TEST_CORO
+    test_coro();
+#endif
+
+    printf("Tests run: %d, Failures: %d\n", tests_run, tests_failed);
+    return tests_failed ? 1 : 0;
+}